@@ -37,16 +37,28 @@
 #include "librorc/device.hh"
 #include "librorc/sysfs_handler.hh"
 #include "librorc/bar.hh"
+#include "librorc/bar_profiler.hh"
 #include "librorc/buffer.hh"
+#include "librorc/hash.hh"
+#include "librorc/parallel.hh"
 #include "librorc/flash.hh"
 #include "librorc/sysmon.hh"
+#include "librorc/telemetry.hh"
 #include "librorc/refclk.hh"
 #include "librorc/microcontroller.hh"
 #include "librorc/dma_channel.hh"
 #include "librorc/event_stream.hh"
+#include "librorc/event_builder.hh"
+#include "librorc/cdh.hh"
+#include "librorc/event_index.hh"
+#include "librorc/event_prefilter.hh"
+#include "librorc/metrics_exporter.hh"
 #include "librorc/patterngenerator.hh"
 #include "librorc/fastclusterfinder.hh"
+#include "librorc/fcf_decoder.hh"
+#include "librorc/fcf_software.hh"
 #include "librorc/datareplaychannel.hh"
+#include "librorc/datareplayplaylist.hh"
 #include "librorc/ddl.hh"
 #include "librorc/diu.hh"
 #include "librorc/siu.hh"
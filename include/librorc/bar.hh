@@ -30,16 +30,32 @@
 #ifndef LIBRORC_BAR_H
 #define LIBRORC_BAR_H
 
+#include <vector>
+
 namespace LIBRARY_NAME {
 class device;
-class bar_impl_hw;
-class bar_impl_sim;
+class bar_impl;
 
 typedef uint64_t bar_address;
 
 class bar {
 public:
   bar(device *dev, int32_t n);
+
+  /**
+   * attach to an existing memory mapping instead of a device BAR, e.g.
+   * anonymous memory for testing and benchmarking. The mapping is not
+   * released on destruction.
+   * @param map start of the mapping
+   * @param size size of the mapping in bytes
+   **/
+  bar(uint8_t *map, size_t size);
+
+  /**
+   * use a custom backend. The bar takes ownership of impl.
+   **/
+  bar(bar_impl *impl);
+
   ~bar();
 
   /**
@@ -86,7 +102,8 @@ public:
    * get current time of day
    * @param tv pointer to struct timeval
    * @param tz pointer to struct timezone
-   * @return return value from gettimeof day or zero for FLI simulation
+   * @return return value from gettimeof day, for FLI simulation zero or -1
+   * if the connection to the simulator is lost
    **/
   int32_t gettime(struct timeval *tv, struct timezone *tz);
 
@@ -98,14 +115,119 @@ public:
 
   void simSetPacketSize(uint32_t packet_size);
 
-protected:
+  /**
+   * get the device this BAR belongs to
+   * @return parent device or NULL for mappings and custom backends
+   **/
+  device *getDevice() { return m_dev; }
+
+  /**
+   * enable or disable posted writes. By default, each write is followed by
+   * an msync() of the affected page. With posted writes enabled, writes are
+   * plain stores and callers have to use flush() where the hardware
+   * requires previous writes to be completed.
+   * @param enable true to enable posted writes
+   **/
+  void setPostedWrites(bool enable);
+
+  /**
+   * check whether posted writes are enabled
+   * @return true if enabled
+   **/
+  bool postedWrites();
+
+  /**
+   * order all previous writes with a store fence and wait for them to
+   * reach the device with a non-posted read.
+   * @param readback address to read back, defaults to the first register
+   * of the BAR
+   **/
+  void flush(bar_address readback = 0);
+
+  /**
+   * write num bytes starting at target without waiting for completion,
+   * regardless of the posted write setting. Each DW is written exactly
+   * once, in address order. Use flush() afterwards.
+   * @param target address
+   * @param source address
+   * @param num number of bytes, multiple of 4
+   **/
+  void memcopyPosted(bar_address target, const void *source, size_t num);
+
+  /**
+   * @brief collects a sequence of register writes and applies them in
+   * one pass.
+   *
+   * Writes to consecutive addresses are merged into a single
+   * memcopyPosted() burst, and all writes are completed with a single
+   * flush() at the end of apply(). Bursts are written as single DW
+   * stores in address order, so the order of the writes is preserved and
+   * a write that has to happen last (e.g. an enable bit) can simply be
+   * added last.
+   **/
+  class transaction {
+  public:
+    transaction(bar *bar);
+
+    /**
+     * add a DW write
+     * @param address target address
+     * @param data data to be written
+     **/
+    void set32(bar_address address, uint32_t data);
+
+    /**
+     * add a masked DW write: only the bits set in mask are replaced with
+     * the corresponding bits of data. The remaining bits are taken from a
+     * previous write to the same address in this transaction if available,
+     * otherwise they are read from the device in apply().
+     * @param address target address
+     * @param mask bits to be modified
+     * @param data new value of the masked bits
+     **/
+    void modify32(bar_address address, uint32_t mask, uint32_t data);
+
+    /**
+     * add writes of consecutive DWs
+     * @param target address of the first DW
+     * @param source data to be written
+     * @param num number of bytes, multiple of 4
+     **/
+    void memcopy(bar_address target, const void *source, size_t num);
+
+    /**
+     * write all collected registers and wait for completion. The
+     * transaction is empty afterwards.
+     * @param readback address used for the completing read, see
+     * bar::flush()
+     * @return number of bursts issued
+     **/
+    size_t apply(bar_address readback = 0);
 
+    /**
+     * get number of collected DW writes
+     **/
+    size_t size() { return m_entries.size(); }
 
-#ifdef MODELSIM
-  bar_impl_sim *p;
-#else
-  bar_impl_hw *p;
-#endif
+    /**
+     * drop all collected writes
+     **/
+    void clear() { m_entries.clear(); }
+
+  protected:
+    typedef struct {
+      bar_address address;
+      uint32_t mask;
+      uint32_t data;
+    } entry;
+
+    bar *m_bar;
+    std::vector<entry> m_entries;
+  };
+
+protected:
+  bar_impl *p;
+  device *m_dev;
 };
 }
 #endif /** LIBRORC_BAR_H */
@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2014, Heiko Engel <hengel@cern.ch>
+ * Copyright (c) 2014, Dominic Eschweiler <dominic.eschweiler@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, FIAS, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * The bar_impl class is the common interface of all BAR backends
+ */
+
+#ifndef LIBRORC_BAR_IMPL_H
+#define LIBRORC_BAR_IMPL_H
+
+#include <librorc/defines.hh>
+#include <librorc/bar.hh>
+
+namespace LIBRARY_NAME
+{
+    /**
+     * @brief Interface implemented by all BAR backends. librorc::bar
+     * forwards all accesses to an instance of this class.
+     */
+    class bar_impl
+    {
+        public:
+            virtual ~bar_impl() {}
+
+            virtual void
+            memcopy
+            (
+                bar_address  target,
+                const void  *source,
+                size_t       num
+            ) = 0;
+
+            virtual void
+            memcopy
+            (
+                void        *target,
+                bar_address  source,
+                size_t       num
+            ) = 0;
+
+            virtual uint32_t get32( bar_address address ) = 0;
+            virtual uint16_t get16( bar_address address ) = 0;
+
+            virtual void
+            set32
+            (
+                bar_address address,
+                uint32_t data
+            ) = 0;
+
+            virtual void
+            set16
+            (
+                bar_address address,
+                uint16_t data
+            ) = 0;
+
+            virtual int32_t
+            gettime
+            (
+                struct timeval *tv,
+                struct timezone *tz
+            ) = 0;
+
+            virtual size_t size() = 0;
+
+            virtual void
+            simSetPacketSize
+            (
+                uint32_t packet_size
+            ) = 0;
+
+            /**
+             * enable/disable posted writes. Backends without a notion of
+             * posted writes may ignore this.
+             **/
+            virtual void setPostedWrites( bool enable ) {}
+            virtual bool postedWrites() { return false; }
+
+            /**
+             * make sure all previous writes have reached the device
+             * @param readback address for the completing non-posted read
+             **/
+            virtual void flush( bar_address readback ) {}
+
+            /**
+             * write without waiting for completion, see
+             * bar::memcopyPosted(). Backends without posted writes use
+             * the regular memcopy.
+             **/
+            virtual void
+            memcopyPosted
+            (
+                bar_address  target,
+                const void  *source,
+                size_t       num
+            )
+            { memcopy(target, source, num); }
+    };
+}
+#endif /** LIBRORC_BAR_IMPL_H */
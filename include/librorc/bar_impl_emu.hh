@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#ifndef LIBRORC_BAR_IMPL_EMU_H
+#define LIBRORC_BAR_IMPL_EMU_H
+
+#include <pthread.h>
+#include <vector>
+
+#include <librorc/defines.hh>
+#include <librorc/bar.hh>
+#include <librorc/bar_impl.hh>
+#include <librorc/buffer.hh>
+#include <librorc/registers.h>
+
+/**
+ * In-process software model of a C-RORC for host-side tests and
+ * benchmarks without hardware or HDL simulator.
+ *
+ * The register file lives in memory. Each link has a DMA engine thread
+ * that generates PatternGenerator events and writes them together with
+ * their EventDescriptors into the Event- and ReportBuffer the same way
+ * the firmware does:
+ * - events start at PCIe packet aligned EventBuffer offsets
+ * - the EventDescriptor is written after the event data, its
+ *   reported_event_size is written last
+ * - the engine stalls while the next write would reach the software read
+ *   pointers and sets the pointer stall flags in DMA_CTRL
+ *
+ * There is no IOMMU in between: the addresses in the scatter gather lists
+ * programmed via dma_channel are host virtual addresses. Use
+ * allocateHostBuffer() to get suitable buffers from anonymous shared memory
+ * or hugetlbfs.
+ *
+ * Generated events consist of an 8 DW CDH with the event ID in DW1[11:0]
+ * and DW2[23:0], followed by the configured pattern. Only the
+ * PatternGenerator is modelled as data source.
+ **/
+#define LIBRORC_EMU_DEFAULT_CHANNELS 12
+#define LIBRORC_EMU_MAX_SG_ENTRIES 2048
+#define LIBRORC_EMU_CDH_SIZE 8
+
+namespace LIBRARY_NAME
+{
+    class bar_emu_channel;
+
+    /**
+     * @brief BAR backend emulating a C-RORC in software
+     **/
+    class bar_impl_emu : public bar_impl
+    {
+        public:
+            /**
+             * @param channels number of links/DMA channels to emulate
+             * @param fw_type firmware type reported in TYPE_CHANNELS
+             * throws LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED
+             **/
+            bar_impl_emu
+            (
+                uint32_t channels = LIBRORC_EMU_DEFAULT_CHANNELS,
+                uint32_t fw_type = RORC_CFG_PROJECT_hlt_in
+            );
+
+            virtual ~bar_impl_emu();
+
+            void
+            memcopy
+            (
+                bar_address  target,
+                const void  *source,
+                size_t       num
+            );
+
+            void
+            memcopy
+            (
+                void        *target,
+                bar_address  source,
+                size_t       num
+            );
+
+            uint32_t get32( bar_address address );
+            uint16_t get16( bar_address address );
+
+            void
+            set32
+            (
+                bar_address address,
+                uint32_t data
+            );
+
+            void
+            set16
+            (
+                bar_address address,
+                uint16_t data
+            );
+
+            int32_t
+            gettime
+            (
+                struct timeval *tv,
+                struct timezone *tz
+            );
+
+            size_t size();
+
+            void
+            simSetPacketSize
+            (
+                uint32_t packet_size
+            );
+
+            /**
+             * number of emulated channels
+             **/
+            uint32_t channels()
+            { return m_channels.size(); }
+
+            /**
+             * allocate host memory usable as DMA buffer. Like the buffers
+             * from the kernel driver it is overmapped, so events wrapping
+             * around the end of the buffer are contiguous in memory.
+             * @param size buffer size in bytes, multiple of the page size
+             * @param hugepages try hugetlbfs first, falls back to regular
+             *        pages
+             * @return pointer to the buffer, NULL on error
+             **/
+            static void *allocateHostBuffer( size_t size, bool hugepages );
+
+            /**
+             * release a buffer from allocateHostBuffer()
+             **/
+            static void freeHostBuffer( void *mem, size_t size );
+
+            /**
+             * scatter gather list describing a buffer from
+             * allocateHostBuffer(), to be used with dma_channel::configure()
+             **/
+            static std::vector<ScatterGatherEntry>
+            sgList
+            (
+                void   *mem,
+                size_t  size
+            );
+
+        protected:
+            uint32_t                       *m_regs;
+            size_t                          m_size;
+            std::vector<bar_emu_channel *>  m_channels;
+
+            uint32_t readRegister( bar_address address );
+            void writeRegister( bar_address address, uint32_t data );
+    };
+}
+#endif /** LIBRORC_BAR_IMPL_EMU_H */
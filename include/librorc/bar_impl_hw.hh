@@ -43,8 +43,15 @@
 
 #include <librorc/defines.hh>
 #include <librorc/bar.hh>
+#include <librorc/bar_impl.hh>
 
 
+/**
+ * number of locks protecting multi-word writes. Each link register file
+ * maps onto its own lock, so channels do not contend with each other.
+ **/
+#define LIBRORC_BAR_LOCK_STRIPES 16
+
 namespace LIBRARY_NAME
 {
     class device;
@@ -53,7 +60,7 @@ namespace LIBRARY_NAME
      * @brief Represents a Base Address Register (BAR) file
      * mapping of the RORCs PCIe address space
      */
-    class bar_impl_hw
+    class bar_impl_hw : public bar_impl
     {
         public:
             bar_impl_hw
@@ -62,7 +69,16 @@ namespace LIBRARY_NAME
                 int32_t  n
             );
 
-            ~bar_impl_hw();
+            /**
+             * use an existing memory mapping as BAR
+             **/
+            bar_impl_hw
+            (
+                uint8_t *map,
+                size_t   size
+            );
+
+            virtual ~bar_impl_hw();
 
             void
             memcopy
@@ -112,16 +128,31 @@ namespace LIBRARY_NAME
                 uint32_t packet_size
             );
 
+            void setPostedWrites( bool enable );
+            bool postedWrites();
+            void flush( bar_address readback );
+
+            void
+            memcopyPosted
+            (
+                bar_address  target,
+                const void  *source,
+                size_t       num
+            );
+
         protected:
 #ifdef PDA
             Bar *m_pda_bar;
             //PciDevice *m_pda_pci_device;
 #endif
             device *m_parent_dev;
-            pthread_mutex_t m_mtx;
+            pthread_mutex_t m_mtx[LIBRORC_BAR_LOCK_STRIPES];
             int32_t m_number;
             uint8_t *m_bar;
             size_t m_size;
+            bool m_posted_writes;
+
+            pthread_mutex_t *stripeLock( bar_address address );
     };
 
 }
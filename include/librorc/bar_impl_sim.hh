@@ -32,8 +32,14 @@
 #ifndef LIBRORC_BAR_IMPL_SIM_H
 #define LIBRORC_BAR_IMPL_SIM_H
 
+#include <pthread.h>
+#include <map>
+#include <vector>
+
 #include <librorc/defines.hh>
 #include <librorc/bar.hh>
+#include <librorc/bar_impl.hh>
+#include <librorc/buffer.hh>
 #ifdef PDA
 #include <pda.h>
 #endif
@@ -55,15 +61,101 @@
 
 #define DEFAULT_PACKET_SIZE 128
 
+/**
+ * maximum number of DWs merged into a single posted write message, and
+ * number of queued DWs after which posted writes are sent out
+ **/
+#define SIM_MAX_WRITE_DW    32
+#define SIM_TX_COALESCE_DW  4096
+
+/**
+ * default number of read completions sent to the simulator before
+ * waiting for their acknowledges
+ **/
+#define SIM_MAX_OUTSTANDING_CMPL 16
+
+/** socket receive buffer size in bytes */
+#define SIM_RX_BUFFER_SIZE  65536
+
+/**
+ * If set, connect to the simulator via this Unix domain socket instead of
+ * TCP port 2000 on MODELSIM_SERVER.
+ **/
+#define SIM_SOCKET_ENV "LIBRORC_SIM_SOCKET"
+
+/**
+ * A structure to represent FLI read request
+ */
+typedef struct
+__attribute__((__packed__))
+{
+	uint64_t buffer_id;     /**< Buffer-ID*/
+	uint64_t offset;        /**< Request offset*/
+	uint16_t length;        /**< Lenght of request*/
+	uint8_t  tag;           /**< Request tag */
+	uint8_t  lower_addr;    /**< Lower alligned address */
+	uint8_t  byte_enable;   /**< Request byte-enable*/
+	uint32_t requester_id;  /**< Requester-ID*/
+} t_read_req;
+
+
 namespace LIBRARY_NAME
 {
     class device;
 
+    /**
+     * @brief sorted interval index from physical DMA addresses to buffer
+     * ID and buffer offset
+     **/
+    class sim_dma_map
+    {
+        public:
+            void clear();
+
+            /**
+             * add all segments of a buffer
+             * @param buffer_id buffer ID
+             * @param sglist scatter gather list of the buffer
+             **/
+            void
+            add
+            (
+                uint64_t                               buffer_id,
+                const std::vector<ScatterGatherEntry> &sglist
+            );
+
+            /**
+             * resolve a physical address
+             * @return true if the address belongs to a known buffer
+             **/
+            bool
+            lookup
+            (
+                uint64_t  phys_addr,
+                uint64_t *buffer_id,
+                uint64_t *offset
+            );
+
+            size_t size()
+            { return m_ranges.size(); }
+
+        protected:
+            typedef struct
+            {
+                uint64_t end;
+                uint64_t buffer_id;
+                uint64_t offset;
+            } range;
+
+            /** keyed by the physical start address of a segment */
+            std::map<uint64_t, range> m_ranges;
+    };
+
     /**
      * @brief Represents a simulated Base Address Register
      * (BAR) file mapping of the RORCs PCIe address space
      */
-    class bar_impl_sim
+    class bar_impl_sim : public bar_impl
     {
         public:
             bar_impl_sim
@@ -72,6 +164,21 @@ namespace LIBRARY_NAME
                 int32_t  n
             );
 
+            /**
+             * use an already connected FLI socket, e.g. one end of a
+             * socketpair(). DMA requests from the device need a parent
+             * device and are not supported on such a BAR.
+             * @param sockfd connected socket, the BAR takes ownership
+             * @param n BAR number
+             * @param size BAR size in bytes
+             **/
+            bar_impl_sim
+            (
+                int      sockfd,
+                int32_t  n,
+                size_t   size
+            );
+
              virtual
             ~bar_impl_sim();
 
@@ -124,6 +231,43 @@ namespace LIBRARY_NAME
                 uint32_t packet_size
             );
 
+            /**
+             * set the number of read completions that may be outstanding
+             * towards the simulator. 1 waits for the acknowledge of each
+             * completion.
+             **/
+            void
+            simSetMaxOutstandingCompletions
+            (
+                uint32_t count
+            );
+
+            /**
+             * posted writes are queued, merged with writes to consecutive
+             * addresses and sent without waiting for the acknowledge.
+             * flush() or any read sends out the queue, flush() also waits
+             * for all acknowledges.
+             **/
+            void setPostedWrites( bool enable );
+            bool postedWrites();
+            void flush( bar_address readback );
+
+            /**
+             * drop the DMA address index and all cached buffer mappings.
+             * The index is rebuilt with the next DMA request. Lookup
+             * misses rebuild it automatically, call this after buffers
+             * have been deleted.
+             **/
+            void invalidateAddressMap();
+
+            void
+            memcopyPosted
+            (
+                bar_address  target,
+                const void  *source,
+                size_t       num
+            );
+
 
         private:
             device *m_parent_dev;
@@ -131,6 +275,8 @@ namespace LIBRARY_NAME
             PciDevice *m_pda_pci_device;
 #endif
             pthread_mutex_t m_mtx;
+            pthread_mutex_t m_ack_mtx;
+            pthread_cond_t  m_ack_cond;
             int32_t m_number;
             uint8_t *m_bar;
             size_t m_size;
@@ -142,10 +288,40 @@ namespace LIBRARY_NAME
             uint32_t m_read_from_dev_done;
             uint64_t m_read_time_data;
             uint32_t m_read_time_done;
-            uint32_t m_write_to_dev_done;
-            uint32_t m_cmpl_to_dev_done;
             uint32_t m_max_packet_size;
 
+            /** serializes writes to the socket and message IDs */
+            pthread_mutex_t m_sock_mtx;
+
+            /** completion window, m_cmpl_acked protected by m_ack_mtx */
+            uint64_t m_cmpl_sent;
+            uint64_t m_cmpl_acked;
+            uint32_t m_max_outstanding_cmpl;
+
+            /** transmit queue, protected by m_mtx */
+            std::vector<uint32_t> m_tx;
+            std::vector<size_t>   m_tx_headers;
+            size_t   m_last_write;
+            bool     m_posted_writes;
+            /** writes in the transmit queue */
+            uint64_t m_writes_queued;
+            /** writes that went out on the socket */
+            uint64_t m_writes_sent;
+            /** protected by m_ack_mtx */
+            uint64_t m_writes_acked;
+            /** false once the socket failed, protected by m_ack_mtx */
+            bool     m_connected;
+
+            /** DMA address index and buffer cache, protected by m_map_mtx */
+            pthread_mutex_t               m_map_mtx;
+            sim_dma_map                   m_dma_map;
+            std::map<uint64_t, buffer *>  m_dma_buffers;
+            bool                          m_dma_map_valid;
+
+            uint8_t  m_rx[SIM_RX_BUFFER_SIZE];
+            size_t   m_rx_pos;
+            size_t   m_rx_len;
+
             pthread_t sock_mon_p;
             pthread_t cmpl_handler_p;
 
@@ -153,6 +329,46 @@ namespace LIBRARY_NAME
             void *sockMonitor();
             void *cmplHandler();
 
+            void init();
+
+            void
+            writeToDevice
+            (
+                uint32_t        address,
+                uint8_t         byte_enable,
+                const uint32_t *data,
+                size_t          ndw,
+                bool            posted
+            );
+
+            void
+            queueMessage
+            (
+                uint32_t *msg,
+                size_t    ndw
+            );
+
+            int sendQueue();
+
+            int
+            sendMessages
+            (
+                std::vector<uint32_t> &msgs,
+                std::vector<size_t>   &headers
+            );
+
+            bool
+            queueCompletion
+            (
+                t_read_req            *rdreq,
+                std::vector<uint32_t> &batch,
+                std::vector<size_t>   &headers
+            );
+            int waitForWriteAcks( uint64_t count );
+            int waitForFlag( volatile uint32_t *flag );
+            void disconnect();
+            void setFlag( volatile uint32_t *flag );
+
             static void*
             sock_monitor_helper(void * This)
             {
@@ -167,6 +383,10 @@ namespace LIBRARY_NAME
                 return 0;
             }
 
+            /**
+             * read one DW from the socket through the receive buffer
+             * @return DW, 0 on end of stream
+             **/
             uint32_t
             readDWfromSock
             (
@@ -216,26 +436,29 @@ namespace LIBRARY_NAME
                 uint64_t *buffer_id,
                 uint64_t *offset
             );
+
+            void rebuildAddressMap();
+            void clearAddressMap();
+
+            /**
+             * copy from/to a DMA buffer
+             * @return 0 on success, 1 if the buffer is unknown
+             **/
+            int32_t
+            dmaCopy
+            (
+                uint64_t  buffer_id,
+                uint64_t  offset,
+                void     *data,
+                size_t    num,
+                bool      to_host
+            );
     };
 
 
 }
 
 
-/**
- * A structure to represent FLI read request
- */
-typedef struct
-__attribute__((__packed__))
-{
-	uint64_t buffer_id;     /**< Buffer-ID*/
-	uint64_t offset;        /**< Request offset*/
-	uint16_t length;        /**< Lenght of request*/
-	uint8_t  tag;           /**< Request tag */
-	uint8_t  lower_addr;    /**< Lower alligned address */
-	uint8_t  byte_enable;   /**< Request byte-enable*/
-	uint32_t requester_id;  /**< Requester-ID*/
-} t_read_req;
 
 /**
  * A structure to represent FLI Messaging
@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#ifndef LIBRORC_BAR_IMPL_TRACE_H
+#define LIBRORC_BAR_IMPL_TRACE_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <librorc/defines.hh>
+#include <librorc/bar.hh>
+#include <librorc/bar_impl.hh>
+
+/**
+ * Register trace file format, all values little endian:
+ *
+ * header: "RORCTRC1", uint64_t BAR size in bytes
+ * record: uint8_t op, varint start time delta to the previous record [ns],
+ *         varint duration [ns], varint address, payload
+ *
+ * Varints are LEB128 encoded. The payload is 4 bytes for 32 bit accesses,
+ * 2 bytes for 16 bit accesses, a varint length followed by the data for
+ * memcopy and empty for flush. Addresses are in the units of the according
+ * bar access.
+ **/
+#define LIBRORC_TRACE_MAGIC "RORCTRC1"
+
+/** number of records a replay searches ahead to resynchronize */
+#define LIBRORC_TRACE_RESYNC_WINDOW 64
+
+namespace LIBRARY_NAME
+{
+    typedef enum
+    {
+        LIBRORC_TRACE_GET32 = 1,
+        LIBRORC_TRACE_SET32,
+        LIBRORC_TRACE_GET16,
+        LIBRORC_TRACE_SET16,
+        LIBRORC_TRACE_COPY_TO_DEV,
+        LIBRORC_TRACE_COPY_FROM_DEV,
+        LIBRORC_TRACE_FLUSH
+    } bar_trace_op;
+
+    typedef struct
+    {
+        uint8_t              op;
+        uint64_t             start_ns;
+        uint64_t             duration_ns;
+        bar_address          address;
+        uint32_t             value; /** 32/16 bit accesses */
+        std::vector<uint8_t> data;  /** memcopy */
+    } bar_trace_record;
+
+    /**
+     * @brief reads a register trace file record by record
+     **/
+    class bar_trace_reader
+    {
+        public:
+            /**
+             * throws LIBRORC_BAR_ERROR_TRACE_OPEN_FAILED or
+             * LIBRORC_BAR_ERROR_TRACE_INVALID
+             **/
+            bar_trace_reader( const char *path );
+
+            /**
+             * decode the next record
+             * @param rec [out] record, start_ns is absolute
+             * @return true on success, false at the end of the trace
+             **/
+            bool next( bar_trace_record *rec );
+
+            /** rewind to the first record **/
+            void rewind();
+
+            /** BAR size of the recorded device in bytes **/
+            size_t barSize()
+            { return m_bar_size; }
+
+            /** get textual name of a bar_trace_op **/
+            static const char *opName( uint8_t op );
+
+        protected:
+            std::vector<uint8_t> m_trace;
+            size_t               m_pos;
+            uint64_t             m_time;
+            size_t               m_bar_size;
+
+            bool readVarint( uint64_t *value );
+    };
+
+    /**
+     * @brief BAR backend that forwards all accesses to another backend and
+     * records them into a register trace file
+     **/
+    class bar_impl_trace_recorder : public bar_impl
+    {
+        public:
+            /**
+             * @param inner backend to record, the recorder takes ownership
+             * @param path trace file to be written
+             * throws LIBRORC_BAR_ERROR_TRACE_OPEN_FAILED
+             **/
+            bar_impl_trace_recorder
+            (
+                bar_impl   *inner,
+                const char *path
+            );
+
+            virtual ~bar_impl_trace_recorder();
+
+            void memcopy( bar_address target, const void *source, size_t num );
+            void memcopy( void *target, bar_address source, size_t num );
+            void memcopyPosted
+            (
+                bar_address  target,
+                const void  *source,
+                size_t       num
+            );
+            uint32_t get32( bar_address address );
+            uint16_t get16( bar_address address );
+            void set32( bar_address address, uint32_t data );
+            void set16( bar_address address, uint16_t data );
+            int32_t gettime( struct timeval *tv, struct timezone *tz );
+            size_t size();
+            void simSetPacketSize( uint32_t packet_size );
+            void setPostedWrites( bool enable );
+            bool postedWrites();
+            void flush( bar_address readback );
+
+        protected:
+            bar_impl        *m_inner;
+            FILE            *m_fd;
+            pthread_mutex_t  m_mtx;
+            uint64_t         m_last_ns;
+
+            void record
+            (
+                uint8_t      op,
+                uint64_t     start_ns,
+                bar_address  address,
+                uint32_t     value,
+                const void  *data,
+                size_t       num
+            );
+    };
+
+    /**
+     * @brief BAR backend that serves reads from a register trace and
+     * checks writes against it.
+     *
+     * Accesses are expected in the recorded order. If an access does not
+     * match the next record, the replay searches the following
+     * LIBRORC_TRACE_RESYNC_WINDOW records for it, e.g. to tolerate a
+     * different number of status polls. If none matches, the access is
+     * counted as mismatch and reads return the last value seen for the
+     * address. In strict mode, a mismatch throws
+     * LIBRORC_BAR_ERROR_REPLAY_MISMATCH instead.
+     **/
+    class bar_impl_trace_replay : public bar_impl
+    {
+        public:
+            /**
+             * throws LIBRORC_BAR_ERROR_TRACE_OPEN_FAILED or
+             * LIBRORC_BAR_ERROR_TRACE_INVALID
+             **/
+            bar_impl_trace_replay( const char *path );
+            virtual ~bar_impl_trace_replay();
+
+            void memcopy( bar_address target, const void *source, size_t num );
+            void memcopy( void *target, bar_address source, size_t num );
+            uint32_t get32( bar_address address );
+            uint16_t get16( bar_address address );
+            void set32( bar_address address, uint32_t data );
+            void set16( bar_address address, uint16_t data );
+            int32_t gettime( struct timeval *tv, struct timezone *tz );
+            size_t size();
+            void simSetPacketSize( uint32_t packet_size ){}
+            void flush( bar_address readback );
+
+            /**
+             * throw on the first mismatch instead of counting it
+             **/
+            void setStrict( bool strict )
+            { m_strict = strict; }
+
+            /**
+             * busy-wait the recorded duration of each access to reproduce
+             * the device latencies of the recorded run
+             **/
+            void setRealtime( bool realtime )
+            { m_realtime = realtime; }
+
+            /** number of accesses that did not match the trace **/
+            uint64_t mismatches()
+            { return m_mismatches; }
+
+            /** description of the first mismatch, empty if none **/
+            std::string firstMismatch()
+            { return m_first_mismatch; }
+
+            /** number of trace records not consumed yet **/
+            uint64_t remaining();
+
+        protected:
+            std::vector<bar_trace_record>   m_records;
+            size_t                          m_pos;
+            size_t                          m_bar_size;
+            bool                            m_strict;
+            bool                            m_realtime;
+            uint64_t                        m_mismatches;
+            std::string                     m_first_mismatch;
+            std::map<bar_address, uint32_t> m_last_value;
+            pthread_mutex_t                 m_mtx;
+
+            const bar_trace_record *match
+            (
+                uint8_t     op,
+                bar_address address
+            );
+
+            void mismatch
+            (
+                uint8_t      op,
+                bar_address  address,
+                const char  *reason
+            );
+    };
+}
+
+#endif /** LIBRORC_BAR_IMPL_TRACE_H */
@@ -0,0 +1,161 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#ifndef LIBRORC_BAR_PROFILER_H
+#define LIBRORC_BAR_PROFILER_H
+
+#include <iostream>
+#include <librorc/defines.hh>
+#include <librorc/bar.hh>
+
+/** number of log2(TSC cycles) latency bins **/
+#define LIBRORC_PROF_HIST_BINS 32
+/** address ranges: global registers plus up to 15 links **/
+#define LIBRORC_PROF_MAX_RANGES 16
+/** number of distinct subsystem scopes **/
+#define LIBRORC_PROF_MAX_SCOPES 32
+
+/**
+ * attribute all BAR accesses of the current thread until the end of the
+ * enclosing block to subsystem 'name'. 'name' has to be a string literal.
+ **/
+#define LIBRORC_PROFILE_SCOPE(name) \
+    LIBRARY_NAME::bar_profiler::scope librorc_profile_scope_(name)
+
+namespace LIBRARY_NAME
+{
+    typedef enum
+    {
+        LIBRORC_PROF_READ = 0,
+        LIBRORC_PROF_WRITE,
+        LIBRORC_PROF_FLUSH,
+        LIBRORC_PROF_NUM_OPS
+    } bar_profile_op;
+
+    typedef enum
+    {
+        LIBRORC_PROF_REGFILE_PCI = 0,
+        LIBRORC_PROF_REGFILE_GTX,
+        LIBRORC_PROF_REGFILE_DDL,
+        LIBRORC_PROF_NUM_REGFILES
+    } bar_profile_regfile;
+
+    typedef struct
+    {
+        uint64_t count;
+        uint64_t cycles;
+        uint64_t max_cycles;
+        uint64_t hist[LIBRORC_PROF_HIST_BINS]; /** bin n: [2^n, 2^(n+1)) */
+    } bar_profile_stats;
+
+    /**
+     * @brief process wide profiler of BAR register accesses
+     *
+     * When enabled, librorc::bar measures each access with the TSC and
+     * accounts it per address range (global registers or link, and the
+     * link's PCIe/GTX/DDL register file) and per calling subsystem, see
+     * LIBRORC_PROFILE_SCOPE. Profiling is disabled by default and can be
+     * enabled with setEnabled() or by setting the environment variable
+     * LIBRORC_BAR_PROFILE before the library is loaded. A disabled profiler
+     * costs a single branch per access.
+     **/
+    class bar_profiler
+    {
+        public:
+            static void setEnabled( bool enable );
+
+            static bool enabled()
+            { return m_enabled; }
+
+            /**
+             * read the time stamp counter
+             **/
+            static uint64_t tsc();
+
+            /**
+             * account one access, called by librorc::bar
+             * @param address BAR address of the access
+             * @param op access type
+             * @param cycles duration in TSC cycles
+             **/
+            static void record
+            (
+                bar_address    address,
+                bar_profile_op op,
+                uint64_t       cycles
+            );
+
+            /**
+             * clear all statistics
+             **/
+            static void reset();
+
+            /**
+             * get statistics of an address range
+             * @param range 0 for global registers, n+1 for link n
+             * @param regfile register file within the link
+             * @param op access type
+             * @param stats [out] statistics
+             * @return 0 on success, -1 on invalid parameters
+             **/
+            static int getRangeStats
+            (
+                uint32_t             range,
+                bar_profile_regfile  regfile,
+                bar_profile_op       op,
+                bar_profile_stats   *stats
+            );
+
+            /**
+             * write a human readable report of all non-empty address
+             * ranges and subsystems
+             * @param os output stream
+             **/
+            static void report( std::ostream &os );
+
+            /**
+             * @brief attributes BAR accesses of the current thread to a
+             * subsystem for the lifetime of the object. Scopes nest, the
+             * innermost one wins.
+             **/
+            class scope
+            {
+                public:
+                    scope( const char *name );
+                    ~scope();
+                protected:
+                    const char *m_prev;
+            };
+
+        protected:
+            static volatile bool m_enabled;
+    };
+}
+
+#endif /** LIBRORC_BAR_PROFILER_H */
@@ -0,0 +1,277 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Accessors for the ALICE Common Data Header (CDH) at the start of each
+ * DDL event. The word layout is resolved at compile time for each
+ * supported header version, a runtime decoder dispatches on the version
+ * field.
+ */
+
+#ifndef LIBRORC_CDH_H
+#define LIBRORC_CDH_H
+
+#include <librorc/defines.hh>
+
+/** CDH version 2: 8 DWs, 50 trigger classes */
+#define LIBRORC_CDH_V2 2
+#define LIBRORC_CDH_V2_SIZE 8
+/** CDH version 3: 10 DWs, 100 trigger classes */
+#define LIBRORC_CDH_V3 3
+#define LIBRORC_CDH_V3_SIZE 10
+
+/** status and error bits, see cdh_view::statusErrorBits() */
+#define LIBRORC_CDH_ERR_TRIGGER_OVERLAP   (1<<0)
+#define LIBRORC_CDH_ERR_TRIGGER_MISSING   (1<<1)
+#define LIBRORC_CDH_ERR_DATA_PARITY       (1<<2)
+#define LIBRORC_CDH_ERR_CONTROL_PARITY    (1<<3)
+#define LIBRORC_CDH_ERR_TRIGGER_INFO      (1<<4)
+#define LIBRORC_CDH_ERR_FEE               (1<<5)
+#define LIBRORC_CDH_ERROR_MASK            0x3f
+
+namespace LIBRARY_NAME
+{
+    /**
+     * word layout of a CDH version. Only the words differing between
+     * versions are described here, DW0-DW5 are common:
+     * - DW1: [31:24] version, [21:14] L1 trigger message,
+     *        [11:0] event ID 1 (bunch crossing)
+     * - DW2: [23:0] event ID 2 (orbit)
+     * - DW3: [31:24] block attributes, [23:0] participating subdetectors
+     * - DW4: [27:12] status and error bits, [11:0] mini event ID
+     * - DW5: trigger classes [31:0]
+     **/
+    template<uint32_t version> struct cdh_layout;
+
+    /**
+     * - DW6: [31:28] ROI [3:0], [17:0] trigger classes [49:32]
+     * - DW7: ROI [35:4]
+     **/
+    template<> struct cdh_layout<LIBRORC_CDH_V2>
+    {
+        enum { size = LIBRORC_CDH_V2_SIZE };
+
+        static inline uint64_t
+        triggerClassesLow( const uint32_t *w )
+        { return w[5] | ((uint64_t)(w[6] & 0x3ffff) << 32); }
+
+        static inline uint64_t
+        triggerClassesHigh( const uint32_t * )
+        { return 0; }
+
+        static inline uint64_t
+        roi( const uint32_t *w )
+        { return (w[6] >> 28) | ((uint64_t)w[7] << 4); }
+    };
+
+    /**
+     * - DW6: trigger classes [63:32]
+     * - DW7: trigger classes [95:64]
+     * - DW8: [31:28] ROI [3:0], [3:0] trigger classes [99:96]
+     * - DW9: ROI [35:4]
+     **/
+    template<> struct cdh_layout<LIBRORC_CDH_V3>
+    {
+        enum { size = LIBRORC_CDH_V3_SIZE };
+
+        static inline uint64_t
+        triggerClassesLow( const uint32_t *w )
+        { return w[5] | ((uint64_t)w[6] << 32); }
+
+        static inline uint64_t
+        triggerClassesHigh( const uint32_t *w )
+        { return w[7] | ((uint64_t)(w[8] & 0xf) << 32); }
+
+        static inline uint64_t
+        roi( const uint32_t *w )
+        { return (w[8] >> 28) | ((uint64_t)w[9] << 4); }
+    };
+
+
+    /**
+     * @brief zero-copy view on the CDH of an event in the DMA buffer
+     *
+     * The view only holds the event pointer, all accessors compile down
+     * to a load and a mask. The caller has to check cdhVersion() and the
+     * event size before picking the view.
+     **/
+    template<uint32_t version>
+    class cdh_view
+    {
+        public:
+            typedef cdh_layout<version> layout;
+
+            explicit cdh_view( const uint32_t *event ) : m_w(event) {}
+
+            /** header size in DWs */
+            static uint32_t size()
+            { return layout::size; }
+
+            uint32_t formatVersion() const
+            { return m_w[1] >> 24; }
+
+            uint32_t bunchCrossing() const
+            { return m_w[1] & 0xfff; }
+
+            uint32_t orbit() const
+            { return m_w[2] & 0xffffff; }
+
+            /** orbit << 12 | bunch crossing */
+            uint64_t eventId() const
+            { return bunchCrossing() | ((uint64_t)orbit() << 12); }
+
+            uint32_t l1TriggerMessage() const
+            { return (m_w[1] >> 14) & 0xff; }
+
+            uint32_t participatingSubdetectors() const
+            { return m_w[3] & 0xffffff; }
+
+            uint32_t blockAttributes() const
+            { return m_w[3] >> 24; }
+
+            uint32_t miniEventId() const
+            { return m_w[4] & 0xfff; }
+
+            /** LIBRORC_CDH_ERR_* and further status bits */
+            uint32_t statusErrorBits() const
+            { return (m_w[4] >> 12) & 0xffff; }
+
+            bool hasError() const
+            { return (statusErrorBits() & LIBRORC_CDH_ERROR_MASK) != 0; }
+
+            /** trigger classes 0..63 */
+            uint64_t triggerClassesLow() const
+            { return layout::triggerClassesLow(m_w); }
+
+            /** trigger classes 64..99, always 0 for version 2 */
+            uint64_t triggerClassesHigh() const
+            { return layout::triggerClassesHigh(m_w); }
+
+            bool triggerClass( uint32_t n ) const
+            {
+                return (n < 64) ? ((triggerClassesLow() >> n) & 1) :
+                    ((triggerClassesHigh() >> (n - 64)) & 1);
+            }
+
+            /** 36 bit region of interest */
+            uint64_t roi() const
+            { return layout::roi(m_w); }
+
+        protected:
+            const uint32_t *m_w;
+    };
+
+    typedef cdh_view<LIBRORC_CDH_V2> cdh_v2;
+    typedef cdh_view<LIBRORC_CDH_V3> cdh_v3;
+
+
+    /**
+     * decoded CDH fields
+     **/
+    typedef struct
+    {
+        uint64_t event_id;
+        uint64_t trigger_classes_low;
+        uint64_t trigger_classes_high;
+        uint64_t roi;
+        uint32_t version;
+        uint32_t subdetectors;
+        uint32_t status;
+        uint32_t l1_message;
+    } cdh_fields;
+
+    /**
+     * header version of an event
+     * @param event start of the event
+     * @param size_dw event size in DWs
+     * @return CDH version, 0 if the event is too short or carries an
+     *         unsupported version
+     **/
+    inline uint32_t
+    cdhVersion
+    (
+        const uint32_t *event,
+        uint32_t        size_dw
+    )
+    {
+        if( size_dw < LIBRORC_CDH_V2_SIZE )
+        { return 0; }
+        uint32_t version = event[1] >> 24;
+        if( version == LIBRORC_CDH_V2 )
+        { return version; }
+        if( version == LIBRORC_CDH_V3 && size_dw >= LIBRORC_CDH_V3_SIZE )
+        { return version; }
+        return 0;
+    }
+
+    template<uint32_t version>
+    inline void
+    cdhDecode
+    (
+        cdh_view<version>  cdh,
+        cdh_fields        *fields
+    )
+    {
+        fields->event_id = cdh.eventId();
+        fields->trigger_classes_low = cdh.triggerClassesLow();
+        fields->trigger_classes_high = cdh.triggerClassesHigh();
+        fields->roi = cdh.roi();
+        fields->version = version;
+        fields->subdetectors = cdh.participatingSubdetectors();
+        fields->status = cdh.statusErrorBits();
+        fields->l1_message = cdh.l1TriggerMessage();
+    }
+
+    /**
+     * decode the CDH of an event of any supported version
+     * @return 0 on success, -1 if the header is missing or unsupported
+     **/
+    inline int
+    cdhDecode
+    (
+        const uint32_t *event,
+        uint32_t        size_dw,
+        cdh_fields     *fields
+    )
+    {
+        switch( cdhVersion(event, size_dw) )
+        {
+            case LIBRORC_CDH_V2:
+                cdhDecode(cdh_v2(event), fields);
+                return 0;
+            case LIBRORC_CDH_V3:
+                cdhDecode(cdh_v3(event), fields);
+                return 0;
+            default:
+                return -1;
+        }
+    }
+}
+#endif /** LIBRORC_CDH_H */
@@ -0,0 +1,180 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * The datareplayplaylist packs DDL event files of several channels into
+ * the DDR3 modules and configures the data replay channels to play
+ * them back.
+ */
+
+#ifndef LIBRORC_DATAREPLAYPLAYLIST_H
+#define LIBRORC_DATAREPLAYPLAYLIST_H
+
+#include <string>
+#include <vector>
+#include <librorc/defines.hh>
+#include <librorc/sysmon.hh>
+
+/** number of channels that can be served by data replay */
+#define LIBRORC_DATA_REPLAY_CHANNELS 12
+
+namespace LIBRARY_NAME
+{
+    class bar;
+
+    /**
+     * @brief: build a multi-channel DDR3 data replay dataset from
+     * DDL event files
+     *
+     * Each channel gets a contiguous region in the DDR3 module of its
+     * controller (channels 0-5: module 0, channels 6-11: module 1).
+     * Regions are packed back to back in channel order and must fit
+     * into ddr3::maxModuleSize() of the module.
+     **/
+    class datareplayplaylist
+    {
+        public:
+            datareplayplaylist( bar *parent_bar );
+            ~datareplayplaylist();
+
+            /**
+             * append an event file to the playlist of a channel. The
+             * file is mapped until the playlist is cleared.
+             * @param channel channel number, 0-11
+             * @param filename DDL event file, size has to be a
+             *        multiple of 4 bytes
+             * @return 0 on success, -1 on error
+             **/
+            int
+            addFile
+            (
+                uint32_t    channel,
+                const char *filename
+            );
+
+            /**
+             * remove all files and unmap them
+             **/
+            void clear();
+
+            /**
+             * assign DDR3 addresses to all events
+             * @return 0 on success, -1 if a channel does not fit into
+             *         its module or the module is not available
+             **/
+            int pack();
+
+            /**
+             * write all events to DDR3, requires pack()
+             * @param stats optional throughput report
+             * @return 0 on success, -1 if not packed
+             **/
+            int
+            upload
+            (
+                ddr3_replay_upload_stats *stats = NULL
+            );
+
+            /**
+             * set start address and event limit of all data replay
+             * channels with events, requires pack()
+             * @param loops number of times each channel replays its
+             *        events, 0 for unlimited continuous replay
+             * @return 0 on success, -1 if not packed
+             **/
+            int
+            configureChannels
+            (
+                uint32_t loops = 0
+            );
+
+            /**
+             * number of events of a channel
+             **/
+            uint32_t
+            numberOfEvents
+            (
+                uint32_t channel
+            );
+
+            /**
+             * DDR3 start address of a channel, valid after pack()
+             **/
+            uint32_t
+            startAddress
+            (
+                uint32_t channel
+            );
+
+            /**
+             * DDR3 address after the last event of a channel, valid
+             * after pack()
+             **/
+            uint32_t
+            endAddress
+            (
+                uint32_t channel
+            );
+
+            /**
+             * text description of the DDR3 layout, one line per channel
+             * and per event
+             **/
+            std::string manifest();
+
+            /**
+             * write manifest() to a file
+             * @return 0 on success, -1 on error
+             **/
+            int
+            writeManifest
+            (
+                const char *filename
+            );
+
+        protected:
+            typedef struct
+            {
+                std::string filename;
+                uint32_t   *data;
+                size_t      size;
+            } event_file;
+
+            bar *m_bar;
+            sysmon *m_sm;
+            bool m_packed;
+            std::vector<event_file> m_files[LIBRORC_DATA_REPLAY_CHANNELS];
+            std::vector<ddr3_replay_event> m_events;
+            uint32_t m_start_addr[LIBRORC_DATA_REPLAY_CHANNELS];
+            uint32_t m_end_addr[LIBRORC_DATA_REPLAY_CHANNELS];
+            uint64_t m_module_units[2];
+    };
+}
+#endif
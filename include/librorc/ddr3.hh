@@ -65,7 +65,7 @@ public:
    * get maximum module size supported by firmware controller
    * @return modules size in bytes
    **/
-  uint32_t maxModuleSize();
+  uint64_t maxModuleSize();
 
   /**
    * check if DDR3 controller and module are ready to be used
@@ -111,6 +111,13 @@ namespace LIBRARY_NAME
             void
             clearAllLastStatusWords();
 
+            /**
+             * Clear event count, DDL and DMA deadtime and all last DIU
+             * status words with a single register transaction
+             **/
+            void
+            clearAllCounters();
+
             /**
              * get DDL deadtime
              * @return deadtime in clock cycles. For HLT_IN this is the
@@ -96,6 +96,29 @@ namespace LIBRARY_NAME
                 uint32_t pcie_packet_size
             );
 
+            /**
+             * configure DMA channel registers from plain scatter gather
+             * lists, e.g. for buffers that are not managed by
+             * librorc::buffer
+             * @param ebList scatter gather list of the EventBuffer
+             * @param ebSize EventBuffer size in bytes
+             * @param rbList scatter gather list of the ReportBuffer
+             * @param rbSize ReportBuffer size in bytes
+             * @param esDir event stream data direction flag
+             * @param pcie_packet_size maximum PCIe packet size to be used
+             * @return 0 on success, ENODEV/EFBIG on error
+             **/
+            int
+            configure
+            (
+                std::vector<ScatterGatherEntry> ebList,
+                uint64_t ebSize,
+                std::vector<ScatterGatherEntry> rbList,
+                uint64_t rbSize,
+                EventStreamDirection esDir,
+                uint32_t pcie_packet_size
+            );
+
             void
             setBufferOffsetsOnDevice
             (
@@ -376,14 +399,32 @@ namespace LIBRARY_NAME
             uint32_t  m_pci_tag;
             uint32_t  m_outFifoDepth;
 
+            int
+            configure
+            (
+                std::vector<ScatterGatherEntry> ebList,
+                uint64_t ebSize,
+                uint32_t ebEntries,
+                std::vector<ScatterGatherEntry> rbList,
+                uint64_t rbSize,
+                uint32_t rbEntries,
+                EventStreamDirection esDir,
+                uint32_t pcie_packet_size
+            );
+
             /**
-             * Copy scatterlist from librorc::buffer into the BufferDescriptorManager
+             * Copy scatterlist into the BufferDescriptorManager
              * of the CRORC, to be used either as ReportBuffer or as EventBuffer.
-             * @param buf librorc::buffer instance to be used as destination buffer
+             * @param list scatter gather list of the destination buffer
              * @param target_ram 0 for EventBuffer, 1 for ReportBuffer
              * @return 0 on sucess, -1 on error
              **/
-            int configureBufferDescriptorRam(buffer *buf, uint32_t target_ram);
+            int
+            configureBufferDescriptorRam
+            (
+                std::vector<ScatterGatherEntry> list,
+                uint32_t target_ram
+            );
 
             std::vector<ScatterGatherEntry>
             prepareSgList
@@ -394,8 +435,10 @@ namespace LIBRARY_NAME
             void
             configureDmaChannelRegisters
             (
-                buffer *eventBuffer,
-                buffer *reportBuffer,
+                uint64_t eb_size,
+                uint32_t eb_entries,
+                uint64_t rb_size,
+                uint32_t rb_entries,
                 uint32_t pcie_packet_size
             );
 
@@ -55,6 +55,9 @@ namespace LIBRARY_NAME {
 
 // bar
 #define LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED 0x2001
+#define LIBRORC_BAR_ERROR_TRACE_OPEN_FAILED 0x2002
+#define LIBRORC_BAR_ERROR_TRACE_INVALID 0x2003
+#define LIBRORC_BAR_ERROR_REPLAY_MISMATCH 0x2004
 
 // event_stream
 #define LIBRORC_EVENT_STREAM_ERROR_CHANNEL_NOT_AVAIL 0x3001
@@ -76,11 +79,20 @@ namespace LIBRARY_NAME {
 #define LIBRORC_SYSMON_ERROR_I2C_INVALID_PARAM 0x4003
 #define LIBRORC_SYSMON_ERROR_DATA_REPLAY_TIMEOUT 0x4004
 #define LIBRORC_SYSMON_ERROR_DATA_REPLAY_INVALID 0x4005
+#define LIBRORC_SYSMON_ERROR_I2C_LOCK_TIMEOUT 0x4006
+#define LIBRORC_SYSMON_ERROR_I2C_LOCK_FAILED 0x4007
 
 // refclk
 #define LIBRORC_REFCLK_ERROR_CONSTRUCTOR_FAILED 0x5001
 #define LIBRORC_REFCLK_ERROR_INVALID_PARAMETER 0x5002
 
+/** telemetry **/
+#define LIBRORC_TELEMETRY_ERROR_CONSTRUCTOR_FAILED 0x6001
+#define LIBRORC_TELEMETRY_ERROR_SHM_GET_FAILED 0x6002
+#define LIBRORC_TELEMETRY_ERROR_SHM_ATTACH_FAILED 0x6003
+#define LIBRORC_TELEMETRY_ERROR_INVALID_RING 0x6004
+#define LIBRORC_TELEMETRY_ERROR_WRITER_ACTIVE 0x6005
+
 typedef struct {
     int errcode;
     const char *msg;
@@ -0,0 +1,258 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * The event_builder class assembles events from the sub-events of
+ * several DMA channels, possibly on different devices, by matching the
+ * event ID in their Common Data Headers.
+ */
+
+#ifndef LIBRORC_EVENT_BUILDER_H
+#define LIBRORC_EVENT_BUILDER_H
+
+#include <vector>
+#include <deque>
+#include <pthread.h>
+#include <librorc/defines.hh>
+#include <librorc/buffer.hh>
+
+/** maximum number of channels contributing to an event */
+#define LIBRORC_EVENT_BUILDER_MAX_SOURCES 64
+/** fragments buffered per channel between reader and builder, power of 2 */
+#define LIBRORC_EVENT_BUILDER_QUEUE_DEPTH 1024
+/** default number of incomplete events kept for reordering */
+#define LIBRORC_EVENT_BUILDER_WINDOW 64
+/** default time an incomplete event waits for missing fragments */
+#define LIBRORC_EVENT_BUILDER_TIMEOUT_US 100000
+/** reader thread back-off while its channel has no new events */
+#define LIBRORC_EVENT_BUILDER_POLL_US 10
+/** event ID of fragments too short to carry a CDH */
+#define LIBRORC_EVENT_BUILDER_INVALID_ID 0xffffffffffffffffull
+
+namespace LIBRARY_NAME
+{
+    class event_stream;
+
+    /**
+     * one sub-event as obtained from event_stream::getNextEvent()
+     **/
+    typedef struct
+    {
+        uint64_t               event_id;  /**< orbit << 12 | bunch crossing */
+        uint64_t               reference; /**< event_stream release reference */
+        EventDescriptor       *report;
+        const uint32_t        *event;
+    } event_fragment;
+
+    /**
+     * an assembled event. fragment[i] is the contribution of source i
+     * and only valid if bit i is set in sources.
+     **/
+    typedef struct
+    {
+        uint64_t       event_id;
+        uint64_t       sources;
+        bool           complete;  /**< false if emitted on timeout, a repeated
+                                       event ID or flush() */
+        uint64_t       first_ns;  /**< CLOCK_MONOTONIC of the first fragment */
+        event_fragment fragment[LIBRORC_EVENT_BUILDER_MAX_SOURCES];
+    } built_event;
+
+    /**
+     * single producer single consumer fragment ring. head is only
+     * written by the reader thread, tail only by the builder.
+     **/
+    typedef struct
+    {
+        volatile uint64_t head;
+        uint8_t           pad0[56];
+        volatile uint64_t tail;
+        uint8_t           pad1[56];
+        event_fragment    slot[LIBRORC_EVENT_BUILDER_QUEUE_DEPTH];
+    } event_fragment_queue;
+
+    /**
+     * @brief source of sub-events for the event_builder
+     *
+     * Sources other than event streams, e.g. synthetic ones in tests,
+     * implement this interface. A source added to a builder is owned by
+     * it and only deleted after its reader thread has stopped.
+     **/
+    class event_fragment_source
+    {
+        public:
+            virtual ~event_fragment_source() {}
+
+            /**
+             * fetch the next sub-event, called by the reader thread
+             * @return true if a sub-event was available
+             **/
+            virtual bool
+            fetchFragment
+            (
+                EventDescriptor **report,
+                const uint32_t  **event,
+                uint64_t         *reference
+            ) = 0;
+
+            /**
+             * release a sub-event, called from releaseEvent()
+             * @return 0 on success, -1 on error
+             **/
+            virtual int releaseFragment( uint64_t reference ) = 0;
+    };
+
+    /**
+     * @brief assemble events from several event streams
+     *
+     * Each added stream gets a reader thread that fetches its events
+     * and hands them to the builder through a lock-free queue. The
+     * consumer calls getNextEvent() to obtain built events and
+     * releaseEvent() to release all contributing sub-events in their
+     * event streams at once. Event data is never copied.
+     *
+     * A built event is emitted as soon as all sources contributed. It is
+     * emitted incomplete if it waited longer than the timeout or if a
+     * source delivers the same event ID again. While the reorder window
+     * is full, fragments starting new events stay queued. This throttles
+     * sources running ahead of the others down to the DMA buffer.
+     *
+     * getNextEvent() and releaseEvent() have to be called from the same
+     * thread.
+     **/
+    class event_builder
+    {
+        public:
+            event_builder();
+            virtual ~event_builder();
+
+            /**
+             * add a stream as source, only before start()
+             * @param stream event stream, not owned
+             * @return source index, -1 if started or too many sources
+             **/
+            int32_t addStream( event_stream *stream );
+
+            /**
+             * add any other source, only before start()
+             * @param fragments fragment source, owned by the builder on
+             *        success
+             * @return source index, -1 if started or too many sources
+             **/
+            int32_t addSource( event_fragment_source *fragments );
+
+            /**
+             * @return number of sources
+             **/
+            uint32_t numberOfSources()
+            { return m_sources.size(); }
+
+            /**
+             * set the number of incomplete events kept for reordering
+             * @param events window size, at least 1
+             **/
+            void setReorderWindow( uint32_t events );
+
+            /**
+             * set the time an incomplete event waits for missing fragments
+             * @param timeout_us timeout in microseconds
+             **/
+            void setTimeout( uint64_t timeout_us );
+
+            /**
+             * start the reader threads
+             * @return 0 on success, -1 without sources or if already
+             *         running
+             **/
+            int start();
+
+            /**
+             * stop the reader threads. Events already fetched stay
+             * available via getNextEvent()
+             **/
+            void stop();
+
+            /**
+             * get the next built event. Non-blocking.
+             * @param [out] event built event, valid until releaseEvent()
+             * @return true if an event was available
+             **/
+            bool getNextEvent( built_event **event );
+
+            /**
+             * release all fragments of a built event
+             * @param event event obtained by getNextEvent()
+             * @return 0 on success, -1 if a fragment release failed
+             **/
+            int releaseEvent( built_event *event );
+
+            /**
+             * flush all incomplete events regardless of timeout, e.g.
+             * at the end of a run
+             **/
+            void flush();
+
+            /** statistics */
+            uint64_t completeEvents()   { return m_complete; }
+            uint64_t incompleteEvents() { return m_incomplete; }
+            uint64_t fragments()        { return m_fragments; }
+
+        protected:
+            typedef struct
+            {
+                event_builder         *builder;
+                uint32_t               index;
+                event_fragment_source *fragments;
+                event_fragment_queue  *queue;
+                pthread_t              thread;
+            } source;
+
+            std::vector<source>         m_sources;
+            std::vector<built_event *>  m_pending;
+            std::vector<built_event *>  m_free;
+            std::deque<built_event *>   m_ready;
+            uint64_t                    m_all_sources;
+            uint32_t                    m_window;
+            uint64_t                    m_timeout_ns;
+            volatile bool               m_stop;
+            bool                        m_running;
+            uint64_t                    m_complete;
+            uint64_t                    m_incomplete;
+            uint64_t                    m_fragments;
+
+            static void *readerThread( void *arg );
+            void readSource( source *src );
+            void collect();
+            bool insert( uint32_t index, const event_fragment *fragment,
+                         uint64_t now );
+            void emit( uint32_t pending_index );
+    };
+}
+#endif /** LIBRORC_EVENT_BUILDER_H */
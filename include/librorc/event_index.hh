@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * The event_index class keeps the decoded CDH fields of the most recent
+ * events of a DMA channel, so consumers can filter and route events
+ * without touching their payload again.
+ */
+
+#ifndef LIBRORC_EVENT_INDEX_H
+#define LIBRORC_EVENT_INDEX_H
+
+#include <vector>
+#include <librorc/defines.hh>
+#include <librorc/buffer.hh>
+#include <librorc/cdh.hh>
+
+/** default number of index entries */
+#define LIBRORC_EVENT_INDEX_ENTRIES 4096
+
+namespace LIBRARY_NAME
+{
+    /**
+     * index entry of one event. version is 0 for events without a
+     * supported CDH, all CDH fields are 0 then.
+     **/
+    typedef struct
+    {
+        uint64_t reference;             /**< event_stream release reference */
+        uint64_t event_id;
+        uint64_t trigger_classes_low;
+        uint64_t trigger_classes_high;
+        uint32_t size;                  /**< event size in DWs */
+        uint32_t status;                /**< CDH status and error bits */
+        uint32_t subdetectors;
+        uint32_t version;
+    } event_index_entry;
+
+    /**
+     * @brief ring of the most recent events of a channel
+     *
+     * add() decodes the CDH once while the header is still hot in the
+     * cache. Lookups only touch the index. The index is not
+     * synchronized, use it from the thread calling add().
+     **/
+    class event_index
+    {
+        public:
+            /**
+             * @param entries number of events kept, rounded up to a power
+             *        of 2
+             **/
+            event_index( uint32_t entries = LIBRORC_EVENT_INDEX_ENTRIES );
+            ~event_index();
+
+            /**
+             * append an event
+             * @param reference release reference from getNextEvent()
+             * @param report EventDescriptor of the event
+             * @param event event data
+             * @return the new entry
+             **/
+            const event_index_entry *
+            add
+            (
+                uint64_t               reference,
+                const EventDescriptor *report,
+                const uint32_t        *event
+            );
+
+            /** number of entries kept */
+            uint32_t capacity()
+            { return m_entries.size(); }
+
+            /** number of events added so far */
+            uint64_t count()
+            { return m_count; }
+
+            /**
+             * get a recent entry
+             * @param age 0 for the newest event, 1 for the one before...
+             * @return entry, NULL if age exceeds the available entries
+             **/
+            const event_index_entry *recent( uint32_t age );
+
+            /**
+             * find a recent event by reference
+             * @return newest entry with this reference, NULL if not found
+             **/
+            const event_index_entry *findReference( uint64_t reference );
+
+            /**
+             * find a recent event by CDH event ID
+             * @return newest entry with this event ID, NULL if not found
+             **/
+            const event_index_entry *findEventId( uint64_t event_id );
+
+            /**
+             * collect the references of recent events with any of the
+             * given trigger classes
+             * @param mask_low trigger classes 0..63
+             * @param mask_high trigger classes 64..99
+             * @param references output, appended
+             * @return number of matching events
+             **/
+            uint32_t
+            selectTriggerClasses
+            (
+                uint64_t               mask_low,
+                uint64_t               mask_high,
+                std::vector<uint64_t> *references
+            );
+
+            void clear();
+
+        protected:
+            std::vector<event_index_entry> m_entries;
+            uint64_t                       m_mask;
+            uint64_t                       m_count;
+    };
+}
+#endif /** LIBRORC_EVENT_INDEX_H */
@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * The event_prefilter class selects events by CDH trigger classes and
+ * event ID on the host, ahead of any further processing.
+ */
+
+#ifndef LIBRORC_EVENT_PREFILTER_H
+#define LIBRORC_EVENT_PREFILTER_H
+
+#include <librorc/defines.hh>
+#include <librorc/buffer.hh>
+#include <librorc/cdh.hh>
+
+/** maximum number of rules of a prefilter */
+#define LIBRORC_PREFILTER_MAX_RULES 16
+
+namespace LIBRARY_NAME
+{
+    /**
+     * one accept rule. A zeroed rule accepts every event. Trigger class
+     * masks are split into classes 0..63 (low) and 64..99 (high).
+     **/
+    typedef struct
+    {
+        uint64_t any_low;     /**< at least one of these classes, if set */
+        uint64_t any_high;
+        uint64_t all_low;     /**< all of these classes */
+        uint64_t all_high;
+        uint64_t none_low;    /**< none of these classes */
+        uint64_t none_high;
+        uint64_t id_mask;     /**< (event ID & id_mask) == id_value */
+        uint64_t id_value;
+        uint32_t status_reject; /**< no CDH status/error bit of these */
+        uint32_t reserved;
+    } event_prefilter_rule;
+
+    typedef struct
+    {
+        uint64_t accepted;
+        uint64_t rejected;
+        uint64_t accepted_bytes;
+        uint64_t rejected_bytes;
+        uint64_t no_cdh;      /**< events without a supported CDH */
+    } event_prefilter_stats;
+
+    /**
+     * @brief software trigger-class and event ID filter
+     *
+     * An event is accepted if it matches any of the rules. Each rule is
+     * evaluated as a sequence of mask operations without data dependent
+     * branches, only the CDH words are read. Attach a prefilter to an
+     * event_stream with setPrefilter() to release rejected events
+     * inside getNextEvent().
+     *
+     * Rules are not synchronized against the filter: change them only
+     * while no events are being fetched.
+     **/
+    class event_prefilter
+    {
+        public:
+            event_prefilter();
+            ~event_prefilter();
+
+            /**
+             * append a rule
+             * @return rule index, -1 if all rules are in use
+             **/
+            int32_t addRule( const event_prefilter_rule *rule );
+
+            /** remove all rules. An empty filter rejects everything. */
+            void clearRules();
+
+            uint32_t numberOfRules()
+            { return m_nrules; }
+
+            /**
+             * set the decision for events without a supported CDH,
+             * default: accept
+             **/
+            void setAcceptUnknown( bool accept )
+            { m_accept_unknown = accept; }
+
+            /**
+             * evaluate the rules for a decoded CDH
+             * @return true if accepted
+             **/
+            bool match( const cdh_fields *cdh ) const;
+
+            /**
+             * filter an event and update the statistics
+             * @param report EventDescriptor of the event
+             * @param event event data
+             * @return true if accepted
+             **/
+            bool
+            accept
+            (
+                const EventDescriptor *report,
+                const uint32_t        *event
+            );
+
+            const event_prefilter_stats *stats()
+            { return &m_stats; }
+
+            void clearStats();
+
+            /**
+             * set trigger class n in a pair of low/high masks
+             **/
+            static void
+            setClass
+            (
+                uint64_t *low,
+                uint64_t *high,
+                uint32_t  n
+            );
+
+        protected:
+            event_prefilter_rule  m_rules[LIBRORC_PREFILTER_MAX_RULES];
+            /** 1 if the any-of masks of a rule are empty */
+            uint64_t              m_any_empty[LIBRORC_PREFILTER_MAX_RULES];
+            uint32_t              m_nrules;
+            bool                  m_accept_unknown;
+            event_prefilter_stats m_stats;
+    };
+}
+#endif /** LIBRORC_EVENT_PREFILTER_H */
@@ -54,6 +54,8 @@ class diu;
 class siu;
 class ddl;
 class fastclusterfinder;
+class event_index;
+class event_prefilter;
 
 typedef struct {
   uint64_t n_events;
@@ -130,6 +132,27 @@ public:
    */
   int releaseEvent(uint64_t reference);
 
+  /**
+   * keep an index of the most recent events. getNextEvent() decodes the
+   * CDH of each event into the index.
+   * @param entries number of events kept, 0 removes the index
+   **/
+  void enableEventIndex(uint32_t entries);
+
+  /**
+   * filter events in getNextEvent(). Rejected events are counted in the
+   * channel status and released right away, they are neither returned
+   * nor added to the event index.
+   * @param filter prefilter, not owned, NULL to disable
+   **/
+  void setPrefilter(event_prefilter *filter);
+
+  /**
+   * get the event index of this stream
+   * @return pointer to the index, NULL if not enabled
+   **/
+  event_index *getEventIndex() { return m_event_index; }
+
   /**
    * get PatternGenerator instance for current event_stream
    * @return pointer to instance of patterngenerator when
@@ -240,6 +263,8 @@ protected:
   pthread_mutex_t m_getEventEnable;
   volatile uint32_t *m_raw_event_buffer;
   EventDescriptor *m_reports;
+  event_index *m_event_index;
+  event_prefilter *m_prefilter;
   EventStreamDirection m_esType;
 
   void initMembers();
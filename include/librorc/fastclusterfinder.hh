@@ -33,13 +33,67 @@
 #define LIBRORC_FASTCLUSTERFINDER_H
 
 #include <iostream>
+#include <vector>
 #include <librorc/defines.hh>
 //#include <librorc/link.hh>
 #include <librorc/registers.h>
 
+/** number of mapping RAM entries, one per RCU channel address */
+#define LIBRORC_FCF_MAPPING_RAM_SIZE 4096
+/** defined data bits of a mapping RAM entry */
+#define LIBRORC_FCF_MAPPING_DATA_MASK 0x1fffffff
+/** mapping RAM entries written per bar transaction */
+#define LIBRORC_FCF_MAPPING_BURST 256
+/** verification modes of loadMappingRam() */
+#define LIBRORC_FCF_VERIFY_NONE 0
+#define LIBRORC_FCF_VERIFY_SAMPLE 1
+#define LIBRORC_FCF_VERIFY_FULL 2
+/** entries read back by LIBRORC_FCF_VERIFY_SAMPLE */
+#define LIBRORC_FCF_VERIFY_SAMPLES 64
+/** loadMappingRam() result if the table was already loaded */
+#define LIBRORC_FCF_MAPPING_UNCHANGED 1
+/**
+ * SysV shared memory key of the mapping table hash cache of device 0,
+ * devices follow consecutively
+ **/
+#define LIBRORC_FCF_MAPPING_SHM_KEY_OFFSET 16896
+#define LIBRORC_FCF_MAPPING_CACHE_LINKS 32
+#define LIBRORC_FCF_MAPPING_CACHE_MAGIC 0x4643464d41504331ull
+
 namespace LIBRARY_NAME {
 class link;
 
+/**
+ * hashes of the mapping tables loaded into the links of a device,
+ * shared between processes. 0 means unknown.
+ **/
+typedef struct {
+  uint64_t magic;
+  volatile uint64_t hash[LIBRORC_FCF_MAPPING_CACHE_LINKS];
+} fcf_mapping_cache;
+
+/**
+ * complete FastClusterFinder parameter set, see the according setters of
+ * class fastclusterfinder for the valid ranges
+ **/
+typedef struct {
+  uint32_t single_pad_suppression;
+  uint32_t bypass_merger;
+  uint32_t deconv_pad;
+  uint32_t merger_algorithm;
+  uint32_t single_seq_limit;
+  uint32_t cluster_lower_limit;
+  uint32_t merger_distance;
+  uint32_t charge_tolerance;
+  uint32_t noise_suppression;
+  uint32_t noise_suppression_minimum;
+  uint32_t noise_suppression_neighbor;
+  uint32_t cluster_qmax_lower_limit;
+  uint32_t tag_border_clusters;
+  uint32_t correct_edge_clusters;
+  uint32_t tag_deconvoluted_clusters;
+} fcf_parameters;
+
 /**
  * @brief Interface class to the FastClusterFinder component
  **/
@@ -291,6 +345,81 @@ public:
    **/
   uint32_t readMappingRamEntry(uint32_t addr);
 
+  /**
+   * load a complete mapping table. The hash of the table is compared
+   * with the hash cached for this link first: if it matches and a
+   * sampled readback agrees, the table is already loaded and nothing is
+   * written. Otherwise the entries are written in bursts of
+   * LIBRORC_FCF_MAPPING_BURST entries with one completion each and
+   * verified as requested.
+   * @param table entries for RCU channel addresses 0..entries-1, see
+   *        writeMappingRamEntry() for the data format
+   * @param entries number of entries, at most LIBRORC_FCF_MAPPING_RAM_SIZE
+   * @param verify LIBRORC_FCF_VERIFY_NONE, _SAMPLE or _FULL
+   * @param force write even if the cached hash matches
+   * @return 0 if loaded, LIBRORC_FCF_MAPPING_UNCHANGED if skipped, -1 on
+   *         invalid size or verification failure
+   **/
+  int loadMappingRam(const uint32_t *table, uint32_t entries,
+                     uint32_t verify = LIBRORC_FCF_VERIFY_SAMPLE,
+                     bool force = false);
+
+  /**
+   * load a mapping table file, see readMappingFile() and
+   * loadMappingRam()
+   * @return see loadMappingRam(), -1 if the file cannot be read
+   **/
+  int loadMappingRam(const char *filename,
+                     uint32_t verify = LIBRORC_FCF_VERIFY_SAMPLE);
+
+  /**
+   * compare the mapping RAM with a table
+   * @param mode LIBRORC_FCF_VERIFY_SAMPLE or _FULL
+   * @return number of mismatching entries
+   **/
+  uint32_t verifyMappingRam(const uint32_t *table, uint32_t entries,
+                            uint32_t mode);
+
+  /**
+   * load the same table into several FastClusterFinders at once, one
+   * thread per instance
+   * @param fcfs FastClusterFinder instances, on separate links
+   * @param results optional, per instance result of loadMappingRam()
+   * @return 0 if all tables are loaded, -1 otherwise
+   **/
+  static int loadMappingRamParallel(std::vector<fastclusterfinder *> &fcfs,
+                                    const uint32_t *table, uint32_t entries,
+                                    uint32_t verify = LIBRORC_FCF_VERIFY_SAMPLE,
+                                    std::vector<int> *results = NULL);
+
+  /**
+   * read a mapping table file. Each line holds an RCU channel address
+   * and the entry data, or only the entry data for consecutive
+   * addresses. Numbers may be decimal or 0x prefixed hex, '#' starts a
+   * comment. Entries not listed are 0.
+   * @param table output, resized to the highest address + 1
+   * @return number of entries, -1 on error
+   **/
+  static int32_t readMappingFile(const char *filename,
+                                 std::vector<uint32_t> *table);
+
+  /**
+   * hash identifying a mapping table
+   **/
+  static uint64_t mappingHash(const uint32_t *table, uint32_t entries);
+
+  /**
+   * select the device whose mapping hash cache is used. Defaults to the
+   * device of the link, bars without device have no cache.
+   * @param device_number device number, -1 to disable the cache
+   **/
+  void setMappingCacheDevice(int32_t device_number);
+
+  /**
+   * remove the mapping hash cache of a device
+   **/
+  static void removeMappingCache(uint32_t device_number);
+
   /**
    * set noise suppression value
    * @param noise_suppression noise suppression value, valid range from 0-15
@@ -380,10 +509,21 @@ public:
    **/
   void setTagDeconvolutedClusters(uint32_t tag);
 
+  /**
+   * load all FastClusterFinder parameters with a single register
+   * transaction instead of one read-modify-write per parameter. Reset,
+   * enable and bypass are not modified.
+   * @param params parameter set
+   **/
+  void setParameters(const fcf_parameters *params);
+
 protected:
   void setCtrlBit(uint32_t pos, uint32_t val);
   uint32_t getCtrlBit(uint32_t pos);
+  volatile uint64_t *mappingCacheSlot();
   link *m_link;
+  fcf_mapping_cache *m_mapping_cache;
+  int32_t m_mapping_cache_device;
 };
 }
 #endif
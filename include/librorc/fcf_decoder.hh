@@ -0,0 +1,200 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * The fcf_decoder class unpacks the cluster records of FastClusterFinder
+ * output events into structure-of-arrays buffers.
+ */
+
+#ifndef LIBRORC_FCF_DECODER_H
+#define LIBRORC_FCF_DECODER_H
+
+#include <librorc/defines.hh>
+#include <librorc/fastclusterfinder.hh>
+
+/**
+ * FCF output events consist of the CDH of the input event, followed by
+ * one record of 6 DWs per cluster and the RCU trailer:
+ * - DW0: [31:30] 0b11 cluster marker, [29:24] row,
+ *        [23:0] total charge, fixed point with 6 fractional bits
+ * - DW1: pad center of gravity, IEEE float
+ * - DW2: time center of gravity, IEEE float
+ * - DW3: second moment in pad direction, IEEE float
+ * - DW4: second moment in time direction, IEEE float
+ * - DW5: [25] deconvoluted in time, [24] deconvoluted in pad,
+ *        [23] border cluster, [22:0] qmax, fixed point with 6
+ *        fractional bits
+ * The first DW without cluster marker ends the cluster list.
+ **/
+#define LIBRORC_FCF_CLUSTER_WORDS 6
+#define LIBRORC_FCF_CLUSTER_MARKER 3
+
+/** decoded cluster flags */
+#define LIBRORC_FCF_FLAG_BORDER      (1<<0)
+#define LIBRORC_FCF_FLAG_DECONV_PAD  (1<<1)
+#define LIBRORC_FCF_FLAG_DECONV_TIME (1<<2)
+
+namespace LIBRARY_NAME
+{
+    /**
+     * @brief structure-of-arrays cluster buffer
+     *
+     * All arrays hold size() valid entries and are 32 byte aligned.
+     * sigma_pad2 and sigma_time2 are the variances, i.e. the second
+     * moments minus the squared centers of gravity, clamped at 0.
+     **/
+    class fcf_clusters
+    {
+        public:
+            fcf_clusters( uint32_t capacity = 0 );
+            ~fcf_clusters();
+
+            /**
+             * grow the arrays to hold at least capacity clusters,
+             * keeping their contents
+             * @return 0 on success, -1 if out of memory
+             **/
+            int reserve( uint32_t capacity );
+
+            uint32_t size()
+            { return m_size; }
+
+            uint32_t capacity()
+            { return m_capacity; }
+
+            void clear()
+            { m_size = 0; }
+
+            uint32_t *row;
+            uint32_t *flags;
+            float    *pad;
+            float    *time;
+            float    *charge;
+            float    *qmax;
+            float    *sigma_pad2;
+            float    *sigma_time2;
+
+        protected:
+            friend class fcf_decoder;
+            uint32_t m_size;
+            uint32_t m_capacity;
+    };
+
+    /**
+     * @brief decode FastClusterFinder output
+     *
+     * The decoder uses AVX2 where the CPU supports it and a scalar
+     * implementation otherwise, both give bit identical results. Flags
+     * of tagging options that are disabled in the FastClusterFinder are
+     * masked, as the firmware does not define them then.
+     **/
+    class fcf_decoder
+    {
+        public:
+            fcf_decoder();
+            ~fcf_decoder();
+
+            /**
+             * set the tagging options the FCF output was produced with
+             * @param tag_border_clusters see
+             *        fastclusterfinder::tagBorderClusters()
+             * @param tag_deconvoluted_clusters see
+             *        fastclusterfinder::tagDeconvolutedClusters()
+             **/
+            void
+            setTagging
+            (
+                uint32_t tag_border_clusters,
+                uint32_t tag_deconvoluted_clusters
+            );
+
+            void setTagging( const fcf_parameters *params );
+
+            /** take the tagging options from the hardware */
+            void setTagging( fastclusterfinder *fcf );
+
+            /**
+             * use AVX2 if available, default: true
+             **/
+            void setSimd( bool enable );
+
+            /**
+             * @return true if decode() uses AVX2
+             **/
+            bool simd()
+            { return m_simd; }
+
+            /** @return true if the CPU supports AVX2 */
+            static bool simdAvailable();
+
+            /**
+             * decode an FCF output event and append its clusters
+             * @param event event data starting with the CDH
+             * @param size_dw event size in DWs
+             * @param clusters output buffer, grown as needed
+             * @return number of clusters decoded, -1 if the event has no
+             *         supported CDH or memory ran out
+             **/
+            int32_t
+            decode
+            (
+                const uint32_t *event,
+                uint32_t        size_dw,
+                fcf_clusters   *clusters
+            );
+
+            /**
+             * decode cluster records without CDH and append them
+             * @param words first cluster record
+             * @param size_dw number of DWs available
+             * @param clusters output buffer, grown as needed
+             * @return number of clusters decoded, -1 if memory ran out
+             **/
+            int32_t
+            decodeRecords
+            (
+                const uint32_t *words,
+                uint32_t        size_dw,
+                fcf_clusters   *clusters
+            );
+
+        protected:
+            uint32_t m_flag_mask;
+            bool     m_simd;
+
+            static uint32_t countRecords( const uint32_t *words,
+                                          uint32_t size_dw );
+            void decodeScalar( const uint32_t *words, uint32_t n,
+                               fcf_clusters *clusters, uint32_t base );
+            void decodeAvx2( const uint32_t *words, uint32_t n,
+                             fcf_clusters *clusters, uint32_t base );
+    };
+}
+#endif /** LIBRORC_FCF_DECODER_H */
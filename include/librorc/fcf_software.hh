@@ -0,0 +1,307 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @section DESCRIPTION
+ * @section DESCRIPTION
+ *
+ * The fcf_software class is a host implementation of the FastClusterFinder
+ * algorithm operating on raw RCU DDL payloads.
+ */
+
+#ifndef LIBRORC_FCF_SOFTWARE_H
+#define LIBRORC_FCF_SOFTWARE_H
+
+#include <vector>
+#include <librorc/defines.hh>
+#include <librorc/fastclusterfinder.hh>
+
+/**
+ * RCU payload following the CDH:
+ * - channel header: [31:30] 0b01, [29] channel error,
+ *   [25:16] number of 10 bit words, [11:0] hardware address
+ * - channel payload: [29:20], [19:10], [9:0] three 10 bit words per DW,
+ *   padded to a full DW. The 10 bit words form bunches of
+ *   [length incl. 2 header words][time of first sample][samples], with
+ *   the samples in descending time order
+ * - RCU trailer: DWs with [31:30] 0b10, the last one holding the trailer
+ *   length in DWs in [6:0]
+ **/
+#define LIBRORC_RCU_CHANNEL_MARKER 1
+#define LIBRORC_RCU_TRAILER_MARKER 2
+
+/** fractional bits of the gain in mapping RAM entries, 1.0 = 0x1000 */
+#define LIBRORC_FCF_GAIN_SHIFT 12
+
+namespace LIBRARY_NAME
+{
+    /** cluster candidate: one time sequence on one pad */
+    typedef struct
+    {
+        uint32_t row;
+        uint32_t pad;
+        uint32_t border;
+        uint32_t deconv_time;
+        uint32_t peak_time;
+        uint32_t charge;
+        uint32_t qmax;
+        uint64_t charge_time;
+        uint64_t charge_time2;
+    } fcf_candidate;
+
+    /** cluster under construction in the merger */
+    typedef struct
+    {
+        uint32_t row;
+        uint32_t last_pad;
+        uint32_t pads;
+        uint32_t border;
+        uint32_t deconv_pad;
+        uint32_t deconv_time_pads;
+        uint32_t ref_time;
+        uint32_t last_qmax;
+        uint32_t falling;
+        uint32_t matched;
+        uint32_t qmax;
+        uint64_t charge;
+        uint64_t charge_pad;
+        uint64_t charge_pad2;
+        uint64_t charge_time;
+        uint64_t charge_time2;
+    } fcf_open_cluster;
+
+    class fcf_software;
+
+    /** one event for fcf_software::processParallel() */
+    typedef struct
+    {
+        /** index of the fcf_software instance to process the event with */
+        uint32_t channel;
+        const uint32_t *event;
+        uint32_t size_dw;
+        std::vector<uint32_t> *output;
+        /** result of process() */
+        int32_t result;
+    } fcf_software_job;
+
+    /**
+     * @brief software reference FastClusterFinder
+     *
+     * Finds clusters in raw RCU payloads with the parameters and mapping
+     * table of the hardware FastClusterFinder and writes them in the
+     * output format described in fcf_decoder.hh, so hardware output can
+     * be validated record by record and links without FCF firmware can
+     * be processed on the host.
+     *
+     * Per channel, samples are gain corrected in fixed point with 6
+     * fractional bits and split into sequences at local minima in time:
+     * a slope needs a sample difference above the charge tolerance, a
+     * minimum splits if the preceding maximum exceeds it by at least the
+     * noise suppression value and the following sample by at least the
+     * noise suppression minimum. Sequences below the single sequence
+     * limit are dropped. The merger joins sequences on adjacent pads of a
+     * row whose peak times differ by at most the merger distance, taking
+     * the first sequence of a cluster or the last merged one as reference
+     * depending on the merger algorithm. With pad deconvolution, a
+     * cluster is split where the qmax per pad rises by more than the
+     * noise suppression neighbor value after having fallen by more than
+     * it. Clusters are then cut on pad count, total charge and qmax.
+     * Centers of gravity and second moments are accumulated in integers
+     * and divided once, so results do not depend on the processing order.
+     * Edge cluster correction is not modelled.
+     *
+     * Unpacking and gain correction of the 10 bit samples use AVX2 where
+     * available, both paths give bit identical results. An instance
+     * holds scratch buffers and must only be used by one thread at a
+     * time, use one instance per DMA channel.
+     **/
+    class fcf_software
+    {
+        public:
+            fcf_software();
+            ~fcf_software();
+
+            /** see fastclusterfinder::setParameters() */
+            void setParameters( const fcf_parameters *params );
+
+            /** read the parameters and branch override from the hardware */
+            void setParameters( fastclusterfinder *fcf );
+
+            void getParameters( fcf_parameters *params );
+
+            /** see fastclusterfinder::setBranchOverride() */
+            void setBranchOverride( uint32_t ovrd );
+
+            /**
+             * set the mapping table, see
+             * fastclusterfinder::writeMappingRamEntry() for the format.
+             * Addresses beyond the table are inactive.
+             * @return 0 on success, -1 if the table is too large
+             **/
+            int
+            setMapping
+            (
+                const uint32_t *table,
+                uint32_t        entries
+            );
+
+            /** use AVX2 if available, default: true */
+            void setSimd( bool enable );
+
+            bool simd()
+            { return m_simd; }
+
+            /** @return true if the CPU supports AVX2 */
+            static bool simdAvailable();
+
+            /**
+             * process a raw event and produce the FCF output event: the
+             * CDH, the cluster records and the RCU trailer of the input
+             * @param event raw event starting with the CDH
+             * @param size_dw event size in DWs
+             * @param output output event, replaced
+             * @return number of clusters, -1 if the event has no
+             *         supported CDH or a malformed trailer
+             **/
+            int32_t
+            process
+            (
+                const uint32_t        *event,
+                uint32_t               size_dw,
+                std::vector<uint32_t> *output
+            );
+
+            /**
+             * find clusters in an RCU payload without CDH and trailer
+             * @param payload first channel header
+             * @param size_dw payload size in DWs
+             * @param records cluster records are appended here
+             * @return number of clusters appended
+             **/
+            int32_t
+            findClusters
+            (
+                const uint32_t        *payload,
+                uint32_t               size_dw,
+                std::vector<uint32_t> *records
+            );
+
+            /**
+             * process events of several channels at once, one thread per
+             * channel. Events of a channel are processed in job order.
+             * @param instances one instance per channel
+             * @param jobs events, result is set for each
+             * @return 0 if all events were processed, -1 otherwise
+             **/
+            static int
+            processParallel
+            (
+                std::vector<fcf_software*>     &instances,
+                std::vector<fcf_software_job>  &jobs
+            );
+
+        protected:
+            fcf_parameters m_params;
+            uint32_t m_branch_override;
+            uint32_t m_mapping[LIBRORC_FCF_MAPPING_RAM_SIZE];
+            bool     m_simd;
+
+            /** raw ADC values and gain corrected charges of a channel */
+            std::vector<uint32_t> m_adc;
+            std::vector<uint32_t> m_charge;
+            std::vector<fcf_candidate> m_candidates;
+            /** candidate indices in merger order */
+            std::vector<uint32_t> m_order;
+            std::vector<uint32_t> m_bucket;
+            std::vector<fcf_open_cluster> m_clusters;
+            std::vector<uint32_t> m_open;
+            std::vector<uint32_t> m_next;
+
+            void
+            processChannel
+            (
+                uint32_t        hw_address,
+                const uint32_t *words,
+                uint32_t        n10
+            );
+
+            void
+            findSequences
+            (
+                const uint32_t *adc,
+                const uint32_t *charge,
+                uint32_t        n,
+                uint32_t        first_time,
+                uint32_t        mapping
+            );
+
+            void
+            addCandidate
+            (
+                const uint32_t *charge,
+                uint32_t        n,
+                uint32_t        begin,
+                uint32_t        end,
+                uint32_t        first_time,
+                uint32_t        mapping,
+                uint32_t        deconv_time
+            );
+
+            void sortCandidates();
+
+            int32_t mergeCandidates( std::vector<uint32_t> *records );
+
+            void
+            initCluster
+            (
+                fcf_open_cluster    *cluster,
+                const fcf_candidate *c,
+                uint32_t             deconv_pad
+            );
+
+            void
+            addToCluster
+            (
+                fcf_open_cluster    *cluster,
+                const fcf_candidate *c
+            );
+
+            uint32_t
+            closeCluster
+            (
+                const fcf_open_cluster *cluster,
+                std::vector<uint32_t>  *records
+            );
+
+            void unpackScalar( const uint32_t *words, uint32_t n_dw,
+                               uint32_t gain );
+            void unpackAvx2( const uint32_t *words, uint32_t n_dw,
+                             uint32_t gain );
+    };
+}
+#endif /** LIBRORC_FCF_SOFTWARE_H */
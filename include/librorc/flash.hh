@@ -33,6 +33,7 @@
 #define LIBRORC_FLASH_H
 
 #include <librorc/defines.hh>
+#include <librorc/hash.hh>
 
 
 #define FLASH_SIZE 16777216
@@ -91,6 +92,25 @@
 
 /** Timeout Value for waiting for SR7=1: 10 seconds **/
 #define CFG_FLASH_TIMEOUT 0x0010000
+#define FLASH_POLL_TIMEOUT_US 10000000
+
+/**
+ * status polling: number of reads without delay, then exponential
+ * back off up to FLASH_POLL_MAX_DELAY_US between reads
+ **/
+#define FLASH_POLL_SPIN 16
+#define FLASH_POLL_MAX_DELAY_US 100
+
+/** number of WORDs per buffer program operation */
+#define FLASH_BUFFER_WORDS 32
+
+/** DWs per BAR read of flash::readBulk */
+#define FLASH_READ_CHUNK_DWS 1024
+/** WORDs of a bulk read compared with 16 bit reads by the self-check */
+#define FLASH_BULK_CHECK_WORDS 32
+
+/** start value of flash::hashUpdate */
+#define FLASH_HASH_INIT LIBRORC_FNV1A_INIT
 
 
 /** flash busy flag mask **/
@@ -235,6 +255,44 @@ namespace LIBRARY_NAME
             uint32_t addr
         );
 
+    /**
+     * read consecutive WORDs from flash with 32 bit BAR reads. The
+     * flash has to be in asynchronous read mode and in read array
+     * state, see setAsynchronousReadMode().
+     * A 32 bit read is expected to return WORD addr in [15:0] and
+     * addr+1 in [31:16]. The first bulk reads of an instance compare
+     * their start against get() until the data reveals the WORD order;
+     * if it does not match, all further reads use get().
+     * @param addr start WORD address
+     * @param words number of WORDs
+     * @param data destination buffer
+     * @param hash optional running hash, updated with hashUpdate()
+     * @return 0 on sucess, -1 on invalid address range
+     **/
+        int32_t
+        readBulk
+        (
+            uint32_t  addr,
+            uint32_t  words,
+            uint16_t *data,
+            uint64_t *hash = NULL
+        );
+
+    /**
+     * update a running 64 bit FNV-1a hash, see fnv1aUpdate()
+     * @param hash current hash, FLASH_HASH_INIT to start
+     * @param data data to add
+     * @param bytes number of bytes
+     * @return updated hash
+     **/
+        static uint64_t
+        hashUpdate
+        (
+            uint64_t    hash,
+            const void *data,
+            size_t      bytes
+        );
+
     /**
      * Buffer Program Mode
      * @param addr start address
@@ -327,6 +385,21 @@ namespace LIBRARY_NAME
             librorc_verbosity_enum  verbose
         );
 
+    /**
+     * compare flash contents with a file
+     * @param filename reference file
+     * @param verbose verbose level
+     * @param hash optional, set to the hash of the flash contents
+     * @return -1 on error, 0 if the flash matches the file, 1 if not
+     * */
+        int32_t
+        verify
+        (
+            char                   *filename,
+            librorc_verbosity_enum  verbose,
+            uint64_t               *hash = NULL
+        );
+
     /**
      * erase flash
      * @param verbose verbose level
@@ -343,13 +416,62 @@ namespace LIBRARY_NAME
      * program flash with binary file
      * @param filename source file
      * @param verbose verbose level
+     * @param differential only erase and program blocks that differ
+     *        from the file contents
      * @return -1 on error, 0 on success
      * */
         int32_t
         flashWrite
         (
             char                   *filename,
-            librorc_verbosity_enum  verbose
+            librorc_verbosity_enum  verbose,
+            bool                    differential = false
+        );
+
+    /**
+     * program flash with an image in memory, starting at address 0.
+     * Each block is erased and programmed in turn, 32 WORD buffers that
+     * are still erased after the block erase are not programmed.
+     * In differential mode each block is read first: identical blocks
+     * are skipped, blocks that only need bits cleared are programmed
+     * without erase.
+     * @param image image data
+     * @param words number of WORDs in the image
+     * @param verbose verbose level
+     * @param differential compare with the flash contents first
+     * @return -1 on error, 0 on success
+     * */
+        int32_t
+        programImage
+        (
+            const uint16_t         *image,
+            uint32_t                words,
+            librorc_verbosity_enum  verbose,
+            bool                    differential
+        );
+
+    /**
+     * program both flash chips concurrently, one thread per chip.
+     * Progress output is suppressed, a summary is printed per chip
+     * if verbose is set.
+     * @param flash0 flash instance of chip select 0
+     * @param filename0 source file for flash0
+     * @param flash1 flash instance of chip select 1
+     * @param filename1 source file for flash1
+     * @param verbose verbose level
+     * @param differential only program blocks that differ
+     * @return -1 if programming of one of the chips failed, 0 on
+     *         success
+     * */
+        static int32_t
+        flashWriteParallel
+        (
+            flash                  *flash0,
+            char                   *filename0,
+            flash                  *flash1,
+            char                   *filename1,
+            librorc_verbosity_enum  verbose,
+            bool                    differential = false
         );
 
     /**
@@ -403,6 +525,12 @@ namespace LIBRARY_NAME
         bar      *m_bar;
         uint32_t  m_base_addr;
         uint32_t  m_chip_select;
+        int32_t   m_bulk_read;
+
+        void checkBulkRead( uint32_t addr, const uint16_t *data,
+                            uint32_t words );
+
+        static void *flashWriteThread( void *arg );
 
 
     /**
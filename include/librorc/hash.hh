@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Content hash shared by the modules that detect unchanged images or
+ * tables, e.g. flash verification and the FCF mapping RAM cache.
+ */
+
+#ifndef LIBRORC_HASH_H
+#define LIBRORC_HASH_H
+
+#include <stddef.h>
+#include <librorc/defines.hh>
+
+/** start value of fnv1aUpdate(), FNV-1a 64 bit offset basis */
+#define LIBRORC_FNV1A_INIT 0xcbf29ce484222325ull
+/** FNV-1a 64 bit prime */
+#define LIBRORC_FNV1A_PRIME 0x100000001b3ull
+
+namespace LIBRARY_NAME
+{
+    /**
+     * update a running 64 bit FNV-1a hash
+     * @param hash current hash, LIBRORC_FNV1A_INIT to start
+     * @param data data to add
+     * @param bytes number of bytes
+     * @return updated hash
+     **/
+    static inline uint64_t
+    fnv1aUpdate
+    (
+        uint64_t    hash,
+        const void *data,
+        size_t      bytes
+    )
+    {
+        const uint8_t *p = (const uint8_t *)data;
+        for( size_t i=0; i<bytes; i++ )
+        {
+            hash ^= p[i];
+            hash *= LIBRORC_FNV1A_PRIME;
+        }
+        return hash;
+    }
+}
+#endif /** LIBRORC_HASH_H */
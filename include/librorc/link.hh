@@ -40,6 +40,9 @@ namespace LIBRARY_NAME
 {
     class device;
 
+/** number of control registers with a software shadow per link **/
+#define LIBRORC_LINK_SHADOW_REGS 6
+
     /**
      * @brief link class, TODO: rename & cleanup!
      **/
@@ -134,6 +137,89 @@ namespace LIBRARY_NAME
              **/
             uint32_t pciReg(uint32_t addr);
 
+            /**
+             * read-modify-write DW in GTX Domain: only the bits set in mask
+             * are replaced with the according bits from value.
+             * @param addr address in GTX component
+             * @param mask bits to be modified
+             * @param value new value of the masked bits
+             **/
+            void
+            modifyGtxReg
+            (
+                uint32_t addr,
+                uint32_t mask,
+                uint32_t value
+            );
+
+            /**
+             * read-modify-write DW in DDL Domain, see modifyGtxReg
+             **/
+            void
+            modifyDdlReg
+            (
+                uint32_t addr,
+                uint32_t mask,
+                uint32_t value
+            );
+
+            /**
+             * read-modify-write DW in Packetizer, see modifyGtxReg
+             **/
+            void
+            modifyPciReg
+            (
+                uint32_t addr,
+                uint32_t mask,
+                uint32_t value
+            );
+
+            /**
+             * enable/disable the software shadow of control registers.
+             * With the shadow enabled, modify*Reg() of a shadowed control
+             * register reads the register from hardware only once and uses
+             * the last written value afterwards. Status, strobe and
+             * write-one-to-clear bits of a shadowed register are never
+             * taken from the shadow. Getters always read from hardware.
+             * The shadow has to be invalidated if the registers are
+             * modified by other link instances or processes.
+             * @param enable true to enable, false to disable
+             **/
+            void setShadowEnable( bool enable );
+
+            /**
+             * check if the control register shadow is enabled
+             * @return true if enabled
+             **/
+            bool shadowEnabled()
+            { return m_shadow_enabled; }
+
+            /**
+             * drop all shadowed register values. The next read-modify-write
+             * of each shadowed register reads from hardware again.
+             **/
+            void invalidateShadow()
+            { m_shadow_valid = 0; }
+
+            /**
+             * get the BAR address of a link register, e.g. to add it to
+             * a bar::transaction
+             * @param addr address in GTX/DDL/PKT component
+             * @return absolute BAR address
+             **/
+            bar_address gtxAddress( uint32_t addr );
+            bar_address ddlAddress( uint32_t addr );
+            bar_address pciAddress( uint32_t addr );
+
+            /**
+             * apply a transaction of registers of this link. The
+             * completing read goes to the first Packetizer register of this
+             * link. The control register shadow is invalidated.
+             * @param t transaction built with *Address() addresses
+             * @return number of bursts issued
+             **/
+            size_t apply( bar::transaction &t );
+
             /**
              * memcopy data to link registers. This is a wrapper around
              * bar::memcopy using m_base offset on the target register.
@@ -300,8 +386,16 @@ namespace LIBRARY_NAME
             uint32_t  m_base;
             uint32_t  m_link_number;
 
+            bool      m_shadow_enabled;
+            uint32_t  m_shadow_valid;
+            uint32_t  m_shadow[LIBRORC_LINK_SHADOW_REGS];
+
             void setDataSourceMux( uint32_t value );
             uint32_t getDataSourceMux();
+
+            int shadowIndex( bar_address addr );
+            void setReg( bar_address addr, uint32_t data );
+            void modifyReg( bar_address addr, uint32_t mask, uint32_t value );
 };
 
 }
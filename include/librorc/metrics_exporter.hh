@@ -0,0 +1,225 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * The metrics_exporter collects DMA and link statistics of all channels
+ * of one or more devices and renders them in the Prometheus text
+ * exposition format, to a file or to clients of a Unix socket.
+ */
+
+#ifndef LIBRORC_METRICS_EXPORTER_H
+#define LIBRORC_METRICS_EXPORTER_H
+
+#include <string>
+#include <vector>
+#include <librorc/defines.hh>
+#include <librorc/event_stream.hh>
+
+namespace LIBRARY_NAME
+{
+    class device;
+    class bar;
+    class sysmon;
+    class link;
+    class dma_channel;
+
+    /**
+     * metrics exported per channel, see metrics_exporter.cpp for names
+     **/
+    typedef enum
+    {
+        kMetricEnabled,
+        kMetricEvents,
+        kMetricBytes,
+        kMetricErrors,
+        kMetricEventRate,
+        kMetricByteRate,
+        kMetricEngineEvents,
+        kMetricStallCycles,
+        kMetricDmaDeadtime,
+        kMetricDdlDeadtime,
+        kMetricEbOccupancy,
+        kMetricRbOccupancy,
+        kMetricCount
+    } metrics_exporter_metric;
+
+    /**
+     * last sample of one channel
+     **/
+    typedef struct
+    {
+        uint32_t device;
+        uint32_t channel;
+        uint32_t valid;    /**< bit i: values[i] is valid */
+        double   values[kMetricCount];
+        /** counters of the previous sample for rates */
+        uint64_t last_events;
+        uint64_t last_bytes;
+    } metrics_exporter_channel;
+
+    /**
+     * @brief export DMA and link statistics in the Prometheus text format
+     *
+     * Event, byte and error counters come from the ChannelStatus shared
+     * memory of the event_stream owning the channel and are only
+     * available if librorc was built with SHM. Stall counts, deadtimes
+     * and ring occupancy are read from the device. Rates are computed
+     * between two calls of sample() on the monotonic clock.
+     **/
+    class metrics_exporter
+    {
+        public:
+            metrics_exporter();
+            ~metrics_exporter();
+
+            /**
+             * open a device and export all of its channels
+             * @param device_number device number
+             * @return 0 on success, -1 if the device can not be opened
+             **/
+            int
+            addDevice
+            (
+                uint32_t device_number
+            );
+
+            /**
+             * add devices starting from 0 until a device fails to open
+             * @return number of devices added
+             **/
+            uint32_t addAllDevices();
+
+            /**
+             * export all channels of a bar that is not owned by the
+             * exporter, e.g. with a custom backend
+             * @param bar BAR1 of the device
+             * @param device_number device number used for labels and
+             *        for the ChannelStatus shared memory keys
+             * @return 0 on success
+             **/
+            int
+            addBar
+            (
+                bar      *bar,
+                uint32_t  device_number
+            );
+
+            /**
+             * number of exported channels over all devices
+             **/
+            uint32_t numberOfChannels();
+
+            /**
+             * read all channels and update the exposition
+             **/
+            void sample();
+
+            /**
+             * get the exposition of the last sample
+             **/
+            const std::string &exposition()
+            { return m_exposition; }
+
+            /**
+             * get the last sample of all channels
+             **/
+            const std::vector<metrics_exporter_channel> &channels()
+            { return m_channels; }
+
+            /**
+             * write the exposition to a file. The file is replaced
+             * atomically, so it can be used with a textfile collector.
+             * @param filename target file
+             * @return 0 on success, -1 on error
+             **/
+            int
+            writeFile
+            (
+                const char *filename
+            );
+
+            /**
+             * listen on a Unix socket. Each client gets the exposition
+             * of the last sample, with an HTTP header if it sent a GET
+             * request. An existing socket file is replaced.
+             * @param path socket path
+             * @return 0 on success, -1 on error
+             **/
+            int
+            listenSocket
+            (
+                const char *path
+            );
+
+            /**
+             * answer socket clients for up to timeout_ms
+             * @param timeout_ms time to wait for clients
+             * @return number of clients served, -1 if not listening
+             **/
+            int
+            serve
+            (
+                uint32_t timeout_ms
+            );
+
+        protected:
+            typedef struct
+            {
+                device         *dev;
+                bar            *dbar;
+                sysmon         *sm;
+                uint32_t        number;
+                bool            owned;
+                std::vector<link *>          links;
+                std::vector<dma_channel *>   channels;
+                std::vector<ChannelStatus *> status;
+            } exporter_device;
+
+            void sampleChannel
+            (
+                exporter_device          *dev,
+                uint32_t                  ch,
+                metrics_exporter_channel *out,
+                double                    interval
+            );
+
+            void render();
+            void serveClient( int fd );
+
+            std::vector<exporter_device>          m_devices;
+            std::vector<metrics_exporter_channel> m_channels;
+            std::string                           m_exposition;
+            std::string                           m_socket_path;
+            int                                   m_socket;
+            uint64_t                              m_last_sample_ns;
+    };
+
+}
+#endif /** LIBRORC_METRICS_EXPORTER_H */
@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Fan-out helper for operations that run independently per link or per
+ * flash chip, e.g. mapping RAM loads, parallel flash programming and
+ * software cluster finding.
+ */
+
+#ifndef LIBRORC_PARALLEL_H
+#define LIBRORC_PARALLEL_H
+
+#include <pthread.h>
+#include <vector>
+#include <librorc/defines.hh>
+
+namespace LIBRARY_NAME
+{
+    /**
+     * run fn once for each element of args, every call in its own thread.
+     * A call that cannot get a thread runs inline instead. Results are
+     * passed back through the elements of args.
+     * @param fn worker, gets a pointer to one element of args
+     * @param args per-call arguments
+     * @param n number of elements in args
+     * @return after all calls completed
+     **/
+    template<typename T>
+    inline void
+    runParallel
+    (
+        void   *(*fn)(void *),
+        T       *args,
+        size_t   n
+    )
+    {
+        std::vector<pthread_t> thread(n);
+        std::vector<bool> running(n, false);
+        for( size_t i=0; i<n; i++ )
+        {
+            if( pthread_create(&thread[i], NULL, fn, &args[i]) == 0 )
+            { running[i] = true; }
+            else
+            { fn(&args[i]); }
+        }
+
+        for( size_t i=0; i<n; i++ )
+        {
+            if( running[i] )
+            { pthread_join(thread[i], NULL); }
+        }
+    }
+
+    template<typename T>
+    inline void
+    runParallel
+    (
+        void           *(*fn)(void *),
+        std::vector<T>  &args
+    )
+    {
+        if( !args.empty() )
+        { runParallel(fn, &args[0], args.size()); }
+    }
+}
+#endif /** LIBRORC_PARALLEL_H */
@@ -121,6 +121,13 @@ namespace LIBRARY_NAME
             void
             clearLastFrontEndCommandWord();
 
+            /**
+             * Clear event count, DDL and DMA deadtime and the last
+             * FrontEnd Command Word with a single register transaction
+             **/
+            void
+            clearAllCounters();
+
             /**
              * get state of SIU Interface FIFO. If this FIFO is permanently
              * empty there is no data from DMA or PG available.
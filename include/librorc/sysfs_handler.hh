@@ -31,6 +31,7 @@
 
 #include <librorc/defines.hh>
 #include <stdint.h>
+#include <pthread.h>
 #include <string>
 #include <vector>
 
@@ -71,6 +72,22 @@ struct __attribute__((__packed__)) scatter {
   uint64_t dma_address;
 };
 
+#define LIBRORC_SYSFS_LATENCY_BINS 24
+
+/**
+ * latency histogram with logarithmic bins: bin[i] counts latencies in
+ * [2^i, 2^(i+1)) microseconds, bin[0] additionally includes 0us. The last
+ * bin collects everything above.
+ **/
+typedef struct {
+  uint64_t bin[LIBRORC_SYSFS_LATENCY_BINS];
+  uint64_t count;
+  uint64_t timeouts;
+  uint64_t min_us;
+  uint64_t max_us;
+  uint64_t sum_us;
+} sysfs_latency_histogram;
+
 class sysfs_handler {
 public:
   sysfs_handler(uint32_t device_id, int scanmode=LIBRORC_SCANMODE_PCI);
@@ -93,6 +110,13 @@ public:
   std::vector<uint64_t> list_all_buffers();
   bool buffer_exists(uint64_t id);
 
+  /**
+   * get histogram of the time from writing a buffer request to the kernel
+   * module until the buffer attributes are available for mapping
+   **/
+  sysfs_latency_histogram get_alloc_latency_histogram();
+  void reset_alloc_latency_histogram();
+
   ssize_t get_sglist_size(uint64_t id);
   int mmap_sglist(void **map, uint64_t id, ssize_t size);
   void munmap_sglist(void *map, ssize_t size);
@@ -104,10 +128,13 @@ protected:
   bool __attribute_exists(std::string attr_path);
   int bind_pci_device();
   int write_ids_to_kernel_module();
+  void record_alloc_latency(uint64_t latency_us, bool timeout);
 
   bool m_device_id_found;
   std::string m_sysfs_device_base;
   std::string m_sysfs_pci_slot;
+  pthread_mutex_t m_hist_mtx;
+  sysfs_latency_histogram m_alloc_hist;
 };
 }
 
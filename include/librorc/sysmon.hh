@@ -31,6 +31,8 @@
 
 #include <iostream>
 #include <cstring>
+#include <vector>
+#include <pthread.h>
 #include <librorc/defines.hh>
 
 #ifndef LIBRORC_SYSMON_H
@@ -41,16 +43,79 @@
 #define LIBRORC_SYSMON_QSFP_EXT_RATE_SELECTION 1
 #define LIBRORC_SYSMON_QSFP_APT_RATE_SELECTION 2
 
+/** number of I2C chains, see sysmon::i2c_module_start */
+#define LIBRORC_SYSMON_I2C_CHAINS 6
+/** SysV shared memory key of the I2C locks of device 0 */
+#define LIBRORC_SYSMON_I2C_LOCK_SHM_KEY_OFFSET 16640
+#define LIBRORC_SYSMON_I2C_LOCK_MAGIC 0x524f524349324331ull
+/** default time to wait for an I2C lock */
+#define LIBRORC_SYSMON_I2C_LOCK_TIMEOUT_MS 5000
+
 namespace LIBRARY_NAME
 {
     class bar;
 
+    /**
+     * event to be written to DDR3 with sysmon::ddr3DataReplayUpload
+     **/
+    typedef struct
+    {
+        uint32_t *event_data;      /**< pointer to data */
+        uint32_t  num_dws;         /**< number of DWs */
+        uint32_t  ddr3_start_addr; /**< DDR3 memory start address */
+        uint8_t   channel;         /**< channel number, 0-11 */
+        bool      last_event;      /**< last event for this channel */
+        bool      diu_error;       /**< set DIU error flag on this event */
+        uint32_t  next_addr;       /**< set to the address for the next event */
+    } ddr3_replay_event;
+
+    /**
+     * throughput of a sysmon::ddr3DataReplayUpload
+     **/
+    typedef struct
+    {
+        uint64_t bytes;            /**< event bytes written */
+        uint64_t blocks;           /**< replay blocks written */
+        double   seconds;          /**< wall clock time */
+        double   mbps;             /**< MB/s over both controllers */
+        double   controller_mbps[2]; /**< MB/s per controller */
+    } ddr3_replay_upload_stats;
+
+    /**
+     * process-shared robust recursive mutex guarding an I2C chain or
+     * the I2C module. All fields besides the mutex and waiters are only
+     * modified by the owner.
+     **/
+    typedef struct
+    {
+        pthread_mutex_t   mtx;
+        volatile uint32_t depth;      /**< recursion depth of the owner */
+        volatile uint32_t waiters;    /**< threads blocked on the mutex */
+        volatile uint32_t generation; /**< incremented on each acquisition */
+        volatile uint32_t recoveries; /**< acquisitions from dead owners */
+    } sysmon_i2c_lock;
+
+    /**
+     * I2C locks of one device: one per chain for multi-transaction
+     * sequences, the last one for single transactions on the I2C
+     * module, which is shared by all chains.
+     **/
+    typedef struct
+    {
+        volatile uint64_t magic;
+        sysmon_i2c_lock   lock[LIBRORC_SYSMON_I2C_CHAINS+1];
+    } sysmon_i2c_locks;
+
     /**
      * @brief System monitor class
      *
      * This class can be attached to bar to provide access to the
      * static parts of the design, like PCIe status and SystemMonitor 
      * readings
+     *
+     * I2C accesses are serialized with the locks in sysmon_i2c_locks.
+     * If the bar belongs to a device, the locks live in SysV shared
+     * memory and are shared by all processes accessing that device.
      **/
     class sysmon
     {
@@ -311,6 +376,60 @@ namespace LIBRARY_NAME
             );
 
 
+            /**
+             * attach to the I2C locks shared by all processes using
+             * device_number. This is done by the constructor if the bar
+             * belongs to a device, which throws
+             * LIBRORC_SYSMON_ERROR_I2C_LOCK_FAILED if that fails. Use this
+             * for other bar backends. A segment whose creator died before
+             * initializing it is replaced.
+             * @param device_number device number, selects the locks
+             * @return 0 on success, -1 on error
+             **/
+            int
+            i2cShareLock
+            (
+                uint32_t device_number
+            );
+
+            /**
+             * set the time to wait for an I2C lock before
+             * LIBRORC_SYSMON_ERROR_I2C_LOCK_TIMEOUT is thrown
+             * @param timeout_ms timeout in milliseconds
+             **/
+            void
+            i2cSetLockTimeout
+            (
+                uint32_t timeout_ms
+            );
+
+            /**
+             * lock an I2C chain for a sequence of transactions that must
+             * not be interleaved with other users of the chain, e.g. a
+             * page select followed by reads. Recursive, every call has to
+             * be paired with i2cUnlockChain, see also i2c_chain_lock.
+             * Transactions of other chains still interleave.
+             * Throws exception on timeout
+             * @param chain i2c chain number
+             **/
+            void
+            i2cLockChain
+            (
+                uint8_t chain
+            );
+
+            void
+            i2cUnlockChain
+            (
+                uint8_t chain
+            );
+
+            /**
+             * number of I2C locks taken over from processes that died
+             * while holding them
+             **/
+            uint32_t i2cLockRecoveries();
+
             /**
              * reset i2c bus
              * @param chain chain to be resetted
@@ -336,6 +455,46 @@ namespace LIBRARY_NAME
                 uint8_t memaddr
             );
 
+            /**
+             * Read bytes from two independent i2c memory locations
+             * in a single transaction. Throws exception on error.
+             * @param chain i2c chain number
+             * @param slvaddr slave address
+             * @param memaddr0 first memory address
+             * @param memaddr1 second memory address
+             * @return data of memaddr1 in bits [15:8], data of
+             * memaddr0 in bits [7:0]
+            **/
+            uint16_t
+            i2c_read_mem_dual
+            (
+                uint8_t chain,
+                uint8_t slvaddr,
+                uint8_t memaddr0,
+                uint8_t memaddr1
+            );
+
+            /**
+             * Read length consecutive bytes starting at memaddr.
+             * The I2C module transfers up to two bytes per
+             * transaction, so this issues (length+1)/2 transactions
+             * instead of length. Throws exception on error.
+             * @param chain i2c chain number
+             * @param slvaddr slave address
+             * @param memaddr first memory address
+             * @param data target buffer, at least length bytes
+             * @param length number of bytes to read
+            **/
+            void
+            i2c_read_mem_seq
+            (
+                uint8_t  chain,
+                uint8_t  slvaddr,
+                uint8_t  memaddr,
+                uint8_t *data,
+                uint32_t length
+            );
+
             /**
              * Write byte to i2c memory location.
              * Throws exception on error
@@ -427,6 +586,25 @@ namespace LIBRARY_NAME
                 bool diu_error = false
             );
 
+            /**
+             * write a list of events to DDR3 memory. Events for channels
+             * 0-5 and 6-11 are streamed to DDR3 controller 0 and 1 from
+             * separate threads. The next block of an event is staged
+             * while the previous one is written by the controller, the
+             * write done flag is only checked before the replay buffer
+             * is reused.
+             * @param events events to be written, next_addr is filled in
+             *        for each event
+             * @param stats optional throughput report
+             * @return 0 on success, throws on error
+             **/
+            int
+            ddr3DataReplayUpload
+            (
+                std::vector<ddr3_replay_event> &events,
+                ddr3_replay_upload_stats       *stats = NULL
+            );
+
             /**
              * read from DDR3 SPD monitor
              * @param module 0 or 1 to select target SO-DIMM module
@@ -441,8 +619,9 @@ namespace LIBRARY_NAME
             );
 
             /**
-             * read string from DDR3 SPD monitor. This iteratively calls
-             * ddr3SpdRead and returns the results as a string
+             * read string from DDR3 SPD monitor. This reads the address
+             * range with i2c_read_mem_seq and returns the results as a
+             * string
              * @param module 0 or 1 to select target SO-DIMM module
              * @param start_address first address to read
              * @param end_address last address to read
@@ -522,6 +701,53 @@ namespace LIBRARY_NAME
                  uint32_t flags
             );
 
+            /**
+             * fill a 16 DW replay block buffer from event data
+             * @return number of DWs consumed
+             **/
+            uint32_t
+            ddr3DataReplayStageBlock
+            (
+                uint32_t *block,
+                uint32_t *data,
+                uint32_t  num_dws,
+                uint8_t   channel,
+                bool      last_event,
+                bool      diu_error
+            );
+
+            /**
+             * write a staged block to the replay buffer and start the
+             * transfer to DDR3 without waiting for write done
+             **/
+            void
+            ddr3DataReplayIssueBlock
+            (
+                 uint32_t start_addr,
+                 uint32_t *block,
+                 uint8_t channel
+            );
+
+            /**
+             * wait for write done of all outstanding replay blocks,
+             * call with m_dr_mtx held. The lock is released if this
+             * throws LIBRORC_SYSMON_ERROR_DATA_REPLAY_TIMEOUT.
+             **/
+            void ddr3DataReplayWaitIdle();
+
+            /**
+             * thread body of ddr3DataReplayUpload
+             **/
+            void
+            ddr3DataReplayUploadController
+            (
+                std::vector<ddr3_replay_event> &events,
+                uint32_t controller,
+                uint64_t *blocks
+            );
+
+            static void *ddr3DataReplayUploadThread( void *arg );
+
             void
             i2c_module_start
             (
@@ -534,6 +760,31 @@ namespace LIBRARY_NAME
 
             uint32_t i2c_wait_for_cmpl();
 
+            /**
+             * run a single I2C module transaction under the chain and
+             * module locks
+             * @return operation register after completion for reads
+             **/
+            uint32_t
+            i2c_transaction
+            (
+                uint8_t  chain,
+                uint8_t  slvaddr,
+                uint8_t  cmd,
+                uint8_t  byte_enable,
+                uint32_t opdata
+            );
+
+            void i2c_lock_init( sysmon_i2c_locks *locks );
+            static bool i2c_lock_creator_died( int shID );
+            void i2c_lock_acquire( uint32_t index );
+            void i2c_lock_release( uint32_t index );
+
+            /**
+             * wait for a transaction of a dead lock owner to finish
+             **/
+            void i2c_lock_recover_module();
+
             /**
              * read string from QSFP i2c memory map
              * @param index target QSFP
@@ -565,6 +816,44 @@ namespace LIBRARY_NAME
 
             /** high speed mode flag */
             uint8_t m_i2c_hsmode;
+
+            /** I2C locks, in shared memory if m_i2c_locks_shared */
+            sysmon_i2c_locks *m_i2c_locks;
+            bool              m_i2c_locks_shared;
+            uint32_t          m_i2c_lock_timeout_ms;
+
+            /** set on release if others were waiting: the next
+             *  acquisition waits until one of them got the lock */
+            bool     m_i2c_handoff[LIBRORC_SYSMON_I2C_CHAINS+1];
+            uint32_t m_i2c_handoff_gen[LIBRORC_SYSMON_I2C_CHAINS+1];
+
+            /** protects the data replay buffer and m_dr_pending */
+            pthread_mutex_t m_dr_mtx;
+
+            /** write done flags of blocks not yet completed */
+            uint32_t m_dr_pending;
+    };
+
+    /**
+     * @brief hold the lock of an I2C chain for the lifetime of this
+     * object
+     **/
+    class i2c_chain_lock
+    {
+        public:
+            i2c_chain_lock
+            (
+                sysmon  *sm,
+                uint8_t  chain
+            ) : m_sm(sm), m_chain(chain)
+            { m_sm->i2cLockChain(m_chain); }
+
+            ~i2c_chain_lock()
+            { m_sm->i2cUnlockChain(m_chain); }
+
+        protected:
+            sysmon  *m_sm;
+            uint8_t  m_chain;
     };
 
 }
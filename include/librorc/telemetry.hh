@@ -0,0 +1,268 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * The telemetry class samples board health values in a background thread
+ * and publishes them in a SysV shared memory ring, so monitoring tools can
+ * read them without accessing the hardware.
+ */
+
+#ifndef LIBRORC_TELEMETRY_H
+#define LIBRORC_TELEMETRY_H
+
+#include <vector>
+#include <pthread.h>
+#include <librorc/defines.hh>
+#include <librorc/sysmon.hh>
+
+/** SysV shared memory key of device 0, devices follow consecutively */
+#define LIBRORC_TELEMETRY_SHM_KEY_OFFSET 16384
+/** number of samples kept in the ring */
+#define LIBRORC_TELEMETRY_SLOTS 4096
+#define LIBRORC_TELEMETRY_MAGIC 0x524f524354454c4dull
+#define LIBRORC_TELEMETRY_VERSION 1
+
+/** default sampling intervals */
+#define LIBRORC_TELEMETRY_INTERVAL_MS 1000
+#define LIBRORC_TELEMETRY_QSFP_INTERVAL_MS 10000
+
+namespace LIBRARY_NAME
+{
+    /**
+     * one telemetry sample. QSFP values are refreshed at the QSFP
+     * interval and repeated in the samples in between,
+     * qsfp_timestamp_us tells when they were read.
+     **/
+    typedef struct
+    {
+        uint64_t timestamp_us;      /**< wall clock time of the sample */
+        uint64_t qsfp_timestamp_us; /**< wall clock time of the QSFP values */
+        uint64_t uptime_seconds;
+        double   fpga_temperature;  /**< degree Celsius */
+        double   vccint;            /**< Volts */
+        double   vccaux;            /**< Volts */
+        double   fan_speed;         /**< RPM */
+        float    max_pcie_deadtime; /**< microseconds */
+        uint32_t pcie_request_canceled;
+        uint32_t pcie_tx_timeout;
+        uint32_t pcie_illegal_request;
+        uint32_t pcie_multi_dw_read;
+        uint32_t pcie_tx_destination_busy;
+        uint32_t pcie_transmission_error;
+        uint32_t qsfp_present;      /**< bit i: QSFP i is present */
+        uint32_t qsfp_valid;        /**< bit i: QSFP i values were read */
+        float    qsfp_temperature[LIBRORC_MAX_QSFP];
+        float    qsfp_voltage[LIBRORC_MAX_QSFP];
+        float    qsfp_rx_power[LIBRORC_MAX_QSFP][4];
+        float    qsfp_tx_bias[LIBRORC_MAX_QSFP][4];
+        uint32_t i2c_errors;        /**< failed QSFP readouts since start */
+    } telemetry_sample;
+
+    /**
+     * ring header at the start of the shared memory segment.
+     * head counts the samples published so far, sample n lives in
+     * slot n % slots.
+     **/
+    typedef struct
+    {
+        uint64_t          magic;
+        uint32_t          version;
+        uint32_t          slots;
+        uint32_t          sample_size;
+        uint32_t          device;
+        uint32_t          interval_ms;
+        uint32_t          qsfp_interval_ms;
+        volatile uint64_t head;
+        volatile int32_t  writer_pid;
+        uint32_t          reserved;
+    } telemetry_ring_header;
+
+    /**
+     * ring slot. seq is odd while the sampler writes the slot and
+     * 2*(n+1) once sample n is complete (seqlock).
+     **/
+    typedef struct
+    {
+        volatile uint64_t seq;
+        telemetry_sample  sample;
+    } telemetry_slot;
+
+    /**
+     * @brief sample board telemetry in the background and share it
+     * with any number of readers
+     *
+     * A sampler instance is created with a sysmon and owns the
+     * sampling thread. It is the only writer of the ring of its device.
+     * Reader instances attach to the ring by device number only and
+     * never touch the hardware. Readers do not take locks: a sample
+     * that is overwritten while it is copied is detected by its
+     * sequence number and skipped.
+     **/
+    class telemetry
+    {
+        public:
+            /**
+             * sampler: create or attach the ring of a device. Only one
+             * process writes a ring, a sampler of a running other process
+             * is refused with LIBRORC_TELEMETRY_ERROR_WRITER_ACTIVE.
+             * Throws exception on error
+             * @param sm sysmon of the device
+             * @param device_number device number, selects the ring
+             **/
+            telemetry
+            (
+                sysmon   *sm,
+                uint32_t  device_number
+            );
+
+            /**
+             * reader: attach the ring of a device
+             * Throws exception if no sampler has created it yet
+             * @param device_number device number, selects the ring
+             **/
+            telemetry
+            (
+                uint32_t device_number
+            );
+
+            ~telemetry();
+
+            /**
+             * set sampling intervals, takes effect with the next sample
+             * @param interval_ms interval of MMIO values
+             * @param qsfp_interval_ms interval of QSFP I2C values,
+             *        0 disables QSFP sampling
+             * @return 0 on success, -1 for readers or invalid intervals
+             **/
+            int
+            setInterval
+            (
+                uint32_t interval_ms,
+                uint32_t qsfp_interval_ms
+            );
+
+            /**
+             * start the sampling thread
+             * @return 0 on success, -1 for readers or if running
+             **/
+            int start();
+
+            /**
+             * stop the sampling thread and wait for it to exit
+             **/
+            void stop();
+
+            bool isRunning();
+
+            /**
+             * take one sample and publish it
+             * @return 0 on success, -1 for readers
+             **/
+            int sampleOnce();
+
+            /**
+             * copy the most recent sample
+             * @param sample target
+             * @return true if a sample was available
+             **/
+            bool
+            latest
+            (
+                telemetry_sample *sample
+            );
+
+            /**
+             * copy up to max_samples most recent samples, oldest first
+             * @param samples target, replaced
+             * @param max_samples maximum number of samples
+             * @return number of samples copied
+             **/
+            uint32_t
+            history
+            (
+                std::vector<telemetry_sample> &samples,
+                uint32_t                       max_samples
+            );
+
+            /**
+             * number of samples published since the ring was created
+             **/
+            uint64_t samplesWritten();
+
+            /**
+             * remove the ring of a device from the system. Attached
+             * instances keep working until they are destroyed.
+             * @return 0 on success, -1 on error
+             **/
+            static int
+            removeSharedMemory
+            (
+                uint32_t device_number
+            );
+
+        protected:
+            void
+            attach
+            (
+                uint32_t device_number,
+                bool     create
+            );
+
+            void readSample( telemetry_sample *sample );
+            void readQsfp( telemetry_sample *sample );
+            void publish( const telemetry_sample *sample );
+
+            bool
+            readSlot
+            (
+                uint64_t          n,
+                telemetry_sample *sample
+            );
+
+            void run();
+            static void *samplerThread( void *arg );
+
+            sysmon                *m_sm;
+            telemetry_ring_header *m_header;
+            telemetry_slot        *m_slots;
+
+            /** QSFP values carried over into samples between readouts */
+            telemetry_sample       m_last;
+            uint64_t               m_next_qsfp_us;
+
+            pthread_t              m_thread;
+            pthread_mutex_t        m_mtx;
+            pthread_cond_t         m_cond;
+            bool                   m_running;
+            bool                   m_stop;
+    };
+
+}
+#endif /** LIBRORC_TELEMETRY_H */
@@ -28,10 +28,16 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  **/
 
+#include <stdio.h>
+#include <stdlib.h>
+
 #include <librorc/device.hh>
 #include <librorc/bar.hh>
+#include <librorc/bar_impl.hh>
 #include <librorc/bar_impl_hw.hh>
 #include <librorc/bar_impl_sim.hh>
+#include <librorc/bar_impl_trace.hh>
+#include <librorc/bar_profiler.hh>
 
 namespace LIBRARY_NAME {
 
@@ -42,34 +48,99 @@ bar::bar(device *dev, int32_t n)
 #else
           new bar_impl_hw(dev, n)
 #endif
-          ) {
+          ),
+      m_dev(dev) {
+  /** record all accesses of this BAR to <LIBRORC_BAR_RECORD>.bar<n> */
+  const char *trace = getenv("LIBRORC_BAR_RECORD");
+  if (trace != NULL) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.bar%d", trace, n);
+    try {
+      p = new bar_impl_trace_recorder(p, path);
+    } catch (...) {
+      delete p;
+      throw;
+    }
+  }
 }
 
+bar::bar(uint8_t *map, size_t size)
+    : p(new bar_impl_hw(map, size)), m_dev(NULL) {}
+
+bar::bar(bar_impl *impl) : p(impl), m_dev(NULL) {}
+
 bar::~bar() { delete p; }
 
+/**
+ * all accessors take a single branch when profiling is disabled, see
+ * bar_profiler.hh
+ **/
 void bar::memcopy(bar_address target, const void *source,
                   size_t num) {
+  if (!bar_profiler::enabled()) {
+    p->memcopy(target, source, num);
+    return;
+  }
+  uint64_t start = bar_profiler::tsc();
   p->memcopy(target, source, num);
+  bar_profiler::record(target, LIBRORC_PROF_WRITE,
+                       bar_profiler::tsc() - start);
 }
 
 void bar::memcopy(void *target, bar_address source, size_t num) {
+  if (!bar_profiler::enabled()) {
+    p->memcopy(target, source, num);
+    return;
+  }
+  uint64_t start = bar_profiler::tsc();
   p->memcopy(target, source, num);
+  bar_profiler::record(source, LIBRORC_PROF_READ,
+                       bar_profiler::tsc() - start);
 }
 
 uint32_t bar::get32(bar_address address) {
-  return p->get32(address);
+  if (!bar_profiler::enabled()) {
+    return p->get32(address);
+  }
+  uint64_t start = bar_profiler::tsc();
+  uint32_t result = p->get32(address);
+  bar_profiler::record(address, LIBRORC_PROF_READ,
+                       bar_profiler::tsc() - start);
+  return result;
 }
 
 uint16_t bar::get16(bar_address address) {
-  return p->get16(address);
+  if (!bar_profiler::enabled()) {
+    return p->get16(address);
+  }
+  uint64_t start = bar_profiler::tsc();
+  uint16_t result = p->get16(address);
+  /** 16 bit addresses are in units of words */
+  bar_profiler::record((address >> 1), LIBRORC_PROF_READ,
+                       bar_profiler::tsc() - start);
+  return result;
 }
 
 void bar::set32(bar_address address, uint32_t data) {
+  if (!bar_profiler::enabled()) {
+    p->set32(address, data);
+    return;
+  }
+  uint64_t start = bar_profiler::tsc();
   p->set32(address, data);
+  bar_profiler::record(address, LIBRORC_PROF_WRITE,
+                       bar_profiler::tsc() - start);
 }
 
 void bar::set16(bar_address address, uint16_t data) {
+  if (!bar_profiler::enabled()) {
+    p->set16(address, data);
+    return;
+  }
+  uint64_t start = bar_profiler::tsc();
   p->set16(address, data);
+  bar_profiler::record((address >> 1), LIBRORC_PROF_WRITE,
+                       bar_profiler::tsc() - start);
 }
 
 int32_t bar::gettime(struct timeval *tv, struct timezone *tz) {
@@ -81,4 +152,92 @@ size_t bar::size() { return p->size(); }
 void bar::simSetPacketSize(uint32_t packet_size) {
   p->simSetPacketSize(packet_size);
 }
+
+void bar::setPostedWrites(bool enable) { p->setPostedWrites(enable); }
+
+bool bar::postedWrites() { return p->postedWrites(); }
+
+void bar::flush(bar_address readback) {
+  if (!bar_profiler::enabled()) {
+    p->flush(readback);
+    return;
+  }
+  uint64_t start = bar_profiler::tsc();
+  p->flush(readback);
+  bar_profiler::record(readback, LIBRORC_PROF_FLUSH,
+                       bar_profiler::tsc() - start);
+}
+
+void bar::memcopyPosted(bar_address target, const void *source, size_t num) {
+  if (!bar_profiler::enabled()) {
+    p->memcopyPosted(target, source, num);
+    return;
+  }
+  uint64_t start = bar_profiler::tsc();
+  p->memcopyPosted(target, source, num);
+  bar_profiler::record(target, LIBRORC_PROF_WRITE,
+                       bar_profiler::tsc() - start);
+}
+
+bar::transaction::transaction(bar *bar) : m_bar(bar) {}
+
+void bar::transaction::set32(bar_address address, uint32_t data) {
+  modify32(address, 0xffffffff, data);
+}
+
+void bar::transaction::modify32(bar_address address, uint32_t mask,
+                                uint32_t data) {
+  entry e;
+  e.address = address;
+  e.mask = mask;
+  e.data = data;
+  m_entries.push_back(e);
+}
+
+void bar::transaction::memcopy(bar_address target, const void *source,
+                               size_t num) {
+  const uint32_t *src = (const uint32_t *)source;
+  for (size_t i = 0; i < (num >> 2); i++) {
+    set32(target + i, src[i]);
+  }
+}
+
+size_t bar::transaction::apply(bar_address readback) {
+  size_t n = m_entries.size();
+  if (n == 0) {
+    return 0;
+  }
+
+  /** resolve masked writes into full DWs */
+  std::vector<uint32_t> values(n);
+  for (size_t i = 0; i < n; i++) {
+    entry &e = m_entries[i];
+    if (e.mask == 0xffffffff) {
+      values[i] = e.data;
+      continue;
+    }
+    size_t prev = i;
+    while (prev > 0 && m_entries[prev - 1].address != e.address) {
+      prev--;
+    }
+    uint32_t current =
+        (prev > 0) ? values[prev - 1] : m_bar->get32(e.address);
+    values[i] = (current & ~e.mask) | (e.data & e.mask);
+  }
+
+  /** write runs of consecutive addresses as a single burst */
+  size_t bursts = 0;
+  size_t start = 0;
+  for (size_t i = 1; i <= n; i++) {
+    if (i == n || m_entries[i].address != m_entries[i - 1].address + 1) {
+      m_bar->memcopyPosted(m_entries[start].address, &values[start],
+                           (i - start) << 2);
+      start = i;
+      bursts++;
+    }
+  }
+  m_bar->flush(readback);
+  m_entries.clear();
+  return bursts;
+}
 }
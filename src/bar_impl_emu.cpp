@@ -0,0 +1,796 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+
+#include <librorc/error.hh>
+#include <librorc/registers.h>
+#include <librorc/patterngenerator.hh>
+#include <librorc/bar_impl_emu.hh>
+
+namespace LIBRARY_NAME
+{
+    /** DMA_CTRL bits, see dma_channel.cpp */
+    #define EMU_DMACTRL_ENABLE     (1<<0)
+    #define EMU_DMACTRL_FIFO_RESET (1<<1)
+    #define EMU_DMACTRL_EBDM       (1<<2)
+    #define EMU_DMACTRL_RBDM       (1<<3)
+    #define EMU_DMACTRL_FIFO_EMPTY (1<<5)
+    #define EMU_DMACTRL_BUSY       (1<<7)
+    #define EMU_DMACTRL_SUSPEND    (1<<10)
+    #define EMU_DMACTRL_STALL_SHIFT 11
+    #define EMU_DMACTRL_UNDERRUN   (1<<13)
+    #define EMU_DMACTRL_SYNC       (1u<<31)
+    #define EMU_DMACTRL_VOLATILE   (EMU_DMACTRL_SYNC | EMU_DMACTRL_FIFO_RESET | \
+                                    EMU_DMACTRL_BUSY | EMU_DMACTRL_FIFO_EMPTY | \
+                                    (3<<EMU_DMACTRL_STALL_SHIFT) | \
+                                    EMU_DMACTRL_UNDERRUN)
+
+    /** DDL_CTRL bits, see patterngenerator.cpp */
+    #define EMU_DDLCTRL_PG_ENABLE     (1<<8)
+    #define EMU_DDLCTRL_PG_EVID_RST   (1<<9)
+    #define EMU_DDLCTRL_PG_CONTINUOUS (1<<10)
+    #define EMU_DDLCTRL_PG_PRBS_SIZE  (1<<13)
+    #define EMU_DDLCTRL_PG_DONE       (1<<14)
+    #define EMU_DDLCTRL_PG_AVAIL      (1<<15)
+    #define EMU_DDLCTRL_MUX_PG        2
+
+    #define EMU_DDL_BASE (1<<RORC_REGFILE_DDL_SEL)
+    #define EMU_GTX_BASE (1<<RORC_REGFILE_GTX_SEL)
+
+    /** GTX/DDL clock domains up, link type DIU */
+    #define EMU_GTX_ASYNC_CFG ((1<<2) | (1<<4) | (1<<5) | \
+                               (RORC_CFG_LINK_TYPE_DIU<<12))
+    #define EMU_GTX_CTRL ((1<<0) | (1<<1) | (1<<5))
+
+
+    /**
+     * @brief register file and DMA engine of a single emulated link
+     **/
+    class bar_emu_channel
+    {
+        public:
+            bar_emu_channel( uint32_t *regs );
+            ~bar_emu_channel();
+
+            uint32_t read( uint32_t offset );
+            void write( uint32_t offset, uint32_t data );
+
+        protected:
+            uint32_t        *m_regs;
+            pthread_mutex_t  m_mtx;
+            pthread_cond_t   m_cond;
+            pthread_t        m_thread;
+            bool             m_stop;
+
+            std::vector<ScatterGatherEntry> m_sg[2];
+            uint32_t         m_n_sg[2];
+            uint64_t         m_buffer_size[2];
+            uint64_t         m_rdptr[2];
+            uint64_t         m_wrptr[2];
+            uint32_t         m_dma_ctrl;
+            volatile uint32_t m_busy;
+            volatile uint32_t m_stall;
+
+            uint32_t         m_ddl_ctrl;
+            uint64_t         m_event_id;
+            uint32_t         m_generated;
+            uint32_t         m_prbs;
+            uint32_t         m_pending_size;
+            std::vector<uint32_t> m_event;
+
+            static void *engineEntry( void *arg );
+            void engine();
+            bool canRun();
+            bool pgDone();
+            uint32_t nextEventSize();
+            uint64_t bufferFree( uint32_t ram );
+            void generateEvent( uint32_t size );
+            void copyToHost( uint32_t ram, uint64_t offset, const void *src,
+                             size_t num );
+            void fifoReset();
+            void updateWritePointerRegisters();
+    };
+
+
+    bar_emu_channel::bar_emu_channel( uint32_t *regs )
+    {
+        m_regs = regs;
+        m_stop = false;
+        for( int i=0; i<2; i++ )
+        {
+            m_sg[i].resize(LIBRORC_EMU_MAX_SG_ENTRIES);
+            m_n_sg[i] = 0;
+            m_buffer_size[i] = 0;
+            m_rdptr[i] = 0;
+            m_wrptr[i] = 0;
+        }
+        m_dma_ctrl  = 0;
+        m_busy      = 0;
+        m_stall     = 0;
+        m_ddl_ctrl  = 0;
+        m_event_id  = 0;
+        m_generated = 0;
+        m_prbs      = 0xffffffff;
+        m_pending_size = 0;
+
+        m_regs[RORC_REG_GTX_ASYNC_CFG] = EMU_GTX_ASYNC_CFG;
+        m_regs[RORC_REG_DMA_PKT_SIZE] = (256>>2);
+        m_regs[EMU_GTX_BASE + RORC_REG_GTX_CTRL] = EMU_GTX_CTRL;
+
+        pthread_mutex_init(&m_mtx, NULL);
+        pthread_cond_init(&m_cond, NULL);
+        if( pthread_create(&m_thread, NULL, engineEntry, this) != 0 )
+        {
+            pthread_cond_destroy(&m_cond);
+            pthread_mutex_destroy(&m_mtx);
+            throw LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED;
+        }
+    }
+
+
+    bar_emu_channel::~bar_emu_channel()
+    {
+        pthread_mutex_lock(&m_mtx);
+        m_stop = true;
+        pthread_cond_broadcast(&m_cond);
+        pthread_mutex_unlock(&m_mtx);
+        pthread_join(m_thread, NULL);
+        pthread_cond_destroy(&m_cond);
+        pthread_mutex_destroy(&m_mtx);
+    }
+
+
+    uint32_t
+    bar_emu_channel::read( uint32_t offset )
+    {
+        switch( offset )
+        {
+            case RORC_REG_DMA_CTRL:
+                return m_regs[offset] |
+                    ((m_busy) ? EMU_DMACTRL_BUSY : EMU_DMACTRL_FIFO_EMPTY) |
+                    (m_stall << EMU_DMACTRL_STALL_SHIFT);
+
+            case RORC_REG_EBDM_N_SG_CONFIG:
+            case RORC_REG_RBDM_N_SG_CONFIG:
+                return (LIBRORC_EMU_MAX_SG_ENTRIES << 16) |
+                    (m_regs[offset] & 0xffff);
+
+            case EMU_DDL_BASE + RORC_REG_DDL_CTRL:
+            {
+                pthread_mutex_lock(&m_mtx);
+                uint32_t value = m_regs[offset] | EMU_DDLCTRL_PG_AVAIL;
+                if( pgDone() )
+                { value |= EMU_DDLCTRL_PG_DONE; }
+                pthread_mutex_unlock(&m_mtx);
+                return value;
+            }
+
+            default:
+                return m_regs[offset];
+        }
+    }
+
+
+    void
+    bar_emu_channel::write
+    (
+        uint32_t offset,
+        uint32_t data
+    )
+    {
+        pthread_mutex_lock(&m_mtx);
+        switch( offset )
+        {
+            case RORC_REG_DMA_CTRL:
+            {
+                m_stall &= ~((data >> EMU_DMACTRL_STALL_SHIFT) & 3);
+                if( data & EMU_DMACTRL_FIFO_RESET )
+                { fifoReset(); }
+                if( data & EMU_DMACTRL_SYNC )
+                {
+                    m_rdptr[0] =
+                        ((uint64_t)m_regs[RORC_REG_EBDM_SW_READ_POINTER_H] << 32) |
+                        m_regs[RORC_REG_EBDM_SW_READ_POINTER_L];
+                    m_rdptr[1] =
+                        ((uint64_t)m_regs[RORC_REG_RBDM_SW_READ_POINTER_H] << 32) |
+                        m_regs[RORC_REG_RBDM_SW_READ_POINTER_L];
+                    m_buffer_size[0] =
+                        ((uint64_t)m_regs[RORC_REG_EBDM_BUFFER_SIZE_H] << 32) |
+                        m_regs[RORC_REG_EBDM_BUFFER_SIZE_L];
+                    m_buffer_size[1] =
+                        ((uint64_t)m_regs[RORC_REG_RBDM_BUFFER_SIZE_H] << 32) |
+                        m_regs[RORC_REG_RBDM_BUFFER_SIZE_L];
+                    m_n_sg[0] = m_regs[RORC_REG_EBDM_N_SG_CONFIG] & 0xffff;
+                    m_n_sg[1] = m_regs[RORC_REG_RBDM_N_SG_CONFIG] & 0xffff;
+                }
+                m_dma_ctrl = data & ~EMU_DMACTRL_VOLATILE;
+                m_regs[offset] = m_dma_ctrl;
+            }
+            break;
+
+            case RORC_REG_SGENTRY_CTRL:
+            {
+                uint32_t ram = (data >> 30) & 1;
+                uint32_t entry = (data & 0x3fffffff);
+                if( data & (1u<<31) )
+                {
+                    if( entry < LIBRORC_EMU_MAX_SG_ENTRIES )
+                    {
+                        m_sg[ram][entry].pointer =
+                            ((uint64_t)m_regs[RORC_REG_SGENTRY_ADDR_HIGH] << 32) |
+                            m_regs[RORC_REG_SGENTRY_ADDR_LOW];
+                        m_sg[ram][entry].length =
+                            m_regs[RORC_REG_SGENTRY_LEN];
+                    }
+                }
+                else if( entry < LIBRORC_EMU_MAX_SG_ENTRIES )
+                {
+                    /** readback, see dma_channel::readSgListEntry() */
+                    m_regs[RORC_REG_SGENTRY_ADDR_LOW] =
+                        (m_sg[ram][entry].pointer & 0xffffffff);
+                    m_regs[RORC_REG_SGENTRY_ADDR_HIGH] =
+                        (m_sg[ram][entry].pointer >> 32);
+                    m_regs[RORC_REG_SGENTRY_LEN] = m_sg[ram][entry].length;
+                }
+                m_regs[offset] = data;
+            }
+            break;
+
+            case EMU_DDL_BASE + RORC_REG_DDL_CTRL:
+            {
+                if( data & EMU_DDLCTRL_PG_EVID_RST )
+                { m_event_id = 0; }
+                if( (data & EMU_DDLCTRL_PG_ENABLE) &&
+                    !(m_ddl_ctrl & EMU_DDLCTRL_PG_ENABLE) )
+                { m_generated = 0; }
+                m_ddl_ctrl = data & ~(EMU_DDLCTRL_PG_DONE | EMU_DDLCTRL_PG_AVAIL);
+                m_regs[offset] = m_ddl_ctrl;
+            }
+            break;
+
+            default:
+                m_regs[offset] = data;
+            break;
+        }
+        pthread_cond_broadcast(&m_cond);
+        pthread_mutex_unlock(&m_mtx);
+    }
+
+
+    /**************************** DMA engine ******************************/
+
+    void*
+    bar_emu_channel::engineEntry( void *arg )
+    {
+        ((bar_emu_channel *)arg)->engine();
+        return NULL;
+    }
+
+
+    bool
+    bar_emu_channel::canRun()
+    {
+        uint32_t enable = EMU_DMACTRL_ENABLE | EMU_DMACTRL_EBDM |
+            EMU_DMACTRL_RBDM;
+        if( (m_dma_ctrl & enable) != enable ||
+            (m_dma_ctrl & EMU_DMACTRL_SUSPEND) )
+        { return false; }
+        if( m_buffer_size[0]==0 || m_buffer_size[1]==0 ||
+            (m_regs[RORC_REG_DMA_PKT_SIZE] & 0x3ff)==0 )
+        { return false; }
+        if( ((m_ddl_ctrl >> 16) & 3) != EMU_DDLCTRL_MUX_PG )
+        { return false; }
+        return !pgDone();
+    }
+
+
+    bool
+    bar_emu_channel::pgDone()
+    {
+        if( !(m_ddl_ctrl & EMU_DDLCTRL_PG_ENABLE) )
+        { return true; }
+        if( m_ddl_ctrl & EMU_DDLCTRL_PG_CONTINUOUS )
+        { return false; }
+        return (m_generated >= m_regs[EMU_DDL_BASE + RORC_REG_DDL_PG_NUM_EVENTS]);
+    }
+
+
+    uint32_t
+    bar_emu_channel::nextEventSize()
+    {
+        uint32_t length = m_regs[EMU_DDL_BASE + RORC_REG_DDL_PG_EVENT_LENGTH];
+        uint32_t size = length;
+        if( m_ddl_ctrl & EMU_DDLCTRL_PG_PRBS_SIZE )
+        {
+            /** 32 bit Galois LFSR, masked with [31:16] of the length reg */
+            uint32_t lsb = m_prbs & 1;
+            m_prbs >>= 1;
+            if( lsb )
+            { m_prbs ^= 0xd0000001; }
+            size = (m_prbs & length & 0xffff0000) >> 16;
+            if( size < (length & 0xffff) )
+            { size = (length & 0xffff); }
+        }
+        return (size) ? size : 1;
+    }
+
+
+    /**
+     * free bytes in front of the write pointer. The engine never writes
+     * onto the software read pointer, so wrptr==rdptr means full.
+     **/
+    uint64_t
+    bar_emu_channel::bufferFree( uint32_t ram )
+    {
+        uint64_t size = m_buffer_size[ram];
+        return (m_rdptr[ram] + size - m_wrptr[ram]) % size;
+    }
+
+
+    void
+    bar_emu_channel::generateEvent( uint32_t size )
+    {
+        m_event.resize(size);
+        uint32_t *event = &m_event[0];
+        uint32_t cdh[LIBRORC_EMU_CDH_SIZE];
+        memset(cdh, 0, sizeof(cdh));
+        cdh[0] = 0xffffffff;
+        cdh[1] = (2<<24) | (m_event_id & 0xfff);
+        cdh[2] = (m_event_id >> 12) & 0xffffff;
+        uint32_t header = (size < LIBRORC_EMU_CDH_SIZE) ?
+            size : LIBRORC_EMU_CDH_SIZE;
+        memcpy(event, cdh, header * sizeof(uint32_t));
+
+        uint32_t mode = (m_ddl_ctrl >> 11) & 3;
+        uint32_t pattern = m_regs[EMU_DDL_BASE + RORC_REG_DDL_PG_PATTERN];
+        for( uint32_t i=header; i<size; i++ )
+        {
+            event[i] = pattern;
+            switch( mode )
+            {
+                case PG_PATTERN_INC:
+                    pattern++;
+                    break;
+                case PG_PATTERN_DEC:
+                    pattern--;
+                    break;
+                case PG_PATTERN_SHIFT:
+                    pattern = (pattern << 1) | (pattern >> 31);
+                    break;
+                default:
+                    pattern = ~pattern;
+                    break;
+            }
+        }
+    }
+
+
+    /**
+     * write to a host buffer through its scatter gather list, wrapping
+     * around at the end of the buffer
+     **/
+    void
+    bar_emu_channel::copyToHost
+    (
+        uint32_t    ram,
+        uint64_t    offset,
+        const void *src,
+        size_t      num
+    )
+    {
+        const uint8_t *source = (const uint8_t *)src;
+        uint64_t size = m_buffer_size[ram];
+        while( num )
+        {
+            offset %= size;
+            uint64_t base = 0;
+            uint32_t i = 0;
+            while( i<m_n_sg[ram] && offset >= base + m_sg[ram][i].length )
+            {
+                base += m_sg[ram][i].length;
+                i++;
+            }
+            if( i==m_n_sg[ram] )
+            { return; }
+
+            uint64_t chunk = base + m_sg[ram][i].length - offset;
+            if( chunk > (size - offset) )
+            { chunk = size - offset; }
+            if( chunk > num )
+            { chunk = num; }
+            memcpy( (uint8_t *)(m_sg[ram][i].pointer + (offset - base)),
+                    source, chunk );
+            source += chunk;
+            offset += chunk;
+            num -= chunk;
+        }
+    }
+
+
+    void
+    bar_emu_channel::fifoReset()
+    {
+        /** let the engine finish the event it is currently writing */
+        while( m_busy )
+        { pthread_cond_wait(&m_cond, &m_mtx); }
+        m_wrptr[0] = 0;
+        m_wrptr[1] = 0;
+        m_stall = 0;
+        updateWritePointerRegisters();
+    }
+
+
+    void
+    bar_emu_channel::updateWritePointerRegisters()
+    {
+        m_regs[RORC_REG_EBDM_FPGA_WRITE_POINTER_L] = (m_wrptr[0] & 0xffffffff);
+        m_regs[RORC_REG_EBDM_FPGA_WRITE_POINTER_H] = (m_wrptr[0] >> 32);
+        m_regs[RORC_REG_RBDM_FPGA_WRITE_POINTER_L] = (m_wrptr[1] & 0xffffffff);
+        m_regs[RORC_REG_RBDM_FPGA_WRITE_POINTER_H] = (m_wrptr[1] >> 32);
+    }
+
+
+    void
+    bar_emu_channel::engine()
+    {
+        pthread_mutex_lock(&m_mtx);
+        while( !m_stop )
+        {
+            if( !canRun() )
+            {
+                pthread_cond_wait(&m_cond, &m_mtx);
+                continue;
+            }
+
+            /** keep the size of a stalled event for the retry */
+            if( m_pending_size==0 )
+            { m_pending_size = nextEventSize(); }
+            uint32_t size = m_pending_size;
+            uint64_t pkt_size = (m_regs[RORC_REG_DMA_PKT_SIZE] & 0x3ff) << 2;
+            uint64_t eb_bytes = (((uint64_t)size<<2) + pkt_size - 1) /
+                pkt_size * pkt_size;
+            if( bufferFree(0) < eb_bytes )
+            { m_stall |= 1; }
+            if( bufferFree(1) < sizeof(EventDescriptor) )
+            { m_stall |= 2; }
+            if( (bufferFree(0) < eb_bytes) ||
+                (bufferFree(1) < sizeof(EventDescriptor)) )
+            {
+                pthread_cond_wait(&m_cond, &m_mtx);
+                continue;
+            }
+
+            m_busy = 1;
+            m_pending_size = 0;
+            uint64_t eb_offset = m_wrptr[0];
+            uint64_t rb_offset = m_wrptr[1];
+            generateEvent(size);
+            pthread_mutex_unlock(&m_mtx);
+
+            copyToHost(0, eb_offset, &m_event[0], size * sizeof(uint32_t));
+
+            EventDescriptor report;
+            memset(&report, 0, sizeof(report));
+            report.offset = eb_offset;
+            report.calc_event_size = size;
+            copyToHost(1, rb_offset, &report, sizeof(report));
+            /** the consumer polls on reported_event_size, make it last */
+            __sync_synchronize();
+            uint32_t reported = size;
+            copyToHost(1, rb_offset + 8, &reported, sizeof(reported));
+
+            pthread_mutex_lock(&m_mtx);
+            m_wrptr[0] = (eb_offset + eb_bytes) % m_buffer_size[0];
+            m_wrptr[1] = (rb_offset + sizeof(EventDescriptor)) %
+                m_buffer_size[1];
+            updateWritePointerRegisters();
+            m_regs[RORC_REG_DMA_N_EVENTS_PROCESSED]++;
+            m_regs[EMU_DDL_BASE + RORC_REG_DDL_EC]++;
+            m_regs[EMU_DDL_BASE + RORC_REG_DDL_TOTAL_WORDS] += size;
+            m_event_id++;
+            m_generated++;
+            m_busy = 0;
+            pthread_cond_broadcast(&m_cond);
+        }
+        pthread_mutex_unlock(&m_mtx);
+    }
+
+
+    /**************************** bar_impl_emu ******************************/
+
+    bar_impl_emu::bar_impl_emu
+    (
+        uint32_t channels,
+        uint32_t fw_type
+    )
+    {
+        m_size = (size_t)(channels + 1) * RORC_CHANNEL_OFFSET * sizeof(uint32_t);
+        m_regs = new uint32_t[m_size / sizeof(uint32_t)];
+        memset(m_regs, 0, m_size);
+        m_regs[RORC_REG_TYPE_CHANNELS] = (fw_type << 16) | (channels & 0xffff);
+
+        try
+        {
+            for( uint32_t i=0; i<channels; i++ )
+            {
+                m_channels.push_back(
+                    new bar_emu_channel(m_regs + (i+1)*RORC_CHANNEL_OFFSET) );
+            }
+        }
+        catch( ... )
+        {
+            for( size_t i=0; i<m_channels.size(); i++ )
+            { delete m_channels[i]; }
+            delete[] m_regs;
+            throw;
+        }
+    }
+
+
+    bar_impl_emu::~bar_impl_emu()
+    {
+        for( size_t i=0; i<m_channels.size(); i++ )
+        { delete m_channels[i]; }
+        delete[] m_regs;
+    }
+
+
+    uint32_t
+    bar_impl_emu::readRegister( bar_address address )
+    {
+        if( address >= (m_size / sizeof(uint32_t)) )
+        { return RORC_CFG_TIMEOUT_PATTERN; }
+        uint32_t channel = address / RORC_CHANNEL_OFFSET;
+        if( channel==0 )
+        { return m_regs[address]; }
+        return m_channels[channel-1]->read(address % RORC_CHANNEL_OFFSET);
+    }
+
+
+    void
+    bar_impl_emu::writeRegister
+    (
+        bar_address address,
+        uint32_t    data
+    )
+    {
+        if( address >= (m_size / sizeof(uint32_t)) )
+        { return; }
+        uint32_t channel = address / RORC_CHANNEL_OFFSET;
+        if( channel==0 )
+        {
+            if( address != RORC_REG_TYPE_CHANNELS )
+            { m_regs[address] = data; }
+            return;
+        }
+        m_channels[channel-1]->write(address % RORC_CHANNEL_OFFSET, data);
+    }
+
+
+    void
+    bar_impl_emu::memcopy
+    (
+        bar_address  target,
+        const void  *source,
+        size_t       num
+    )
+    {
+        const uint8_t *src = (const uint8_t *)source;
+        for( size_t i=0; i<num; i+=sizeof(uint32_t) )
+        {
+            uint32_t data = 0;
+            if( (num - i) < sizeof(uint32_t) )
+            { data = readRegister(target); }
+            memcpy(&data, src + i, ((num - i) < sizeof(uint32_t)) ?
+                   (num - i) : sizeof(uint32_t));
+            writeRegister(target++, data);
+        }
+    }
+
+
+    void
+    bar_impl_emu::memcopy
+    (
+        void        *target,
+        bar_address  source,
+        size_t       num
+    )
+    {
+        uint8_t *dest = (uint8_t *)target;
+        for( size_t i=0; i<num; i+=sizeof(uint32_t) )
+        {
+            uint32_t data = readRegister(source++);
+            memcpy(dest + i, &data, ((num - i) < sizeof(uint32_t)) ?
+                   (num - i) : sizeof(uint32_t));
+        }
+    }
+
+
+    uint32_t
+    bar_impl_emu::get32( bar_address address )
+    { return readRegister(address); }
+
+
+    uint16_t
+    bar_impl_emu::get16( bar_address address )
+    {
+        uint32_t data = readRegister(address >> 1);
+        return (address & 1) ? (data >> 16) : (data & 0xffff);
+    }
+
+
+    void
+    bar_impl_emu::set32
+    (
+        bar_address address,
+        uint32_t data
+    )
+    { writeRegister(address, data); }
+
+
+    void
+    bar_impl_emu::set16
+    (
+        bar_address address,
+        uint16_t data
+    )
+    {
+        uint32_t value = readRegister(address >> 1);
+        if( address & 1 )
+        { value = (value & 0x0000ffff) | ((uint32_t)data << 16); }
+        else
+        { value = (value & 0xffff0000) | data; }
+        writeRegister((address >> 1), value);
+    }
+
+
+    int32_t
+    bar_impl_emu::gettime
+    (
+        struct timeval *tv,
+        struct timezone *tz
+    )
+    { return gettimeofday(tv, tz); }
+
+
+    size_t
+    bar_impl_emu::size()
+    { return m_size; }
+
+
+    void
+    bar_impl_emu::simSetPacketSize
+    (
+        uint32_t packet_size
+    )
+    {}
+
+
+    static int
+    hostBufferFd( bool hugepages )
+    {
+        int fd = -1;
+#ifdef SYS_memfd_create
+        fd = syscall(SYS_memfd_create, "librorc_emu",
+                     (hugepages) ? MFD_HUGETLB : 0);
+#endif
+        if( fd < 0 && !hugepages )
+        {
+            char path[] = "/dev/shm/librorc_emu_XXXXXX";
+            fd = mkstemp(path);
+            if( fd >= 0 )
+            { unlink(path); }
+        }
+        return fd;
+    }
+
+
+    static void*
+    mapHostBuffer
+    (
+        size_t size,
+        bool   hugepages
+    )
+    {
+        int fd = hostBufferFd(hugepages);
+        if( fd < 0 )
+        { return NULL; }
+        if( ftruncate(fd, size) != 0 )
+        {
+            close(fd);
+            return NULL;
+        }
+
+        /** reserve twice the size and map the buffer into both halves */
+        uint8_t *mem = (uint8_t *)mmap(NULL, 2*size, PROT_NONE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if( mem != MAP_FAILED )
+        {
+            if( mmap(mem, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+                mmap(mem + size, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED )
+            {
+                munmap(mem, 2*size);
+                mem = (uint8_t *)MAP_FAILED;
+            }
+        }
+        close(fd);
+        return (mem == MAP_FAILED) ? NULL : mem;
+    }
+
+
+    void*
+    bar_impl_emu::allocateHostBuffer
+    (
+        size_t size,
+        bool   hugepages
+    )
+    {
+        void *mem = NULL;
+        if( hugepages )
+        { mem = mapHostBuffer(size, true); }
+        if( mem == NULL )
+        { mem = mapHostBuffer(size, false); }
+        return mem;
+    }
+
+
+    void
+    bar_impl_emu::freeHostBuffer
+    (
+        void   *mem,
+        size_t  size
+    )
+    {
+        if( mem != NULL )
+        { munmap(mem, 2*size); }
+    }
+
+
+    std::vector<ScatterGatherEntry>
+    bar_impl_emu::sgList
+    (
+        void   *mem,
+        size_t  size
+    )
+    {
+        std::vector<ScatterGatherEntry> list;
+        ScatterGatherEntry entry;
+        entry.pointer = (uint64_t)(uintptr_t)mem;
+        entry.length = size;
+        list.push_back(entry);
+        return list;
+    }
+}
@@ -34,6 +34,7 @@
 
 #include <librorc/device.hh>
 #include <librorc/error.hh>
+#include <librorc/registers.h>
 #include <librorc/bar_impl_hw.hh>
 
 namespace LIBRARY_NAME
@@ -59,14 +60,46 @@ bar_impl_hw::bar_impl_hw
 //    if( PDA_SUCCESS != PciDevice_getBar(m_pda_pci_device, &m_pda_bar, m_number) )
 //    { throw LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED; }
 
-    pthread_mutex_init(&m_mtx, NULL);
+    m_posted_writes = false;
+    for(int i=0; i<LIBRORC_BAR_LOCK_STRIPES; i++)
+    { pthread_mutex_init(&m_mtx[i], NULL); }
+}
+
+
+
+bar_impl_hw::bar_impl_hw
+(
+    uint8_t *map,
+    size_t   size
+)
+{
+    m_parent_dev = NULL;
+    m_number     = 0;
+    m_bar        = map;
+
+    if(m_bar == NULL)
+    { throw LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED; }
+
+    m_size          = size;
+    m_posted_writes = false;
+    for(int i=0; i<LIBRORC_BAR_LOCK_STRIPES; i++)
+    { pthread_mutex_init(&m_mtx[i], NULL); }
 }
 
 
 
 bar_impl_hw::~bar_impl_hw()
 {
-    pthread_mutex_destroy(&m_mtx);
+    for(int i=0; i<LIBRORC_BAR_LOCK_STRIPES; i++)
+    { pthread_mutex_destroy(&m_mtx[i]); }
+}
+
+
+
+pthread_mutex_t*
+bar_impl_hw::stripeLock( bar_address address )
+{
+    return &m_mtx[(address / RORC_CHANNEL_OFFSET) % LIBRORC_BAR_LOCK_STRIPES];
 }
 
 
@@ -80,12 +113,40 @@ bar_impl_hw::memcopy
     size_t               num
 )
 {
-    pthread_mutex_lock(&m_mtx);
+    /** multi-word writes are serialized per link register file only */
+    pthread_mutex_t *mtx = stripeLock(target);
+    pthread_mutex_lock(mtx);
 //    if( PDA_SUCCESS != Bar_memcpyToBar32(m_pda_bar, (target << 2), source, num) )
 //    { cout << "bar copy failed!" << endl; }
     memcpy( (uint8_t*)m_bar + (target << 2), source, num);
-    msync( (uint8_t*)m_bar + ((target << 2) & PAGE_MASK) , PAGE_SIZE, MS_SYNC);
-    pthread_mutex_unlock(&m_mtx);
+    if( !m_posted_writes )
+    { msync( (uint8_t*)m_bar + ((target << 2) & PAGE_MASK) , PAGE_SIZE, MS_SYNC); }
+    pthread_mutex_unlock(mtx);
+}
+
+
+
+__attribute__((optimize("no-tree-vectorize")))
+__attribute__((__target__("no-sse")))
+void
+bar_impl_hw::memcopyPosted
+(
+    bar_address  target,
+    const void  *source,
+    size_t       num
+)
+{
+    /**
+     * single 32 bit stores in address order: memcpy neither guarantees
+     * the store order nor the width and may write a DW twice
+     **/
+    volatile uint32_t *bar = (volatile uint32_t *)m_bar;
+    const uint32_t *src = (const uint32_t *)source;
+    pthread_mutex_t *mtx = stripeLock(target);
+    pthread_mutex_lock(mtx);
+    for( size_t i=0; i<(num >> 2); i++ )
+    { bar[target + i] = src[i]; }
+    pthread_mutex_unlock(mtx);
 }
 
 
@@ -100,12 +161,27 @@ bar_impl_hw::memcopy
     size_t               num
 )
 {
-    assert(false);
-    pthread_mutex_lock(&m_mtx);
-//    if( PDA_SUCCESS != Bar_memcpyFromBar32(m_pda_bar, target, source, num) )
-//    { cout << "bar copy failed!" << endl; }
-    memcpy( target, (const void*)(m_bar + (source << 2)), num);
-    pthread_mutex_unlock(&m_mtx);
+    /**
+     * read with single aligned 32 bit loads, wider or unaligned reads
+     * as issued by memcpy are not supported by all register files
+     **/
+    volatile uint32_t *bar = (volatile uint32_t *)m_bar;
+    uint32_t *dest = (uint32_t *)target;
+    size_t dws = (num >> 2);
+    if( ((source << 2) + num) > m_size )
+    {
+        memset(target, 0xff, num);
+        return;
+    }
+
+    for( size_t i=0; i<dws; i++ )
+    { dest[i] = bar[source + i]; }
+
+    if( num & 3 )
+    {
+        uint32_t last = bar[source + dws];
+        memcpy( (uint8_t *)target + (dws << 2), &last, (num & 3) );
+    }
 }
 
 
@@ -115,7 +191,7 @@ __attribute__((__target__("no-sse")))
 uint32_t
 bar_impl_hw::get32(bar_address address )
 {
-    uint32_t *bar = (uint32_t *)m_bar;
+    volatile uint32_t *bar = (volatile uint32_t *)m_bar;
     uint32_t result;
     if( (address << 2) < m_size)
     {
@@ -133,8 +209,8 @@ __attribute__((__target__("no-sse")))
 uint16_t
 bar_impl_hw::get16(bar_address address )
 {
-    uint16_t *sbar;
-    sbar = (uint16_t *)m_bar;
+    volatile uint16_t *sbar;
+    sbar = (volatile uint16_t *)m_bar;
     assert( sbar != NULL );
 
     uint64_t result;
@@ -158,14 +234,14 @@ bar_impl_hw::set32
     uint32_t data
 )
 {
-    uint32_t *bar = (uint32_t *)m_bar;
+    volatile uint32_t *bar = (volatile uint32_t *)m_bar;
     assert( m_bar != NULL );
     if( (address << 2) < m_size)
     {
-        pthread_mutex_lock(&m_mtx);
+        /** aligned 32 bit stores are atomic, no locking required */
         bar[address] = data;
-        msync( (bar + ( (address << 2) & PAGE_MASK) ), PAGE_SIZE, MS_SYNC);
-        pthread_mutex_unlock(&m_mtx);
+        if( !m_posted_writes )
+        { msync( (m_bar + ( (address << 2) & PAGE_MASK) ), PAGE_SIZE, MS_SYNC); }
     }
 
 }
@@ -181,17 +257,18 @@ bar_impl_hw::set16
     uint16_t data
 )
 {
-    uint16_t *sbar;
-    sbar = (uint16_t *)m_bar;
+    volatile uint16_t *sbar;
+    sbar = (volatile uint16_t *)m_bar;
 
     assert( sbar != NULL );
     if( (address << 1) < m_size)
     {
-        pthread_mutex_lock(&m_mtx);
         sbar[address] = data;
-        msync( (sbar + ( (address << 1) & PAGE_MASK) ),
-               PAGE_SIZE, MS_SYNC);
-        pthread_mutex_unlock(&m_mtx);
+        if( !m_posted_writes )
+        {
+            msync( (m_bar + ( (address << 1) & PAGE_MASK) ),
+                   PAGE_SIZE, MS_SYNC);
+        }
     }
 }
 
@@ -219,4 +296,31 @@ bar_impl_hw::size()
     return m_size;
 }
 
+
+
+void
+bar_impl_hw::setPostedWrites( bool enable )
+{
+    m_posted_writes = enable;
+}
+
+
+
+bool
+bar_impl_hw::postedWrites()
+{
+    return m_posted_writes;
+}
+
+
+
+void
+bar_impl_hw::flush( bar_address readback )
+{
+    /** order all previous stores, then complete them with a non-posted
+     *  read: PCIe does not allow a read to pass posted writes */
+    __sync_synchronize();
+    get32(readback);
+}
+
 }
@@ -31,7 +31,11 @@
 
 #include <pthread.h>
 #include <netdb.h>
+#include <poll.h>
+#include <netinet/tcp.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <cstring> //memcpy
 #include <cstdlib> //abort
 #include <cstdio> //perror
@@ -45,11 +49,6 @@
     #define MODELSIM_SERVER "localhost"
 #endif
 
-/**
- * usleep time for FLI read polling
- * */
-#define USLEEP_TIME 50
-
 namespace LIBRARY_NAME
 {
 
@@ -66,41 +65,117 @@ bar_impl_sim::bar_impl_sim
     m_pda_pci_device = dev->getPdaPciDevice();
 #endif
 
+    const char *path = getenv(SIM_SOCKET_ENV);
+    if( path != NULL )
+    {
+        /** local simulator via Unix domain socket */
+        struct sockaddr_un serv_addr;
+        if( strlen(path) >= sizeof(serv_addr.sun_path) )
+        {
+            std::cout << "ERROR: socket path too long" << std::endl;
+            throw LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED;
+        }
+        m_sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if( m_sockfd < 0 )
+        {
+            std::cout << "ERROR: failed to open socket" << std::endl;
+            throw LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED;
+        }
+        memset(&serv_addr, 0, sizeof(serv_addr));
+        serv_addr.sun_family = AF_UNIX;
+        strcpy(serv_addr.sun_path, path);
+        if( 0 > connect(m_sockfd,(struct sockaddr *) &serv_addr, sizeof(serv_addr)) )
+        {
+            std::cout << "ERROR connecting" << std::endl;
+            close(m_sockfd);
+            throw LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED;
+        }
+    }
+    else
+    {
+        m_sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        if( m_sockfd < 0 )
+        {
+            std::cout << "ERROR: failed to open socket" << std::endl;
+            throw LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED;
+        }
+
+        struct hostent *server = gethostbyname(MODELSIM_SERVER);
+        if( server == NULL )
+        {
+            std::cout << "ERROR: no such host" << std::endl;
+            throw LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED;
+        }
+
+        struct sockaddr_in serv_addr;
+        bzero((char *) &serv_addr, sizeof(serv_addr));
+        serv_addr.sin_family = AF_INET;
+        bcopy( (char *)server->h_addr,
+               (char *)&serv_addr.sin_addr.s_addr,
+               server->h_length
+             );
+        serv_addr.sin_port = htons(2000);
+        if( 0 > connect(m_sockfd,(struct sockaddr *) &serv_addr, sizeof(serv_addr)) )
+        {
+            std::cout << "ERROR connecting" << std::endl;
+            throw LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED;
+        }
+
+        /** small messages must not wait for Nagle */
+        int flag = 1;
+        setsockopt(m_sockfd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    }
+
+    init();
+}
+
+
+
+bar_impl_sim::bar_impl_sim
+(
+    int      sockfd,
+    int32_t  n,
+    size_t   size
+)
+{
+    m_parent_dev = NULL;
+    m_number     = n;
+    m_size       = size;
+    m_sockfd     = sockfd;
+#ifdef PDA
+    m_pda_pci_device = NULL;
+#endif
+    init();
+}
+
+
+
+void
+bar_impl_sim::init()
+{
     /** initialize mutex */
     pthread_mutex_init(&m_mtx, NULL);
+    pthread_mutex_init(&m_ack_mtx, NULL);
+    pthread_cond_init(&m_ack_cond, NULL);
+    pthread_mutex_init(&m_map_mtx, NULL);
+    pthread_mutex_init(&m_sock_mtx, NULL);
+    m_dma_map_valid = false;
+    m_cmpl_sent     = 0;
+    m_cmpl_acked    = 0;
+    m_max_outstanding_cmpl = SIM_MAX_OUTSTANDING_CMPL;
 
     m_read_from_dev_done = 0;
     m_read_time_done = 0;
-    m_write_to_dev_done  = 0;
     m_max_packet_size = DEFAULT_PACKET_SIZE;
 
-    m_sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if( m_sockfd < 0 )
-    {
-        std::cout << "ERROR: failed to open socket" << std::endl;
-        throw LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED;
-    }
-
-    struct hostent *server = gethostbyname(MODELSIM_SERVER);
-    if( server == NULL )
-    {
-        std::cout << "ERROR: no such host" << std::endl;
-        throw LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED;
-    }
-
-    struct sockaddr_in serv_addr;
-    bzero((char *) &serv_addr, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    bcopy( (char *)server->h_addr,
-           (char *)&serv_addr.sin_addr.s_addr,
-           server->h_length
-         );
-    serv_addr.sin_port = htons(2000);
-    if( 0 > connect(m_sockfd,(struct sockaddr *) &serv_addr, sizeof(serv_addr)) )
-    {
-        std::cout << "ERROR connecting" << std::endl;
-        throw LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED;
-    }
+    m_last_write    = (size_t)-1;
+    m_posted_writes = false;
+    m_writes_queued = 0;
+    m_writes_sent   = 0;
+    m_writes_acked  = 0;
+    m_connected     = true;
+    m_rx_pos        = 0;
+    m_rx_len        = 0;
 
     /** create pipe for redirecting read requests to completion handler
      *  pipefd[0]: read end
@@ -112,81 +187,279 @@ bar_impl_sim::bar_impl_sim
         throw LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED;
     }
 
+    m_msgid = 0;
+
     /** completion handler */
     pthread_create(&cmpl_handler_p, NULL, cmpl_handler_helper, this);
 
     /** watch incoming packets */
     pthread_create(&sock_mon_p, NULL, sock_monitor_helper, this);
-    m_msgid = 0;
 }
 
 
 
 bar_impl_sim::~bar_impl_sim()
 {
-    close(m_pipefd[0]);
     close(m_pipefd[1]);
     pthread_cancel(sock_mon_p);
     pthread_cancel(cmpl_handler_p);
+    pthread_join(sock_mon_p, NULL);
+    pthread_join(cmpl_handler_p, NULL);
+    close(m_pipefd[0]);
     close(m_sockfd);
 
+    clearAddressMap();
+    pthread_mutex_destroy(&m_map_mtx);
+    pthread_mutex_destroy(&m_sock_mtx);
+    pthread_cond_destroy(&m_ack_cond);
+    pthread_mutex_destroy(&m_ack_mtx);
     pthread_mutex_destroy(&m_mtx);
     /** Further stuff here **/
 }
 
 
 
+/**
+ * wait until the socket monitor has set flag, then clear it again
+ * @return 0 on success, -1 if the connection to the simulator is lost
+ **/
+int
+bar_impl_sim::waitForFlag
+(
+    volatile uint32_t *flag
+)
+{
+    int result = 0;
+    pthread_mutex_lock(&m_ack_mtx);
+    while( !(*flag) && m_connected )
+    { pthread_cond_wait(&m_ack_cond, &m_ack_mtx); }
+    if( *flag )
+    { *flag = 0; }
+    else
+    { result = -1; }
+    pthread_mutex_unlock(&m_ack_mtx);
+    return result;
+}
+
+
+
 void
-bar_impl_sim::memcopy
+bar_impl_sim::setFlag
 (
-    bar_address  target,
-    const void          *source,
-    size_t               num
+    volatile uint32_t *flag
+)
+{
+    pthread_mutex_lock(&m_ack_mtx);
+    *flag = 1;
+    pthread_cond_broadcast(&m_ack_cond);
+    pthread_mutex_unlock(&m_ack_mtx);
+}
+
+
+
+/**
+ * @return 0 on success, -1 if the connection to the simulator is lost
+ **/
+int
+bar_impl_sim::waitForWriteAcks
+(
+    uint64_t count
+)
+{
+    pthread_mutex_lock(&m_ack_mtx);
+    while( m_writes_acked < count && m_connected )
+    { pthread_cond_wait(&m_ack_cond, &m_ack_mtx); }
+    int result = (m_writes_acked < count) ? -1 : 0;
+    pthread_mutex_unlock(&m_ack_mtx);
+    return result;
+}
+
+
+
+/**
+ * mark the connection to the simulator as lost and wake up all waiters,
+ * no acknowledgements or completions will arrive anymore
+ **/
+void
+bar_impl_sim::disconnect()
+{
+    pthread_mutex_lock(&m_ack_mtx);
+    m_connected = false;
+    pthread_cond_broadcast(&m_ack_cond);
+    pthread_mutex_unlock(&m_ack_mtx);
+}
+
+
+
+/** append a message to the transmit queue, call with m_mtx held */
+void
+bar_impl_sim::queueMessage
+(
+    uint32_t *msg,
+    size_t    ndw
+)
+{
+    m_tx_headers.push_back(m_tx.size());
+    m_tx.insert(m_tx.end(), msg, msg+ndw);
+    m_last_write = (size_t)-1;
+}
+
+
+
+/**
+ * send the transmit queue with a single write, call with m_mtx held.
+ * Writes only count as sent if the queue went out completely.
+ * @return 0 on success, -1 on socket error
+ **/
+int
+bar_impl_sim::sendQueue()
+{
+    int result = sendMessages(m_tx, m_tx_headers);
+    if( result == 0 )
+    { m_writes_sent += m_writes_queued; }
+    m_writes_queued = 0;
+    m_last_write = (size_t)-1;
+    return result;
+}
+
+
+
+/**
+ * write a batch of messages to the socket. Message IDs are assigned
+ * here, so they are in socket order for all senders.
+ * @return 0 on success, -1 if the socket failed. The connection is
+ *         marked as lost then.
+ **/
+int
+bar_impl_sim::sendMessages
+(
+    std::vector<uint32_t> &msgs,
+    std::vector<size_t>   &headers
 )
 {
-    int      result;
-    size_t   ndw = num>>2;
-    int32_t  buffersize = 4 + ndw;
-    uint32_t buffer[buffersize];
-    buffer[0] = ((ndw+4)<<16) + CMD_WRITE_TO_DEVICE;
-    buffer[2] = target<<2;
-    if( ndw > 1 )
+    pthread_mutex_lock(&m_sock_mtx);
+    for( size_t i=0; i<headers.size(); i++ )
     {
-        /** BAR, BE, length */
-        buffer[3] = (m_number<<24) + (0xff<<16) + ndw;
+        msgs[headers[i]+1] = m_msgid;
+        m_msgid++;
     }
-    else
+    size_t bytes = msgs.size() * sizeof(uint32_t);
+    const uint8_t *data = (const uint8_t *)&msgs[0];
+    int status = 0;
+    while( bytes )
     {
-        /** BAR, BE, length */
-        buffer[3] = (m_number<<24) + (0x0f<<16) + ndw;
+        ssize_t result = write(m_sockfd, data, bytes);
+        if( result <= 0 )
+        {
+            std::cout << "ERROR writing to socket" << std::endl;
+            status = -1;
+            break;
+        }
+        data  += result;
+        bytes -= result;
     }
-    memcpy(&(buffer[4]), source, num);
+    pthread_mutex_unlock(&m_sock_mtx);
+    msgs.clear();
+    headers.clear();
 
-    pthread_mutex_lock(&m_mtx);
-    {
-        buffer[1] = m_msgid;
-        result = write( m_sockfd, buffer, buffersize*sizeof(uint32_t) );
-        m_msgid++;
-    }
-    pthread_mutex_unlock(&m_mtx);
+    if( status < 0 )
+    { disconnect(); }
+    return status;
+}
 
 
-    if( result != (ssize_t)(buffersize*sizeof(uint32_t)) )
-    {
-        std::cout << "ERROR writing to socket" << std::endl;
-    }
-    else
+
+void
+bar_impl_sim::writeToDevice
+(
+    uint32_t        address,
+    uint8_t         byte_enable,
+    const uint32_t *data,
+    size_t          ndw,
+    bool            posted
+)
+{
+    bool full = (byte_enable == ((ndw > 1) ? 0xff : 0x0f));
+    bool sent = true;
+    uint64_t count;
+
+    pthread_mutex_lock(&m_mtx);
     {
-        /** wait for FLI acknowledgement */
-        while( !m_write_to_dev_done )
+        /**
+         * merge with the previous write if both cover full DWs and this
+         * one continues where the previous one ended
+         **/
+        size_t last = m_last_write;
+        if( posted && full && last != (size_t)-1 )
         {
-            usleep(USLEEP_TIME);
+            uint32_t last_ndw = m_tx[last+3] & 0xffff;
+            if( (m_tx[last+2] + (last_ndw<<2)) == address &&
+                (last_ndw + ndw) <= SIM_MAX_WRITE_DW )
+            {
+                m_tx.insert(m_tx.end(), data, data+ndw);
+                last_ndw += ndw;
+                m_tx[last]   = ((last_ndw+4)<<16) + CMD_WRITE_TO_DEVICE;
+                m_tx[last+3] = (m_number<<24) + (0xff<<16) + last_ndw;
+                ndw = 0;
+            }
+        }
+
+        if( ndw )
+        {
+            uint32_t header[4];
+            header[0] = ((ndw+4)<<16) + CMD_WRITE_TO_DEVICE;
+            header[2] = address;
+            /** BAR, BE, length */
+            header[3] = (m_number<<24) + (byte_enable<<16) + ndw;
+            queueMessage(header, 4);
+            m_tx.insert(m_tx.end(), data, data+ndw);
+            m_writes_queued++;
+            if( full )
+            { m_last_write = m_tx.size() - ndw - 4; }
         }
-        m_write_to_dev_done=0;
 
-        //DEBUG_PRINTF(PDADEBUG_EXTERNAL, "%d: memcpy %ld DWs to %lx\n",
-        //        buffer[1], ndw, target);
+        if( !posted || m_tx.size() >= SIM_TX_COALESCE_DW )
+        { sent = (sendQueue() == 0); }
+        count = m_writes_sent;
     }
+    pthread_mutex_unlock(&m_mtx);
+
+    /** wait for FLI acknowledgement */
+    if( !posted && sent )
+    { waitForWriteAcks(count); }
+}
+
+
+
+void
+bar_impl_sim::memcopy
+(
+    bar_address  target,
+    const void          *source,
+    size_t               num
+)
+{
+    size_t ndw = num>>2;
+    std::vector<uint32_t> data(ndw+1);
+    memcpy(&data[0], source, ndw<<2);
+    writeToDevice(target<<2, (ndw > 1) ? 0xff : 0x0f, &data[0], ndw,
+                  m_posted_writes);
+}
+
+
+
+void
+bar_impl_sim::memcopyPosted
+(
+    bar_address  target,
+    const void  *source,
+    size_t       num
+)
+{
+    size_t ndw = num>>2;
+    std::vector<uint32_t> data(ndw+1);
+    memcpy(&data[0], source, ndw<<2);
+    writeToDevice(target<<2, (ndw > 1) ? 0xff : 0x0f, &data[0], ndw, true);
 }
 
 
@@ -199,62 +472,45 @@ bar_impl_sim::memcopy
     size_t               num
 )
 {
-    pthread_mutex_lock(&m_mtx);
-    //TODO : needs to be implemented!
-    pthread_mutex_unlock(&m_mtx);
+    /** one read request per DW */
+    uint8_t *dest = (uint8_t *)target;
+    for( size_t i=0; i<num; i+=4 )
+    {
+        uint32_t data = get32(source + (i >> 2));
+        memcpy(dest + i, &data, (num - i < 4) ? (num - i) : 4);
+    }
 }
 
 
 
 uint32_t bar_impl_sim::get32(bar_address address )
 {
-    int      result;
-    uint32_t data = 0;
-    uint32_t buffersize = 4;
-    uint32_t buffer[buffersize];
+    uint32_t buffer[4];
     buffer[0] = (4<<16) + CMD_READ_FROM_DEVICE;
     buffer[2] = address<<2;
     /** BAR, BE, length */
     buffer[3] = (m_number<<24) + (0x0f<<16) + 1;
 
+    /** queued posted writes go out in front of the read */
+    int result;
     pthread_mutex_lock(&m_mtx);
     {
-        buffer[1] = m_msgid;
-        result = write( m_sockfd, buffer, sizeof(uint32_t)*buffersize );
-        m_msgid++;
+        queueMessage(buffer, 4);
+        result = sendQueue();
     }
     pthread_mutex_unlock(&m_mtx);
 
-    if( result != (ssize_t)(sizeof(uint32_t)*buffersize) )
-    {
-        std::cout << "ERROR writing to socket" << std::endl;
-    }
-    else
-    {
-        /** wait for completion */
-        while( !m_read_from_dev_done )
-        {
-            usleep(USLEEP_TIME);
-        }
-
-        data = m_read_from_dev_data;
-        m_read_from_dev_done = 0;
-
-        //DEBUG_PRINTF(PDADEBUG_EXTERNAL, "%d: get32(0x%lx)=%08x\n",
-        //        buffer[1], address, data);
-
-    }
-    return data;
+    /** wait for completion */
+    if( result < 0 || waitForFlag(&m_read_from_dev_done) < 0 )
+    { return 0; }
+    return m_read_from_dev_data;
 }
 
 
 
 uint16_t bar_impl_sim::get16(bar_address address )
 {
-    int      result;
-    uint16_t data = 0;
-    int32_t  buffersize = 4;
-    uint32_t buffer[buffersize];
+    uint32_t buffer[4];
     buffer[0] = (4<<16) + CMD_READ_FROM_DEVICE;
     buffer[2] = (address<<1) & ~(0x03);
     if( address & 0x01 )
@@ -268,32 +524,18 @@ uint16_t bar_impl_sim::get16(bar_address address )
         buffer[3] = (m_number<<24) + (0x03<<16) + 1;
     }
 
+    int result;
     pthread_mutex_lock(&m_mtx);
     {
-        buffer[1] = m_msgid;
-        result = write(m_sockfd, buffer, buffersize*sizeof(uint32_t));
-        m_msgid++;
-    }
-
-    if( result != (ssize_t)(buffersize*sizeof(uint32_t)) )
-    {
-        std::cout << "ERROR writing to socket" << std::endl;
-    }
-    else
-    {
-        /** wait for FLI completion */
-        while( !m_read_from_dev_done )
-        {
-            usleep(USLEEP_TIME);
-        }
-        data = m_read_from_dev_data & 0xffff;
-        m_read_from_dev_done = 0;
-
-        //DEBUG_PRINTF(PDADEBUG_EXTERNAL, "%d: get16(0x%lx)=%04x\n",
-        //        buffer[1], address, data);
+        queueMessage(buffer, 4);
+        result = sendQueue();
     }
+    pthread_mutex_unlock(&m_mtx);
 
-    return data;
+    /** wait for FLI completion */
+    if( result < 0 || waitForFlag(&m_read_from_dev_done) < 0 )
+    { return 0; }
+    return m_read_from_dev_data & 0xffff;
 }
 
 
@@ -306,38 +548,7 @@ bar_impl_sim::set32
 )
 {
     /** send write command to Modelsim FLI server */
-    int      result;
-    int32_t  buffersize = 5;
-    uint32_t buffer[buffersize];
-    buffer[0] = (5<<16) + CMD_WRITE_TO_DEVICE;
-    buffer[2] = address<<2;
-    buffer[3] = (m_number<<24) + (0x0f<<16) + 1; //BAR, BE, length
-    buffer[4] = data;
-
-    pthread_mutex_lock(&m_mtx);
-    {
-        buffer[1] = m_msgid;
-        result = write( m_sockfd, buffer, buffersize*sizeof(uint32_t) );
-        m_msgid++;
-    }
-    pthread_mutex_unlock(&m_mtx);
-
-    if( result != (ssize_t)(buffersize*sizeof(uint32_t)) )
-    {
-        std::cout << "ERROR writing to socket" << std::endl;
-    }
-    else
-    {
-        /** wait for FLI acknowledgement */
-        while( !m_write_to_dev_done )
-        {
-            usleep(USLEEP_TIME);
-        }
-        m_write_to_dev_done=0;
-
-        //DEBUG_PRINTF(PDADEBUG_EXTERNAL, "%d: set32(0x%lx, %08x)\n",
-        //        buffer[1], address, data);
-    }
+    writeToDevice(address<<2, 0x0f, &data, 1, m_posted_writes);
 }
 
 
@@ -350,47 +561,49 @@ bar_impl_sim::set16
 )
 {
     /** send write command to Modelsim FLI server */
-    int      result;
-    uint32_t buffersize = 5;
-    uint32_t buffer[buffersize];
-    buffer[0] = (5<<16) + CMD_WRITE_TO_DEVICE;
-    buffer[2] = (address<<1) & ~(0x03);
-    if ( address & 0x01 )
-    {
-        /** BAR, BE, length */
-        buffer[3] = (m_number<<24) + (0x0c<<16) + 1;
-    }
-    else
-    {
-        /** BAR, BE, length */
-        buffer[3] = (m_number<<24) + (0x03<<16) + 1;
-    }
-    buffer[4] = (data<<16) + data;
+    uint32_t dw = (data<<16) + data;
+    writeToDevice( (address<<1) & ~(0x03), (address & 0x01) ? 0x0c : 0x03,
+                   &dw, 1, m_posted_writes );
+}
+
+
 
+void
+bar_impl_sim::setPostedWrites
+(
+    bool enable
+)
+{
+    if( !enable )
+    { flush(0); }
+    m_posted_writes = enable;
+}
+
+
+
+bool
+bar_impl_sim::postedWrites()
+{ return m_posted_writes; }
+
+
+
+void
+bar_impl_sim::flush
+(
+    bar_address readback
+)
+{
+    uint64_t count;
+    int result = 0;
     pthread_mutex_lock(&m_mtx);
     {
-        buffer[1] = m_msgid;
-        result = write(m_sockfd, buffer, buffersize*sizeof(uint32_t));
-        m_msgid++;
+        if( !m_tx.empty() )
+        { result = sendQueue(); }
+        count = m_writes_sent;
     }
     pthread_mutex_unlock(&m_mtx);
-
-    if ( result != (ssize_t)(buffersize*sizeof(uint32_t)) )
-    {
-        std::cout << "ERROR writing to socket" << std::endl;
-    }
-    else
-    {
-        /** wait for FLI acknowledgement */
-        while( !m_write_to_dev_done )
-        {
-            usleep(USLEEP_TIME);
-        }
-        m_write_to_dev_done=0;
-
-        //DEBUG_PRINTF(PDADEBUG_EXTERNAL, "%d: set32(0x%lx, %04x)\n",
-        //        buffer[1], address, data);
-    }
+    if( result == 0 )
+    { waitForWriteAcks(count); }
 }
 
 
@@ -402,32 +615,22 @@ bar_impl_sim::gettime
     struct timezone *tz
 )
 {
-    int      result;
-    int32_t  buffersize = 2;
-    uint32_t buffer[buffersize];
+    uint32_t buffer[2];
     buffer[0] = (2<<16) + CMD_GET_TIME;
 
+    int result;
     pthread_mutex_lock(&m_mtx);
     {
-        buffer[1] = m_msgid;
-        result = write(m_sockfd, buffer, buffersize*sizeof(uint32_t));
-        m_msgid++;
+        queueMessage(buffer, 2);
+        result = sendQueue();
     }
     pthread_mutex_unlock(&m_mtx);
 
-    if( result != (ssize_t)(buffersize*sizeof(uint32_t)) )
-    {
-        std::cout << "ERROR writing to socket" << std::endl;
-    }
-
     /** wait for FLI completion */
-    while( !m_read_time_done )
-    {
-        usleep(USLEEP_TIME);
-    }
+    if( result < 0 || waitForFlag(&m_read_time_done) < 0 )
+    { return -1; }
 
     uint64_t data = m_read_time_data;
-    m_read_time_done = 0;
 
     /** mti_Now is in [ns] */
     tv->tv_sec  = (data/1000/1000/1000);
@@ -477,6 +680,8 @@ bar_impl_sim::sockMonitor()
         }
     }
 
+    /** the simulator closed the connection */
+    disconnect();
     return NULL;
 }
 
@@ -487,19 +692,33 @@ bar_impl_sim::sockMonitor()
         int sock
     )
     {
-        uint32_t buffer;
-
-        int result = read(sock, &buffer, sizeof(uint32_t)); /** read 1 DW */
-        if (result == 0)
+        uint32_t buffer = 0;
+        size_t have = 0;
+        while( have < sizeof(uint32_t) )
         {
-            /** terminate if 0 characters received */
-            //DEBUG_PRINTF(PDADEBUG_EXTERNAL, "readDWfromSock: closing socket\n");
-            close(sock);
-        }
-        else if (result!=sizeof(uint32_t))
-        {
-            std::cout << "ERROR: librorc::bar_impl_sim::readDWfromSock returned "
-                 << result << " bytes" << std::endl;
+            if( m_rx_pos == m_rx_len )
+            {
+                /** refill, one read usually returns several messages */
+                ssize_t result = read(sock, m_rx, sizeof(m_rx));
+                if( result <= 0 )
+                {
+                    /** terminate if 0 characters received */
+                    if( result < 0 )
+                    {
+                        std::cout << "ERROR: librorc::bar_impl_sim::readDWfromSock returned "
+                             << result << std::endl;
+                    }
+                    return 0;
+                }
+                m_rx_pos = 0;
+                m_rx_len = result;
+            }
+            size_t chunk = sizeof(uint32_t) - have;
+            if( chunk > (m_rx_len - m_rx_pos) )
+            { chunk = m_rx_len - m_rx_pos; }
+            memcpy( ((uint8_t *)&buffer) + have, m_rx + m_rx_pos, chunk );
+            m_rx_pos += chunk;
+            have += chunk;
         }
 
         return buffer;
@@ -520,7 +739,7 @@ bar_impl_sim::sockMonitor()
 
         readDWfromSock(m_sockfd);
         m_read_from_dev_data = readDWfromSock(m_sockfd);
-        m_read_from_dev_done = 1;
+        setFlag(&m_read_from_dev_done);
     }
 
 
@@ -552,28 +771,15 @@ bar_impl_sim::sockMonitor()
                  << std::hex << addr << std::dec << std::endl;
             abort();
         }
-        else
+        else if( dmaCopy(buffer_id, offset, msg_buffer,
+                         msgsize*sizeof(uint32_t), true) )
         {
-            buffer *buf;
-
-            try
-            {
-                buf = new buffer(m_parent_dev, buffer_id, 0);
-            }
-            catch(...)
-            {
-                perror("failed to connect to buffer");
-                abort();
-            }
-
-            uint32_t *mem = buf->getMem();
-            memcpy(mem+(offset>>2), msg_buffer, msgsize*sizeof(uint32_t));
-
-            //DEBUG_PRINTF(PDADEBUG_EXTERNAL, "CMD_WRITE_TO_HOST: %d DWs to buf %ld offset 0x%lx\n",
-            //        msgsize, buffer_id, offset);
-
-            delete buf;
+            perror("failed to connect to buffer");
+            abort();
         }
+
+        //DEBUG_PRINTF(PDADEBUG_EXTERNAL, "CMD_WRITE_TO_HOST: %d DWs to buf %ld offset 0x%lx\n",
+        //        msgsize, buffer_id, offset);
     }
 
 
@@ -605,7 +811,9 @@ bar_impl_sim::sockMonitor()
         //DEBUG_PRINTF(PDADEBUG_EXTERNAL, "CMD_READ_FROM_HOST: %d bytes from 0x%lx, tag=%d\n",
         //        rdreq.length, addr, rdreq.tag);
 
-        if( getOffset(addr, &(rdreq.buffer_id), &(rdreq.offset)) )
+        uint64_t buffer_id;
+        uint64_t offset;
+        if( getOffset(addr, &buffer_id, &offset) )
         {
             std::cout << "ERROR: Could not find physical address 0x"
                   << std::hex << addr << std::dec << std::endl;
@@ -613,6 +821,8 @@ bar_impl_sim::sockMonitor()
         }
         else
         {
+            rdreq.buffer_id = buffer_id;
+            rdreq.offset    = offset;
             /** push request into pipe */
             if
             (
@@ -637,7 +847,10 @@ bar_impl_sim::sockMonitor()
             std::cout << "ERROR: Invalid message size for CMD_ACK_CMPL: "
                  << msgsize << std::endl;
         }
-        m_cmpl_to_dev_done = 1;
+        pthread_mutex_lock(&m_ack_mtx);
+        m_cmpl_acked++;
+        pthread_cond_broadcast(&m_ack_cond);
+        pthread_mutex_unlock(&m_ack_mtx);
     }
 
 
@@ -652,7 +865,10 @@ bar_impl_sim::sockMonitor()
             std::cout << "ERROR: Invalid message size for CMD_ACK_WRITE: "
                  << msgsize << std::endl;
         }
-        m_write_to_dev_done = 1;
+        pthread_mutex_lock(&m_ack_mtx);
+        m_writes_acked++;
+        pthread_cond_broadcast(&m_ack_cond);
+        pthread_mutex_unlock(&m_ack_mtx);
     }
 
 
@@ -669,134 +885,159 @@ bar_impl_sim::sockMonitor()
         }
         m_read_time_data = ((uint64_t)readDWfromSock(m_sockfd)<<32);
         m_read_time_data += readDWfromSock(m_sockfd);
-        m_read_time_done = 1;
+        setFlag(&m_read_time_done);
     }
 
 
-    int
-    bar_impl_sim::getOffset
+    void
+    sim_dma_map::clear()
+    { m_ranges.clear(); }
+
+
+    void
+    sim_dma_map::add
+    (
+        uint64_t                               buffer_id,
+        const std::vector<ScatterGatherEntry> &sglist
+    )
+    {
+        uint64_t offset = 0;
+        for( size_t i=0; i<sglist.size(); i++ )
+        {
+            range r;
+            r.end       = sglist[i].pointer + sglist[i].length;
+            r.buffer_id = buffer_id;
+            r.offset    = offset;
+            m_ranges[sglist[i].pointer] = r;
+            offset += sglist[i].length;
+        }
+    }
+
+
+    bool
+    sim_dma_map::lookup
     (
         uint64_t  phys_addr,
         uint64_t *buffer_id,
         uint64_t *offset
     )
     {
-#ifdef PDA
+        /** last segment starting at or below phys_addr */
+        std::map<uint64_t, range>::iterator iter =
+            m_ranges.upper_bound(phys_addr);
+        if( iter == m_ranges.begin() )
+        { return false; }
+        --iter;
+        if( phys_addr >= iter->second.end )
+        { return false; }
+        *buffer_id = iter->second.buffer_id;
+        *offset    = iter->second.offset + (phys_addr - iter->first);
+        return true;
+    }
 
-        uint64_t *listOfBuffers = NULL;
-        uint64_t numOfBuffers = PciDevice_getListOfBuffers(m_pda_pci_device, &listOfBuffers);
-
-        for( uint64_t idx=0; idx < numOfBuffers; idx++ ) {
-            *buffer_id = listOfBuffers[idx];
-            *offset = 0;
-            DMABuffer *buffer;
-            if (PDA_SUCCESS != PciDevice_getDMABuffer(m_pda_pci_device, listOfBuffers[idx], &buffer)) {
-                return 1;
-            }
 
-            DMABuffer_SGNode *sglist;
-            if( DMABuffer_getSGList(buffer, &sglist ) != PDA_SUCCESS ) {
-                return 1;
-            }
+    /** call with m_map_mtx held */
+    void
+    bar_impl_sim::clearAddressMap()
+    {
+        std::map<uint64_t, buffer *>::iterator iter;
+        for( iter=m_dma_buffers.begin(); iter!=m_dma_buffers.end(); ++iter )
+        { delete iter->second; }
+        m_dma_buffers.clear();
+        m_dma_map.clear();
+        m_dma_map_valid = false;
+    }
 
-            /** Iterate sglist entries of the current buffer */
-            for (DMABuffer_SGNode *node = sglist; node != NULL; node = node->next ) {
-                if(   ( (uint64_t)(node->d_pointer) <= phys_addr)
-                   && (((uint64_t)(node->d_pointer) + node->length) > phys_addr) )
-                {
-                    *offset += ( phys_addr - (uint64_t)(node->d_pointer) );
-                    return 0;
-                }
-                else
-                {
-                    *offset += (node->length)/sizeof(uint64_t);
-                }
-            }
-        }
-        return 1;
 
-#if 0
-        DMABuffer *first_buffer;
+    /** call with m_map_mtx held */
+    void
+    bar_impl_sim::rebuildAddressMap()
+    {
+        clearAddressMap();
+        m_dma_map_valid = true;
+        if( m_parent_dev == NULL )
+        { return; }
 
-        if
-        (
-            PDA_SUCCESS !=
-                PciDevice_getDMABuffer(m_pda_pci_device, 0, &first_buffer)
-        )
-        {
-            return 1;
-        }
+        std::vector<uint64_t> bufferlist;
+#ifdef PDA
+        uint64_t *listOfBuffers = NULL;
+        uint64_t numOfBuffers =
+            PciDevice_getListOfBuffers(m_pda_pci_device, &listOfBuffers);
+        bufferlist.assign(listOfBuffers, listOfBuffers + numOfBuffers);
+#else
+        bufferlist = m_parent_dev->getHandler()->list_all_buffers();
+#endif
 
-        /** Iterate buffers */
-        PdaDebugReturnCode ret = PDA_SUCCESS;
-        for
-        (
-            DMABuffer *buffer = first_buffer;
-            buffer != NULL;
-            ret = DMABuffer_getNext(buffer, &buffer)
-        )
+        for( size_t i=0; i<bufferlist.size(); i++ )
         {
-            *offset = 0;
-            if(ret != PDA_SUCCESS)
-            {
-                return 1;
-            }
-            DMABuffer_SGNode *sglist;
+            buffer *buf;
+            try
+            { buf = new buffer(m_parent_dev, bufferlist[i], 1); }
+            catch(...)
+            { continue; }
+            m_dma_buffers[bufferlist[i]] = buf;
+            m_dma_map.add(bufferlist[i], buf->sgList());
+        }
+    }
 
-            if( DMABuffer_getSGList(buffer, &sglist ) != PDA_SUCCESS )
-            {
-                return 1;
-            }
 
-            /** Iterate sglist entries of the current buffer */
-            for
-            (
-                DMABuffer_SGNode *node = sglist;
-                node != NULL;
-                node = node->next
-            )
-            {
-                if(   ( (uint64_t)(node->d_pointer) <= phys_addr)
-                   && (((uint64_t)(node->d_pointer) + node->length) > phys_addr) )
-                {
-                    *offset += ( phys_addr - (uint64_t)(node->d_pointer) );
-                    if(DMABuffer_getIndex(buffer, buffer_id) != PDA_SUCCESS)
-                    {
-                        return 1;
-                    }
-                    return 0;
-                }
-                else
-                {
-                    *offset += (node->length)/sizeof(uint64_t);
-                }
+    void
+    bar_impl_sim::invalidateAddressMap()
+    {
+        pthread_mutex_lock(&m_map_mtx);
+        clearAddressMap();
+        pthread_mutex_unlock(&m_map_mtx);
+    }
 
 
-            }
+    int
+    bar_impl_sim::getOffset
+    (
+        uint64_t  phys_addr,
+        uint64_t *buffer_id,
+        uint64_t *offset
+    )
+    {
+        pthread_mutex_lock(&m_map_mtx);
+        bool found = m_dma_map_valid &&
+            m_dma_map.lookup(phys_addr, buffer_id, offset);
+        if( !found )
+        {
+            /** buffers may have been added since the last rebuild */
+            rebuildAddressMap();
+            found = m_dma_map.lookup(phys_addr, buffer_id, offset);
         }
-        return 1;
-#endif
-#else
-        sysfs_handler *hd = m_parent_dev->getHandler();
-        std::vector<uint64_t> bufferlist = hd->list_all_buffers();
-        std::vector<uint64_t>::iterator iter, end;
-        iter = bufferlist.begin();
-        end = bufferlist.end();
-        while( iter != end )
+        pthread_mutex_unlock(&m_map_mtx);
+        return (found) ? 0 : 1;
+    }
+
+
+    int32_t
+    bar_impl_sim::dmaCopy
+    (
+        uint64_t  buffer_id,
+        uint64_t  offset,
+        void     *data,
+        size_t    num,
+        bool      to_host
+    )
+    {
+        pthread_mutex_lock(&m_map_mtx);
+        std::map<uint64_t, buffer *>::iterator iter =
+            m_dma_buffers.find(buffer_id);
+        if( iter == m_dma_buffers.end() )
         {
-            buffer *buf = new buffer(m_parent_dev, *iter, 0);
-            uint64_t buf_offset;
-            if( buf->physAddrToOffset(phys_addr, &buf_offset)) {
-                 *offset = buf_offset;
-                 *buffer_id = *iter;
-                 delete buf;
-                 return 0;
-            }                 
-            delete buf;
-            ++iter;
+            pthread_mutex_unlock(&m_map_mtx);
+            return 1;
         }
-        return 1;
-#endif
+        /** buffers are overmapped, copies may wrap around the end */
+        uint8_t *mem = (uint8_t *)iter->second->getMem() + offset;
+        if( to_host )
+        { memcpy(mem, data, num); }
+        else
+        { memcpy(data, mem, num); }
+        pthread_mutex_unlock(&m_map_mtx);
+        return 0;
     }
 
 void
@@ -809,101 +1050,149 @@ bar_impl_sim::simSetPacketSize
 }
 
 
-void*
-bar_impl_sim::cmplHandler()
+void
+bar_impl_sim::simSetMaxOutstandingCompletions
+(
+    uint32_t count
+)
 {
-    t_read_req rdreq;
-    while( int result = read(m_pipefd[0], &rdreq, sizeof(t_read_req)) )
-    {
-        if(result<0)
-        {
-            std::cout << "ERROR: Failed to read from pipe: "
-                 << result << std::endl;
-            break;
-        }
-
-        /**
-         * break request down into CMPL_Ds with size <= m_max_packet_size
-         * wait for cmpl_done via CMD_CMPL_DONE from sock_monitor
-         * after each packet
-         */
-        buffer *buf;
-        try
-        {
-            buf = new buffer(m_parent_dev, rdreq.buffer_id, 1);
-        }
-        catch(...)
-        {
-            std::cout << "ERROR: Failed to connect to buffer "
-                 << rdreq.buffer_id << std::endl;
-            abort();
-        }
+    m_max_outstanding_cmpl = (count) ? count : 1;
+}
 
-        uint32_t *mem = buf->getMem();
 
-        while ( rdreq.length )
-        {
-            uint32_t length     = 0;
-            uint32_t byte_count = rdreq.length;
 
-            if( rdreq.length>m_max_packet_size)
-            {
-                length = m_max_packet_size;
-            }
-            else
-            {
-                length = rdreq.length;
-            }
-
-            int32_t buffersize
-                = 4*sizeof(uint32_t) + length;
+/**
+ * append the next CMPL_D of a read request to a completion batch
+ * @return false if the request is complete
+ **/
+bool
+bar_impl_sim::queueCompletion
+(
+    t_read_req            *rdreq,
+    std::vector<uint32_t> &batch,
+    std::vector<size_t>   &headers
+)
+{
+    uint32_t length     = rdreq->length;
+    uint32_t byte_count = rdreq->length;
+    if( length > m_max_packet_size )
+    { length = m_max_packet_size; }
+
+    size_t header = batch.size();
+    batch.resize(header + 4 + ((length + 3) >> 2));
+    headers.push_back(header);
+
+    /** prepare CMD_CMPL_TO_DEVICE */
+    batch[header]   = ((4 + (length>>2))<<16) + CMD_CMPL_TO_DEVICE;
+    batch[header+2] = rdreq->requester_id;
+    batch[header+3] =   (0<<29)          /** cmpl_status */
+                      + (byte_count<<16) /** remaining byte count */
+                      + (rdreq->tag<<8)
+                      + (rdreq->lower_addr);
+
+    if( dmaCopy(rdreq->buffer_id, rdreq->offset, &batch[header+4], length,
+                false) )
+    {
+        std::cout << "ERROR: Failed to connect to buffer "
+             << rdreq->buffer_id << std::endl;
+        abort();
+    }
+    batch.resize(header + 4 + (length >> 2));
 
-            uint32_t buffer[((buffersize/sizeof(uint32_t))+1)];
+    rdreq->length     -= length;
+    rdreq->offset     += length;
+    rdreq->lower_addr += length;
+    rdreq->lower_addr &= 0x7f; /** only lower 7 bit */
+    return (rdreq->length != 0);
+}
 
-            /** prepare CMD_CMPL_TO_DEVICE */
-            buffer[0] = ((buffersize>>2)<<16) + CMD_CMPL_TO_DEVICE;
-            buffer[2] = rdreq.requester_id;
-            buffer[3] =   (0<<29)          /** cmpl_status */
-                        + (byte_count<<16) /** remaining byte count */
-                        + (rdreq.tag<<8)
-                        + (rdreq.lower_addr);
 
-            memcpy(&(buffer[4]), mem+(rdreq.offset>>2), length);
 
-            pthread_mutex_lock(&m_mtx);
+void*
+bar_impl_sim::cmplHandler()
+{
+    /** outstanding read requests by tag */
+    std::map<uint8_t, t_read_req> pending;
+    std::map<uint8_t, t_read_req>::iterator next = pending.end();
+    std::vector<uint32_t> batch;
+    std::vector<size_t>   headers;
+    bool open = true;
+
+    while( open || !pending.empty() )
+    {
+        /**
+         * block for new requests only if there is nothing to complete,
+         * otherwise just pick up what is already in the pipe
+         **/
+        struct pollfd pfd;
+        pfd.fd = m_pipefd[0];
+        pfd.events = POLLIN;
+        while( open && poll(&pfd, 1, (pending.empty()) ? -1 : 0) > 0 )
+        {
+            t_read_req rdreq;
+            int result = read(m_pipefd[0], &rdreq, sizeof(t_read_req));
+            if( result <= 0 )
             {
-                buffer[1] = m_msgid;
-                /** send to FLI */
-                result = write(m_sockfd, buffer, buffersize);
-                m_msgid++;
+                if( result < 0 )
+                {
+                    std::cout << "ERROR: Failed to read from pipe: "
+                         << result << std::endl;
+                }
+                open = false;
+                break;
             }
-            pthread_mutex_unlock(&m_mtx);
-
-            if( result!=buffersize )
+            if( pending.count(rdreq.tag) )
             {
-                std::cout << "ERROR: CMD_CMPL_TO_DEVICE write failed with "
-                    << result << std::endl;
+                std::cout << "ERROR: read request with outstanding tag "
+                     << (uint32_t)rdreq.tag << std::endl;
             }
+            pending[rdreq.tag] = rdreq;
+            next = pending.end();
+        }
+        if( pending.empty() )
+        { continue; }
+
+        /**
+         * break requests down into CMPL_Ds with size <= m_max_packet_size,
+         * interleave the tags round robin and send as many as the
+         * completion window allows in one batch
+         **/
+        pthread_mutex_lock(&m_ack_mtx);
+        uint64_t window = m_cmpl_acked + m_max_outstanding_cmpl - m_cmpl_sent;
+        pthread_mutex_unlock(&m_ack_mtx);
+
+        while( window && !pending.empty() )
+        {
+            if( next == pending.end() )
+            { next = pending.begin(); }
+            if( queueCompletion(&next->second, batch, headers) )
+            { ++next; }
             else
-            {
-                /** wait for FLI acknowledgement */
-                while( !m_cmpl_to_dev_done )
-                {
-                    usleep(USLEEP_TIME);
-                }
-                m_cmpl_to_dev_done = 0;
+            { pending.erase(next++); }
+            window--;
+        }
 
-                //DEBUG_PRINTF(PDADEBUG_EXTERNAL,
-                //        "CMD_CMPL_TO_DEVICE tag=%d, length=%d B, buffer=%ld, offset=0x%x\n",
-                //        rdreq.tag, length, rdreq.buffer_id, (rdreq.offset>>2));
-            }
+        if( !headers.empty() )
+        {
+            uint64_t sent = headers.size();
+            if( sendMessages(batch, headers) == 0 )
+            { m_cmpl_sent += sent; }
+        }
+
+        /** wait for FLI acknowledgements to open the window again */
+        pthread_mutex_lock(&m_ack_mtx);
+        while( !pending.empty() && m_connected &&
+               (m_cmpl_sent - m_cmpl_acked) >= m_max_outstanding_cmpl )
+        { pthread_cond_wait(&m_ack_cond, &m_ack_mtx); }
+        bool connected = m_connected;
+        pthread_mutex_unlock(&m_ack_mtx);
 
-            rdreq.length     -= length;
-            rdreq.offset     += length;
-            rdreq.lower_addr += length;
-            rdreq.lower_addr &= 0x7f; /** only lower 7 bit */
+        /** requests cannot be completed without a simulator */
+        if( !connected )
+        {
+            pending.clear();
+            next = pending.end();
         }
-        delete buf;
     }
 
     //DEBUG_PRINTF(PDADEBUG_EXTERNAL, "Pipe has been closed, cmpl_handler stopping.\n");
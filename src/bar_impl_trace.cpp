@@ -0,0 +1,636 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <string.h>
+#include <sstream>
+
+#include <librorc/error.hh>
+#include <librorc/bar_impl_trace.hh>
+
+namespace LIBRARY_NAME
+{
+    /** key space for 16 bit accesses in the replay register map */
+    #define TRACE_KEY16 (1ull << 63)
+
+    static uint64_t
+    monotonicNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+
+
+    static size_t
+    putVarint
+    (
+        uint8_t  *buf,
+        uint64_t  value
+    )
+    {
+        size_t n = 0;
+        do
+        {
+            uint8_t byte = (value & 0x7f);
+            value >>= 7;
+            buf[n++] = (value) ? (byte | 0x80) : byte;
+        } while( value );
+        return n;
+    }
+
+
+    /****************************************************
+     * bar_trace_reader
+     ***************************************************/
+
+    bar_trace_reader::bar_trace_reader( const char *path )
+    {
+        FILE *fd = fopen(path, "rb");
+        if( fd == NULL )
+        { throw LIBRORC_BAR_ERROR_TRACE_OPEN_FAILED; }
+
+        uint8_t chunk[65536];
+        size_t nread;
+        while( (nread = fread(chunk, 1, sizeof(chunk), fd)) > 0 )
+        { m_trace.insert(m_trace.end(), chunk, chunk + nread); }
+        fclose(fd);
+
+        size_t header_size = strlen(LIBRORC_TRACE_MAGIC) + sizeof(uint64_t);
+        if( m_trace.size() < header_size ||
+            memcmp(&m_trace[0], LIBRORC_TRACE_MAGIC,
+                   strlen(LIBRORC_TRACE_MAGIC)) != 0 )
+        { throw LIBRORC_BAR_ERROR_TRACE_INVALID; }
+
+        uint64_t bar_size;
+        memcpy(&bar_size, &m_trace[strlen(LIBRORC_TRACE_MAGIC)],
+               sizeof(bar_size));
+        m_bar_size = bar_size;
+        rewind();
+    }
+
+
+    void
+    bar_trace_reader::rewind()
+    {
+        m_pos  = strlen(LIBRORC_TRACE_MAGIC) + sizeof(uint64_t);
+        m_time = 0;
+    }
+
+
+    bool
+    bar_trace_reader::readVarint( uint64_t *value )
+    {
+        uint64_t result = 0;
+        uint32_t shift = 0;
+        while( m_pos < m_trace.size() && shift < 64 )
+        {
+            uint8_t byte = m_trace[m_pos++];
+            result |= ((uint64_t)(byte & 0x7f) << shift);
+            if( !(byte & 0x80) )
+            {
+                *value = result;
+                return true;
+            }
+            shift += 7;
+        }
+        return false;
+    }
+
+
+    bool
+    bar_trace_reader::next( bar_trace_record *rec )
+    {
+        if( m_pos >= m_trace.size() )
+        { return false; }
+
+        uint64_t delta, length;
+        rec->op = m_trace[m_pos++];
+        if( !readVarint(&delta) || !readVarint(&rec->duration_ns) ||
+            !readVarint(&rec->address) )
+        { throw LIBRORC_BAR_ERROR_TRACE_INVALID; }
+        m_time += delta;
+        rec->start_ns = m_time;
+        rec->value = 0;
+        rec->data.clear();
+
+        switch( rec->op )
+        {
+            case LIBRORC_TRACE_GET32:
+            case LIBRORC_TRACE_SET32:
+                length = 4;
+                break;
+            case LIBRORC_TRACE_GET16:
+            case LIBRORC_TRACE_SET16:
+                length = 2;
+                break;
+            case LIBRORC_TRACE_COPY_TO_DEV:
+            case LIBRORC_TRACE_COPY_FROM_DEV:
+                if( !readVarint(&length) )
+                { throw LIBRORC_BAR_ERROR_TRACE_INVALID; }
+                break;
+            case LIBRORC_TRACE_FLUSH:
+                length = 0;
+                break;
+            default:
+                throw LIBRORC_BAR_ERROR_TRACE_INVALID;
+        }
+
+        if( m_pos + length > m_trace.size() )
+        { throw LIBRORC_BAR_ERROR_TRACE_INVALID; }
+
+        if( rec->op == LIBRORC_TRACE_COPY_TO_DEV ||
+            rec->op == LIBRORC_TRACE_COPY_FROM_DEV )
+        { rec->data.assign(&m_trace[m_pos], &m_trace[m_pos] + length); }
+        else
+        { memcpy(&rec->value, &m_trace[m_pos], length); }
+        m_pos += length;
+        return true;
+    }
+
+
+    const char *
+    bar_trace_reader::opName( uint8_t op )
+    {
+        switch( op )
+        {
+            case LIBRORC_TRACE_GET32:         return "get32";
+            case LIBRORC_TRACE_SET32:         return "set32";
+            case LIBRORC_TRACE_GET16:         return "get16";
+            case LIBRORC_TRACE_SET16:         return "set16";
+            case LIBRORC_TRACE_COPY_TO_DEV:   return "memcopy_to";
+            case LIBRORC_TRACE_COPY_FROM_DEV: return "memcopy_from";
+            case LIBRORC_TRACE_FLUSH:         return "flush";
+            default:                          return "unknown";
+        }
+    }
+
+
+    /****************************************************
+     * bar_impl_trace_recorder
+     ***************************************************/
+
+    bar_impl_trace_recorder::bar_impl_trace_recorder
+    (
+        bar_impl   *inner,
+        const char *path
+    )
+    {
+        m_fd = fopen(path, "wb");
+        if( m_fd == NULL )
+        { throw LIBRORC_BAR_ERROR_TRACE_OPEN_FAILED; }
+
+        m_inner = inner;
+        uint64_t bar_size = m_inner->size();
+        fwrite(LIBRORC_TRACE_MAGIC, 1, strlen(LIBRORC_TRACE_MAGIC), m_fd);
+        fwrite(&bar_size, sizeof(bar_size), 1, m_fd);
+        m_last_ns = monotonicNs();
+        pthread_mutex_init(&m_mtx, NULL);
+    }
+
+
+    bar_impl_trace_recorder::~bar_impl_trace_recorder()
+    {
+        fclose(m_fd);
+        pthread_mutex_destroy(&m_mtx);
+        delete m_inner;
+    }
+
+
+    void
+    bar_impl_trace_recorder::record
+    (
+        uint8_t      op,
+        uint64_t     start_ns,
+        bar_address  address,
+        uint32_t     value,
+        const void  *data,
+        size_t       num
+    )
+    {
+        uint64_t end_ns = monotonicNs();
+        uint8_t buf[48];
+        size_t n = 0;
+
+        pthread_mutex_lock(&m_mtx);
+        /** concurrent accesses may finish out of order */
+        uint64_t delta = (start_ns > m_last_ns) ? (start_ns - m_last_ns) : 0;
+        m_last_ns += delta;
+        buf[n++] = op;
+        n += putVarint(&buf[n], delta);
+        n += putVarint(&buf[n], end_ns - start_ns);
+        n += putVarint(&buf[n], address);
+        switch( op )
+        {
+            case LIBRORC_TRACE_GET32:
+            case LIBRORC_TRACE_SET32:
+                memcpy(&buf[n], &value, 4);
+                n += 4;
+                break;
+            case LIBRORC_TRACE_GET16:
+            case LIBRORC_TRACE_SET16:
+                memcpy(&buf[n], &value, 2);
+                n += 2;
+                break;
+            case LIBRORC_TRACE_COPY_TO_DEV:
+            case LIBRORC_TRACE_COPY_FROM_DEV:
+                n += putVarint(&buf[n], num);
+                break;
+        }
+        fwrite(buf, 1, n, m_fd);
+        if( num )
+        { fwrite(data, 1, num, m_fd); }
+        pthread_mutex_unlock(&m_mtx);
+    }
+
+
+    void
+    bar_impl_trace_recorder::memcopy
+    (
+        bar_address  target,
+        const void  *source,
+        size_t       num
+    )
+    {
+        uint64_t start = monotonicNs();
+        m_inner->memcopy(target, source, num);
+        record(LIBRORC_TRACE_COPY_TO_DEV, start, target, 0, source, num);
+    }
+
+
+    void
+    bar_impl_trace_recorder::memcopy
+    (
+        void        *target,
+        bar_address  source,
+        size_t       num
+    )
+    {
+        uint64_t start = monotonicNs();
+        m_inner->memcopy(target, source, num);
+        record(LIBRORC_TRACE_COPY_FROM_DEV, start, source, 0, target, num);
+    }
+
+
+    void
+    bar_impl_trace_recorder::memcopyPosted
+    (
+        bar_address  target,
+        const void  *source,
+        size_t       num
+    )
+    {
+        uint64_t start = monotonicNs();
+        m_inner->memcopyPosted(target, source, num);
+        record(LIBRORC_TRACE_COPY_TO_DEV, start, target, 0, source, num);
+    }
+
+
+    uint32_t
+    bar_impl_trace_recorder::get32( bar_address address )
+    {
+        uint64_t start = monotonicNs();
+        uint32_t value = m_inner->get32(address);
+        record(LIBRORC_TRACE_GET32, start, address, value, NULL, 0);
+        return value;
+    }
+
+
+    uint16_t
+    bar_impl_trace_recorder::get16( bar_address address )
+    {
+        uint64_t start = monotonicNs();
+        uint16_t value = m_inner->get16(address);
+        record(LIBRORC_TRACE_GET16, start, address, value, NULL, 0);
+        return value;
+    }
+
+
+    void
+    bar_impl_trace_recorder::set32
+    (
+        bar_address address,
+        uint32_t    data
+    )
+    {
+        uint64_t start = monotonicNs();
+        m_inner->set32(address, data);
+        record(LIBRORC_TRACE_SET32, start, address, data, NULL, 0);
+    }
+
+
+    void
+    bar_impl_trace_recorder::set16
+    (
+        bar_address address,
+        uint16_t    data
+    )
+    {
+        uint64_t start = monotonicNs();
+        m_inner->set16(address, data);
+        record(LIBRORC_TRACE_SET16, start, address, data, NULL, 0);
+    }
+
+
+    void
+    bar_impl_trace_recorder::flush( bar_address readback )
+    {
+        uint64_t start = monotonicNs();
+        m_inner->flush(readback);
+        record(LIBRORC_TRACE_FLUSH, start, readback, 0, NULL, 0);
+    }
+
+
+    int32_t
+    bar_impl_trace_recorder::gettime
+    (
+        struct timeval  *tv,
+        struct timezone *tz
+    )
+    { return m_inner->gettime(tv, tz); }
+
+
+    size_t
+    bar_impl_trace_recorder::size()
+    { return m_inner->size(); }
+
+
+    void
+    bar_impl_trace_recorder::simSetPacketSize( uint32_t packet_size )
+    { m_inner->simSetPacketSize(packet_size); }
+
+
+    void
+    bar_impl_trace_recorder::setPostedWrites( bool enable )
+    { m_inner->setPostedWrites(enable); }
+
+
+    bool
+    bar_impl_trace_recorder::postedWrites()
+    { return m_inner->postedWrites(); }
+
+
+    /****************************************************
+     * bar_impl_trace_replay
+     ***************************************************/
+
+    bar_impl_trace_replay::bar_impl_trace_replay( const char *path )
+    {
+        bar_trace_reader reader(path);
+        bar_trace_record rec;
+        while( reader.next(&rec) )
+        { m_records.push_back(rec); }
+
+        m_bar_size   = reader.barSize();
+        m_pos        = 0;
+        m_strict     = false;
+        m_realtime   = false;
+        m_mismatches = 0;
+        pthread_mutex_init(&m_mtx, NULL);
+    }
+
+
+    bar_impl_trace_replay::~bar_impl_trace_replay()
+    {
+        pthread_mutex_destroy(&m_mtx);
+    }
+
+
+    uint64_t
+    bar_impl_trace_replay::remaining()
+    {
+        pthread_mutex_lock(&m_mtx);
+        uint64_t n = m_records.size() - m_pos;
+        pthread_mutex_unlock(&m_mtx);
+        return n;
+    }
+
+
+    /** call with m_mtx held */
+    const bar_trace_record *
+    bar_impl_trace_replay::match
+    (
+        uint8_t     op,
+        bar_address address
+    )
+    {
+        for( size_t i=0; i<LIBRORC_TRACE_RESYNC_WINDOW; i++ )
+        {
+            size_t idx = m_pos + i;
+            if( idx >= m_records.size() )
+            { break; }
+            const bar_trace_record *rec = &m_records[idx];
+            if( rec->op == op && rec->address == address )
+            {
+                m_pos = idx + 1;
+                if( m_realtime )
+                {
+                    uint64_t end = monotonicNs() + rec->duration_ns;
+                    while( monotonicNs() < end ){}
+                }
+                return rec;
+            }
+        }
+        return NULL;
+    }
+
+
+    /** call with m_mtx held */
+    void
+    bar_impl_trace_replay::mismatch
+    (
+        uint8_t      op,
+        bar_address  address,
+        const char  *reason
+    )
+    {
+        if( m_mismatches == 0 )
+        {
+            std::ostringstream msg;
+            msg << bar_trace_reader::opName(op) << " 0x" << std::hex
+                << address << std::dec << " at record " << m_pos << ": "
+                << reason;
+            m_first_mismatch = msg.str();
+        }
+        m_mismatches++;
+        if( m_strict )
+        {
+            pthread_mutex_unlock(&m_mtx);
+            throw LIBRORC_BAR_ERROR_REPLAY_MISMATCH;
+        }
+    }
+
+
+    uint32_t
+    bar_impl_trace_replay::get32( bar_address address )
+    {
+        pthread_mutex_lock(&m_mtx);
+        const bar_trace_record *rec = match(LIBRORC_TRACE_GET32, address);
+        uint32_t value;
+        if( rec )
+        { value = rec->value; }
+        else
+        {
+            mismatch(LIBRORC_TRACE_GET32, address, "not in trace");
+            value = m_last_value[address];
+        }
+        m_last_value[address] = value;
+        pthread_mutex_unlock(&m_mtx);
+        return value;
+    }
+
+
+    uint16_t
+    bar_impl_trace_replay::get16( bar_address address )
+    {
+        pthread_mutex_lock(&m_mtx);
+        const bar_trace_record *rec = match(LIBRORC_TRACE_GET16, address);
+        uint16_t value;
+        if( rec )
+        { value = rec->value; }
+        else
+        {
+            mismatch(LIBRORC_TRACE_GET16, address, "not in trace");
+            value = m_last_value[address | TRACE_KEY16];
+        }
+        m_last_value[address | TRACE_KEY16] = value;
+        pthread_mutex_unlock(&m_mtx);
+        return value;
+    }
+
+
+    void
+    bar_impl_trace_replay::set32
+    (
+        bar_address address,
+        uint32_t    data
+    )
+    {
+        pthread_mutex_lock(&m_mtx);
+        const bar_trace_record *rec = match(LIBRORC_TRACE_SET32, address);
+        if( !rec )
+        { mismatch(LIBRORC_TRACE_SET32, address, "not in trace"); }
+        else if( rec->value != data )
+        { mismatch(LIBRORC_TRACE_SET32, address, "data differs"); }
+        m_last_value[address] = data;
+        pthread_mutex_unlock(&m_mtx);
+    }
+
+
+    void
+    bar_impl_trace_replay::set16
+    (
+        bar_address address,
+        uint16_t    data
+    )
+    {
+        pthread_mutex_lock(&m_mtx);
+        const bar_trace_record *rec = match(LIBRORC_TRACE_SET16, address);
+        if( !rec )
+        { mismatch(LIBRORC_TRACE_SET16, address, "not in trace"); }
+        else if( rec->value != data )
+        { mismatch(LIBRORC_TRACE_SET16, address, "data differs"); }
+        m_last_value[address | TRACE_KEY16] = data;
+        pthread_mutex_unlock(&m_mtx);
+    }
+
+
+    void
+    bar_impl_trace_replay::memcopy
+    (
+        bar_address  target,
+        const void  *source,
+        size_t       num
+    )
+    {
+        pthread_mutex_lock(&m_mtx);
+        const bar_trace_record *rec =
+            match(LIBRORC_TRACE_COPY_TO_DEV, target);
+        if( !rec )
+        { mismatch(LIBRORC_TRACE_COPY_TO_DEV, target, "not in trace"); }
+        else if( rec->data.size() != num ||
+                 (num && memcmp(&rec->data[0], source, num) != 0) )
+        { mismatch(LIBRORC_TRACE_COPY_TO_DEV, target, "data differs"); }
+        const uint32_t *src = (const uint32_t *)source;
+        for( size_t i=0; i<(num>>2); i++ )
+        { m_last_value[target + i] = src[i]; }
+        pthread_mutex_unlock(&m_mtx);
+    }
+
+
+    void
+    bar_impl_trace_replay::memcopy
+    (
+        void        *target,
+        bar_address  source,
+        size_t       num
+    )
+    {
+        pthread_mutex_lock(&m_mtx);
+        const bar_trace_record *rec =
+            match(LIBRORC_TRACE_COPY_FROM_DEV, source);
+        if( rec && rec->data.size() == num )
+        {
+            if( num )
+            { memcpy(target, &rec->data[0], num); }
+        }
+        else
+        {
+            mismatch(LIBRORC_TRACE_COPY_FROM_DEV, source,
+                     (rec) ? "size differs" : "not in trace");
+            uint32_t *dest = (uint32_t *)target;
+            for( size_t i=0; i<(num>>2); i++ )
+            { dest[i] = m_last_value[source + i]; }
+        }
+        pthread_mutex_unlock(&m_mtx);
+    }
+
+
+    void
+    bar_impl_trace_replay::flush( bar_address readback )
+    {
+        pthread_mutex_lock(&m_mtx);
+        if( !match(LIBRORC_TRACE_FLUSH, readback) )
+        { mismatch(LIBRORC_TRACE_FLUSH, readback, "not in trace"); }
+        pthread_mutex_unlock(&m_mtx);
+    }
+
+
+    int32_t
+    bar_impl_trace_replay::gettime
+    (
+        struct timeval  *tv,
+        struct timezone *tz
+    )
+    { return gettimeofday(tv, tz); }
+
+
+    size_t
+    bar_impl_trace_replay::size()
+    { return m_bar_size; }
+}
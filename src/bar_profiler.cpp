@@ -0,0 +1,341 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <iomanip>
+
+#include <librorc/registers.h>
+#include <librorc/bar_profiler.hh>
+
+namespace LIBRARY_NAME
+{
+    typedef struct
+    {
+        const char        *name;
+        bar_profile_stats  stats[LIBRORC_PROF_NUM_OPS];
+    } bar_profile_scope;
+
+    static bar_profile_stats
+        g_ranges[LIBRORC_PROF_MAX_RANGES][LIBRORC_PROF_NUM_REGFILES]
+                [LIBRORC_PROF_NUM_OPS];
+    /** scope 0 collects all accesses outside of any scope */
+    static bar_profile_scope g_scopes[LIBRORC_PROF_MAX_SCOPES];
+    static volatile uint32_t g_nscopes = 1;
+    static pthread_mutex_t g_scope_mtx = PTHREAD_MUTEX_INITIALIZER;
+    static uint64_t g_tsc_start = 0;
+    static uint64_t g_ns_start = 0;
+
+    static __thread const char *t_scope = NULL;
+
+    static const char *op_names[LIBRORC_PROF_NUM_OPS] =
+    { "read", "write", "flush" };
+    static const char *regfile_names[LIBRORC_PROF_NUM_REGFILES] =
+    { "PCIe", "GTX", "DDL" };
+
+    volatile bool bar_profiler::m_enabled = false;
+
+
+    static uint64_t
+    monotonicNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+
+
+    static void
+    addStats
+    (
+        bar_profile_stats *stats,
+        uint64_t           cycles
+    )
+    {
+        uint32_t bin = 0;
+        while( (bin < LIBRORC_PROF_HIST_BINS-1) && (cycles >> (bin+1)) )
+        { bin++; }
+        __sync_fetch_and_add(&stats->count, 1);
+        __sync_fetch_and_add(&stats->cycles, cycles);
+        __sync_fetch_and_add(&stats->hist[bin], 1);
+        uint64_t max = stats->max_cycles;
+        while( cycles > max )
+        {
+            uint64_t prev = __sync_val_compare_and_swap(&stats->max_cycles,
+                                                        max, cycles);
+            if( prev == max )
+            { break; }
+            max = prev;
+        }
+    }
+
+
+    /** upper bound of the histogram bin containing quantile q */
+    static uint64_t
+    quantile
+    (
+        const bar_profile_stats *stats,
+        double                   q
+    )
+    {
+        uint64_t limit = (uint64_t)(q * stats->count);
+        uint64_t sum = 0;
+        for( uint32_t bin=0; bin<LIBRORC_PROF_HIST_BINS; bin++ )
+        {
+            sum += stats->hist[bin];
+            if( sum > limit )
+            {
+                uint64_t bound = (2ull << bin);
+                return (bound < stats->max_cycles) ? bound : stats->max_cycles;
+            }
+        }
+        return stats->max_cycles;
+    }
+
+
+    static uint32_t
+    scopeIndex( const char *name )
+    {
+        if( name == NULL )
+        { return 0; }
+
+        uint32_t n = g_nscopes;
+        for( uint32_t i=1; i<n; i++ )
+        {
+            if( g_scopes[i].name == name )
+            { return i; }
+        }
+
+        /** not found: register under lock, string literals of the same
+         *  name may have different addresses in different objects */
+        pthread_mutex_lock(&g_scope_mtx);
+        uint32_t i;
+        for( i=1; i<g_nscopes; i++ )
+        {
+            if( strcmp(g_scopes[i].name, name) == 0 )
+            { break; }
+        }
+        if( (i == g_nscopes) && (i < LIBRORC_PROF_MAX_SCOPES) )
+        {
+            g_scopes[i].name = name;
+            __sync_synchronize();
+            g_nscopes = i + 1;
+        }
+        pthread_mutex_unlock(&g_scope_mtx);
+        return (i < LIBRORC_PROF_MAX_SCOPES) ? i : 0;
+    }
+
+
+    void
+    bar_profiler::setEnabled( bool enable )
+    {
+        if( enable && !m_enabled )
+        {
+            g_ns_start  = monotonicNs();
+            g_tsc_start = tsc();
+        }
+        m_enabled = enable;
+    }
+
+
+    uint64_t
+    bar_profiler::tsc()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        uint32_t lo, hi;
+        __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+        return ((uint64_t)hi << 32) | lo;
+#else
+        return monotonicNs();
+#endif
+    }
+
+
+    void
+    bar_profiler::record
+    (
+        bar_address    address,
+        bar_profile_op op,
+        uint64_t       cycles
+    )
+    {
+        uint32_t range = address / RORC_CHANNEL_OFFSET;
+        if( range >= LIBRORC_PROF_MAX_RANGES )
+        { range = LIBRORC_PROF_MAX_RANGES - 1; }
+
+        bar_profile_regfile regfile = LIBRORC_PROF_REGFILE_PCI;
+        if( range != 0 )
+        {
+            if( address & (1<<RORC_REGFILE_DDL_SEL) )
+            { regfile = LIBRORC_PROF_REGFILE_DDL; }
+            else if( address & (1<<RORC_REGFILE_GTX_SEL) )
+            { regfile = LIBRORC_PROF_REGFILE_GTX; }
+        }
+
+        addStats(&g_ranges[range][regfile][op], cycles);
+        addStats(&g_scopes[scopeIndex(t_scope)].stats[op], cycles);
+    }
+
+
+    void
+    bar_profiler::reset()
+    {
+        memset(g_ranges, 0, sizeof(g_ranges));
+        pthread_mutex_lock(&g_scope_mtx);
+        for( uint32_t i=0; i<LIBRORC_PROF_MAX_SCOPES; i++ )
+        { memset(g_scopes[i].stats, 0, sizeof(g_scopes[i].stats)); }
+        pthread_mutex_unlock(&g_scope_mtx);
+        g_ns_start  = monotonicNs();
+        g_tsc_start = tsc();
+    }
+
+
+    int
+    bar_profiler::getRangeStats
+    (
+        uint32_t             range,
+        bar_profile_regfile  regfile,
+        bar_profile_op       op,
+        bar_profile_stats   *stats
+    )
+    {
+        if( range >= LIBRORC_PROF_MAX_RANGES ||
+            regfile >= LIBRORC_PROF_NUM_REGFILES ||
+            op >= LIBRORC_PROF_NUM_OPS )
+        { return -1; }
+        *stats = g_ranges[range][regfile][op];
+        return 0;
+    }
+
+
+    static void
+    reportLine
+    (
+        std::ostream            &os,
+        const char              *op,
+        const bar_profile_stats *stats,
+        double                   cycles_per_us
+    )
+    {
+        os << std::setw(6) << op
+           << std::setw(11) << stats->count
+           << std::setw(12) << std::fixed << std::setprecision(1)
+           << stats->cycles / cycles_per_us
+           << std::setw(10) << stats->cycles / stats->count
+           << std::setw(10) << quantile(stats, 0.5)
+           << std::setw(10) << quantile(stats, 0.99)
+           << std::setw(11) << stats->max_cycles << std::endl;
+    }
+
+
+    void
+    bar_profiler::report( std::ostream &os )
+    {
+        uint64_t ns = monotonicNs() - g_ns_start;
+        uint64_t cycles = tsc() - g_tsc_start;
+        double cycles_per_us = (ns) ? (1000.0 * cycles / ns) : 1.0;
+        std::ios_base::fmtflags flags = os.flags();
+
+        os << "BAR access profile, " << std::fixed << std::setprecision(1)
+           << cycles_per_us << " cycles/us, latencies in cycles" << std::endl;
+        os << std::left << std::setw(18) << "range" << std::right
+           << std::setw(6) << "op" << std::setw(11) << "count"
+           << std::setw(12) << "total_us" << std::setw(10) << "avg"
+           << std::setw(10) << "p50" << std::setw(10) << "p99"
+           << std::setw(11) << "max" << std::endl;
+        for( uint32_t r=0; r<LIBRORC_PROF_MAX_RANGES; r++ )
+        {
+            for( uint32_t f=0; f<LIBRORC_PROF_NUM_REGFILES; f++ )
+            {
+                for( uint32_t o=0; o<LIBRORC_PROF_NUM_OPS; o++ )
+                {
+                    const bar_profile_stats *stats = &g_ranges[r][f][o];
+                    if( stats->count == 0 )
+                    { continue; }
+                    char name[32];
+                    if( r == 0 )
+                    { snprintf(name, sizeof(name), "global"); }
+                    else
+                    {
+                        snprintf(name, sizeof(name), "link %u %s",
+                                 r - 1, regfile_names[f]);
+                    }
+                    os << std::left << std::setw(18) << name << std::right;
+                    reportLine(os, op_names[o], stats, cycles_per_us);
+                }
+            }
+        }
+
+        os << "subsystem" << std::endl;
+        for( uint32_t s=0; s<g_nscopes; s++ )
+        {
+            for( uint32_t o=0; o<LIBRORC_PROF_NUM_OPS; o++ )
+            {
+                const bar_profile_stats *stats = &g_scopes[s].stats[o];
+                if( stats->count == 0 )
+                { continue; }
+                os << std::left << std::setw(18)
+                   << ((s == 0) ? "(none)" : g_scopes[s].name) << std::right;
+                reportLine(os, op_names[o], stats, cycles_per_us);
+            }
+        }
+        os.flags(flags);
+    }
+
+
+    bar_profiler::scope::scope( const char *name )
+    {
+        m_prev = t_scope;
+        t_scope = name;
+    }
+
+
+    bar_profiler::scope::~scope()
+    {
+        t_scope = m_prev;
+    }
+
+
+    /** enable profiling from the environment and report at exit */
+    static struct bar_profiler_env
+    {
+        bar_profiler_env()
+        {
+            if( getenv("LIBRORC_BAR_PROFILE") != NULL )
+            { bar_profiler::setEnabled(true); }
+        }
+
+        ~bar_profiler_env()
+        {
+            if( getenv("LIBRORC_BAR_PROFILE") != NULL )
+            { bar_profiler::report(std::cerr); }
+        }
+    } g_bar_profiler_env;
+}
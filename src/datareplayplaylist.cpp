@@ -0,0 +1,309 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <sstream>
+#include <iomanip>
+
+#include <librorc/datareplayplaylist.hh>
+#include <librorc/datareplaychannel.hh>
+#include <librorc/ddr3.hh>
+#include <librorc/link.hh>
+
+/** DDR3 address units per replay block of 15 DWs */
+#define DATA_REPLAY_BLOCK_UNITS 8
+/** highest start address supported by the replay channels */
+#define DATA_REPLAY_MAX_ADDR 0x80000000ull
+
+namespace LIBRARY_NAME
+{
+    datareplayplaylist::datareplayplaylist
+    (
+        bar *parent_bar
+    )
+    {
+        m_bar = parent_bar;
+        m_sm = new sysmon(parent_bar);
+        m_packed = false;
+        for( uint32_t ch=0; ch<LIBRORC_DATA_REPLAY_CHANNELS; ch++ )
+        {
+            m_start_addr[ch] = 0;
+            m_end_addr[ch] = 0;
+        }
+        m_module_units[0] = 0;
+        m_module_units[1] = 0;
+    }
+
+
+
+    datareplayplaylist::~datareplayplaylist()
+    {
+        clear();
+        delete m_sm;
+    }
+
+
+
+    int
+    datareplayplaylist::addFile
+    (
+        uint32_t    channel,
+        const char *filename
+    )
+    {
+        if( channel >= LIBRORC_DATA_REPLAY_CHANNELS )
+        { return -1; }
+
+        int fd = open(filename, O_RDONLY);
+        if( fd < 0 )
+        { return -1; }
+
+        struct stat st;
+        if( fstat(fd, &st) || st.st_size == 0 || (st.st_size & 3) )
+        {
+            close(fd);
+            return -1;
+        }
+
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if( map == MAP_FAILED )
+        { return -1; }
+
+        event_file file;
+        file.filename = filename;
+        file.data     = (uint32_t *)map;
+        file.size     = st.st_size;
+        m_files[channel].push_back(file);
+        m_packed = false;
+        return 0;
+    }
+
+
+
+    void
+    datareplayplaylist::clear()
+    {
+        for( uint32_t ch=0; ch<LIBRORC_DATA_REPLAY_CHANNELS; ch++ )
+        {
+            for( size_t i=0; i<m_files[ch].size(); i++ )
+            { munmap(m_files[ch][i].data, m_files[ch][i].size); }
+            m_files[ch].clear();
+        }
+        m_events.clear();
+        m_packed = false;
+    }
+
+
+
+    int
+    datareplayplaylist::pack()
+    {
+        m_packed = false;
+        m_events.clear();
+
+        uint64_t next[2] = {0, 0};
+        for( uint32_t c=0; c<2; c++ )
+        {
+            ddr3 module(m_bar, c);
+            m_module_units[c] = (module.isImplemented())
+                ? (module.maxModuleSize() / 8) : 0;
+            if( m_module_units[c] > DATA_REPLAY_MAX_ADDR )
+            { m_module_units[c] = DATA_REPLAY_MAX_ADDR; }
+        }
+
+        for( uint32_t ch=0; ch<LIBRORC_DATA_REPLAY_CHANNELS; ch++ )
+        {
+            uint32_t c = (ch>5) ? 1 : 0;
+            m_start_addr[ch] = next[c];
+            for( size_t i=0; i<m_files[ch].size(); i++ )
+            {
+                uint32_t num_dws = m_files[ch][i].size >> 2;
+                uint64_t units = (uint64_t)((num_dws + 14) / 15) *
+                    DATA_REPLAY_BLOCK_UNITS;
+                if( next[c] + units > m_module_units[c] )
+                { return -1; }
+
+                ddr3_replay_event ev;
+                ev.event_data      = m_files[ch][i].data;
+                ev.num_dws         = num_dws;
+                ev.ddr3_start_addr = next[c];
+                ev.channel         = ch;
+                ev.last_event      = (i == m_files[ch].size()-1);
+                ev.diu_error       = false;
+                ev.next_addr       = next[c] + units;
+                m_events.push_back(ev);
+                next[c] += units;
+            }
+            m_end_addr[ch] = next[c];
+        }
+
+        m_packed = true;
+        return 0;
+    }
+
+
+
+    int
+    datareplayplaylist::upload
+    (
+        ddr3_replay_upload_stats *stats
+    )
+    {
+        if( !m_packed )
+        { return -1; }
+        return m_sm->ddr3DataReplayUpload(m_events, stats);
+    }
+
+
+
+    int
+    datareplayplaylist::configureChannels
+    (
+        uint32_t loops
+    )
+    {
+        if( !m_packed )
+        { return -1; }
+
+        for( uint32_t ch=0; ch<LIBRORC_DATA_REPLAY_CHANNELS; ch++ )
+        {
+            if( m_files[ch].empty() )
+            { continue; }
+            link ln(m_bar, ch);
+            datareplaychannel dr(&ln);
+            dr.setStartAddress(m_start_addr[ch]);
+            dr.setEventLimit(loops * m_files[ch].size());
+        }
+        return 0;
+    }
+
+
+
+    uint32_t
+    datareplayplaylist::numberOfEvents
+    (
+        uint32_t channel
+    )
+    {
+        if( channel >= LIBRORC_DATA_REPLAY_CHANNELS )
+        { return 0; }
+        return m_files[channel].size();
+    }
+
+
+
+    uint32_t
+    datareplayplaylist::startAddress
+    (
+        uint32_t channel
+    )
+    {
+        if( channel >= LIBRORC_DATA_REPLAY_CHANNELS )
+        { return 0; }
+        return m_start_addr[channel];
+    }
+
+
+
+    uint32_t
+    datareplayplaylist::endAddress
+    (
+        uint32_t channel
+    )
+    {
+        if( channel >= LIBRORC_DATA_REPLAY_CHANNELS )
+        { return 0; }
+        return m_end_addr[channel];
+    }
+
+
+
+    std::string
+    datareplayplaylist::manifest()
+    {
+        std::ostringstream out;
+        out << "# channel <ch> <module> <start_addr> <end_addr> <events> <bytes>"
+            << std::endl
+            << "# event <ch> <index> <ddr3_addr> <bytes> <file>"
+            << std::endl;
+        if( !m_packed )
+        { return out.str(); }
+
+        size_t ev = 0;
+        for( uint32_t ch=0; ch<LIBRORC_DATA_REPLAY_CHANNELS; ch++ )
+        {
+            if( m_files[ch].empty() )
+            { continue; }
+            uint64_t bytes = 0;
+            for( size_t i=0; i<m_files[ch].size(); i++ )
+            { bytes += m_files[ch][i].size; }
+
+            out << "channel " << ch << " " << ((ch>5) ? 1 : 0)
+                << std::hex << std::setfill('0')
+                << " 0x" << std::setw(8) << m_start_addr[ch]
+                << " 0x" << std::setw(8) << m_end_addr[ch]
+                << std::dec << std::setfill(' ')
+                << " " << m_files[ch].size() << " " << bytes << std::endl;
+
+            for( size_t i=0; i<m_files[ch].size(); i++, ev++ )
+            {
+                out << "event " << ch << " " << i
+                    << std::hex << std::setfill('0')
+                    << " 0x" << std::setw(8) << m_events[ev].ddr3_start_addr
+                    << std::dec << std::setfill(' ')
+                    << " " << m_files[ch][i].size
+                    << " " << m_files[ch][i].filename << std::endl;
+            }
+        }
+        return out.str();
+    }
+
+
+
+    int
+    datareplayplaylist::writeManifest
+    (
+        const char *filename
+    )
+    {
+        FILE *fd = fopen(filename, "w");
+        if( !fd )
+        { return -1; }
+        std::string text = manifest();
+        size_t written = fwrite(text.data(), 1, text.size(), fd);
+        if( fclose(fd) || written != text.size() )
+        { return -1; }
+        return 0;
+    }
+}
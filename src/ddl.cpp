@@ -54,10 +54,9 @@ namespace LIBRARY_NAME
         uint32_t value
     )
     {
-        uint32_t ddlctrl = m_link->ddlReg(RORC_REG_DDL_CTRL);
-        ddlctrl &= ~(1<<31);
-        ddlctrl |= ((value&1)<<31);
-        m_link->setDdlReg(RORC_REG_DDL_CTRL, ddlctrl);
+        m_link->modifyDdlReg(RORC_REG_DDL_CTRL, (1<<31), ((value&1)<<31));
+        // the DDL reset also resets the shadowed DDL control registers
+        m_link->invalidateShadow();
     }
 
     uint32_t
@@ -78,10 +77,7 @@ namespace LIBRARY_NAME
         uint32_t value
     )
     {
-        uint32_t ddlctrl = m_link->ddlReg(RORC_REG_DDL_CTRL);
-        ddlctrl &= ~(1<<0); // clear previous value
-        ddlctrl |= (value&1); // clear previous value
-        m_link->setDdlReg(RORC_REG_DDL_CTRL, ddlctrl);
+        m_link->modifyDdlReg(RORC_REG_DDL_CTRL, (1<<0), (value&1));
     }
 
     uint32_t
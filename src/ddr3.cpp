@@ -73,7 +73,7 @@ namespace LIBRARY_NAME {
         return (getBitrate() != 0);
     }
 
-    uint32_t ddr3::maxModuleSize() {
+    uint64_t ddr3::maxModuleSize() {
         uint32_t ddr3ctrl = m_bar->get32(RORC_REG_DDR3_CTRL);
         // get controller address width encoded as (32-regval)
         uint32_t addr_width = (32 - ((ddr3ctrl >> (m_offset + 11)) & 0x7));
@@ -83,7 +83,7 @@ namespace LIBRARY_NAME {
         if (nranks == 1) {
             addr_width -= 1;
         }
-        return 8 * (1 << addr_width);
+        return 8ull << addr_width;
     }
 
     bool ddr3::initSuccessful() {
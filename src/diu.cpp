@@ -34,6 +34,7 @@
 #include <librorc/diu.hh>
 #include <librorc/registers.h>
 #include <librorc/link.hh>
+#include <librorc/bar_profiler.hh>
 
 namespace LIBRARY_NAME
 {
@@ -58,17 +59,13 @@ namespace LIBRARY_NAME
     void
     diu::setForcedXoff( uint32_t xoff ) {
         std::cout << "Setting XOFF to " << xoff << std::endl;
-        uint32_t ddlctrl = m_link->ddlReg(RORC_REG_DDL_CTRL);
-        ddlctrl &= ~(1<<6);
-        ddlctrl |= ((xoff&1) << 6);
-        m_link->setDdlReg(RORC_REG_DDL_CTRL, ddlctrl);
+        m_link->modifyDdlReg(RORC_REG_DDL_CTRL, (1<<6), ((xoff&1) << 6));
     }
 
     void
     diu::clearInterfaceCounters()
     {
-        m_link->setDdlReg(RORC_REG_DDL_CTRL,
-                m_link->ddlReg(RORC_REG_DDL_CTRL)|(1<<2));
+        m_link->modifyDdlReg(RORC_REG_DDL_CTRL, (1<<2), (1<<2));
     }
 
     uint32_t
@@ -80,10 +77,26 @@ namespace LIBRARY_NAME
     void
     diu::clearAllLastStatusWords()
     {
-        clearLastFrontEndStatusWord();
-        clearLastCommandTransmissionStatusWord();
-        clearLastDataTransmissionStatusWord();
-        clearLastInterfaceStatusWord();
+        bar::transaction t(m_link->getBar());
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_CTSTW), 0);
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_FESTW), 0);
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_DTSTW), 0);
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_IFSTW), 0);
+        m_link->apply(t);
+    }
+
+    void
+    diu::clearAllCounters()
+    {
+        bar::transaction t(m_link->getBar());
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_EC), 0);
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_DEADTIME), 0);
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_CTSTW), 0);
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_FESTW), 0);
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_DTSTW), 0);
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_IFSTW), 0);
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_DMA_DEADTIME), 0);
+        m_link->apply(t);
     }
 
     uint32_t
@@ -217,9 +230,7 @@ namespace LIBRARY_NAME
     void
     diu::useAsDataSource()
     {
-        uint32_t ddlctrl = m_link->ddlReg(RORC_REG_DDL_CTRL);
-        ddlctrl &= ~(3<<16); // set MUX to 0
-        m_link->setDdlReg(RORC_REG_DDL_CTRL, ddlctrl);
+        m_link->modifyDdlReg(RORC_REG_DDL_CTRL, (3<<16), 0); // set MUX to 0
     }
 
 
@@ -328,6 +339,7 @@ namespace LIBRARY_NAME
         uint32_t address
     )
     {
+        LIBRORC_PROFILE_SCOPE("diu");
         uint32_t timeout = LIBRORC_DIU_TIMEOUT;
         uint32_t status;
 
@@ -34,6 +34,7 @@
 #include <librorc/registers.h>
 #include <librorc/buffer.hh>
 #include <librorc/link.hh>
+#include <librorc/bar_profiler.hh>
 
 
 namespace LIBRARY_NAME
@@ -103,11 +104,10 @@ dma_channel::~dma_channel()
 void
 dma_channel::enable()
 {
-    uint32_t dmacfg = DMAConfig();
-    dmacfg |= (1<<DMACTRL_EBDM_ENABLE_BIT) |
+    uint32_t enable = (1<<DMACTRL_EBDM_ENABLE_BIT) |
         (1<<DMACTRL_RBDM_ENABLE_BIT) |
         (1<<DMACTRL_ENABLE_BIT);
-    setDMAConfig( dmacfg );
+    m_link->modifyPciReg(RORC_REG_DMA_CTRL, enable, enable);
 }
 
 uint32_t
@@ -148,10 +148,8 @@ dma_channel::setEbdmEnable
     uint32_t enable
 )
 {
-    uint32_t dmacfg = DMAConfig();
-    dmacfg &= ~(1<<DMACTRL_EBDM_ENABLE_BIT);
-    dmacfg |= ((enable&1)<<DMACTRL_EBDM_ENABLE_BIT);
-    setDMAConfig(dmacfg);
+    m_link->modifyPciReg(RORC_REG_DMA_CTRL, (1<<DMACTRL_EBDM_ENABLE_BIT),
+                         ((enable&1)<<DMACTRL_EBDM_ENABLE_BIT));
 }
 
 void
@@ -160,10 +158,8 @@ dma_channel::setRbdmEnable
     uint32_t enable
 )
 {
-    uint32_t dmacfg = DMAConfig();
-    dmacfg &= ~(1<<DMACTRL_RBDM_ENABLE_BIT);
-    dmacfg |= ((enable&1)<<DMACTRL_RBDM_ENABLE_BIT);
-    setDMAConfig(dmacfg);
+    m_link->modifyPciReg(RORC_REG_DMA_CTRL, (1<<DMACTRL_RBDM_ENABLE_BIT),
+                         ((enable&1)<<DMACTRL_RBDM_ENABLE_BIT));
 }
 
 
@@ -221,7 +217,8 @@ dma_channel::setEBOffset
 )
 {
     m_link->memcopy( RORC_REG_EBDM_SW_READ_POINTER_L, &offset, sizeof(offset) );
-    setDMAConfig( DMAConfig() | (1<<DMACTRL_SYNC_SWRDPTRS_BIT) );
+    m_link->modifyPciReg(RORC_REG_DMA_CTRL, (1<<DMACTRL_SYNC_SWRDPTRS_BIT),
+                         (1<<DMACTRL_SYNC_SWRDPTRS_BIT));
     m_last_ebdm_offset = offset;
 }
 
@@ -259,7 +256,8 @@ dma_channel::setRBOffset
 )
 {
     m_link->memcopy( RORC_REG_RBDM_SW_READ_POINTER_L, &offset, sizeof(offset) );
-    setDMAConfig( DMAConfig() | (1<<DMACTRL_SYNC_SWRDPTRS_BIT) );
+    m_link->modifyPciReg(RORC_REG_DMA_CTRL, (1<<DMACTRL_SYNC_SWRDPTRS_BIT),
+                         (1<<DMACTRL_SYNC_SWRDPTRS_BIT));
     m_last_rbdm_offset = offset;
 }
 
@@ -310,26 +308,29 @@ dma_channel::configure
     uint32_t pcie_packet_size
 )
 {
-    int result;
     if( eventBuffer==NULL || reportBuffer==NULL )
     { return ENODEV; }
 
-    if( esDir == kEventStreamToHost )
-    {
-        result = configureBufferDescriptorRam(eventBuffer, 0);
-        if( result != 0 )
-        { return result; }
-    }
-    else
-    { m_outFifoDepth = outFifoDepth(); }
-
-    result = configureBufferDescriptorRam(reportBuffer, 1);
-    if( result != 0 )
-    { return result; }
+    return configure(eventBuffer->sgList(), eventBuffer->getPhysicalSize(),
+                     eventBuffer->getnSGEntries(), reportBuffer->sgList(),
+                     reportBuffer->getPhysicalSize(),
+                     reportBuffer->getnSGEntries(), esDir, pcie_packet_size);
+}
 
-    configureDmaChannelRegisters(eventBuffer, reportBuffer, pcie_packet_size);
 
-    return 0;
+int
+dma_channel::configure
+(
+    std::vector<ScatterGatherEntry> ebList,
+    uint64_t ebSize,
+    std::vector<ScatterGatherEntry> rbList,
+    uint64_t rbSize,
+    EventStreamDirection esDir,
+    uint32_t pcie_packet_size
+)
+{
+    return configure(ebList, ebSize, ebList.size(), rbList, rbSize,
+                     rbList.size(), esDir, pcie_packet_size);
 }
 
 
@@ -375,11 +376,8 @@ dma_channel::setSuspend
     uint32_t value
 )
 {
-    uint32_t dmacfg = DMAConfig();
-    // clear suspend bit and set new value
-    dmacfg &= ~(1<<DMACTRL_SUSPEND_BIT);
-    dmacfg |= ( (value&1)<<DMACTRL_SUSPEND_BIT);
-    setDMAConfig(dmacfg);
+    m_link->modifyPciReg(RORC_REG_DMA_CTRL, (1<<DMACTRL_SUSPEND_BIT),
+                         ((value&1)<<DMACTRL_SUSPEND_BIT));
 }
 
 
@@ -526,10 +524,45 @@ dma_channel::prepareSgList
 }
 
 
+int
+dma_channel::configure
+(
+    std::vector<ScatterGatherEntry> ebList,
+    uint64_t ebSize,
+    uint32_t ebEntries,
+    std::vector<ScatterGatherEntry> rbList,
+    uint64_t rbSize,
+    uint32_t rbEntries,
+    EventStreamDirection esDir,
+    uint32_t pcie_packet_size
+)
+{
+    LIBRORC_PROFILE_SCOPE("dma_channel::configure");
+    int result;
+    if( esDir == kEventStreamToHost )
+    {
+        result = configureBufferDescriptorRam(ebList, 0);
+        if( result != 0 )
+        { return result; }
+    }
+    else
+    { m_outFifoDepth = outFifoDepth(); }
+
+    result = configureBufferDescriptorRam(rbList, 1);
+    if( result != 0 )
+    { return result; }
+
+    configureDmaChannelRegisters(ebSize, ebEntries, rbSize, rbEntries,
+                                 pcie_packet_size);
+
+    return 0;
+}
+
+
 int
 dma_channel::configureBufferDescriptorRam
 (
-    buffer *buf,
+    std::vector<ScatterGatherEntry> list,
     uint32_t target_ram
 )
 {
@@ -538,8 +571,8 @@ dma_channel::configureBufferDescriptorRam
     uint32_t max_num_sg =
         (target_ram) ? getRBDMMaxSgEntries() : getEBDMMaxSgEntries();
 
-    // get scatter gather list from PDA and prepare it for the DMA channel
-    std::vector<ScatterGatherEntry> sglist = prepareSgList(buf->sgList());
+    // prepare scatter gather list for the DMA channel
+    std::vector<ScatterGatherEntry> sglist = prepareSgList(list);
 
     // make sure scatter gather list fits into RAM
     if(sglist.size() >= max_num_sg )
@@ -570,21 +603,21 @@ dma_channel::configureBufferDescriptorRam
 void
 dma_channel::configureDmaChannelRegisters
 (
-    buffer *eventBuffer,
-    buffer *reportBuffer,
+    uint64_t eb_size,
+    uint32_t eb_entries,
+    uint64_t rb_size,
+    uint32_t rb_entries,
     uint32_t pcie_packet_size
 )
 {
-    uint64_t eb_size = eventBuffer->getPhysicalSize();
-    uint64_t rb_size = reportBuffer->getPhysicalSize();
     uint64_t ebrdptr = eb_size - pcie_packet_size;
     uint64_t rbrdptr = rb_size - sizeof(EventDescriptor);
 
     DmaChannelConfigRegisters chcfg;
-    chcfg.ebdm_n_sg_config      = eventBuffer->getnSGEntries();
+    chcfg.ebdm_n_sg_config      = eb_entries;
     chcfg.ebdm_buffer_size_low  = (eb_size & 0xffffffff);
     chcfg.ebdm_buffer_size_high = (eb_size >> 32);
-    chcfg.rbdm_n_sg_config      = reportBuffer->getnSGEntries();
+    chcfg.rbdm_n_sg_config      = rb_entries;
     chcfg.rbdm_buffer_size_low  = (rb_size & 0xffffffff);
     chcfg.rbdm_buffer_size_high = (rb_size >> 32);
     chcfg.swptrs.ebdm_sw_read_pointer_low  = (ebrdptr & 0xffffffff);
@@ -593,9 +626,18 @@ dma_channel::configureDmaChannelRegisters
     chcfg.swptrs.rbdm_sw_read_pointer_high = (rbrdptr >> 32);
     uint32_t dma_ctrl = (1<<DMACTRL_SYNC_SWRDPTRS_BIT) | m_pci_tag;
 
-    m_link->memcopy( RORC_REG_EBDM_N_SG_CONFIG, &chcfg, sizeof(chcfg) );
-    setDMAConfig(dma_ctrl);
-    setPciePacketSize(pcie_packet_size);
+    /**
+     * DMA_CTRL latches the read pointers with SYNC_SWRDPTRS, so it is
+     * only written once chcfg has reached the device
+     **/
+    bar::transaction t(m_link->getBar());
+    t.memcopy( m_link->pciAddress(RORC_REG_EBDM_N_SG_CONFIG), &chcfg,
+               sizeof(chcfg) );
+    m_link->apply(t);
+    t.set32( m_link->pciAddress(RORC_REG_DMA_CTRL), dma_ctrl );
+    t.set32( m_link->pciAddress(RORC_REG_DMA_PKT_SIZE),
+             ((pcie_packet_size >> 2) & 0x3ff) );
+    m_link->apply(t);
     m_last_rbdm_offset = rbrdptr;
     m_last_ebdm_offset = ebrdptr;
 }
@@ -656,7 +698,7 @@ dma_channel::fifoUnderrun()
 void
 dma_channel::clearFifoUnderrunFlag()
 {
-    setDMAConfig(DMAConfig() | (1<<13));
+    m_link->modifyPciReg(RORC_REG_DMA_CTRL, (1<<13), (1<<13));
 }
 
 }
@@ -53,6 +53,9 @@ const errmsg_t table[] = {
 
     /** bar **/
     {LIBRORC_BAR_ERROR_CONSTRUCTOR_FAILED, "failed to get bar mapping"},
+    {LIBRORC_BAR_ERROR_TRACE_OPEN_FAILED, "failed to open register trace file"},
+    {LIBRORC_BAR_ERROR_TRACE_INVALID, "invalid register trace file"},
+    {LIBRORC_BAR_ERROR_REPLAY_MISMATCH, "register access does not match trace"},
 
     /** event_stream **/
     {LIBRORC_EVENT_STREAM_ERROR_CHANNEL_NOT_AVAIL, "Requested channel not available in FW"},
@@ -74,10 +77,19 @@ const errmsg_t table[] = {
     {LIBRORC_SYSMON_ERROR_I2C_INVALID_PARAM, "invalid I2C chain selected"},
     {LIBRORC_SYSMON_ERROR_DATA_REPLAY_TIMEOUT, "data replay timeout"},
     {LIBRORC_SYSMON_ERROR_DATA_REPLAY_INVALID, "invalid replay channel selected"},
+    {LIBRORC_SYSMON_ERROR_I2C_LOCK_TIMEOUT, "timeout waiting for I2C lock"},
+    {LIBRORC_SYSMON_ERROR_I2C_LOCK_FAILED, "failed to get I2C lock"},
 
     /** refclk **/
     {LIBRORC_REFCLK_ERROR_CONSTRUCTOR_FAILED, "parent sysmon not initialized"},
     {LIBRORC_REFCLK_ERROR_INVALID_PARAMETER, "failed to find config for requested clock frequencies"},
+
+    /** telemetry **/
+    {LIBRORC_TELEMETRY_ERROR_CONSTRUCTOR_FAILED, "parent sysmon not initialized"},
+    {LIBRORC_TELEMETRY_ERROR_SHM_GET_FAILED, "failed to get SysV SHM for telemetry ring"},
+    {LIBRORC_TELEMETRY_ERROR_SHM_ATTACH_FAILED, "failed to attach to SysV SHM for telemetry ring"},
+    {LIBRORC_TELEMETRY_ERROR_INVALID_RING, "telemetry ring not initialized or incompatible"},
+    {LIBRORC_TELEMETRY_ERROR_WRITER_ACTIVE, "another sampler is writing the telemetry ring"},
 };
 
 const ssize_t table_len = sizeof(table) / sizeof(errmsg_t);
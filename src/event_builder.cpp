@@ -0,0 +1,434 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <time.h>
+#include <unistd.h>
+
+#include <librorc/event_builder.hh>
+#include <librorc/event_stream.hh>
+#include <librorc/cdh.hh>
+
+namespace LIBRARY_NAME
+{
+    static uint64_t
+    monotonicNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+
+
+    /** the event ID words are the same in all CDH versions */
+    static inline uint64_t
+    fragmentEventId
+    (
+        EventDescriptor *report,
+        const uint32_t  *event
+    )
+    {
+        if( (report->calc_event_size & 0x3fffffff) < 3 )
+        { return LIBRORC_EVENT_BUILDER_INVALID_ID; }
+        return cdh_v2(event).eventId();
+    }
+
+
+    /** event_fragment_source on top of an event stream, not owned */
+    class event_stream_source : public event_fragment_source
+    {
+        public:
+            event_stream_source( event_stream *stream )
+            { m_stream = stream; }
+
+            bool
+            fetchFragment
+            (
+                EventDescriptor **report,
+                const uint32_t  **event,
+                uint64_t         *reference
+            )
+            {
+                if( !m_stream->getNextEvent(report, event, reference) )
+                { return false; }
+                m_stream->updateChannelStatus(*report);
+                return true;
+            }
+
+            int releaseFragment( uint64_t reference )
+            { return m_stream->releaseEvent(reference); }
+
+        protected:
+            event_stream *m_stream;
+    };
+
+
+    event_builder::event_builder()
+    {
+        m_all_sources = 0;
+        m_window = LIBRORC_EVENT_BUILDER_WINDOW;
+        m_timeout_ns = (uint64_t)LIBRORC_EVENT_BUILDER_TIMEOUT_US * 1000;
+        m_stop = false;
+        m_running = false;
+        m_complete = 0;
+        m_incomplete = 0;
+        m_fragments = 0;
+    }
+
+
+
+    event_builder::~event_builder()
+    {
+        /** sources are only deleted once no reader thread uses them */
+        stop();
+        for( size_t i=0; i<m_sources.size(); i++ )
+        {
+            delete m_sources[i].fragments;
+            delete m_sources[i].queue;
+        }
+        for( size_t i=0; i<m_pending.size(); i++ )
+        { delete m_pending[i]; }
+        for( size_t i=0; i<m_ready.size(); i++ )
+        { delete m_ready[i]; }
+        for( size_t i=0; i<m_free.size(); i++ )
+        { delete m_free[i]; }
+    }
+
+
+
+    int32_t
+    event_builder::addStream
+    (
+        event_stream *stream
+    )
+    {
+        if( stream == NULL )
+        { return -1; }
+        event_stream_source *source = new event_stream_source(stream);
+        int32_t index = addSource(source);
+        if( index < 0 )
+        { delete source; }
+        return index;
+    }
+
+
+
+    int32_t
+    event_builder::addSource
+    (
+        event_fragment_source *fragments
+    )
+    {
+        if( fragments == NULL || m_running ||
+            m_sources.size() >= LIBRORC_EVENT_BUILDER_MAX_SOURCES )
+        { return -1; }
+
+        source src;
+        src.builder = this;
+        src.index = m_sources.size();
+        src.fragments = fragments;
+        src.queue = new event_fragment_queue;
+        src.queue->head = 0;
+        src.queue->tail = 0;
+        m_sources.push_back(src);
+        m_all_sources |= ((uint64_t)1 << src.index);
+        return src.index;
+    }
+
+
+
+    void
+    event_builder::setReorderWindow
+    (
+        uint32_t events
+    )
+    { m_window = (events > 0) ? events : 1; }
+
+
+
+    void
+    event_builder::setTimeout
+    (
+        uint64_t timeout_us
+    )
+    { m_timeout_ns = timeout_us * 1000; }
+
+
+
+    int
+    event_builder::start()
+    {
+        if( m_running || m_sources.empty() )
+        { return -1; }
+
+        m_stop = false;
+        for( size_t i=0; i<m_sources.size(); i++ )
+        {
+            if( pthread_create(&m_sources[i].thread, NULL, readerThread,
+                               &m_sources[i]) != 0 )
+            {
+                m_stop = true;
+                for( size_t j=0; j<i; j++ )
+                { pthread_join(m_sources[j].thread, NULL); }
+                return -1;
+            }
+        }
+        m_running = true;
+        return 0;
+    }
+
+
+
+    void
+    event_builder::stop()
+    {
+        if( !m_running )
+        { return; }
+        m_stop = true;
+        for( size_t i=0; i<m_sources.size(); i++ )
+        { pthread_join(m_sources[i].thread, NULL); }
+        m_running = false;
+    }
+
+
+
+    bool
+    event_builder::getNextEvent
+    (
+        built_event **event
+    )
+    {
+        collect();
+        if( m_ready.empty() )
+        { return false; }
+        *event = m_ready.front();
+        m_ready.pop_front();
+        return true;
+    }
+
+
+
+    int
+    event_builder::releaseEvent
+    (
+        built_event *event
+    )
+    {
+        int result = 0;
+        for( uint32_t i=0; i<m_sources.size(); i++ )
+        {
+            if( (event->sources >> i) & 1 )
+            {
+                if( m_sources[i].fragments->releaseFragment(
+                        event->fragment[i].reference) < 0 )
+                { result = -1; }
+            }
+        }
+        event->sources = 0;
+        m_free.push_back(event);
+        return result;
+    }
+
+
+
+    void
+    event_builder::flush()
+    {
+        collect();
+        while( !m_pending.empty() )
+        { emit(0); }
+    }
+
+
+
+    /**********************************************************
+     *                  protected
+     * *******************************************************/
+    void *
+    event_builder::readerThread
+    (
+        void *arg
+    )
+    {
+        source *src = (source *)arg;
+        src->builder->readSource(src);
+        return NULL;
+    }
+
+
+
+    void
+    event_builder::readSource
+    (
+        source *src
+    )
+    {
+        event_fragment_queue *queue = src->queue;
+        while( !m_stop )
+        {
+            uint64_t head = queue->head;
+            if( head - queue->tail >= LIBRORC_EVENT_BUILDER_QUEUE_DEPTH )
+            {
+                /** builder is behind, leave the events in the DMA buffer */
+                usleep(LIBRORC_EVENT_BUILDER_POLL_US);
+                continue;
+            }
+
+            event_fragment *fragment =
+                &queue->slot[head & (LIBRORC_EVENT_BUILDER_QUEUE_DEPTH-1)];
+            if( !src->fragments->fetchFragment(&fragment->report,
+                    &fragment->event, &fragment->reference) )
+            {
+                usleep(LIBRORC_EVENT_BUILDER_POLL_US);
+                continue;
+            }
+            fragment->event_id =
+                fragmentEventId(fragment->report, fragment->event);
+
+            /** publish the slot before moving head */
+            __sync_synchronize();
+            queue->head = head + 1;
+        }
+    }
+
+
+
+    void
+    event_builder::collect()
+    {
+        uint64_t now = monotonicNs();
+        for( uint32_t i=0; i<m_sources.size(); i++ )
+        {
+            event_fragment_queue *queue = m_sources[i].queue;
+            uint64_t tail = queue->tail;
+            uint64_t head = queue->head;
+            __sync_synchronize();
+            for( ; tail!=head; tail++ )
+            {
+                if( !insert(i, &queue->slot[tail &
+                            (LIBRORC_EVENT_BUILDER_QUEUE_DEPTH-1)], now) )
+                { break; }
+            }
+            /** slots are consumed before handing them back */
+            __sync_synchronize();
+            queue->tail = tail;
+        }
+
+        /** m_pending is ordered by arrival */
+        while( !m_pending.empty() &&
+               now - m_pending[0]->first_ns >= m_timeout_ns )
+        { emit(0); }
+    }
+
+
+
+    bool
+    event_builder::insert
+    (
+        uint32_t              index,
+        const event_fragment *fragment,
+        uint64_t              now
+    )
+    {
+        uint64_t bit = ((uint64_t)1 << index);
+        built_event *event = NULL;
+        if( fragment->event_id != LIBRORC_EVENT_BUILDER_INVALID_ID )
+        {
+            for( uint32_t p=0; p<m_pending.size(); p++ )
+            {
+                if( m_pending[p]->event_id != fragment->event_id )
+                { continue; }
+                if( m_pending[p]->sources & bit )
+                {
+                    /** same ID again from this source, e.g. after a wrap */
+                    emit(p);
+                    break;
+                }
+                event = m_pending[p];
+                break;
+            }
+        }
+
+        if( event == NULL )
+        {
+            /** window full: keep the fragment queued, this source is
+             *  ahead of the others */
+            if( m_pending.size() >= m_window )
+            { return false; }
+
+            if( m_free.empty() )
+            { event = new built_event; }
+            else
+            {
+                event = m_free.back();
+                m_free.pop_back();
+            }
+            event->event_id = fragment->event_id;
+            event->sources = 0;
+            event->first_ns = now;
+            m_pending.push_back(event);
+        }
+
+        event->fragment[index] = *fragment;
+        event->sources |= bit;
+        m_fragments++;
+
+        if( event->sources == m_all_sources ||
+            fragment->event_id == LIBRORC_EVENT_BUILDER_INVALID_ID )
+        {
+            for( uint32_t p=m_pending.size(); p>0; p-- )
+            {
+                if( m_pending[p-1] == event )
+                {
+                    emit(p-1);
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+
+
+    void
+    event_builder::emit
+    (
+        uint32_t pending_index
+    )
+    {
+        built_event *event = m_pending[pending_index];
+        m_pending.erase(m_pending.begin() + pending_index);
+        event->complete = (event->sources == m_all_sources);
+        if( event->complete )
+        { m_complete++; }
+        else
+        { m_incomplete++; }
+        m_ready.push_back(event);
+    }
+
+}
@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc/event_index.hh>
+
+namespace LIBRARY_NAME
+{
+    event_index::event_index
+    (
+        uint32_t entries
+    )
+    {
+        uint32_t size = 1;
+        while( size < entries )
+        { size <<= 1; }
+        m_entries.resize(size);
+        m_mask = size - 1;
+        m_count = 0;
+    }
+
+
+
+    event_index::~event_index()
+    {}
+
+
+
+    const event_index_entry *
+    event_index::add
+    (
+        uint64_t               reference,
+        const EventDescriptor *report,
+        const uint32_t        *event
+    )
+    {
+        event_index_entry *entry = &m_entries[m_count & m_mask];
+        uint32_t size = report->calc_event_size & 0x3fffffff;
+        entry->reference = reference;
+        entry->size = size;
+
+        cdh_fields cdh;
+        if( cdhDecode(event, size, &cdh) == 0 )
+        {
+            entry->event_id = cdh.event_id;
+            entry->trigger_classes_low = cdh.trigger_classes_low;
+            entry->trigger_classes_high = cdh.trigger_classes_high;
+            entry->status = cdh.status;
+            entry->subdetectors = cdh.subdetectors;
+            entry->version = cdh.version;
+        }
+        else
+        {
+            entry->event_id = 0;
+            entry->trigger_classes_low = 0;
+            entry->trigger_classes_high = 0;
+            entry->status = 0;
+            entry->subdetectors = 0;
+            entry->version = 0;
+        }
+        m_count++;
+        return entry;
+    }
+
+
+
+    const event_index_entry *
+    event_index::recent
+    (
+        uint32_t age
+    )
+    {
+        if( age >= m_count || age > m_mask )
+        { return NULL; }
+        return &m_entries[(m_count - 1 - age) & m_mask];
+    }
+
+
+
+    const event_index_entry *
+    event_index::findReference
+    (
+        uint64_t reference
+    )
+    {
+        const event_index_entry *entry;
+        for( uint32_t age=0; (entry = recent(age)) != NULL; age++ )
+        {
+            if( entry->reference == reference )
+            { return entry; }
+        }
+        return NULL;
+    }
+
+
+
+    const event_index_entry *
+    event_index::findEventId
+    (
+        uint64_t event_id
+    )
+    {
+        const event_index_entry *entry;
+        for( uint32_t age=0; (entry = recent(age)) != NULL; age++ )
+        {
+            if( entry->version && entry->event_id == event_id )
+            { return entry; }
+        }
+        return NULL;
+    }
+
+
+
+    uint32_t
+    event_index::selectTriggerClasses
+    (
+        uint64_t               mask_low,
+        uint64_t               mask_high,
+        std::vector<uint64_t> *references
+    )
+    {
+        uint32_t matches = 0;
+        uint64_t available = (m_count > m_mask) ? m_mask + 1 : m_count;
+        for( uint64_t i=m_count-available; i<m_count; i++ )
+        {
+            const event_index_entry *entry = &m_entries[i & m_mask];
+            if( (entry->trigger_classes_low & mask_low) |
+                (entry->trigger_classes_high & mask_high) )
+            {
+                references->push_back(entry->reference);
+                matches++;
+            }
+        }
+        return matches;
+    }
+
+
+
+    void
+    event_index::clear()
+    { m_count = 0; }
+
+}
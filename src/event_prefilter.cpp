@@ -0,0 +1,153 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <cstring>
+
+#include <librorc/event_prefilter.hh>
+
+namespace LIBRARY_NAME
+{
+    event_prefilter::event_prefilter()
+    {
+        m_nrules = 0;
+        m_accept_unknown = true;
+        clearStats();
+    }
+
+
+
+    event_prefilter::~event_prefilter()
+    {}
+
+
+
+    int32_t
+    event_prefilter::addRule
+    (
+        const event_prefilter_rule *rule
+    )
+    {
+        if( m_nrules >= LIBRORC_PREFILTER_MAX_RULES )
+        { return -1; }
+        m_rules[m_nrules] = *rule;
+        m_rules[m_nrules].id_value &= rule->id_mask;
+        m_any_empty[m_nrules] = ((rule->any_low | rule->any_high) == 0);
+        return m_nrules++;
+    }
+
+
+
+    void
+    event_prefilter::clearRules()
+    { m_nrules = 0; }
+
+
+
+    bool
+    event_prefilter::match
+    (
+        const cdh_fields *cdh
+    ) const
+    {
+        uint64_t tcl = cdh->trigger_classes_low;
+        uint64_t tch = cdh->trigger_classes_high;
+        uint64_t accepted = 0;
+
+        /** comparisons yield 0/1, combined with bitwise ops only */
+        for( uint32_t i=0; i<m_nrules; i++ )
+        {
+            const event_prefilter_rule *r = &m_rules[i];
+            uint64_t any = (((tcl & r->any_low) | (tch & r->any_high)) != 0) |
+                m_any_empty[i];
+            uint64_t all = (((tcl & r->all_low) ^ r->all_low) |
+                            ((tch & r->all_high) ^ r->all_high)) == 0;
+            uint64_t none = ((tcl & r->none_low) | (tch & r->none_high)) == 0;
+            uint64_t id = ((cdh->event_id & r->id_mask) ^ r->id_value) == 0;
+            uint64_t status = (cdh->status & r->status_reject) == 0;
+            accepted |= any & all & none & id & status;
+        }
+        return accepted != 0;
+    }
+
+
+
+    bool
+    event_prefilter::accept
+    (
+        const EventDescriptor *report,
+        const uint32_t        *event
+    )
+    {
+        uint32_t size = report->calc_event_size & 0x3fffffff;
+        cdh_fields cdh;
+        bool accepted;
+        if( cdhDecode(event, size, &cdh) == 0 )
+        { accepted = match(&cdh); }
+        else
+        {
+            m_stats.no_cdh++;
+            accepted = m_accept_unknown;
+        }
+
+        if( accepted )
+        {
+            m_stats.accepted++;
+            m_stats.accepted_bytes += (uint64_t)size << 2;
+        }
+        else
+        {
+            m_stats.rejected++;
+            m_stats.rejected_bytes += (uint64_t)size << 2;
+        }
+        return accepted;
+    }
+
+
+
+    void
+    event_prefilter::clearStats()
+    { memset(&m_stats, 0, sizeof(m_stats)); }
+
+
+
+    void
+    event_prefilter::setClass
+    (
+        uint64_t *low,
+        uint64_t *high,
+        uint32_t  n
+    )
+    {
+        if( n < 64 )
+        { *low |= ((uint64_t)1 << n); }
+        else
+        { *high |= ((uint64_t)1 << (n - 64)); }
+    }
+
+}
@@ -48,6 +48,8 @@
 
 #include <librorc/fastclusterfinder.hh>
 #include <librorc/diu.hh>
+#include <librorc/event_index.hh>
+#include <librorc/event_prefilter.hh>
 #include <librorc/ddl.hh>
 #include <librorc/siu.hh>
 #include <librorc/patterngenerator.hh>
@@ -101,6 +103,8 @@ int event_stream::initializeDma(uint64_t bufferId, uint64_t bufferSize) {
 }
 
 void event_stream::initMembers() {
+  m_event_index = NULL;
+  m_prefilter = NULL;
   m_raw_event_buffer = NULL;
   m_eventBuffer = NULL;
   m_reportBuffer = NULL;
@@ -184,6 +188,10 @@ void event_stream::deleteParts() {
   if (m_release_map) {
     delete[] m_release_map;
   }
+  if (m_event_index) {
+    delete m_event_index;
+    m_event_index = NULL;
+  }
   if (!m_called_with_bar) {
     if (m_bar1) {
       delete m_bar1;
@@ -348,27 +356,53 @@ bool event_stream::getNextEvent(EventDescriptor **report,
                                 const uint32_t **event, uint64_t *reference) {
   pthread_mutex_lock(&m_getEventEnable);
 
-  uint64_t tmp_index = 0;
-  if (m_receive_index == EVENT_INDEX_UNDEFINED) {
-    tmp_index = 0;
-  } else {
-    tmp_index = (m_receive_index < m_max_rb_entries - 1) ? (m_receive_index + 1) : 0;
-  }
+  while (true) {
+    uint64_t tmp_index = 0;
+    if (m_receive_index == EVENT_INDEX_UNDEFINED) {
+      tmp_index = 0;
+    } else {
+      tmp_index = (m_receive_index < m_max_rb_entries - 1) ? (m_receive_index + 1) : 0;
+    }
+
+    if (m_reports[tmp_index].reported_event_size == 0) {
+      pthread_mutex_unlock(&m_getEventEnable);
+      return false;
+    }
 
-  if (m_reports[tmp_index].reported_event_size == 0) {
-    pthread_mutex_unlock(&m_getEventEnable);
-    return false;
+    m_receive_index = tmp_index;
+    *reference = m_receive_index;
+    *report = &m_reports[m_receive_index];
+    *event = getRawEvent(**report);
+    m_channel_status->receive_offset = m_reports[tmp_index].offset;
+
+    if (m_prefilter && !m_prefilter->accept(*report, *event)) {
+      updateChannelStatus(*report);
+      releaseEvent(*reference);
+      continue;
+    }
+    break;
   }
 
-  m_receive_index = tmp_index;
-  *reference = m_receive_index;
-  *report = &m_reports[m_receive_index];
-  *event = getRawEvent(**report);
-  m_channel_status->receive_offset = m_reports[tmp_index].offset;
+  if (m_event_index) {
+    m_event_index->add(*reference, *report, *event);
+  }
   pthread_mutex_unlock(&m_getEventEnable);
   return true;
 }
 
+void event_stream::enableEventIndex(uint32_t entries) {
+  pthread_mutex_lock(&m_getEventEnable);
+  delete m_event_index;
+  m_event_index = (entries > 0) ? new event_index(entries) : NULL;
+  pthread_mutex_unlock(&m_getEventEnable);
+}
+
+void event_stream::setPrefilter(event_prefilter *filter) {
+  pthread_mutex_lock(&m_getEventEnable);
+  m_prefilter = filter;
+  pthread_mutex_unlock(&m_getEventEnable);
+}
+
 uint64_t event_stream::getNumberOfPendingReleases() {
   uint64_t numberOfEvents = 0;
   for (uint64_t i = 0; i < m_max_rb_entries; i++) {
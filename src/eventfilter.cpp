@@ -49,12 +49,8 @@ namespace LIBRARY_NAME
         bool filter_all
     )
     {
-        uint32_t filterctrl = m_link->ddlReg(RORC_REG_DDL_FILTER_CTRL);
-        if(filter_all)
-        { filterctrl |= (1<<31); }
-        else
-        { filterctrl &= ~(1<<31); }
-        m_link->setDdlReg(RORC_REG_DDL_FILTER_CTRL, filterctrl);
+        m_link->modifyDdlReg(RORC_REG_DDL_FILTER_CTRL, (1<<31),
+                             (filter_all) ? (1<<31) : 0);
     }
 
     bool
@@ -69,10 +65,7 @@ namespace LIBRARY_NAME
         uint32_t mask
     )
     {
-        uint32_t filterctrl = m_link->ddlReg(RORC_REG_DDL_FILTER_CTRL);
-        filterctrl &= 0xff000000;
-        filterctrl |= (mask & 0x00ffffff);
-        m_link->setDdlReg(RORC_REG_DDL_FILTER_CTRL, filterctrl);
+        m_link->modifyDdlReg(RORC_REG_DDL_FILTER_CTRL, 0x00ffffff, mask);
     }
 
     uint32_t
@@ -30,23 +30,41 @@
  **/
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <fstream>
 #include <sstream>
 #include <cassert>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 #include <librorc/fastclusterfinder.hh>
 #include <librorc/link.hh>
+#include <librorc/bar.hh>
+#include <librorc/device.hh>
+#include <librorc/hash.hh>
+#include <librorc/parallel.hh>
+#include <librorc/bar_profiler.hh>
+
+/** m_mapping_cache_device before the device of the link was looked up */
+#define MAPPING_CACHE_DEVICE_DEFAULT -2
 
 namespace LIBRARY_NAME {
-fastclusterfinder::fastclusterfinder(link *link) { m_link = link; }
+fastclusterfinder::fastclusterfinder(link *link) {
+  m_link = link;
+  m_mapping_cache = NULL;
+  m_mapping_cache_device = MAPPING_CACHE_DEVICE_DEFAULT;
+}
 
-fastclusterfinder::~fastclusterfinder() { m_link = NULL; }
+fastclusterfinder::~fastclusterfinder() {
+  if (m_mapping_cache) {
+    shmdt(m_mapping_cache);
+  }
+  m_link = NULL;
+}
 
 void fastclusterfinder::setCtrlBit(uint32_t pos, uint32_t val) {
   assert(pos < 32);
-  uint32_t fcfctrl = m_link->ddlReg(RORC_REG_FCF_CTRL);
-  fcfctrl &= ~(1 << pos);
-  fcfctrl |= ((val & 1) << pos);
-  m_link->setDdlReg(RORC_REG_FCF_CTRL, fcfctrl);
+  m_link->modifyDdlReg(RORC_REG_FCF_CTRL, (1 << pos), ((val & 1) << pos));
 }
 
 uint32_t fastclusterfinder::getCtrlBit(uint32_t pos) {
@@ -120,10 +138,8 @@ void fastclusterfinder::setSplitClusterTagging(uint32_t tag) {
 }
 
 void fastclusterfinder::setSingleSeqLimit(uint8_t singe_seq_limit) {
-  uint32_t limits = m_link->ddlReg(RORC_REG_FCF_LIMITS);
-  limits &= ~(0xff << 16);
-  limits |= ((singe_seq_limit & 0xff) << 16);
-  m_link->setDdlReg(RORC_REG_FCF_LIMITS, limits);
+  m_link->modifyDdlReg(RORC_REG_FCF_LIMITS, (0xff << 16),
+                       ((singe_seq_limit & 0xff) << 16));
 }
 
 uint8_t fastclusterfinder::singleSeqLimit() {
@@ -132,10 +148,8 @@ uint8_t fastclusterfinder::singleSeqLimit() {
 }
 
 void fastclusterfinder::setClusterLowerLimit(uint16_t cluster_low_limit) {
-  uint32_t limits = m_link->ddlReg(RORC_REG_FCF_LIMITS);
-  limits &= ~(0x0000ffff);
-  limits |= (cluster_low_limit & 0xffff);
-  m_link->setDdlReg(RORC_REG_FCF_LIMITS, limits);
+  m_link->modifyDdlReg(RORC_REG_FCF_LIMITS, 0x0000ffff,
+                       (cluster_low_limit & 0xffff));
 }
 
 uint16_t fastclusterfinder::clusterLowerLimit() {
@@ -144,10 +158,8 @@ uint16_t fastclusterfinder::clusterLowerLimit() {
 }
 
 void fastclusterfinder::setMergerDistance(uint8_t match_distance) {
-  uint32_t limits = m_link->ddlReg(RORC_REG_FCF_LIMITS);
-  limits &= ~(0x0f << 24);
-  limits |= ((match_distance & 0x0f) << 24);
-  m_link->setDdlReg(RORC_REG_FCF_LIMITS, limits);
+  m_link->modifyDdlReg(RORC_REG_FCF_LIMITS, (0x0f << 24),
+                       ((match_distance & 0x0f) << 24));
 }
 
 uint8_t fastclusterfinder::mergerDistance() {
@@ -156,10 +168,8 @@ uint8_t fastclusterfinder::mergerDistance() {
 }
 
 void fastclusterfinder::setChargeTolerance(uint8_t charge_tolerance) {
-  uint32_t limits = m_link->ddlReg(RORC_REG_FCF_LIMITS);
-  limits &= ~(0x0f << 28);
-  limits |= ((charge_tolerance & 0x0f) << 28);
-  m_link->setDdlReg(RORC_REG_FCF_LIMITS, limits);
+  m_link->modifyDdlReg(RORC_REG_FCF_LIMITS, (0x0f << 28),
+                       ((charge_tolerance & 0x0f) << 28));
 }
 
 uint8_t fastclusterfinder::chargeTolerance() {
@@ -173,18 +183,13 @@ uint8_t fastclusterfinder::errorMask() {
 }
 
 void fastclusterfinder::clearErrors() {
-  uint32_t fcfctrl = m_link->ddlReg(RORC_REG_FCF_CTRL);
-  fcfctrl |= (1 << 1);
-  m_link->setDdlReg(RORC_REG_FCF_CTRL, fcfctrl);
-  fcfctrl &= ~(1 << 1);
-  m_link->setDdlReg(RORC_REG_FCF_CTRL, fcfctrl);
+  m_link->modifyDdlReg(RORC_REG_FCF_CTRL, (1 << 1), (1 << 1));
+  m_link->modifyDdlReg(RORC_REG_FCF_CTRL, (1 << 1), 0);
 }
 
 void fastclusterfinder::setNoiseSuppression(uint8_t noise_suppresion) {
-  uint32_t fcfctrl = m_link->ddlReg(RORC_REG_FCF_LIMITS2);
-  fcfctrl &= ~(0xf << 28);
-  fcfctrl |= (noise_suppresion & 0xf) << 28;
-  m_link->setDdlReg(RORC_REG_FCF_LIMITS2, fcfctrl);
+  m_link->modifyDdlReg(RORC_REG_FCF_LIMITS2, (0xf << 28),
+                       (noise_suppresion & 0xf) << 28);
 }
 
 uint8_t fastclusterfinder::noiseSuppression() {
@@ -193,10 +198,8 @@ uint8_t fastclusterfinder::noiseSuppression() {
 }
 
 void fastclusterfinder::setNoiseSuppressionMinimum(uint8_t noise_suppresion) {
-  uint32_t fcfctrl = m_link->ddlReg(RORC_REG_FCF_LIMITS2);
-  fcfctrl &= ~(0xf << 24);
-  fcfctrl |= (noise_suppresion & 0xf) << 24;
-  m_link->setDdlReg(RORC_REG_FCF_LIMITS2, fcfctrl);
+  m_link->modifyDdlReg(RORC_REG_FCF_LIMITS2, (0xf << 24),
+                       (noise_suppresion & 0xf) << 24);
 }
 
 uint8_t fastclusterfinder::noiseSuppressionMinimum() {
@@ -205,10 +208,8 @@ uint8_t fastclusterfinder::noiseSuppressionMinimum() {
 }
 
 void fastclusterfinder::setNoiseSuppressionNeighbor(uint8_t noise_suppresion) {
-  uint32_t fcfctrl = m_link->ddlReg(RORC_REG_FCF_CTRL);
-  fcfctrl &= ~(0x3 << 18);
-  fcfctrl |= (noise_suppresion & 0x3) << 18;
-  m_link->setDdlReg(RORC_REG_FCF_CTRL, fcfctrl);
+  m_link->modifyDdlReg(RORC_REG_FCF_CTRL, (0x3 << 18),
+                       (noise_suppresion & 0x3) << 18);
 }
 
 uint8_t fastclusterfinder::noiseSuppressionNeighbor() {
@@ -217,10 +218,7 @@ uint8_t fastclusterfinder::noiseSuppressionNeighbor() {
 }
 
 void fastclusterfinder::setClusterQmaxLowerLimit(uint16_t limit) {
-  uint32_t regval = m_link->ddlReg(RORC_REG_FCF_LIMITS2);
-  regval &= ~(0x7ff);
-  regval |= (limit & 0x7ff);
-  m_link->setDdlReg(RORC_REG_FCF_LIMITS2, regval);
+  m_link->modifyDdlReg(RORC_REG_FCF_LIMITS2, 0x7ff, (limit & 0x7ff));
 }
 
 uint16_t fastclusterfinder::clusterQmaxLowerLimit() {
@@ -244,10 +242,35 @@ uint32_t fastclusterfinder::tagDeconvolutedClusters() {
 }
 
 void fastclusterfinder::setTagDeconvolutedClusters(uint32_t tag) {
-  uint32_t regval = m_link->ddlReg(RORC_REG_FCF_CTRL);
-  regval &= ~(3 << 16);
-  regval |= (tag & 3) << 16;
-  m_link->setDdlReg(RORC_REG_FCF_CTRL, regval);
+  m_link->modifyDdlReg(RORC_REG_FCF_CTRL, (3 << 16), (tag & 3) << 16);
+}
+
+void fastclusterfinder::setParameters(const fcf_parameters *params) {
+  LIBRORC_PROFILE_SCOPE("fcf");
+  uint32_t ctrl_mask = (1 << 2) | (1 << 3) | (1 << 4) | (1 << 5) |
+                       (3 << 16) | (3 << 18) | (1 << 20) | (1 << 21);
+  uint32_t ctrl = ((params->single_pad_suppression & 1) << 2) |
+                  ((params->bypass_merger & 1) << 3) |
+                  ((params->deconv_pad & 1) << 4) |
+                  ((params->merger_algorithm & 1) << 5) |
+                  ((params->tag_deconvoluted_clusters & 3) << 16) |
+                  ((params->noise_suppression_neighbor & 3) << 18) |
+                  ((params->tag_border_clusters & 1) << 20) |
+                  ((params->correct_edge_clusters & 1) << 21);
+  uint32_t limits = (params->cluster_lower_limit & 0xffff) |
+                    ((params->single_seq_limit & 0xff) << 16) |
+                    ((params->merger_distance & 0x0f) << 24) |
+                    ((params->charge_tolerance & 0x0f) << 28);
+  uint32_t limits2_mask = (0xf << 28) | (0xf << 24) | 0x7ff;
+  uint32_t limits2 = ((params->noise_suppression & 0xf) << 28) |
+                     ((params->noise_suppression_minimum & 0xf) << 24) |
+                     (params->cluster_qmax_lower_limit & 0x7ff);
+
+  bar::transaction t(m_link->getBar());
+  t.set32(m_link->ddlAddress(RORC_REG_FCF_LIMITS), limits);
+  t.modify32(m_link->ddlAddress(RORC_REG_FCF_CTRL), ctrl_mask, ctrl);
+  t.modify32(m_link->ddlAddress(RORC_REG_FCF_LIMITS2), limits2_mask, limits2);
+  m_link->apply(t);
 }
 
 /****************************************************
@@ -256,12 +279,251 @@ void fastclusterfinder::setTagDeconvolutedClusters(uint32_t tag) {
 
 /** see header file for 'data' bit mapping */
 void fastclusterfinder::writeMappingRamEntry(uint32_t addr, uint32_t data) {
+  LIBRORC_PROFILE_SCOPE("fcf");
+  volatile uint64_t *cached = mappingCacheSlot();
+  if (cached) {
+    *cached = 0;
+  }
   m_link->setDdlReg(RORC_REG_FCF_RAM_DATA, data);
   m_link->setDdlReg(RORC_REG_FCF_RAM_CTRL, (addr | (1 << 31)));
 }
 
 uint32_t fastclusterfinder::readMappingRamEntry(uint32_t addr) {
+  LIBRORC_PROFILE_SCOPE("fcf");
   m_link->setDdlReg(RORC_REG_FCF_RAM_CTRL, addr);
   return m_link->ddlReg(RORC_REG_FCF_RAM_DATA);
 }
+
+int fastclusterfinder::loadMappingRam(const uint32_t *table, uint32_t entries,
+                                      uint32_t verify, bool force) {
+  LIBRORC_PROFILE_SCOPE("fcf");
+  if (entries == 0 || entries > LIBRORC_FCF_MAPPING_RAM_SIZE) {
+    return -1;
+  }
+
+  uint64_t hash = mappingHash(table, entries);
+  volatile uint64_t *cached = mappingCacheSlot();
+  /** the sampled readback catches a RAM cleared by FPGA reconfiguration */
+  if (!force && cached && *cached == hash &&
+      verifyMappingRam(table, entries, LIBRORC_FCF_VERIFY_SAMPLE) == 0) {
+    return LIBRORC_FCF_MAPPING_UNCHANGED;
+  }
+  if (cached) {
+    *cached = 0;
+  }
+
+  /** each DATA/CTRL pair as two single posted writes, the write enable
+   *  in CTRL must reach the RAM exactly once and after its DATA */
+  bar *b = m_link->getBar();
+  bar_address data_addr = m_link->ddlAddress(RORC_REG_FCF_RAM_DATA);
+  bar_address ctrl_addr = m_link->ddlAddress(RORC_REG_FCF_RAM_CTRL);
+  for (uint32_t start = 0; start < entries;
+       start += LIBRORC_FCF_MAPPING_BURST) {
+    uint32_t end = start + LIBRORC_FCF_MAPPING_BURST;
+    if (end > entries) {
+      end = entries;
+    }
+    for (uint32_t addr = start; addr < end; addr++) {
+      uint32_t ctrl = addr | (1 << 31);
+      b->memcopyPosted(data_addr, &table[addr], sizeof(uint32_t));
+      b->memcopyPosted(ctrl_addr, &ctrl, sizeof(uint32_t));
+    }
+    b->flush(ctrl_addr);
+  }
+
+  if (verify != LIBRORC_FCF_VERIFY_NONE &&
+      verifyMappingRam(table, entries, verify) != 0) {
+    return -1;
+  }
+  if (cached) {
+    *cached = hash;
+  }
+  return 0;
+}
+
+int fastclusterfinder::loadMappingRam(const char *filename, uint32_t verify) {
+  std::vector<uint32_t> table;
+  if (readMappingFile(filename, &table) <= 0) {
+    return -1;
+  }
+  return loadMappingRam(&table[0], table.size(), verify);
+}
+
+uint32_t fastclusterfinder::verifyMappingRam(const uint32_t *table,
+                                             uint32_t entries, uint32_t mode) {
+  LIBRORC_PROFILE_SCOPE("fcf");
+  uint32_t step = 1;
+  if (mode == LIBRORC_FCF_VERIFY_SAMPLE &&
+      entries > LIBRORC_FCF_VERIFY_SAMPLES) {
+    step = entries / LIBRORC_FCF_VERIFY_SAMPLES;
+  }
+
+  uint32_t mismatches = 0;
+  for (uint32_t addr = 0; addr < entries; addr += step) {
+    if ((readMappingRamEntry(addr) ^ table[addr]) &
+        LIBRORC_FCF_MAPPING_DATA_MASK) {
+      mismatches++;
+    }
+  }
+  /** always include the last entry */
+  if ((entries - 1) % step &&
+      ((readMappingRamEntry(entries - 1) ^ table[entries - 1]) &
+       LIBRORC_FCF_MAPPING_DATA_MASK)) {
+    mismatches++;
+  }
+  return mismatches;
+}
+
+typedef struct {
+  fastclusterfinder *fcf;
+  const uint32_t *table;
+  uint32_t entries;
+  uint32_t verify;
+  int result;
+} mapping_load_args;
+
+static void *mappingLoadThread(void *arg) {
+  mapping_load_args *args = (mapping_load_args *)arg;
+  args->result =
+      args->fcf->loadMappingRam(args->table, args->entries, args->verify);
+  return NULL;
+}
+
+int fastclusterfinder::loadMappingRamParallel(
+    std::vector<fastclusterfinder *> &fcfs, const uint32_t *table,
+    uint32_t entries, uint32_t verify, std::vector<int> *results) {
+  std::vector<mapping_load_args> args(fcfs.size());
+  for (size_t i = 0; i < fcfs.size(); i++) {
+    args[i].fcf = fcfs[i];
+    args[i].table = table;
+    args[i].entries = entries;
+    args[i].verify = verify;
+    args[i].result = -1;
+  }
+
+  /** links use separate register files and BAR lock stripes */
+  runParallel(mappingLoadThread, args);
+
+  int result = 0;
+  for (size_t i = 0; i < fcfs.size(); i++) {
+    if (args[i].result < 0) {
+      result = -1;
+    }
+  }
+
+  if (results) {
+    results->resize(fcfs.size());
+    for (size_t i = 0; i < fcfs.size(); i++) {
+      (*results)[i] = args[i].result;
+    }
+  }
+  return result;
+}
+
+int32_t fastclusterfinder::readMappingFile(const char *filename,
+                                           std::vector<uint32_t> *table) {
+  FILE *fd = fopen(filename, "r");
+  if (fd == NULL) {
+    return -1;
+  }
+
+  table->clear();
+  char line[256];
+  uint32_t next = 0;
+  int32_t result = 0;
+  while (fgets(line, sizeof(line), fd)) {
+    char *comment = strchr(line, '#');
+    if (comment) {
+      *comment = 0;
+    }
+
+    char *pos = line;
+    char *end;
+    unsigned long values[2];
+    int n = 0;
+    while (n < 2) {
+      values[n] = strtoul(pos, &end, 0);
+      if (end == pos) {
+        break;
+      }
+      pos = end;
+      n++;
+    }
+    if (n == 0) {
+      continue;
+    }
+
+    uint32_t addr = (n == 2) ? values[0] : next;
+    uint32_t data = (n == 2) ? values[1] : values[0];
+    if (addr >= LIBRORC_FCF_MAPPING_RAM_SIZE) {
+      result = -1;
+      break;
+    }
+    if (table->size() <= addr) {
+      table->resize(addr + 1, 0);
+    }
+    (*table)[addr] = data;
+    next = addr + 1;
+  }
+  fclose(fd);
+  return (result < 0) ? -1 : (int32_t)table->size();
+}
+
+uint64_t fastclusterfinder::mappingHash(const uint32_t *table,
+                                        uint32_t entries) {
+  uint64_t hash = fnv1aUpdate(LIBRORC_FNV1A_INIT, &entries, sizeof(entries));
+  hash = fnv1aUpdate(hash, table, entries * sizeof(uint32_t));
+  /** 0 marks an unknown table in the cache */
+  return hash ? hash : 1;
+}
+
+void fastclusterfinder::setMappingCacheDevice(int32_t device_number) {
+  if (m_mapping_cache) {
+    shmdt(m_mapping_cache);
+    m_mapping_cache = NULL;
+  }
+  m_mapping_cache_device = (device_number < 0) ? -1 : device_number;
+}
+
+void fastclusterfinder::removeMappingCache(uint32_t device_number) {
+  int shID = shmget(LIBRORC_FCF_MAPPING_SHM_KEY_OFFSET + device_number,
+                    sizeof(fcf_mapping_cache), 0);
+  if (shID != -1) {
+    shmctl(shID, IPC_RMID, NULL);
+  }
+}
+
+volatile uint64_t *fastclusterfinder::mappingCacheSlot() {
+  if (m_mapping_cache_device == MAPPING_CACHE_DEVICE_DEFAULT) {
+    device *dev = m_link->getBar()->getDevice();
+    m_mapping_cache_device = dev ? dev->getDeviceId() : -1;
+  }
+  uint32_t link_number = m_link->linkNumber();
+  if (m_mapping_cache_device < 0 ||
+      link_number >= LIBRORC_FCF_MAPPING_CACHE_LINKS) {
+    return NULL;
+  }
+
+  if (m_mapping_cache == NULL) {
+    int shID = shmget(LIBRORC_FCF_MAPPING_SHM_KEY_OFFSET +
+                          m_mapping_cache_device,
+                      sizeof(fcf_mapping_cache), IPC_CREAT | 0666);
+    if (shID == -1) {
+      return NULL;
+    }
+    void *shm = shmat(shID, 0, 0);
+    if (shm == (void *)-1) {
+      return NULL;
+    }
+    m_mapping_cache = (fcf_mapping_cache *)shm;
+    /** new segments are zeroed, i.e. all hashes unknown */
+    if (m_mapping_cache->magic != LIBRORC_FCF_MAPPING_CACHE_MAGIC) {
+      for (uint32_t i = 0; i < LIBRORC_FCF_MAPPING_CACHE_LINKS; i++) {
+        m_mapping_cache->hash[i] = 0;
+      }
+      m_mapping_cache->magic = LIBRORC_FCF_MAPPING_CACHE_MAGIC;
+    }
+  }
+  return &m_mapping_cache->hash[link_number];
+}
 }
@@ -0,0 +1,404 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LIBRORC_FCF_AVX2
+#include <immintrin.h>
+#endif
+
+#include <librorc/fcf_decoder.hh>
+#include <librorc/cdh.hh>
+
+namespace LIBRARY_NAME
+{
+    /** fixed point scaling of charge and qmax */
+    #define FCF_FIXED_POINT_SCALE (1.0f / 64.0f)
+    #define FCF_FLAG_SHIFT 23
+    #define FCF_FLAG_BITS 0x7
+
+    static inline float
+    wordToFloat
+    (
+        uint32_t word
+    )
+    {
+        float value;
+        memcpy(&value, &word, sizeof(value));
+        return value;
+    }
+
+
+    static inline float
+    variance
+    (
+        float moment2,
+        float mean
+    )
+    {
+        float v = moment2 - mean * mean;
+        return (v > 0.0f) ? v : 0.0f;
+    }
+
+
+    fcf_clusters::fcf_clusters
+    (
+        uint32_t capacity
+    )
+    {
+        row = NULL;
+        flags = NULL;
+        pad = NULL;
+        time = NULL;
+        charge = NULL;
+        qmax = NULL;
+        sigma_pad2 = NULL;
+        sigma_time2 = NULL;
+        m_size = 0;
+        m_capacity = 0;
+        reserve(capacity);
+    }
+
+
+
+    fcf_clusters::~fcf_clusters()
+    {
+        free(row);
+        free(flags);
+        free(pad);
+        free(time);
+        free(charge);
+        free(qmax);
+        free(sigma_pad2);
+        free(sigma_time2);
+    }
+
+
+
+    /** replace an array by a larger aligned copy */
+    template<typename T>
+    static bool
+    growArray
+    (
+        T        **array,
+        uint32_t   size,
+        uint32_t   capacity
+    )
+    {
+        void *mem;
+        if( posix_memalign(&mem, 32, (size_t)capacity * sizeof(T)) != 0 )
+        { return false; }
+        if( *array )
+        { memcpy(mem, *array, (size_t)size * sizeof(T)); }
+        free(*array);
+        *array = (T *)mem;
+        return true;
+    }
+
+
+
+    int
+    fcf_clusters::reserve
+    (
+        uint32_t capacity
+    )
+    {
+        if( capacity <= m_capacity )
+        { return 0; }
+
+        /** round up to full AVX2 vectors */
+        capacity = (capacity + 7) & ~7;
+        if( !growArray(&row, m_size, capacity) ||
+            !growArray(&flags, m_size, capacity) ||
+            !growArray(&pad, m_size, capacity) ||
+            !growArray(&time, m_size, capacity) ||
+            !growArray(&charge, m_size, capacity) ||
+            !growArray(&qmax, m_size, capacity) ||
+            !growArray(&sigma_pad2, m_size, capacity) ||
+            !growArray(&sigma_time2, m_size, capacity) )
+        { return -1; }
+        m_capacity = capacity;
+        return 0;
+    }
+
+
+
+    fcf_decoder::fcf_decoder()
+    {
+        m_flag_mask = LIBRORC_FCF_FLAG_BORDER | LIBRORC_FCF_FLAG_DECONV_PAD |
+            LIBRORC_FCF_FLAG_DECONV_TIME;
+        m_simd = simdAvailable();
+    }
+
+
+
+    fcf_decoder::~fcf_decoder()
+    {}
+
+
+
+    void
+    fcf_decoder::setTagging
+    (
+        uint32_t tag_border_clusters,
+        uint32_t tag_deconvoluted_clusters
+    )
+    {
+        m_flag_mask = 0;
+        if( tag_border_clusters )
+        { m_flag_mask |= LIBRORC_FCF_FLAG_BORDER; }
+        if( tag_deconvoluted_clusters )
+        {
+            m_flag_mask |= LIBRORC_FCF_FLAG_DECONV_PAD |
+                LIBRORC_FCF_FLAG_DECONV_TIME;
+        }
+    }
+
+
+
+    void
+    fcf_decoder::setTagging
+    (
+        const fcf_parameters *params
+    )
+    {
+        setTagging(params->tag_border_clusters,
+                   params->tag_deconvoluted_clusters);
+    }
+
+
+
+    void
+    fcf_decoder::setTagging
+    (
+        fastclusterfinder *fcf
+    )
+    { setTagging(fcf->tagBorderClusters(), fcf->tagDeconvolutedClusters()); }
+
+
+
+    void
+    fcf_decoder::setSimd
+    (
+        bool enable
+    )
+    { m_simd = enable && simdAvailable(); }
+
+
+
+    bool
+    fcf_decoder::simdAvailable()
+    {
+#ifdef LIBRORC_FCF_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+
+
+
+    int32_t
+    fcf_decoder::decode
+    (
+        const uint32_t *event,
+        uint32_t        size_dw,
+        fcf_clusters   *clusters
+    )
+    {
+        uint32_t header;
+        switch( cdhVersion(event, size_dw) )
+        {
+            case LIBRORC_CDH_V2:
+                header = cdh_v2::size();
+                break;
+            case LIBRORC_CDH_V3:
+                header = cdh_v3::size();
+                break;
+            default:
+                return -1;
+        }
+        return decodeRecords(event + header, size_dw - header, clusters);
+    }
+
+
+
+    int32_t
+    fcf_decoder::decodeRecords
+    (
+        const uint32_t *words,
+        uint32_t        size_dw,
+        fcf_clusters   *clusters
+    )
+    {
+        uint32_t n = countRecords(words, size_dw);
+        if( clusters->reserve(clusters->m_size + n) < 0 )
+        { return -1; }
+
+        if( m_simd )
+        { decodeAvx2(words, n, clusters, clusters->m_size); }
+        else
+        { decodeScalar(words, n, clusters, clusters->m_size); }
+        clusters->m_size += n;
+        return n;
+    }
+
+
+
+    /**********************************************************
+     *                  protected
+     * *******************************************************/
+    uint32_t
+    fcf_decoder::countRecords
+    (
+        const uint32_t *words,
+        uint32_t        size_dw
+    )
+    {
+        uint32_t n = 0;
+        uint32_t max = size_dw / LIBRORC_FCF_CLUSTER_WORDS;
+        while( n < max &&
+               (words[n * LIBRORC_FCF_CLUSTER_WORDS] >> 30) ==
+               LIBRORC_FCF_CLUSTER_MARKER )
+        { n++; }
+        return n;
+    }
+
+
+
+    void
+    fcf_decoder::decodeScalar
+    (
+        const uint32_t *words,
+        uint32_t        n,
+        fcf_clusters   *clusters,
+        uint32_t        base
+    )
+    {
+        for( uint32_t i=0; i<n; i++ )
+        {
+            const uint32_t *w = words + i * LIBRORC_FCF_CLUSTER_WORDS;
+            uint32_t o = base + i;
+            float pad = wordToFloat(w[1]);
+            float time = wordToFloat(w[2]);
+            clusters->row[o] = (w[0] >> 24) & 0x3f;
+            clusters->charge[o] =
+                (float)(int32_t)(w[0] & 0xffffff) * FCF_FIXED_POINT_SCALE;
+            clusters->pad[o] = pad;
+            clusters->time[o] = time;
+            clusters->sigma_pad2[o] = variance(wordToFloat(w[3]), pad);
+            clusters->sigma_time2[o] = variance(wordToFloat(w[4]), time);
+            clusters->qmax[o] =
+                (float)(int32_t)(w[5] & 0x7fffff) * FCF_FIXED_POINT_SCALE;
+            clusters->flags[o] =
+                (w[5] >> FCF_FLAG_SHIFT) & FCF_FLAG_BITS & m_flag_mask;
+        }
+    }
+
+
+
+#ifdef LIBRORC_FCF_AVX2
+    __attribute__((target("avx2")))
+    static void
+    decodeAvx2Block
+    (
+        const uint32_t *words,
+        uint32_t        n,
+        uint32_t        flag_mask,
+        fcf_clusters   *clusters,
+        uint32_t        base
+    )
+    {
+        const __m256i stride = _mm256_setr_epi32(0, 6, 12, 18, 24, 30, 36, 42);
+        const __m256i row_mask = _mm256_set1_epi32(0x3f);
+        const __m256i charge_mask = _mm256_set1_epi32(0xffffff);
+        const __m256i qmax_mask = _mm256_set1_epi32(0x7fffff);
+        const __m256i flags = _mm256_set1_epi32(FCF_FLAG_BITS & flag_mask);
+        const __m256 scale = _mm256_set1_ps(FCF_FIXED_POINT_SCALE);
+        const __m256 zero = _mm256_setzero_ps();
+
+        for( uint32_t i=0; i+8<=n; i+=8 )
+        {
+            const int *w = (const int *)(words + i * LIBRORC_FCF_CLUSTER_WORDS);
+            __m256i w0 = _mm256_i32gather_epi32(w, stride, 4);
+            __m256 pad = _mm256_castsi256_ps(
+                    _mm256_i32gather_epi32(w + 1, stride, 4));
+            __m256 time = _mm256_castsi256_ps(
+                    _mm256_i32gather_epi32(w + 2, stride, 4));
+            __m256 pad2 = _mm256_castsi256_ps(
+                    _mm256_i32gather_epi32(w + 3, stride, 4));
+            __m256 time2 = _mm256_castsi256_ps(
+                    _mm256_i32gather_epi32(w + 4, stride, 4));
+            __m256i w5 = _mm256_i32gather_epi32(w + 5, stride, 4);
+
+            uint32_t o = base + i;
+            _mm256_storeu_si256((__m256i *)(clusters->row + o),
+                    _mm256_and_si256(_mm256_srli_epi32(w0, 24), row_mask));
+            _mm256_storeu_ps(clusters->charge + o, _mm256_mul_ps(
+                    _mm256_cvtepi32_ps(_mm256_and_si256(w0, charge_mask)),
+                    scale));
+            _mm256_storeu_ps(clusters->pad + o, pad);
+            _mm256_storeu_ps(clusters->time + o, time);
+            _mm256_storeu_ps(clusters->sigma_pad2 + o, _mm256_max_ps(
+                    _mm256_sub_ps(pad2, _mm256_mul_ps(pad, pad)), zero));
+            _mm256_storeu_ps(clusters->sigma_time2 + o, _mm256_max_ps(
+                    _mm256_sub_ps(time2, _mm256_mul_ps(time, time)), zero));
+            _mm256_storeu_ps(clusters->qmax + o, _mm256_mul_ps(
+                    _mm256_cvtepi32_ps(_mm256_and_si256(w5, qmax_mask)),
+                    scale));
+            _mm256_storeu_si256((__m256i *)(clusters->flags + o),
+                    _mm256_and_si256(_mm256_srli_epi32(w5, FCF_FLAG_SHIFT),
+                                     flags));
+        }
+    }
+#endif
+
+
+
+    void
+    fcf_decoder::decodeAvx2
+    (
+        const uint32_t *words,
+        uint32_t        n,
+        fcf_clusters   *clusters,
+        uint32_t        base
+    )
+    {
+        uint32_t done = 0;
+#ifdef LIBRORC_FCF_AVX2
+        done = n & ~7;
+        decodeAvx2Block(words, done, m_flag_mask, clusters, base);
+#endif
+        decodeScalar(words + done * LIBRORC_FCF_CLUSTER_WORDS, n - done,
+                     clusters, base + done);
+    }
+
+}
@@ -0,0 +1,853 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LIBRORC_FCF_AVX2
+#include <immintrin.h>
+#endif
+
+#include <librorc/fcf_software.hh>
+#include <librorc/fcf_decoder.hh>
+#include <librorc/parallel.hh>
+#include <librorc/cdh.hh>
+
+namespace LIBRARY_NAME
+{
+    /** fractional bits of charges, see fcf_decoder.hh */
+    #define FCF_CHARGE_SHIFT 6
+    #define FCF_CHARGE_MAX 0xffffff
+    #define FCF_QMAX_MAX 0x7fffff
+    #define FCF_TAG_BORDER (1<<23)
+    #define FCF_TAG_DECONV_PAD (1<<24)
+    #define FCF_TAG_DECONV_TIME (1<<25)
+    #define RCU_ADC_MASK 0x3ff
+
+    static inline uint32_t
+    floatToWord
+    (
+        float value
+    )
+    {
+        uint32_t word;
+        memcpy(&word, &value, sizeof(word));
+        return word;
+    }
+
+
+
+    static inline uint32_t
+    distance
+    (
+        uint32_t a,
+        uint32_t b
+    )
+    { return (a > b) ? (a - b) : (b - a); }
+
+
+
+    /** row and pad of a candidate, the merger processes pads in this order */
+    #define FCF_PAD_KEYS (1 << 14)
+
+    static inline uint32_t
+    padKey
+    (
+        const fcf_candidate *c
+    )
+    { return (c->row << 8) | c->pad; }
+
+
+
+    fcf_software::fcf_software()
+    {
+        memset(&m_params, 0, sizeof(m_params));
+        memset(m_mapping, 0, sizeof(m_mapping));
+        m_branch_override = 0;
+        m_simd = simdAvailable();
+    }
+
+
+
+    fcf_software::~fcf_software()
+    {}
+
+
+
+    void
+    fcf_software::setParameters
+    (
+        const fcf_parameters *params
+    )
+    {
+        /** same field widths as the hardware registers */
+        m_params.single_pad_suppression = params->single_pad_suppression & 1;
+        m_params.bypass_merger = params->bypass_merger & 1;
+        m_params.deconv_pad = params->deconv_pad & 1;
+        m_params.merger_algorithm = params->merger_algorithm & 1;
+        m_params.single_seq_limit = params->single_seq_limit & 0xff;
+        m_params.cluster_lower_limit = params->cluster_lower_limit & 0xffff;
+        m_params.merger_distance = params->merger_distance & 0xf;
+        m_params.charge_tolerance = params->charge_tolerance & 0xf;
+        m_params.noise_suppression = params->noise_suppression & 0xf;
+        m_params.noise_suppression_minimum =
+            params->noise_suppression_minimum & 0xf;
+        m_params.noise_suppression_neighbor =
+            params->noise_suppression_neighbor & 3;
+        m_params.cluster_qmax_lower_limit =
+            params->cluster_qmax_lower_limit & 0x7ff;
+        m_params.tag_border_clusters = params->tag_border_clusters & 1;
+        m_params.correct_edge_clusters = params->correct_edge_clusters & 1;
+        m_params.tag_deconvoluted_clusters =
+            params->tag_deconvoluted_clusters & 3;
+    }
+
+
+
+    void
+    fcf_software::setParameters
+    (
+        fastclusterfinder *fcf
+    )
+    {
+        fcf_parameters params;
+        params.single_pad_suppression = fcf->singlePadSuppression();
+        params.bypass_merger = fcf->bypassMerger();
+        params.deconv_pad = fcf->deconvPad();
+        params.merger_algorithm = fcf->mergerAlgorithm();
+        params.single_seq_limit = fcf->singleSeqLimit();
+        params.cluster_lower_limit = fcf->clusterLowerLimit();
+        params.merger_distance = fcf->mergerDistance();
+        params.charge_tolerance = fcf->chargeTolerance();
+        params.noise_suppression = fcf->noiseSuppression();
+        params.noise_suppression_minimum = fcf->noiseSuppressionMinimum();
+        params.noise_suppression_neighbor = fcf->noiseSuppressionNeighbor();
+        params.cluster_qmax_lower_limit = fcf->clusterQmaxLowerLimit();
+        params.tag_border_clusters = fcf->tagBorderClusters();
+        params.correct_edge_clusters = fcf->correctEdgeClusters();
+        params.tag_deconvoluted_clusters = fcf->tagDeconvolutedClusters();
+        setParameters(&params);
+        setBranchOverride(fcf->branchOverride());
+    }
+
+
+
+    void
+    fcf_software::getParameters
+    (
+        fcf_parameters *params
+    )
+    { *params = m_params; }
+
+
+
+    void
+    fcf_software::setBranchOverride
+    (
+        uint32_t ovrd
+    )
+    { m_branch_override = ovrd & 1; }
+
+
+
+    int
+    fcf_software::setMapping
+    (
+        const uint32_t *table,
+        uint32_t        entries
+    )
+    {
+        if( entries > LIBRORC_FCF_MAPPING_RAM_SIZE )
+        { return -1; }
+        memset(m_mapping, 0, sizeof(m_mapping));
+        for( uint32_t i=0; i<entries; i++ )
+        { m_mapping[i] = table[i] & LIBRORC_FCF_MAPPING_DATA_MASK; }
+        return 0;
+    }
+
+
+
+    void
+    fcf_software::setSimd
+    (
+        bool enable
+    )
+    { m_simd = enable && simdAvailable(); }
+
+
+
+    bool
+    fcf_software::simdAvailable()
+    {
+#ifdef LIBRORC_FCF_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+
+
+
+    int32_t
+    fcf_software::process
+    (
+        const uint32_t        *event,
+        uint32_t               size_dw,
+        std::vector<uint32_t> *output
+    )
+    {
+        uint32_t header;
+        switch( cdhVersion(event, size_dw) )
+        {
+            case LIBRORC_CDH_V2:
+                header = cdh_v2::size();
+                break;
+            case LIBRORC_CDH_V3:
+                header = cdh_v3::size();
+                break;
+            default:
+                return -1;
+        }
+
+        uint32_t trailer = 0;
+        if( size_dw > header &&
+            (event[size_dw - 1] >> 30) == LIBRORC_RCU_TRAILER_MARKER )
+        {
+            trailer = event[size_dw - 1] & 0x7f;
+            if( trailer == 0 || trailer > size_dw - header )
+            { return -1; }
+        }
+
+        output->assign(event, event + header);
+        int32_t n = findClusters(event + header, size_dw - header - trailer,
+                                 output);
+        output->insert(output->end(), event + size_dw - trailer,
+                       event + size_dw);
+        return n;
+    }
+
+
+
+    int32_t
+    fcf_software::findClusters
+    (
+        const uint32_t        *payload,
+        uint32_t               size_dw,
+        std::vector<uint32_t> *records
+    )
+    {
+        m_candidates.clear();
+        uint32_t i = 0;
+        while( i < size_dw )
+        {
+            uint32_t w = payload[i++];
+            /** resynchronize on the next channel header */
+            if( (w >> 30) != LIBRORC_RCU_CHANNEL_MARKER )
+            { continue; }
+
+            uint32_t n10 = (w >> 16) & RCU_ADC_MASK;
+            uint32_t n_dw = (n10 + 2) / 3;
+            if( n_dw > size_dw - i )
+            { break; }
+            if( !((w >> 29) & 1) )
+            { processChannel(w & 0xfff, payload + i, n10); }
+            i += n_dw;
+        }
+        return mergeCandidates(records);
+    }
+
+
+
+    typedef struct
+    {
+        fcf_software                  *instance;
+        uint32_t                       channel;
+        std::vector<fcf_software_job> *jobs;
+    } fcf_thread_args;
+
+    static void *
+    processChannelJobs
+    (
+        void *arg
+    )
+    {
+        fcf_thread_args *args = (fcf_thread_args *)arg;
+        std::vector<fcf_software_job> &jobs = *args->jobs;
+        for( size_t i=0; i<jobs.size(); i++ )
+        {
+            if( jobs[i].channel == args->channel )
+            {
+                jobs[i].result = args->instance->process(
+                        jobs[i].event, jobs[i].size_dw, jobs[i].output);
+            }
+        }
+        return NULL;
+    }
+
+
+
+    int
+    fcf_software::processParallel
+    (
+        std::vector<fcf_software*>     &instances,
+        std::vector<fcf_software_job>  &jobs
+    )
+    {
+        for( size_t i=0; i<jobs.size(); i++ )
+        { jobs[i].result = -1; }
+
+        std::vector<fcf_thread_args> args(instances.size());
+        for( size_t i=0; i<instances.size(); i++ )
+        {
+            args[i].instance = instances[i];
+            args[i].channel = i;
+            args[i].jobs = &jobs;
+        }
+        runParallel(processChannelJobs, args);
+
+        for( size_t i=0; i<jobs.size(); i++ )
+        {
+            if( jobs[i].result < 0 )
+            { return -1; }
+        }
+        return 0;
+    }
+
+
+
+    /**********************************************************
+     *                  protected
+     * *******************************************************/
+    void
+    fcf_software::processChannel
+    (
+        uint32_t        hw_address,
+        const uint32_t *words,
+        uint32_t        n10
+    )
+    {
+        if( m_branch_override )
+        { hw_address &= 0x7ff; }
+        uint32_t mapping = m_mapping[hw_address];
+        if( !((mapping >> 15) & 1) )
+        { return; }
+
+        uint32_t n_dw = (n10 + 2) / 3;
+        if( m_adc.size() < n_dw * 3 )
+        {
+            m_adc.resize(n_dw * 3);
+            m_charge.resize(n_dw * 3);
+        }
+        uint32_t gain = (mapping >> 16) & 0x1fff;
+        if( m_simd )
+        { unpackAvx2(words, n_dw, gain); }
+        else
+        { unpackScalar(words, n_dw, gain); }
+
+        uint32_t p = 0;
+        while( p + 2 <= n10 )
+        {
+            uint32_t length = m_adc[p];
+            uint32_t time = m_adc[p + 1];
+            if( length < 2 || p + length > n10 )
+            { break; }
+            uint32_t n = length - 2;
+            if( n > 0 && n <= time + 1 )
+            {
+                findSequences(&m_adc[p + 2], &m_charge[p + 2], n,
+                              time + 1 - n, mapping);
+            }
+            p += length;
+        }
+    }
+
+
+
+    /**
+     * samples of a bunch are stored in descending time order: position p
+     * in time order is array index n-1-p at time first_time+p
+     **/
+    void
+    fcf_software::findSequences
+    (
+        const uint32_t *adc,
+        const uint32_t *charge,
+        uint32_t        n,
+        uint32_t        first_time,
+        uint32_t        mapping
+    )
+    {
+        uint32_t tolerance = m_params.charge_tolerance;
+        uint32_t begin = 0;
+        uint32_t split = 0;
+        uint32_t falling = 0;
+        uint32_t max = adc[n - 1];
+        uint32_t min = 0;
+        uint32_t min_pos = 0;
+
+        for( uint32_t p=1; p<n; p++ )
+        {
+            uint32_t v = adc[n - 1 - p];
+            if( !falling )
+            {
+                if( v > max )
+                { max = v; }
+                else if( v + tolerance < max )
+                {
+                    falling = 1;
+                    min = v;
+                    min_pos = p;
+                }
+            }
+            else if( v < min )
+            {
+                min = v;
+                min_pos = p;
+            }
+            else if( v > min + tolerance )
+            {
+                falling = 0;
+                if( max >= min + m_params.noise_suppression &&
+                    v >= min + m_params.noise_suppression_minimum )
+                {
+                    addCandidate(charge, n, begin, min_pos, first_time,
+                                 mapping, 1);
+                    begin = min_pos + 1;
+                    split = 1;
+                    max = 0;
+                    for( uint32_t i=begin; i<=p; i++ )
+                    { max = std::max(max, adc[n - 1 - i]); }
+                }
+                else
+                { max = v; }
+            }
+        }
+        addCandidate(charge, n, begin, n - 1, first_time, mapping, split);
+    }
+
+
+
+    void
+    fcf_software::addCandidate
+    (
+        const uint32_t *charge,
+        uint32_t        n,
+        uint32_t        begin,
+        uint32_t        end,
+        uint32_t        first_time,
+        uint32_t        mapping,
+        uint32_t        deconv_time
+    )
+    {
+        fcf_candidate c;
+        c.row = (mapping >> 8) & 0x3f;
+        c.pad = mapping & 0xff;
+        c.border = (mapping >> 14) & 1;
+        c.deconv_time = deconv_time;
+        c.peak_time = first_time + begin;
+        c.charge = 0;
+        c.qmax = 0;
+        c.charge_time = 0;
+        c.charge_time2 = 0;
+
+        for( uint32_t p=begin; p<=end; p++ )
+        {
+            uint32_t q = charge[n - 1 - p];
+            uint64_t t = first_time + p;
+            c.charge += q;
+            c.charge_time += q * t;
+            c.charge_time2 += q * t * t;
+            if( q > c.qmax )
+            {
+                c.qmax = q;
+                c.peak_time = t;
+            }
+        }
+
+        if( c.charge == 0 ||
+            (c.charge >> FCF_CHARGE_SHIFT) < m_params.single_seq_limit )
+        { return; }
+        m_candidates.push_back(c);
+    }
+
+
+
+    int32_t
+    fcf_software::mergeCandidates
+    (
+        std::vector<uint32_t> *records
+    )
+    {
+        sortCandidates();
+
+        int32_t n = 0;
+        fcf_open_cluster cluster;
+        if( m_params.bypass_merger )
+        {
+            for( size_t i=0; i<m_order.size(); i++ )
+            {
+                initCluster(&cluster, &m_candidates[m_order[i]], 0);
+                n += closeCluster(&cluster, records);
+            }
+            return n;
+        }
+
+        /**
+         * clusters live in m_clusters, m_open and m_next list the clusters
+         * ending on the previous and on the current pad in time order
+         **/
+        uint32_t rise = m_params.noise_suppression_neighbor << FCF_CHARGE_SHIFT;
+        m_clusters.resize(m_order.size());
+        uint32_t used = 0;
+        m_open.clear();
+        size_t i = 0;
+        while( i < m_order.size() )
+        {
+            const fcf_candidate *first = &m_candidates[m_order[i]];
+            size_t end = i + 1;
+            while( end < m_order.size() &&
+                   padKey(&m_candidates[m_order[end]]) == padKey(first) )
+            { end++; }
+
+            /** clusters only continue onto the next pad of the same row */
+            if( !m_open.empty() )
+            {
+                const fcf_open_cluster *last = &m_clusters[m_open[0]];
+                if( last->row != first->row || last->last_pad + 1 != first->pad )
+                {
+                    for( size_t k=0; k<m_open.size(); k++ )
+                    { n += closeCluster(&m_clusters[m_open[k]], records); }
+                    m_open.clear();
+                }
+            }
+
+            m_next.clear();
+            for( size_t j=i; j<end; j++ )
+            {
+                const fcf_candidate *c = &m_candidates[m_order[j]];
+                size_t k = 0;
+                while( k < m_open.size() &&
+                       (m_clusters[m_open[k]].matched ||
+                        distance(c->peak_time, m_clusters[m_open[k]].ref_time) >
+                        m_params.merger_distance) )
+                { k++; }
+
+                if( k == m_open.size() )
+                {
+                    initCluster(&m_clusters[used], c, 0);
+                    m_next.push_back(used++);
+                    continue;
+                }
+
+                fcf_open_cluster *open = &m_clusters[m_open[k]];
+                open->matched = 1;
+                if( m_params.deconv_pad && open->falling &&
+                    c->qmax > open->last_qmax + rise )
+                {
+                    open->deconv_pad = 1;
+                    n += closeCluster(open, records);
+                    initCluster(&m_clusters[used], c, 1);
+                    m_next.push_back(used++);
+                }
+                else
+                {
+                    addToCluster(open, c);
+                    m_next.push_back(m_open[k]);
+                }
+            }
+
+            for( size_t k=0; k<m_open.size(); k++ )
+            {
+                fcf_open_cluster *open = &m_clusters[m_open[k]];
+                if( !open->matched )
+                { n += closeCluster(open, records); }
+                open->matched = 0;
+            }
+            m_open.swap(m_next);
+            i = end;
+        }
+
+        for( size_t k=0; k<m_open.size(); k++ )
+        { n += closeCluster(&m_clusters[m_open[k]], records); }
+        return n;
+    }
+
+
+
+    /**
+     * order the candidates by row and pad with a counting sort, then by
+     * time within a pad. Pads hold few candidates, so insertion sort is
+     * sufficient for the second step.
+     **/
+    void
+    fcf_software::sortCandidates()
+    {
+        m_bucket.assign(FCF_PAD_KEYS + 1, 0);
+        for( size_t i=0; i<m_candidates.size(); i++ )
+        { m_bucket[padKey(&m_candidates[i]) + 1]++; }
+        for( uint32_t k=0; k<FCF_PAD_KEYS; k++ )
+        { m_bucket[k + 1] += m_bucket[k]; }
+
+        m_order.resize(m_candidates.size());
+        for( size_t i=0; i<m_candidates.size(); i++ )
+        { m_order[m_bucket[padKey(&m_candidates[i])]++] = i; }
+
+        for( size_t i=1; i<m_order.size(); i++ )
+        {
+            uint32_t index = m_order[i];
+            const fcf_candidate *c = &m_candidates[index];
+            size_t j = i;
+            while( j > 0 )
+            {
+                const fcf_candidate *prev = &m_candidates[m_order[j - 1]];
+                if( padKey(prev) != padKey(c) || prev->peak_time <= c->peak_time )
+                { break; }
+                m_order[j] = m_order[j - 1];
+                j--;
+            }
+            m_order[j] = index;
+        }
+    }
+
+
+
+    void
+    fcf_software::initCluster
+    (
+        fcf_open_cluster    *cluster,
+        const fcf_candidate *c,
+        uint32_t             deconv_pad
+    )
+    {
+        cluster->row = c->row;
+        cluster->last_pad = c->pad;
+        cluster->pads = 1;
+        cluster->border = c->border;
+        cluster->deconv_pad = deconv_pad;
+        cluster->deconv_time_pads = c->deconv_time;
+        cluster->ref_time = c->peak_time;
+        cluster->last_qmax = c->qmax;
+        cluster->falling = 0;
+        cluster->matched = 0;
+        cluster->qmax = c->qmax;
+        cluster->charge = c->charge;
+        cluster->charge_pad = (uint64_t)c->charge * c->pad;
+        cluster->charge_pad2 = (uint64_t)c->charge * c->pad * c->pad;
+        cluster->charge_time = c->charge_time;
+        cluster->charge_time2 = c->charge_time2;
+    }
+
+
+
+    void
+    fcf_software::addToCluster
+    (
+        fcf_open_cluster    *cluster,
+        const fcf_candidate *c
+    )
+    {
+        uint32_t fall = m_params.noise_suppression_neighbor << FCF_CHARGE_SHIFT;
+        if( c->qmax + fall < cluster->last_qmax )
+        { cluster->falling = 1; }
+        cluster->last_qmax = c->qmax;
+        cluster->last_pad = c->pad;
+        if( m_params.merger_algorithm )
+        { cluster->ref_time = c->peak_time; }
+
+        cluster->pads++;
+        cluster->border |= c->border;
+        cluster->deconv_time_pads += c->deconv_time;
+        cluster->qmax = std::max(cluster->qmax, c->qmax);
+        cluster->charge += c->charge;
+        cluster->charge_pad += (uint64_t)c->charge * c->pad;
+        cluster->charge_pad2 += (uint64_t)c->charge * c->pad * c->pad;
+        cluster->charge_time += c->charge_time;
+        cluster->charge_time2 += c->charge_time2;
+    }
+
+
+
+    uint32_t
+    fcf_software::closeCluster
+    (
+        const fcf_open_cluster *cluster,
+        std::vector<uint32_t>  *records
+    )
+    {
+        if( (m_params.single_pad_suppression && cluster->pads == 1) ||
+            (cluster->charge >> FCF_CHARGE_SHIFT) <
+            m_params.cluster_lower_limit ||
+            (cluster->qmax >> FCF_CHARGE_SHIFT) <
+            m_params.cluster_qmax_lower_limit )
+        { return 0; }
+
+        uint32_t tags = 0;
+        if( m_params.tag_border_clusters && cluster->border )
+        { tags |= FCF_TAG_BORDER; }
+        if( m_params.tag_deconvoluted_clusters )
+        {
+            if( cluster->deconv_pad )
+            { tags |= FCF_TAG_DECONV_PAD; }
+            /** extended tagging requires 2 pads split in time */
+            uint32_t pads = (m_params.tag_deconvoluted_clusters == 1) ? 1 : 2;
+            if( cluster->deconv_time_pads >= pads )
+            { tags |= FCF_TAG_DECONV_TIME; }
+        }
+
+        size_t o = records->size();
+        records->resize(o + LIBRORC_FCF_CLUSTER_WORDS);
+        uint32_t *w = &(*records)[o];
+        double charge = (double)cluster->charge;
+        uint64_t q = std::min(cluster->charge, (uint64_t)FCF_CHARGE_MAX);
+        w[0] = (LIBRORC_FCF_CLUSTER_MARKER << 30) | (cluster->row << 24) |
+            (uint32_t)q;
+        w[1] = floatToWord((float)((double)cluster->charge_pad / charge));
+        w[2] = floatToWord((float)((double)cluster->charge_time / charge));
+        w[3] = floatToWord((float)((double)cluster->charge_pad2 / charge));
+        w[4] = floatToWord((float)((double)cluster->charge_time2 / charge));
+        w[5] = tags | std::min(cluster->qmax, (uint32_t)FCF_QMAX_MAX);
+        return 1;
+    }
+
+
+
+    void
+    fcf_software::unpackScalar
+    (
+        const uint32_t *words,
+        uint32_t        n_dw,
+        uint32_t        gain
+    )
+    {
+        uint32_t shift = LIBRORC_FCF_GAIN_SHIFT - FCF_CHARGE_SHIFT;
+        uint32_t *adc = &m_adc[0];
+        uint32_t *charge = &m_charge[0];
+        for( uint32_t i=0; i<n_dw; i++ )
+        {
+            uint32_t w = words[i];
+            adc[3 * i] = (w >> 20) & RCU_ADC_MASK;
+            adc[3 * i + 1] = (w >> 10) & RCU_ADC_MASK;
+            adc[3 * i + 2] = w & RCU_ADC_MASK;
+            charge[3 * i] = (adc[3 * i] * gain) >> shift;
+            charge[3 * i + 1] = (adc[3 * i + 1] * gain) >> shift;
+            charge[3 * i + 2] = (adc[3 * i + 2] * gain) >> shift;
+        }
+    }
+
+
+
+#ifdef LIBRORC_FCF_AVX2
+    /**
+     * 8 DWs hold 24 samples. Word g of the output is plane g%3 of input
+     * DW g/3, so each output vector is a permutation of the three planes
+     * with the same indices, blended by plane.
+     **/
+    __attribute__((target("avx2")))
+    static void
+    unpackAvx2Block
+    (
+        const uint32_t *words,
+        uint32_t        n_dw,
+        uint32_t        gain,
+        uint32_t       *adc,
+        uint32_t       *charge
+    )
+    {
+        const __m256i mask = _mm256_set1_epi32(RCU_ADC_MASK);
+        const __m256i g = _mm256_set1_epi32(gain);
+        const __m128i shift = _mm_cvtsi32_si128(
+                LIBRORC_FCF_GAIN_SHIFT - FCF_CHARGE_SHIFT);
+        const __m256i idx0 = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+        const __m256i idx1 = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+        const __m256i idx2 = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+
+        for( uint32_t i=0; i<n_dw; i+=8 )
+        {
+            __m256i w = _mm256_loadu_si256((const __m256i *)(words + i));
+            __m256i a = _mm256_and_si256(_mm256_srli_epi32(w, 20), mask);
+            __m256i b = _mm256_and_si256(_mm256_srli_epi32(w, 10), mask);
+            __m256i c = _mm256_and_si256(w, mask);
+
+            __m256i out[3];
+            out[0] = _mm256_blend_epi32(_mm256_blend_epi32(
+                        _mm256_permutevar8x32_epi32(a, idx0),
+                        _mm256_permutevar8x32_epi32(b, idx0), 0x92),
+                    _mm256_permutevar8x32_epi32(c, idx0), 0x24);
+            out[1] = _mm256_blend_epi32(_mm256_blend_epi32(
+                        _mm256_permutevar8x32_epi32(a, idx1),
+                        _mm256_permutevar8x32_epi32(b, idx1), 0x24),
+                    _mm256_permutevar8x32_epi32(c, idx1), 0x49);
+            out[2] = _mm256_blend_epi32(_mm256_blend_epi32(
+                        _mm256_permutevar8x32_epi32(a, idx2),
+                        _mm256_permutevar8x32_epi32(b, idx2), 0x49),
+                    _mm256_permutevar8x32_epi32(c, idx2), 0x92);
+
+            for( uint32_t j=0; j<3; j++ )
+            {
+                uint32_t o = 3 * i + 8 * j;
+                _mm256_storeu_si256((__m256i *)(adc + o), out[j]);
+                _mm256_storeu_si256((__m256i *)(charge + o), _mm256_srl_epi32(
+                            _mm256_mullo_epi32(out[j], g), shift));
+            }
+        }
+    }
+#endif
+
+
+
+    void
+    fcf_software::unpackAvx2
+    (
+        const uint32_t *words,
+        uint32_t        n_dw,
+        uint32_t        gain
+    )
+    {
+        uint32_t done = 0;
+#ifdef LIBRORC_FCF_AVX2
+        /** the payload of the last channel may end at the buffer end */
+        done = n_dw & ~7;
+        unpackAvx2Block(words, done, gain, &m_adc[0], &m_charge[0]);
+#endif
+        uint32_t shift = LIBRORC_FCF_GAIN_SHIFT - FCF_CHARGE_SHIFT;
+        for( uint32_t i=done; i<n_dw; i++ )
+        {
+            uint32_t w = words[i];
+            for( uint32_t j=0; j<3; j++ )
+            {
+                uint32_t v = (w >> (20 - 10 * j)) & RCU_ADC_MASK;
+                m_adc[3 * i + j] = v;
+                m_charge[3 * i + j] = (v * gain) >> shift;
+            }
+        }
+    }
+
+}
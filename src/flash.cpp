@@ -34,15 +34,70 @@
 #include <unistd.h> //usleep
 #include <cstdlib> //calloc
 #include <cstdio> //fopen
+#include <cstring> //memcpy
 #include <sys/stat.h> //stat
 #include <fcntl.h> //open
+#include <time.h> //clock_gettime
+#include <vector>
 
 #include <librorc/flash.hh>
 #include <librorc/bar.hh>
+#include <librorc/bar_profiler.hh>
+#include <librorc/parallel.hh>
+
+/** flash::m_bulk_read: WORD order of 32 bit reads checked or not */
+#define FLASH_BULK_READ_UNKNOWN -1
+#define FLASH_BULK_READ_OFF      0
+#define FLASH_BULK_READ_ON       1
 
 namespace LIBRARY_NAME
 {
 
+/**
+ * adaptive status polling: most operations complete within a few
+ * register reads, so the first FLASH_POLL_SPIN polls are not delayed.
+ * After that the delay doubles up to FLASH_POLL_MAX_DELAY_US.
+ **/
+class flash_poll
+{
+    public:
+        flash_poll()
+        {
+            m_polls = 0;
+            m_delay = 1;
+            clock_gettime(CLOCK_MONOTONIC, &m_start);
+        }
+
+        /**
+         * wait before the next status read
+         * @return false after FLASH_POLL_TIMEOUT_US
+         **/
+        bool
+        wait()
+        {
+            m_polls++;
+            if( m_polls > FLASH_POLL_SPIN )
+            {
+                usleep(m_delay);
+                if( m_delay < FLASH_POLL_MAX_DELAY_US )
+                { m_delay <<= 1; }
+            }
+
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            uint64_t elapsed_us = (now.tv_sec - m_start.tv_sec) * 1000000ull +
+                (now.tv_nsec - m_start.tv_nsec) / 1000;
+            return (elapsed_us < FLASH_POLL_TIMEOUT_US);
+        }
+
+    protected:
+        uint32_t m_polls;
+        uint32_t m_delay;
+        struct timespec m_start;
+};
+
+
+
 flash::flash
 (
     bar                    *flashbar,
@@ -58,6 +113,7 @@ flash::flash
     m_bar           = flashbar;
     m_base_addr     = chip_select << FLASH_CHIP_SELECT_BIT;
     m_chip_select   = chip_select;
+    m_bulk_read     = FLASH_BULK_READ_UNKNOWN;
 }
 
 
@@ -175,11 +231,105 @@ flash::get
     uint32_t addr
 )
 {
+    LIBRORC_PROFILE_SCOPE("flash");
     return m_bar->get16(m_base_addr + addr);
 }
 
 
 
+int32_t
+flash::readBulk
+(
+    uint32_t  addr,
+    uint32_t  words,
+    uint16_t *data,
+    uint64_t *hash
+)
+{
+    LIBRORC_PROFILE_SCOPE("flash");
+    if( (uint64_t)addr + words > (FLASH_SIZE >> 1) )
+    { return -1; }
+
+    uint32_t done = 0;
+
+    /** 32 bit reads have to start at an even WORD address */
+    if( (addr & 1) && words )
+    {
+        data[0] = get(addr);
+        done = 1;
+    }
+
+    uint32_t chunk[FLASH_READ_CHUNK_DWS];
+    while( (words - done > 1) && (m_bulk_read != FLASH_BULK_READ_OFF) )
+    {
+        uint32_t dws = (words - done) >> 1;
+        if( dws > FLASH_READ_CHUNK_DWS )
+        { dws = FLASH_READ_CHUNK_DWS; }
+        m_bar->memcopy(chunk, (m_base_addr + addr + done) >> 1,
+                dws * sizeof(uint32_t));
+        memcpy(data + done, chunk, dws * sizeof(uint32_t));
+        if( m_bulk_read == FLASH_BULK_READ_UNKNOWN )
+        {
+            checkBulkRead(addr + done, data + done, dws << 1);
+            if( m_bulk_read == FLASH_BULK_READ_OFF )
+            { break; }
+        }
+        done += (dws << 1);
+    }
+
+    /** the remainder, or everything if 32 bit reads are unusable */
+    for( ; done < words; done++ )
+    { data[done] = get(addr + done); }
+
+    if( hash )
+    { *hash = hashUpdate(*hash, data, words * sizeof(uint16_t)); }
+
+    return 0;
+}
+
+
+
+void
+flash::checkBulkRead
+(
+    uint32_t        addr,
+    const uint16_t *data,
+    uint32_t        words
+)
+{
+    if( words > FLASH_BULK_CHECK_WORDS )
+    { words = FLASH_BULK_CHECK_WORDS; }
+
+    /** uniform data, e.g. erased flash, can not reveal the WORD order */
+    bool distinct = false;
+    for( uint32_t i=0; i<words; i++ )
+    {
+        if( get(addr + i) != data[i] )
+        {
+            m_bulk_read = FLASH_BULK_READ_OFF;
+            return;
+        }
+        distinct |= (data[i] != data[0]);
+    }
+    if( distinct )
+    { m_bulk_read = FLASH_BULK_READ_ON; }
+}
+
+
+
+uint64_t
+flash::hashUpdate
+(
+    uint64_t    hash,
+    const void *data,
+    size_t      bytes
+)
+{
+    return fnv1aUpdate(hash, data, bytes);
+}
+
+
+
 uint16_t
 flash::resetBlock
 (
@@ -228,7 +378,7 @@ flash::programBuffer
     librorc_verbosity_enum verbose
 )
 {
-    uint32_t timeout = CFG_FLASH_TIMEOUT;
+    LIBRORC_PROFILE_SCOPE("flash");
 
     /** Get current block address */
     struct flash_architecture arch;
@@ -254,12 +404,10 @@ flash::programBuffer
     sendCommand(addr, FLASH_CMD_BUFFER_PROG);
     uint16_t status = get(addr);
 
+    flash_poll buffer_poll;
     while( !(status & FLASH_PEC_BUSY) )
     {
-        usleep(100);
-        status = get(addr);
-        timeout--;
-        if(timeout == 0)
+        if( !buffer_poll.wait() )
         {
             if( verbose==LIBRORC_VERBOSE_ON )
             {
@@ -268,6 +416,7 @@ flash::programBuffer
             }
             return -status;
         }
+        status = get(addr);
     }
 
     /** write word count */
@@ -280,14 +429,11 @@ flash::programBuffer
     sendCommand(arch.blkaddr, FLASH_CMD_CONFIRM);
 
     /** Wait while device is busy */
-    timeout = CFG_FLASH_TIMEOUT;
     status = get(arch.blkaddr);
+    flash_poll busy_poll;
     while( (status & FLASH_PEC_BUSY) == 0 )
     {
-        usleep(100);
-        status = get(arch.blkaddr);
-        timeout--;
-        if(timeout == 0)
+        if( !busy_poll.wait() )
         {
             if( verbose==LIBRORC_VERBOSE_ON )
             {
@@ -296,6 +442,7 @@ flash::programBuffer
             }
             return -status;
         }
+        status = get(arch.blkaddr);
     }
 
     /** SR.5 or SR.4 nonzero -> program/erase/sequence error */
@@ -323,20 +470,19 @@ flash::eraseBlock
     uint32_t blkaddr
 )
 {
+    LIBRORC_PROFILE_SCOPE("flash");
     uint16_t status;
-    uint32_t timeout = CFG_FLASH_TIMEOUT;
 
     sendCommand(blkaddr, FLASH_CMD_BLOCK_ERASE_SETUP);
     sendCommand(blkaddr, FLASH_CMD_CONFIRM);
 
     status = get(blkaddr);
+    flash_poll poll;
     while( (status & FLASH_PEC_BUSY) == 0 || status==0xffff)
     {
-        usleep(100);
-        status = get(blkaddr);
-        timeout--;
-        if(timeout == 0)
+        if( !poll.wait() )
         { return -status; }
+        status = get(blkaddr);
     }
 
     resetBlock(blkaddr); /** return into read array mode */
@@ -374,7 +520,7 @@ flash::lockBlock
     uint32_t blkaddr
 )
 {
-    uint32_t timeout = CFG_FLASH_TIMEOUT;
+    flash_poll poll;
 
     /** clear any latched status register contents */
     clearStatusRegister(blkaddr);
@@ -386,11 +532,9 @@ flash::lockBlock
     uint16_t status = getStatusRegister(blkaddr);
     while( (status & FLASH_PEC_BUSY) == 0)
     {
-        usleep(100);
-        status = getStatusRegister(blkaddr);
-        timeout--;
-        if(timeout == 0)
+        if( !poll.wait() )
         { return -status; }
+        status = getStatusRegister(blkaddr);
     }
     clearStatusRegister(blkaddr);
     resetBlock(blkaddr); /** return into read array mode */
@@ -406,7 +550,7 @@ flash::unlockBlock
     uint32_t blkaddr
 )
 {
-    uint32_t timeout = CFG_FLASH_TIMEOUT;
+    flash_poll poll;
 
     clearStatusRegister(blkaddr);
 
@@ -418,11 +562,9 @@ flash::unlockBlock
     uint16_t status = getStatusRegister(blkaddr);
     while( (status & FLASH_PEC_BUSY) == 0)
     {
-        usleep(100);
-        status = getStatusRegister(blkaddr);
-        timeout--;
-        if(timeout == 0)
+        if( !poll.wait() )
         { return -status; }
+        status = getStatusRegister(blkaddr);
     }
     clearStatusRegister(blkaddr);
     resetBlock(blkaddr); /** return into read array mode */
@@ -450,21 +592,20 @@ flash::blankCheck
     uint32_t blkaddr
 )
 {
+    LIBRORC_PROFILE_SCOPE("flash");
     uint16_t status;
-    uint32_t timeout = CFG_FLASH_TIMEOUT;
 
     sendCommand(blkaddr, FLASH_CMD_BC_SETUP);
     sendCommand(blkaddr, FLASH_CMD_BC_CONFIRM);
     status = get(blkaddr);
 
     /** wait for blankCheck to complete */
+    flash_poll poll;
     while( (status & FLASH_PEC_BUSY) == 0)
     {
-        usleep(100);
-        status = get(blkaddr);
-        timeout--;
-        if(timeout == 0)
+        if( !poll.wait() )
         { return -status; }
+        status = get(blkaddr);
     }
     clearStatusRegister(blkaddr);
 
@@ -523,6 +664,7 @@ flash::dump
     uint64_t flash_words = (FLASH_SIZE/2);
     uint16_t *flash_buffer =
         (uint16_t*)calloc(flash_words, sizeof(uint16_t));
+    uint64_t hash = FLASH_HASH_INIT;
 
     FILE *filep = fopen(filename, "w");
     if(filep == NULL)
@@ -531,14 +673,21 @@ flash::dump
         return -1;
     }
 
-    for(uint64_t i=0; i<flash_words; i++)
+    if( readBulk(0, flash_words, flash_buffer, &hash) )
     {
-        flash_buffer[i] = get(i);
-        if(verbose == LIBRORC_VERBOSE_ON)
+        free(flash_buffer);
+        fclose(filep);
+        return -1;
+    }
+
+    if(verbose == LIBRORC_VERBOSE_ON)
+    {
+        for(uint64_t i=0; i<flash_words; i++)
         {
             std::cout << i << " : "  << std::hex << std::setw(4)
                  << flash_buffer[i] << std::dec << std::endl;
         }
+        std::cout << "hash : " << std::hex << hash << std::dec << std::endl;
     }
 
     if( fwrite(flash_buffer, FLASH_SIZE, 1, filep) != 1 )
@@ -556,6 +705,89 @@ flash::dump
 
 
 
+int32_t
+flash::verify
+(
+    char                   *filename,
+    librorc_verbosity_enum  verbose,
+    uint64_t               *hash
+)
+{
+    if(filename == NULL)
+    { return -1; }
+
+    FILE *filep = fopen(filename, "r");
+    if(filep == NULL)
+    { return -1; }
+
+    /**
+     * stream file and flash in chunks and compare them, the running
+     * hash covers the flash contents
+     **/
+    std::vector<uint16_t> file_buffer(FLASH_READ_CHUNK_DWS << 1);
+    std::vector<uint16_t> flash_buffer(FLASH_READ_CHUNK_DWS << 1);
+    uint64_t flash_hash = FLASH_HASH_INIT;
+    uint32_t addr = 0;
+    int32_t result = 0;
+
+    while( result >= 0 )
+    {
+        size_t bytes = fread(&file_buffer[0], 1,
+                file_buffer.size() * sizeof(uint16_t), filep);
+        if( bytes == 0 )
+        { break; }
+        if( (addr << 1) + bytes > FLASH_SIZE )
+        {
+            result = -1;
+            break;
+        }
+
+        /** a trailing odd byte is compared against the low byte */
+        uint32_t words = (bytes + 1) >> 1;
+        if( readBulk(addr, words, &flash_buffer[0]) )
+        {
+            result = -1;
+            break;
+        }
+        flash_hash = hashUpdate(flash_hash, &flash_buffer[0], bytes);
+
+        if( memcmp(&file_buffer[0], &flash_buffer[0], bytes) )
+        {
+            if(verbose == LIBRORC_VERBOSE_ON && result == 0)
+            {
+                for( uint32_t i=0; i<(bytes>>1); i++ )
+                {
+                    if( file_buffer[i] != flash_buffer[i] )
+                    {
+                        std::cout << "mismatch at WORD address 0x"
+                             << std::hex << (addr + i) << ": file "
+                             << file_buffer[i] << ", flash "
+                             << flash_buffer[i] << std::dec << std::endl;
+                        break;
+                    }
+                }
+            }
+            result = 1;
+        }
+        addr += words;
+    }
+    fclose(filep);
+
+    if( hash )
+    { *hash = flash_hash; }
+
+    if(verbose == LIBRORC_VERBOSE_ON && result >= 0)
+    {
+        std::cout << "Verified " << std::dec << (addr << 1)
+             << " bytes, hash " << std::hex << flash_hash << std::dec
+             << ((result == 0) ? " matches" : " differs") << std::endl;
+    }
+
+    return result;
+}
+
+
+
 int32_t
 flash::erase
 (
@@ -631,7 +863,8 @@ int32_t
 flash::flashWrite
 (
     char                   *filename,
-    librorc_verbosity_enum  verbose
+    librorc_verbosity_enum  verbose,
+    bool                    differential
 )
 {
     if(filename == NULL)
@@ -654,8 +887,6 @@ flash::flashWrite
         return -1;
     }
 
-    uint64_t addr = 0;
-
     if(verbose == LIBRORC_VERBOSE_ON)
     {
         std::cout << "Bitfile Size         : "
@@ -664,7 +895,7 @@ flash::flashWrite
              << " Bytes)" << std::endl;
 
         std::cout << "Bitfile will be written to Flash starting at addr "
-             << addr << std::endl;
+             << 0 << std::endl;
     }
 
     /** Open the flash file */
@@ -676,69 +907,251 @@ flash::flashWrite
         return -1;
 	}
 
-    /** Erase the flash first */
-    if( erase(stat_buf.st_size, verbose)!=0 )
+    /** read the whole image, pad a trailing byte with 0xff */
+    uint32_t words = (stat_buf.st_size + 1) >> 1;
+    std::vector<uint16_t> image(words, 0xffff);
+    size_t bytes_total = 0;
+    ssize_t bytes_read;
+    while( bytes_total < (size_t)stat_buf.st_size &&
+           (bytes_read = read(fd, ((uint8_t *)&image[0]) + bytes_total,
+                              stat_buf.st_size - bytes_total)) > 0 )
+    { bytes_total += bytes_read; }
+    close(fd);
+
+    if( bytes_total != (size_t)stat_buf.st_size )
     {
-        std::cout << "CRORC flash erase failed!" << std::endl;
+        std::cout << "failed to read input file "
+             << filename << "!"<< std::endl;
         return -1;
     }
 
-    /** Program flash */
-    size_t bytes_read = 0;
-    size_t bytes_programmed = 0;
-    uint16_t *buffer
-        = (uint16_t *)malloc(32*sizeof(uint16_t));
+    return programImage(&image[0], words, verbose, differential);
+}
+
 
-    while ( (bytes_read=read(fd, buffer, 32*sizeof(uint16_t))) > 0 )
+
+int32_t
+flash::programImage
+(
+    const uint16_t         *image,
+    uint32_t                words,
+    librorc_verbosity_enum  verbose,
+    bool                    differential
+)
+{
+    uint32_t addr = 0;
+    uint32_t blocks_skipped = 0;
+    uint32_t blocks_erased = 0;
+    uint32_t buffers_programmed = 0;
+    std::vector<uint16_t> current;
+
+    while( addr < words )
     {
+        struct flash_architecture arch;
+        if ( getFlashArchitecture(addr, &arch) )
+        {
+            std::cout << "Invalid flash address: "
+                 << addr << std::endl;
+            return -1;
+        }
+
+        uint32_t blkwords = arch.blksize >> 1;
+        uint32_t count = (words - addr < blkwords) ? (words - addr) : blkwords;
+        const uint16_t *data = image + addr;
+
         if(verbose == LIBRORC_VERBOSE_ON)
         {
-            std::cout << "\rWriting " << std::dec
-                 << (uint64_t)bytes_read << " bytes to 0x"
-                 << std::hex << addr << " : "
-                 << std::dec
-                 << (uint64_t)((100*bytes_programmed)/stat_buf.st_size)
+            std::cout << "\rWriting block "
+                 << std::dec << arch.blknum << " (0x"
+                 << std::hex << arch.blkaddr << ") : "
+                 << std::dec << (uint64_t)((100ull*addr)/words)
                  << "% ...";
             fflush(stdout);
         }
 
-        int32_t ret = programBuffer(addr, bytes_read/2, buffer, verbose);
-        if (ret < 0)
+        /**
+         * a block can be programmed without erase if no bit has to
+         * change from 0 to 1
+         **/
+        bool erase_block = true;
+        if( differential )
         {
-            std::cout << "programBuffer failed, STS: " << std::hex
-                 << -ret << std::dec << std::endl;
-            break;
+            current.resize(count);
+            if( readBulk(addr, count, &current[0]) )
+            {
+                std::cout << "Failed to read block at addr" << std::hex
+                     << arch.blkaddr << std::dec << std::endl;
+                return -1;
+            }
+
+            bool identical = true;
+            erase_block = false;
+            for( uint32_t i=0; i<count; i++ )
+            {
+                if( current[i] != data[i] )
+                { identical = false; }
+                if( (current[i] & data[i]) != data[i] )
+                {
+                    erase_block = true;
+                    break;
+                }
+            }
+
+            if( identical )
+            {
+                blocks_skipped++;
+                addr += blkwords;
+                continue;
+            }
+        }
+
+        /** check if block is locked */
+        if( getBlockLockConfiguration(arch.blkaddr) )
+        {
+            int32_t status = unlockBlock(arch.blkaddr) ;
+            if ( status < 0 )
+            {
+                std::cout << "Failed to unlock block at addr" << std::hex
+                     << arch.blkaddr << std::endl;
+                return -1;
+            }
         }
 
-        for(uint64_t i=0; i<(bytes_read/2); i++)
+        if( erase_block )
         {
-            uint16_t status = get(addr+i);
-            if( buffer[i] != status )
+            int32_t status = eraseBlock(arch.blkaddr);
+            if( status < 0 )
+            {
+                std::cout << "Failed to erase block at addr" << std::hex
+                     << arch.blkaddr << ": " << -status << std::endl;
+                return -1;
+            }
+            blocks_erased++;
+            current.assign(count, 0xffff);
+        }
+
+        /** program all buffers that differ from the current contents */
+        for( uint32_t offset=0; offset<count; offset+=FLASH_BUFFER_WORDS )
+        {
+            uint16_t length = (count - offset < FLASH_BUFFER_WORDS)
+                ? (count - offset) : FLASH_BUFFER_WORDS;
+            bool changed = false;
+            for( uint32_t i=0; i<length && !changed; i++ )
+            { changed = (current[offset+i] != data[offset+i]); }
+            if( !changed )
+            { continue; }
+
+            int32_t ret = programBuffer(addr + offset, length,
+                    (uint16_t *)(data + offset), verbose);
+            if (ret < 0)
+            {
+                std::cout << "programBuffer failed, STS: " << std::hex
+                     << -ret << std::dec << std::endl;
+                return -1;
+            }
+            buffers_programmed++;
+
+            uint16_t readback[FLASH_BUFFER_WORDS];
+            if( readBulk(addr + offset, length, readback) )
             {
-                std::cout << "write failed: written "
-                     << std::hex << buffer[i]
-                     << ", read " << status << ", addr " << std::hex
-                     << (addr+i) << ", bytes_read "
-                     << std::dec << bytes_read << std::endl;
-                break;
+                std::cout << "Failed to read back buffer at addr"
+                     << std::hex << (addr + offset) << std::dec
+                     << std::endl;
+                return -1;
+            }
+            for( uint32_t i=0; i<length; i++ )
+            {
+                if( data[offset+i] != readback[i] )
+                {
+                    std::cout << "write failed: written "
+                         << std::hex << data[offset+i]
+                         << ", read " << readback[i] << ", addr "
+                         << (addr + offset + i) << std::dec << std::endl;
+                    return -1;
+                }
             }
         }
 
-        bytes_programmed += bytes_read;
-        addr += bytes_read/2;
+        addr += blkwords;
     }
 
     if(verbose == LIBRORC_VERBOSE_ON)
-    { std::cout << std::endl << "DONE!" << std::endl; }
-
-    /* Close everything */
-	free(buffer);
-    close(fd);
+    {
+        std::cout << std::endl << "Flash " << m_chip_select << ": "
+             << std::dec << blocks_skipped << " blocks unchanged, "
+             << blocks_erased << " blocks erased, "
+             << buffers_programmed << " buffers programmed" << std::endl
+             << "DONE!" << std::endl;
+    }
 
     return 0;
 }
 
 
+
+typedef struct
+{
+    flash                  *chip;
+    char                   *filename;
+    librorc_verbosity_enum  verbose;
+    bool                    differential;
+    int32_t                 result;
+} flash_write_args;
+
+
+
+void *
+flash::flashWriteThread
+(
+    void *arg
+)
+{
+    flash_write_args *args = (flash_write_args *)arg;
+    args->result = args->chip->flashWrite(args->filename, LIBRORC_VERBOSE_OFF,
+            args->differential);
+    if( args->verbose == LIBRORC_VERBOSE_ON )
+    {
+        std::cout << "Flash " << args->chip->getChipSelect() << ": "
+             << ((args->result == 0) ? "DONE" : "FAILED") << std::endl;
+    }
+    return NULL;
+}
+
+
+
+int32_t
+flash::flashWriteParallel
+(
+    flash                  *flash0,
+    char                   *filename0,
+    flash                  *flash1,
+    char                   *filename1,
+    librorc_verbosity_enum  verbose,
+    bool                    differential
+)
+{
+    flash_write_args args[2];
+    args[0].chip = flash0;
+    args[0].filename = filename0;
+    args[1].chip = flash1;
+    args[1].filename = filename1;
+
+    for( int i=0; i<2; i++ )
+    {
+        args[i].verbose = verbose;
+        args[i].differential = differential;
+        args[i].result = -1;
+        if( args[i].chip == NULL )
+        { return -1; }
+    }
+
+    /** flash chips are independent, chip select is part of the address */
+    runParallel(flashWriteThread, args, 2);
+
+    return (args[0].result == 0 && args[1].result == 0) ? 0 : -1;
+}
+
+
 uint32_t
 flash::getChipSelect()
 {
@@ -753,22 +1166,33 @@ flash::findFpgaSyncWord
     uint32_t searchLength
 )
 {
+    LIBRORC_PROFILE_SCOPE("flash");
     /** ensure offset and length are even numbers */
     uint32_t offset = startOffset & ~(0x00000001);
     uint32_t end_offest = startOffset + (searchLength & ~(0x00000001));
+    if( end_offest > FLASH_SIZE )
+    { end_offest = FLASH_SIZE; }
     uint32_t cur_word = 0;
-    while( cur_word!=FPGA_SYNCWORD && offset<end_offest)
+    uint16_t chunk[FLASH_READ_CHUNK_DWS << 1];
+
+    while( offset<end_offest )
     {
-        /** 16bit flash interface: 2 bytes per read, so
-         * increment offset by 2 */
-        cur_word = (cur_word<<16) + get(offset>>1);
-        offset += 2;
+        /** 16bit flash interface: 2 bytes per WORD */
+        uint32_t words = (end_offest - offset + 1) >> 1;
+        if( words > (FLASH_READ_CHUNK_DWS << 1) )
+        { words = (FLASH_READ_CHUNK_DWS << 1); }
+        if( readBulk(offset>>1, words, chunk) )
+        { return -1; }
+
+        for( uint32_t i=0; i<words; i++ )
+        {
+            cur_word = (cur_word<<16) + chunk[i];
+            offset += 2;
+            if( cur_word==FPGA_SYNCWORD )
+            { return (offset-2); }
+        }
     }
-
-    if( cur_word==FPGA_SYNCWORD )
-    { return (offset-2); }
-    else
-    { return -1; }
+    return -1;
 }
 
 
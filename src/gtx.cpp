@@ -29,6 +29,7 @@
 #include <unistd.h>
 #include <librorc/gtx.hh>
 #include <librorc/link.hh>
+#include <librorc/bar_profiler.hh>
 #include <librorc/registers.h>
 
 /** Conversions between PLL values and their register representations */
@@ -256,6 +257,9 @@ namespace LIBRARY_NAME {
         asynccfg |= (((value >> 1) & 1) << GTX_ASYNCCFG_RXRESET); // RXreset
         asynccfg |= (((value >> 2) & 1) << GTX_ASYNCCFG_TXRESET); // TXreset
         m_link->setPciReg(RORC_REG_GTX_ASYNC_CFG, asynccfg);
+        // a GTX reset also resets the link's DDL domain registers
+        if( value & 1 )
+        { m_link->invalidateShadow(); }
     }
 
     uint32_t gtx::getRxReset() {
@@ -355,6 +359,7 @@ namespace LIBRARY_NAME {
     uint16_t
     gtx::drpRead(uint8_t drp_addr)
     {
+        LIBRORC_PROFILE_SCOPE("gtx::drp");
         uint32_t drp_cmd = (0<<24) | (drp_addr<<16) | (0x00);
         m_link->setPciReg(RORC_REG_GTX_DRP_CTRL, drp_cmd);
         uint32_t drp_status = waitForDrpDenToDeassert();
@@ -368,6 +373,7 @@ namespace LIBRARY_NAME {
         uint16_t drp_data
     )
     {
+        LIBRORC_PROFILE_SCOPE("gtx::drp");
         uint32_t drp_cmd = (1<<24) | (drp_addr<<16) | (drp_data);
         m_link->setPciReg(RORC_REG_GTX_DRP_CTRL, drp_cmd);
         waitForDrpDenToDeassert();
@@ -39,18 +39,60 @@ namespace LIBRARY_NAME
 
 #define LIBRORC_LINK_WAITFORGTX_TIMEOUT 10000
 
+#define LIBRORC_REGFILE_PCI 0
+#define LIBRORC_REGFILE_GTX (1<<RORC_REGFILE_GTX_SEL)
+#define LIBRORC_REGFILE_DDL (1<<RORC_REGFILE_DDL_SEL)
+
+    typedef struct
+    {
+        uint32_t regfile;
+        uint32_t addr;
+        uint32_t volatile_mask; /** status, strobe and W1C bits */
+    } shadow_reg;
+
+    /** write-mostly control registers that can be shadowed */
+    const shadow_reg shadow_regs[LIBRORC_LINK_SHADOW_REGS] =
+    {
+        /** busy/fifo status [7:4], stall/underrun flags [13:11],
+         *  sync SW read pointers [31] */
+        {LIBRORC_REGFILE_PCI, RORC_REG_DMA_CTRL,
+            (0xf<<4) | (7<<11) | (1u<<31)},
+        /** clear counters [2], link status [5:4], PG done [14],
+         *  feature flags [15], [25:24], SIU status [30:28] */
+        {LIBRORC_REGFILE_DDL, RORC_REG_DDL_CTRL,
+            (1<<2) | (3<<4) | (3<<14) | (3<<24) | (7u<<28)},
+        /** error mask [12:6] */
+        {LIBRORC_REGFILE_DDL, RORC_REG_FCF_CTRL, (0x7f<<6)},
+        {LIBRORC_REGFILE_DDL, RORC_REG_FCF_LIMITS, 0},
+        {LIBRORC_REGFILE_DDL, RORC_REG_FCF_LIMITS2, 0},
+        {LIBRORC_REGFILE_DDL, RORC_REG_DDL_FILTER_CTRL, 0},
+    };
+
     link::link
     (
         bar      *bar,
         uint32_t  link_number
     )
     {
-        m_bar         = bar;
-        m_base        = (link_number + 1) * RORC_CHANNEL_OFFSET;
-        m_link_number = link_number;
+        m_bar            = bar;
+        m_base           = (link_number + 1) * RORC_CHANNEL_OFFSET;
+        m_link_number    = link_number;
+        m_shadow_enabled = false;
+        m_shadow_valid   = 0;
     };
 
 
+    void
+    link::setShadowEnable
+    (
+        bool enable
+    )
+    {
+        m_shadow_enabled = enable;
+        m_shadow_valid = 0;
+    }
+
+
     void
     link::setGtxReg
     (
@@ -58,7 +100,7 @@ namespace LIBRARY_NAME
         uint32_t data
     )
     {
-        m_bar->set32( m_base+(1<<RORC_REGFILE_GTX_SEL)+addr, data);
+        setReg( m_base+LIBRORC_REGFILE_GTX+addr, data);
     }
 
 
@@ -76,7 +118,7 @@ namespace LIBRARY_NAME
         uint32_t data
     )
     {
-        m_bar->set32( m_base+(1<<RORC_REGFILE_DDL_SEL)+addr, data);
+        setReg( m_base+LIBRORC_REGFILE_DDL+addr, data);
     }
 
 
@@ -94,7 +136,7 @@ namespace LIBRARY_NAME
         uint32_t data
     )
     {
-        m_bar->set32((m_base + addr), data);
+        setReg( m_base+LIBRORC_REGFILE_PCI+addr, data);
     }
 
 
@@ -108,6 +150,75 @@ namespace LIBRARY_NAME
     }
 
 
+    void
+    link::modifyGtxReg
+    (
+        uint32_t addr,
+        uint32_t mask,
+        uint32_t value
+    )
+    {
+        modifyReg( m_base+LIBRORC_REGFILE_GTX+addr, mask, value);
+    }
+
+
+    void
+    link::modifyDdlReg
+    (
+        uint32_t addr,
+        uint32_t mask,
+        uint32_t value
+    )
+    {
+        modifyReg( m_base+LIBRORC_REGFILE_DDL+addr, mask, value);
+    }
+
+
+    void
+    link::modifyPciReg
+    (
+        uint32_t addr,
+        uint32_t mask,
+        uint32_t value
+    )
+    {
+        modifyReg( m_base+LIBRORC_REGFILE_PCI+addr, mask, value);
+    }
+
+
+    bar_address
+    link::gtxAddress(uint32_t addr)
+    {
+        return m_base+LIBRORC_REGFILE_GTX+addr;
+    }
+
+
+    bar_address
+    link::ddlAddress(uint32_t addr)
+    {
+        return m_base+LIBRORC_REGFILE_DDL+addr;
+    }
+
+
+    bar_address
+    link::pciAddress(uint32_t addr)
+    {
+        return m_base+LIBRORC_REGFILE_PCI+addr;
+    }
+
+
+    size_t
+    link::apply
+    (
+        bar::transaction &t
+    )
+    {
+        size_t bursts = t.apply(m_base);
+        invalidateShadow();
+        return bursts;
+    }
+
+
     void
     link::memcopy
     (
@@ -205,10 +316,7 @@ namespace LIBRARY_NAME
         uint32_t enable
     )
     {
-        uint32_t ddlctrl = ddlReg(RORC_REG_DDL_CTRL);
-        ddlctrl &= ~(1<<1); // clear bit
-        ddlctrl |= ((enable & 1)<<1); // set new value
-        setDdlReg(RORC_REG_DDL_CTRL, ddlctrl);
+        modifyDdlReg(RORC_REG_DDL_CTRL, (1<<1), ((enable & 1)<<1));
     }
 
 
@@ -218,10 +326,7 @@ namespace LIBRARY_NAME
         uint32_t active
     )
     {
-        uint32_t ddlctrl = ddlReg(RORC_REG_DDL_CTRL);
-        ddlctrl &= ~(1<<3); // clear bit
-        ddlctrl |= ((active & 1)<<3); // set new value
-        setDdlReg(RORC_REG_DDL_CTRL, ddlctrl);
+        modifyDdlReg(RORC_REG_DDL_CTRL, (1<<3), ((active & 1)<<3));
     }
 
 
@@ -316,10 +421,52 @@ namespace LIBRARY_NAME
 
     void link::setDataSourceMux( uint32_t value )
     {
-        uint32_t ddlctrl = ddlReg(RORC_REG_DDL_CTRL);
-        ddlctrl &= ~(3<<16);
-        ddlctrl |= ((value&3)<<16);
-        setDdlReg(RORC_REG_DDL_CTRL, ddlctrl);
+        modifyDdlReg(RORC_REG_DDL_CTRL, (3<<16), ((value&3)<<16));
+    }
+
+    int link::shadowIndex( bar_address addr )
+    {
+        for( int i=0; i<LIBRORC_LINK_SHADOW_REGS; i++ )
+        {
+            if( addr == (m_base + shadow_regs[i].regfile + shadow_regs[i].addr) )
+            { return i; }
+        }
+        return -1;
+    }
+
+    void link::setReg( bar_address addr, uint32_t data )
+    {
+        m_bar->set32(addr, data);
+        if( m_shadow_enabled )
+        {
+            int idx = shadowIndex(addr);
+            if( idx >= 0 )
+            {
+                m_shadow[idx] = data;
+                m_shadow_valid |= (1<<idx);
+            }
+        }
+    }
+
+    void link::modifyReg( bar_address addr, uint32_t mask, uint32_t value )
+    {
+        uint32_t current;
+        int idx = (m_shadow_enabled) ? shadowIndex(addr) : -1;
+        if( idx >= 0 )
+        {
+            if( !(m_shadow_valid & (1<<idx)) )
+            {
+                m_shadow[idx] = m_bar->get32(addr);
+                m_shadow_valid |= (1<<idx);
+            }
+            current = (m_shadow[idx] & ~shadow_regs[idx].volatile_mask);
+        }
+        else
+        { current = m_bar->get32(addr); }
+
+        current &= ~mask;
+        current |= (value & mask);
+        setReg(addr, current);
     }
 
     uint32_t link::getDataSourceMux()
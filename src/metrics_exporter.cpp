@@ -0,0 +1,519 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <cstdio>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <librorc/metrics_exporter.hh>
+#include <librorc/device.hh>
+#include <librorc/bar.hh>
+#include <librorc/sysmon.hh>
+#include <librorc/link.hh>
+#include <librorc/dma_channel.hh>
+#include <librorc/registers.h>
+
+namespace LIBRARY_NAME
+{
+
+#define EXPORTER_MAX_DEVICES 256
+/** time a socket client gets to send its request */
+#define EXPORTER_CLIENT_TIMEOUT_MS 100
+
+    typedef struct
+    {
+        const char *name;
+        const char *type;
+        const char *help;
+    } metric_description;
+
+    /** indexed by metrics_exporter_metric */
+    static const metric_description metrics[kMetricCount] =
+    {
+        { "librorc_dma_enabled", "gauge",
+          "DMA engine enable state" },
+        { "librorc_dma_events_total", "counter",
+          "events received by the event stream" },
+        { "librorc_dma_bytes_total", "counter",
+          "bytes received by the event stream" },
+        { "librorc_dma_errors_total", "counter",
+          "event stream errors" },
+        { "librorc_dma_event_rate", "gauge",
+          "events per second since the previous sample" },
+        { "librorc_dma_byte_rate", "gauge",
+          "bytes per second since the previous sample" },
+        { "librorc_dma_engine_events_total", "counter",
+          "events processed by the DMA engine" },
+        { "librorc_dma_stall_cycles_total", "counter",
+          "cycles the DMA engine waited for the PCIe interface" },
+        { "librorc_dma_deadtime_cycles_total", "counter",
+          "cycles the DMA input FIFO was full while the link was active" },
+        { "librorc_ddl_deadtime_cycles_total", "counter",
+          "DDL deadtime cycles" },
+        { "librorc_dma_eb_occupancy_ratio", "gauge",
+          "filled fraction of the event buffer" },
+        { "librorc_dma_rb_occupancy_ratio", "gauge",
+          "filled fraction of the report buffer" },
+    };
+
+
+    static uint64_t
+    monotonicNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+
+
+    /** fill state of a ring from DMA write offset and read offset */
+    static double
+    occupancy
+    (
+        uint64_t write_offset,
+        uint64_t read_offset,
+        uint64_t size
+    )
+    {
+        if( size == 0 )
+        { return 0.0; }
+        return (double)((write_offset + size - read_offset) % size) / size;
+    }
+
+
+    metrics_exporter::metrics_exporter()
+    {
+        m_socket = -1;
+        m_last_sample_ns = 0;
+    }
+
+
+
+    metrics_exporter::~metrics_exporter()
+    {
+        if( m_socket >= 0 )
+        {
+            close(m_socket);
+            unlink(m_socket_path.c_str());
+        }
+
+        for( size_t i=0; i<m_devices.size(); i++ )
+        {
+            exporter_device *d = &m_devices[i];
+            for( size_t ch=0; ch<d->channels.size(); ch++ )
+            {
+                delete d->channels[ch];
+                delete d->links[ch];
+                if( d->status[ch] )
+                { shmdt(d->status[ch]); }
+            }
+            delete d->sm;
+            if( d->owned )
+            {
+                delete d->dbar;
+                delete d->dev;
+            }
+        }
+    }
+
+
+
+    int
+    metrics_exporter::addDevice
+    (
+        uint32_t device_number
+    )
+    {
+        device *dev = NULL;
+        bar *b = NULL;
+        try
+        {
+            dev = new device(device_number);
+            b = new bar(dev, 1);
+        }
+        catch(...)
+        {
+            delete dev;
+            return -1;
+        }
+
+        if( addBar(b, device_number) < 0 )
+        {
+            delete b;
+            delete dev;
+            return -1;
+        }
+        m_devices.back().dev = dev;
+        m_devices.back().owned = true;
+        return 0;
+    }
+
+
+
+    uint32_t
+    metrics_exporter::addAllDevices()
+    {
+        uint32_t count = 0;
+        while( count < EXPORTER_MAX_DEVICES && addDevice(count) == 0 )
+        { count++; }
+        return count;
+    }
+
+
+
+    int
+    metrics_exporter::addBar
+    (
+        bar      *b,
+        uint32_t  device_number
+    )
+    {
+        exporter_device d;
+        d.dev = NULL;
+        d.dbar = b;
+        d.number = device_number;
+        d.owned = false;
+        try
+        { d.sm = new sysmon(b); }
+        catch(...)
+        { return -1; }
+
+        uint32_t nchannels = d.sm->numberOfChannels();
+        for( uint32_t ch=0; ch<nchannels; ch++ )
+        {
+            link *l = new link(b, ch);
+            d.links.push_back(l);
+            d.channels.push_back(new dma_channel(l));
+            d.status.push_back(NULL);
+
+            metrics_exporter_channel c;
+            memset(&c, 0, sizeof(c));
+            c.device = device_number;
+            c.channel = ch;
+            m_channels.push_back(c);
+        }
+        m_devices.push_back(d);
+        return 0;
+    }
+
+
+
+    uint32_t
+    metrics_exporter::numberOfChannels()
+    {
+        return m_channels.size();
+    }
+
+
+
+    void
+    metrics_exporter::sample()
+    {
+        uint64_t now = monotonicNs();
+        double interval = m_last_sample_ns ?
+            (now - m_last_sample_ns) / 1000000000.0 : 0.0;
+        m_last_sample_ns = now;
+
+        size_t index = 0;
+        for( size_t i=0; i<m_devices.size(); i++ )
+        {
+            exporter_device *d = &m_devices[i];
+            for( uint32_t ch=0; ch<d->channels.size(); ch++ )
+            { sampleChannel(d, ch, &m_channels[index++], interval); }
+        }
+        render();
+    }
+
+
+
+    int
+    metrics_exporter::writeFile
+    (
+        const char *filename
+    )
+    {
+        char tmpname[4096];
+        snprintf(tmpname, sizeof(tmpname), "%s.tmp.%d", filename, getpid());
+
+        FILE *fd = fopen(tmpname, "w");
+        if( fd == NULL )
+        { return -1; }
+        size_t written = fwrite(m_exposition.data(), 1,
+                                m_exposition.size(), fd);
+        if( fclose(fd) != 0 || written != m_exposition.size() ||
+            rename(tmpname, filename) != 0 )
+        {
+            unlink(tmpname);
+            return -1;
+        }
+        return 0;
+    }
+
+
+
+    int
+    metrics_exporter::listenSocket
+    (
+        const char *path
+    )
+    {
+        struct sockaddr_un addr;
+        if( strlen(path) >= sizeof(addr.sun_path) )
+        { return -1; }
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if( fd < 0 )
+        { return -1; }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+        unlink(path);
+
+        if( bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+            listen(fd, 16) != 0 )
+        {
+            close(fd);
+            return -1;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        if( m_socket >= 0 )
+        {
+            close(m_socket);
+            unlink(m_socket_path.c_str());
+        }
+        m_socket = fd;
+        m_socket_path = path;
+        return 0;
+    }
+
+
+
+    int
+    metrics_exporter::serve
+    (
+        uint32_t timeout_ms
+    )
+    {
+        if( m_socket < 0 )
+        { return -1; }
+
+        int served = 0;
+        uint64_t end = monotonicNs() + (uint64_t)timeout_ms * 1000000;
+        uint64_t now;
+        while( (now = monotonicNs()) < end )
+        {
+            struct pollfd pfd;
+            pfd.fd = m_socket;
+            pfd.events = POLLIN;
+            int ret = poll(&pfd, 1, (end - now + 999999) / 1000000);
+            if( ret < 0 && errno != EINTR )
+            { break; }
+            if( ret <= 0 )
+            { continue; }
+
+            int client = accept(m_socket, NULL, NULL);
+            if( client < 0 )
+            { continue; }
+            serveClient(client);
+            close(client);
+            served++;
+        }
+        return served;
+    }
+
+
+
+    /**********************************************************
+     *                  protected
+     * *******************************************************/
+    void
+    metrics_exporter::sampleChannel
+    (
+        exporter_device          *d,
+        uint32_t                  ch,
+        metrics_exporter_channel *out,
+        double                    interval
+    )
+    {
+        dma_channel *dma = d->channels[ch];
+        link *l = d->links[ch];
+        uint32_t valid = 0;
+
+        /** the event stream may have been started after us */
+        if( d->status[ch] == NULL )
+        {
+            int shID = shmget(SHM_KEY_OFFSET + d->number * SHM_DEV_OFFSET + ch,
+                              sizeof(ChannelStatus), 0);
+            if( shID != -1 )
+            {
+                void *shm = shmat(shID, 0, SHM_RDONLY);
+                if( shm != (void *)-1 )
+                { d->status[ch] = (ChannelStatus *)shm; }
+            }
+        }
+
+        bool enabled = dma->getEnable();
+        out->values[kMetricEnabled] = enabled;
+        out->values[kMetricEngineEvents] = dma->eventCount();
+        out->values[kMetricStallCycles] = dma->stallCount();
+        valid |= (1<<kMetricEnabled) | (1<<kMetricEngineEvents) |
+            (1<<kMetricStallCycles);
+
+        if( enabled )
+        {
+            out->values[kMetricEbOccupancy] = occupancy(
+                    dma->getEBDMAOffset(), dma->getEBOffset(),
+                    dma->getEBSize());
+            out->values[kMetricRbOccupancy] = occupancy(
+                    dma->getRBDMAOffset(), dma->getRBOffset(),
+                    dma->getRBSize());
+            valid |= (1<<kMetricEbOccupancy) | (1<<kMetricRbOccupancy);
+        }
+
+        uint32_t type = l->linkType();
+        if( (type == RORC_CFG_LINK_TYPE_DIU ||
+             type == RORC_CFG_LINK_TYPE_SIU) && l->isDdlDomainReady() )
+        {
+            out->values[kMetricDmaDeadtime] =
+                l->ddlReg(RORC_REG_DDL_DMA_DEADTIME);
+            out->values[kMetricDdlDeadtime] =
+                l->ddlReg(RORC_REG_DDL_DEADTIME);
+            valid |= (1<<kMetricDmaDeadtime) | (1<<kMetricDdlDeadtime);
+        }
+
+        ChannelStatus *status = d->status[ch];
+        if( status )
+        {
+            uint64_t events = status->n_events;
+            uint64_t bytes = status->bytes_received;
+            out->values[kMetricEvents] = events;
+            out->values[kMetricBytes] = bytes;
+            out->values[kMetricErrors] = status->error_count;
+            valid |= (1<<kMetricEvents) | (1<<kMetricBytes) |
+                (1<<kMetricErrors);
+
+            /** no rate on the first sample or after a counter reset */
+            bool had_status = (out->valid & (1<<kMetricEvents)) != 0;
+            if( interval > 0.0 && had_status &&
+                events >= out->last_events && bytes >= out->last_bytes )
+            {
+                out->values[kMetricEventRate] =
+                    (events - out->last_events) / interval;
+                out->values[kMetricByteRate] =
+                    (bytes - out->last_bytes) / interval;
+                valid |= (1<<kMetricEventRate) | (1<<kMetricByteRate);
+            }
+            out->last_events = events;
+            out->last_bytes = bytes;
+        }
+
+        out->valid = valid;
+    }
+
+
+
+    void
+    metrics_exporter::render()
+    {
+        std::string text;
+        char line[256];
+        for( uint32_t m=0; m<kMetricCount; m++ )
+        {
+            snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n",
+                     metrics[m].name, metrics[m].help,
+                     metrics[m].name, metrics[m].type);
+            text += line;
+            for( size_t i=0; i<m_channels.size(); i++ )
+            {
+                const metrics_exporter_channel *c = &m_channels[i];
+                if( !(c->valid & (1<<m)) )
+                { continue; }
+                snprintf(line, sizeof(line),
+                         "%s{device=\"%u\",channel=\"%u\"} %.15g\n",
+                         metrics[m].name, c->device, c->channel,
+                         c->values[m]);
+                text += line;
+            }
+        }
+        m_exposition = text;
+    }
+
+
+
+    void
+    metrics_exporter::serveClient
+    (
+        int fd
+    )
+    {
+        /** a plain connect gets the bare exposition, Prometheus style
+         *  HTTP clients send a request first */
+        char request[4096];
+        ssize_t len = 0;
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if( poll(&pfd, 1, EXPORTER_CLIENT_TIMEOUT_MS) > 0 )
+        { len = recv(fd, request, sizeof(request), MSG_DONTWAIT); }
+
+        std::string reply;
+        if( len >= 4 && strncmp(request, "GET ", 4) == 0 )
+        {
+            char header[256];
+            snprintf(header, sizeof(header),
+                     "HTTP/1.0 200 OK\r\n"
+                     "Content-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %lu\r\n\r\n",
+                     (unsigned long)m_exposition.size());
+            reply = header;
+        }
+        reply += m_exposition;
+
+        size_t sent = 0;
+        while( sent < reply.size() )
+        {
+            ssize_t ret = send(fd, reply.data() + sent, reply.size() - sent,
+                               MSG_NOSIGNAL);
+            if( ret <= 0 )
+            { break; }
+            sent += ret;
+        }
+    }
+
+}
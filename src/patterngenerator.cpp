@@ -54,9 +54,8 @@ namespace LIBRARY_NAME
     void
     patterngenerator::enable()
     {
-        uint32_t ddlctrl = m_link->ddlReg(RORC_REG_DDL_CTRL);
-        ddlctrl |= (1<<8); // enable PatternGenerator
-        m_link->setDdlReg(RORC_REG_DDL_CTRL, ddlctrl);
+        // enable PatternGenerator
+        m_link->modifyDdlReg(RORC_REG_DDL_CTRL, (1<<8), (1<<8));
     }
 
 
@@ -88,13 +87,10 @@ namespace LIBRARY_NAME
     void
     patterngenerator::resetEventId()
     {
-        uint32_t ddlctrl = m_link->ddlReg(RORC_REG_DDL_CTRL);
         // set eventid_rst
-        ddlctrl |= (1<<9);
-        m_link->setDdlReg(RORC_REG_DDL_CTRL, ddlctrl);
+        m_link->modifyDdlReg(RORC_REG_DDL_CTRL, (1<<9), (1<<9));
         // release eventid_rst
-        ddlctrl &= ~(1<<9);
-        m_link->setDdlReg(RORC_REG_DDL_CTRL, ddlctrl);
+        m_link->modifyDdlReg(RORC_REG_DDL_CTRL, (1<<9), 0);
     }
 
 
@@ -105,9 +101,8 @@ namespace LIBRARY_NAME
     )
     {
         m_link->setDdlReg(RORC_REG_DDL_PG_EVENT_LENGTH, eventSize);
-        uint32_t ddlctrl = m_link->ddlReg(RORC_REG_DDL_CTRL);
-        ddlctrl &= ~(1<<13); // static event size
-        m_link->setDdlReg(RORC_REG_DDL_CTRL, ddlctrl);
+        // static event size
+        m_link->modifyDdlReg(RORC_REG_DDL_CTRL, (1<<13), 0);
     }
 
 
@@ -121,9 +116,8 @@ namespace LIBRARY_NAME
         uint32_t eventSize = (prbs_max_size_mask & 0xffff0000) |
             prbs_min_size;
         m_link->setDdlReg(RORC_REG_DDL_PG_EVENT_LENGTH, eventSize);
-        uint32_t ddlctrl = m_link->ddlReg(RORC_REG_DDL_CTRL);
-        ddlctrl |= (1<<13); // PRBS event size
-        m_link->setDdlReg(RORC_REG_DDL_CTRL, ddlctrl);
+        // PRBS event size
+        m_link->modifyDdlReg(RORC_REG_DDL_CTRL, (1<<13), (1<<13));
     }
 
 
@@ -135,7 +129,7 @@ namespace LIBRARY_NAME
         uint32_t numberOfEvents
     )
     {
-        uint32_t ddlctrl = m_link->ddlReg(RORC_REG_DDL_CTRL);
+        uint32_t ddlctrl = 0;
         /**
          * allow only implemented PatternGenerator Modes:
          * PG_PATTERN_INC, PG_PATTERN_DEC,
@@ -143,7 +137,6 @@ namespace LIBRARY_NAME
          * TODO: report/break on invalid mode
          **/
 
-        ddlctrl &= ~(3<<11); // clear current mode setting
         if( patternMode==PG_PATTERN_DEC ||
                 patternMode==PG_PATTERN_SHIFT ||
                 patternMode==PG_PATTERN_TOGGLE )
@@ -154,14 +147,15 @@ namespace LIBRARY_NAME
 
         if(numberOfEvents)
         {
-            ddlctrl &= ~(1<<10); // disable continuous mode
+            // disable continuous mode
             m_link->setDdlReg(RORC_REG_DDL_PG_NUM_EVENTS, numberOfEvents);
         }
         else
         {
             ddlctrl |= (1<<10); // enable continuous mode
         }
-        m_link->setDdlReg(RORC_REG_DDL_CTRL, ddlctrl);
+        // replace mode setting [12:11] and continuous mode flag [10]
+        m_link->modifyDdlReg(RORC_REG_DDL_CTRL, (7<<10), ddlctrl);
     }
 
 
@@ -175,9 +169,6 @@ namespace LIBRARY_NAME
     void
     patterngenerator::useAsDataSource()
     {
-        uint32_t ddlctrl = m_link->ddlReg(RORC_REG_DDL_CTRL);
-        ddlctrl &= ~(3<<16);
-        ddlctrl |= (2<<16); // set MUX to 2
-        m_link->setDdlReg(RORC_REG_DDL_CTRL, ddlctrl);
+        m_link->modifyDdlReg(RORC_REG_DDL_CTRL, (3<<16), (2<<16)); // set MUX to 2
     }
 }
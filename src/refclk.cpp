@@ -244,6 +244,9 @@ namespace LIBRARY_NAME
         refclkopts opts
     )
     {
+        /** keep other processes off the chain while the DCO is frozen */
+        i2c_chain_lock lock(m_sysmon, LIBRORC_REFCLK_I2C_CHAIN);
+
         // Freeze oscillator
         setFreezeDCO();
 
@@ -287,6 +290,8 @@ namespace LIBRARY_NAME
     void
     refclk::reset()
     {
+        i2c_chain_lock lock(m_sysmon, LIBRORC_REFCLK_I2C_CHAIN);
+
         /** Recall initial conditions */
         setRFMCtrl( M_RECALL );
         /** Wait for RECALL to complete */
@@ -301,6 +306,8 @@ namespace LIBRARY_NAME
     void
     refclk::releaseDCO()
     {
+        i2c_chain_lock lock(m_sysmon, LIBRORC_REFCLK_I2C_CHAIN);
+
         // get current FREEZE_DCO settings
         uint8_t freeze_val = refclk_read(137);
 
@@ -323,6 +330,7 @@ namespace LIBRARY_NAME
     void
     refclk::setFreezeDCO()
     {
+        i2c_chain_lock lock(m_sysmon, LIBRORC_REFCLK_I2C_CHAIN);
         uint8_t val = refclk_read(137);
         val |= FREEZE_DCO;
         refclk_write(137, val);
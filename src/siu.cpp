@@ -73,8 +73,7 @@ namespace LIBRARY_NAME
     void
     siu::clearInterfaceCounters()
     {
-        m_link->setDdlReg(RORC_REG_DDL_CTRL,
-                m_link->ddlReg(RORC_REG_DDL_CTRL)|(1<<2));
+        m_link->modifyDdlReg(RORC_REG_DDL_CTRL, (1<<2), (1<<2));
     }
 
     uint32_t
@@ -89,6 +88,17 @@ namespace LIBRARY_NAME
         m_link->setDdlReg(RORC_REG_DDL_FESTW, 0);
     }
 
+    void
+    siu::clearAllCounters()
+    {
+        bar::transaction t(m_link->getBar());
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_EC), 0);
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_DEADTIME), 0);
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_FESTW), 0);
+        t.set32(m_link->ddlAddress(RORC_REG_DDL_DMA_DEADTIME), 0);
+        m_link->apply(t);
+    }
+
     bool
     siu::isInterfaceFifoEmpty()
     {
@@ -35,6 +35,8 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/inotify.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <sstream>
 #include <cstring>
@@ -56,7 +58,14 @@ namespace LIBRARY_NAME {
 #define SYSFS_ATTR_DEVICE_ID "device"
 #define SYSFS_ATTR_VENDOR_ID "vendor"
 
-#define LIBRORC_DEFAULT_SPINS 21
+// maximum time to wait for an attribute to show up. This matches the total
+// duration of the former 21-step exponential backoff (~2s).
+#define LIBRORC_SYSFS_WAIT_TIMEOUT_US 2097152
+// polling interval bounds used as fallback if no inotify event is delivered.
+// sysfs does not reliably notify about files created by the kernel, so the
+// wait always re-checks the path at least every LIBRORC_SYSFS_POLL_MAX_US.
+#define LIBRORC_SYSFS_POLL_MIN_US 1
+#define LIBRORC_SYSFS_POLL_MAX_US 1024
 
 typedef struct {
   uint16_t vendor_id;
@@ -82,34 +91,127 @@ std::string getBufferAttributeName(uint64_t id, std::string name) {
   return std::string(SYSFS_ATTR_BUF_DIR) + idToStr(id) + "/" + name;
 }
 
-int spinOpen(const char *path, int flags,
-             uint64_t spins = LIBRORC_DEFAULT_SPINS) {
-  int fd = -1;
-  for (uint64_t i = 0; i < spins; i++) {
-    fd = open(path, flags);
-    if (fd != -1) {
+uint64_t monotonicUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * get the deepest already existing directory along path
+ **/
+std::string existingParentDir(std::string path) {
+  struct stat fstat;
+  size_t pos = path.find_last_of('/');
+  while (pos != std::string::npos && pos > 0) {
+    std::string dir = path.substr(0, pos);
+    if (stat(dir.c_str(), &fstat) == 0 && S_ISDIR(fstat.st_mode)) {
+      return dir;
+    }
+    pos = path.find_last_of('/', pos - 1);
+  }
+  return "/";
+}
+
+/**
+ * wait until path exists. An inotify watch on the deepest existing parent
+ * directory wakes the caller as soon as a new entry is created, the path is
+ * additionally re-checked with a bounded exponential backoff in case no
+ * event is delivered or inotify is not available.
+ * @return 0 if path exists, -1 on timeout with errno set to ETIMEDOUT
+ **/
+int waitForPath(const char *path, uint64_t timeout_us) {
+  struct stat fstat;
+  if (stat(path, &fstat) == 0) {
+    return 0;
+  }
+
+  uint64_t start = monotonicUs();
+  uint64_t interval = LIBRORC_SYSFS_POLL_MIN_US;
+  std::string watched_dir;
+  int wd = -1;
+  int ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  int ret = -1;
+
+  while (true) {
+    if (ifd != -1) {
+      // follow the path down as intermediate directories show up
+      std::string dir = existingParentDir(path);
+      if (dir != watched_dir) {
+        if (wd != -1) {
+          inotify_rm_watch(ifd, wd);
+        }
+        wd = inotify_add_watch(ifd, dir.c_str(),
+                               IN_CREATE | IN_MOVED_TO | IN_ATTRIB);
+        watched_dir = dir;
+      }
+    }
+
+    if (stat(path, &fstat) == 0) {
+      ret = 0;
       break;
     }
-    usleep(1 << i);
+
+    uint64_t elapsed = monotonicUs() - start;
+    if (elapsed >= timeout_us) {
+      errno = ETIMEDOUT;
+      break;
+    }
+    uint64_t slice = interval;
+    if (slice > timeout_us - elapsed) {
+      slice = timeout_us - elapsed;
+    }
+
+    if (wd != -1) {
+      struct pollfd pfd;
+      pfd.fd = ifd;
+      pfd.events = POLLIN;
+      struct timespec ts;
+      ts.tv_sec = slice / 1000000;
+      ts.tv_nsec = (slice % 1000000) * 1000;
+      if (ppoll(&pfd, 1, &ts, NULL) > 0) {
+        // drain pending events, the path is checked again anyway
+        char evbuf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        while (read(ifd, evbuf, sizeof(evbuf)) > 0) {
+        }
+      }
+    } else {
+      usleep(slice);
+    }
+
+    if (interval < LIBRORC_SYSFS_POLL_MAX_US) {
+      interval <<= 1;
+    }
+  }
+
+  if (ifd != -1) {
+    close(ifd);
+  }
+  return ret;
+}
+
+int spinOpen(const char *path, int flags,
+             uint64_t timeout_us = LIBRORC_SYSFS_WAIT_TIMEOUT_US) {
+  int fd = open(path, flags);
+  if (fd == -1 && errno == ENOENT && waitForPath(path, timeout_us) == 0) {
+    fd = open(path, flags);
   }
   return (fd);
 }
 
 int spinStat(const char *path, struct stat *fstat,
-             uint64_t spins = LIBRORC_DEFAULT_SPINS) {
-  int ret = -1;
-  for (uint64_t i = 0; i < spins; i++) {
+             uint64_t timeout_us = LIBRORC_SYSFS_WAIT_TIMEOUT_US) {
+  int ret = stat(path, fstat);
+  if (ret == -1 && errno == ENOENT && waitForPath(path, timeout_us) == 0) {
     ret = stat(path, fstat);
-    if (ret != -1) {
-      break;
-    }
-    usleep(1 << i);
   }
   return ret;
 }
 
 /*************************** Base *********************************/
 sysfs_handler::sysfs_handler(uint32_t device_id, int scanmode) {
+  pthread_mutex_init(&m_hist_mtx, NULL);
+  reset_alloc_latency_histogram();
   // make sure kernel module is loaded
   if (!__attribute_exists(SYSFS_MOD_BASE)) {
     throw LIBRORC_DEVICE_ERROR_PDA_KMOD_MISMATCH;
@@ -132,7 +234,7 @@ sysfs_handler::sysfs_handler(uint32_t device_id, int scanmode) {
   }
 }
 
-sysfs_handler::~sysfs_handler(){};
+sysfs_handler::~sysfs_handler() { pthread_mutex_destroy(&m_hist_mtx); }
 
 int sysfs_handler::get_bin_attr(const char *attr) {
   std::string fname = m_sysfs_device_base + attr;
@@ -216,6 +318,7 @@ int sysfs_handler::allocate_buffer(uint64_t id, uint64_t size) {
     return -1;
   }
 
+  uint64_t start = monotonicUs();
   ssize_t nbytes = write(fd, &request, sizeof(request));
   if (nbytes <= 0) {
     std::cerr << "allocate_buffer: failed to write to " << fname << std::endl;
@@ -223,6 +326,24 @@ int sysfs_handler::allocate_buffer(uint64_t id, uint64_t size) {
     return -1;
   }
   close(fd);
+
+  // the kernel module creates the buffer attributes asynchronously: the
+  // buffer is mappable once both map and sg are available.
+  std::string mapname =
+      m_sysfs_device_base + getBufferAttributeName(id, SYSFS_ATTR_DMA_MAP);
+  std::string sgname =
+      m_sysfs_device_base + getBufferAttributeName(id, SYSFS_ATTR_DMA_SG);
+  if (waitForPath(mapname.c_str(), LIBRORC_SYSFS_WAIT_TIMEOUT_US) != 0 ||
+      waitForPath(sgname.c_str(), LIBRORC_SYSFS_WAIT_TIMEOUT_US) != 0) {
+    std::cerr << "allocate_buffer: timeout waiting for " << mapname
+              << std::endl;
+    record_alloc_latency(0, true);
+    // the request was accepted: hand the buffer back instead of leaking
+    // it until someone frees it manually.
+    deallocate_buffer(id);
+    return -1;
+  }
+  record_alloc_latency(monotonicUs() - start, false);
   return 0;
 }
 
@@ -302,6 +423,20 @@ std::vector<uint64_t> sysfs_handler::list_all_buffers() {
   return bufferlist;
 }
 
+sysfs_latency_histogram sysfs_handler::get_alloc_latency_histogram() {
+  pthread_mutex_lock(&m_hist_mtx);
+  sysfs_latency_histogram hist = m_alloc_hist;
+  pthread_mutex_unlock(&m_hist_mtx);
+  return hist;
+}
+
+void sysfs_handler::reset_alloc_latency_histogram() {
+  pthread_mutex_lock(&m_hist_mtx);
+  memset(&m_alloc_hist, 0, sizeof(m_alloc_hist));
+  m_alloc_hist.min_us = ~(uint64_t)0;
+  pthread_mutex_unlock(&m_hist_mtx);
+}
+
 /***************** Scatter-Gather-List Handling ******************************/
 int sysfs_handler::mmap_sglist(void **map, uint64_t id, ssize_t size) {
   return mmap_file(map, getBufferAttributeName(id, SYSFS_ATTR_DMA_SG), size,
@@ -435,6 +570,28 @@ int64_t sysfs_handler::__get_char_attr(std::string attr_path, int nbytes) {
   return strtoll(str, NULL, 0);
 }
 
+void sysfs_handler::record_alloc_latency(uint64_t latency_us, bool timeout) {
+  pthread_mutex_lock(&m_hist_mtx);
+  if (timeout) {
+    m_alloc_hist.timeouts++;
+  } else {
+    uint32_t bin = 0;
+    while ((latency_us >> (bin + 1)) && bin < (LIBRORC_SYSFS_LATENCY_BINS - 1)) {
+      bin++;
+    }
+    m_alloc_hist.bin[bin]++;
+    m_alloc_hist.count++;
+    m_alloc_hist.sum_us += latency_us;
+    if (latency_us < m_alloc_hist.min_us) {
+      m_alloc_hist.min_us = latency_us;
+    }
+    if (latency_us > m_alloc_hist.max_us) {
+      m_alloc_hist.max_us = latency_us;
+    }
+  }
+  pthread_mutex_unlock(&m_hist_mtx);
+}
+
 int sysfs_handler::write_ids_to_kernel_module() {
   std::string fname = std::string(SYSFS_MOD_BASE) + SYSFS_ATTR_NEW_ID;
   FILE *fp = fopen(fname.c_str(), "w");
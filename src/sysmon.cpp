@@ -28,18 +28,28 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
  *
- * TODO/Note: i2c_reset, i2c_read_mem and i2c_write_mem shall not be
- * called from parallel processes. This may result in deadlocks or
- * data corruption.
+ * Note: I2C transactions are serialized by a robust process-shared
+ * mutex on the I2C module, multi-transaction sequences additionally
+ * hold the lock of their chain. The locks live in SysV shared memory
+ * per device, so monitoring and control tools can run in parallel.
  * */
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/time.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 
 #include <librorc/error.hh>
 #include <librorc/sysmon.hh>
 #include <librorc/registers.h>
 #include <librorc/bar.hh>
+#include <librorc/bar_profiler.hh>
+#include <librorc/device.hh>
 
 namespace LIBRARY_NAME
 {
@@ -48,8 +58,19 @@ namespace LIBRARY_NAME
 #define I2C_READ                (1<<1)
 #define I2C_WRITE               (1<<2)
 #define DDR3_SPD_SLVADDR        0x50
+/** I2C completion poll interval, doubled up to the maximum while busy */
+#define I2C_CMPL_POLL_MIN_US    10
+#define I2C_CMPL_POLL_MAX_US    100
+/** lock index of the I2C module, behind the chain locks */
+#define I2C_LOCK_MODULE         LIBRORC_SYSMON_I2C_CHAINS
+/** max time a releasing owner waits for a waiter to take over */
+#define I2C_LOCK_HANDOFF_US     1000
+/** max time to wait for a dead owner's transaction to finish */
+#define I2C_LOCK_RECOVER_POLLS  1000
 
 #define SYSMON_DR_TIMEOUT 10000
+/** write done polls without sleeping before falling back to usleep */
+#define SYSMON_DR_SPIN 64
 #define DATA_REPLAY_C0_WRITE_DONE (1<<0)
 #define DATA_REPLAY_C1_WRITE_DONE (1<<1)
 #define DATA_REPLAY_EOE (1<<8)
@@ -72,12 +93,40 @@ namespace LIBRARY_NAME
 
         /** default to 100 kHz I2C speed */
         m_i2c_hsmode = 0;
+
+        /** process local I2C locks unless the device is known */
+        m_i2c_locks = new sysmon_i2c_locks;
+        m_i2c_locks_shared = false;
+        m_i2c_lock_timeout_ms = LIBRORC_SYSMON_I2C_LOCK_TIMEOUT_MS;
+        i2c_lock_init(m_i2c_locks);
+        if( m_bar->getDevice() &&
+            i2cShareLock(m_bar->getDevice()->getDeviceId()) != 0 )
+        {
+            /** process local locks would not protect against other
+             *  processes on the same device */
+            for( uint32_t i=0; i<=I2C_LOCK_MODULE; i++ )
+            { pthread_mutex_destroy(&m_i2c_locks->lock[i].mtx); }
+            delete m_i2c_locks;
+            throw LIBRORC_SYSMON_ERROR_I2C_LOCK_FAILED;
+        }
+
+        pthread_mutex_init(&m_dr_mtx, NULL);
+        m_dr_pending = 0;
     }
 
 
 
     sysmon::~sysmon()
     {
+        pthread_mutex_destroy(&m_dr_mtx);
+        if( m_i2c_locks_shared )
+        { shmdt((void *)m_i2c_locks); }
+        else
+        {
+            for( uint32_t i=0; i<=I2C_LOCK_MODULE; i++ )
+            { pthread_mutex_destroy(&m_i2c_locks->lock[i].mtx); }
+            delete m_i2c_locks;
+        }
         m_bar = NULL;
     }
 
@@ -469,6 +518,7 @@ namespace LIBRARY_NAME
         uint8_t index
     )
     {
+        i2c_chain_lock lock(this, index);
         qsfp_select_page0(index);
         return( qsfp_i2c_string_readout(index, 148, 163) );
     }
@@ -481,6 +531,7 @@ namespace LIBRARY_NAME
         uint8_t index
     )
     {
+        i2c_chain_lock lock(this, index);
         qsfp_select_page0(index);
         return( qsfp_i2c_string_readout(index, 168, 183) );
     }
@@ -493,6 +544,7 @@ namespace LIBRARY_NAME
         uint8_t index
     )
     {
+        i2c_chain_lock lock(this, index);
         qsfp_select_page0(index);
         return( qsfp_i2c_string_readout(index, 196, 211) );
     }
@@ -505,6 +557,7 @@ namespace LIBRARY_NAME
         uint8_t index
     )
     {
+        i2c_chain_lock lock(this, index);
         qsfp_select_page0(index);
         return( qsfp_i2c_string_readout(index, 184, 185) );
     }
@@ -517,13 +570,10 @@ namespace LIBRARY_NAME
         uint8_t index
     )
     {
-        uint8_t data_r;
-        data_r = i2c_read_mem(index, QSFP_I2C_SLVADDR, 23);
-
-        uint32_t temp = data_r;
-        data_r = i2c_read_mem(index, QSFP_I2C_SLVADDR, 22);
+        uint8_t data_r[2];
+        i2c_read_mem_seq(index, QSFP_I2C_SLVADDR, 22, data_r, 2);
 
-        temp += ((uint32_t)data_r<<8);
+        uint32_t temp = ((uint32_t)data_r[0]<<8) | data_r[1];
 
         return ((float)temp/256);
     }
@@ -538,8 +588,9 @@ namespace LIBRARY_NAME
     {
         /** voltage is 16bit unsigned integer (0 to 65535) with
          * LSB equal to 100 uVolt. This gives a range of 0-6.55 Volts. */
-        uint16_t voltage = (i2c_read_mem(index, QSFP_I2C_SLVADDR, 26)<<8) |
-            i2c_read_mem(index, QSFP_I2C_SLVADDR, 27);
+        uint8_t data_r[2];
+        i2c_read_mem_seq(index, QSFP_I2C_SLVADDR, 26, data_r, 2);
+        uint16_t voltage = (data_r[0]<<8) | data_r[1];
         return voltage/10000.0;
     }
 
@@ -554,8 +605,9 @@ namespace LIBRARY_NAME
     {
         /** TX bias current is a 16b uint16_t
          * with LSB equal to 2 uA */
-        uint16_t ubias = (i2c_read_mem(index, QSFP_I2C_SLVADDR, 42+2*channel)<<8) |
-            i2c_read_mem(index, QSFP_I2C_SLVADDR, 43+2*channel);
+        uint8_t data_r[2];
+        i2c_read_mem_seq(index, QSFP_I2C_SLVADDR, 42+2*channel, data_r, 2);
+        uint16_t ubias = (data_r[0]<<8) | data_r[1];
         /** return in mA */
         return ubias*0.002;
     }
@@ -571,8 +623,9 @@ namespace LIBRARY_NAME
     {
         /** RX received optical power is a 16b uint16_t
          * with LSB equal to 0.1 uWatt */
-        uint16_t upower = (i2c_read_mem(index, QSFP_I2C_SLVADDR, 34+2*channel)<<8) |
-            i2c_read_mem(index, QSFP_I2C_SLVADDR, 35+2*channel);
+        uint8_t data_r[2];
+        i2c_read_mem_seq(index, QSFP_I2C_SLVADDR, 34+2*channel, data_r, 2);
+        uint16_t upower = (data_r[0]<<8) | data_r[1];
         /** return in mWatt */
         return upower/10000.0;
     }
@@ -585,12 +638,14 @@ namespace LIBRARY_NAME
         uint8_t index
     )
     {
+        i2c_chain_lock lock(this, index);
         qsfp_select_page0(index);
 
         /** Wavelengthis provided as uint16_t
          * with LSB equal to 0.05 nm */
-        uint16_t uwl = (i2c_read_mem(index, QSFP_I2C_SLVADDR, 186)<<8) |
-            i2c_read_mem(index, QSFP_I2C_SLVADDR, 187);
+        uint8_t data_r[2];
+        i2c_read_mem_seq(index, QSFP_I2C_SLVADDR, 186, data_r, 2);
+        uint16_t uwl = (data_r[0]<<8) | data_r[1];
         /** return in nm */
         return uwl * 0.05;
     }
@@ -620,14 +675,16 @@ namespace LIBRARY_NAME
         uint8_t index
     )
     {
+        i2c_chain_lock lock(this, index);
         qsfp_select_page0(index);
         /**
          * rate selection support:
          * page 0, byte 221, bits [3:2] and
          * page 0, byte 195, bit 5
          * */
-        uint8_t options = i2c_read_mem(index, QSFP_I2C_SLVADDR, 195);
-        uint8_t enh_options = i2c_read_mem(index, QSFP_I2C_SLVADDR, 221);
+        uint16_t opts = i2c_read_mem_dual(index, QSFP_I2C_SLVADDR, 195, 221);
+        uint8_t options = (opts & 0xff);
+        uint8_t enh_options = (opts>>8);
         uint8_t ext_rate_sel = i2c_read_mem(index, QSFP_I2C_SLVADDR, 141);
 
         /** enh_options[3:2]==0 and options[5]==0 */
@@ -761,18 +818,64 @@ namespace LIBRARY_NAME
         uint8_t memaddr
     )
     {
+        LIBRORC_PROFILE_SCOPE("sysmon::i2c");
         uint32_t opdata = memaddr;
-        m_bar->set32(RORC_REG_I2C_OPERATION, opdata);
+        uint32_t result = i2c_transaction(chain, slvaddr, I2C_READ,
+                1, opdata); /** byte_enable */
+
+        return ((result>>8) & 0xff);
+    }
+
+
+
+    uint16_t
+    sysmon::i2c_read_mem_dual
+    (
+        uint8_t chain,
+        uint8_t slvaddr,
+        uint8_t memaddr0,
+        uint8_t memaddr1
+    )
+    {
+        LIBRORC_PROFILE_SCOPE("sysmon::i2c");
+        uint32_t opdata = (memaddr1<<16) | (memaddr0);
+        uint32_t result = i2c_transaction(chain, slvaddr, I2C_READ,
+                3, opdata); /** byte_enable */
+
+        /** data0 in [15:8], data1 in [31:24] */
+        return ( ((result>>16) & 0xff00) | ((result>>8) & 0xff) );
+    }
 
-        i2c_module_start(chain, 
-                slvaddr,
-                I2C_READ,
-                m_i2c_hsmode, /** mode */
-                1); /** byte_enable */
 
-        i2c_wait_for_cmpl();
 
-        return ((m_bar->get32(RORC_REG_I2C_OPERATION)>>8) & 0xff);
+    void
+    sysmon::i2c_read_mem_seq
+    (
+        uint8_t  chain,
+        uint8_t  slvaddr,
+        uint8_t  memaddr,
+        uint8_t *data,
+        uint32_t length
+    )
+    {
+        if ( (uint32_t)memaddr + length > 256 )
+        {
+            throw LIBRORC_SYSMON_ERROR_I2C_INVALID_PARAM;
+        }
+
+        uint32_t i = 0;
+        for( ; i+1<length; i+=2 )
+        {
+            uint16_t pair = i2c_read_mem_dual(chain, slvaddr,
+                    memaddr+i, memaddr+i+1);
+            data[i]   = (pair & 0xff);
+            data[i+1] = (pair>>8);
+        }
+
+        if( i<length )
+        {
+            data[i] = i2c_read_mem(chain, slvaddr, memaddr+i);
+        }
     }
 
 
@@ -786,16 +889,10 @@ namespace LIBRARY_NAME
         uint8_t data
     )
     {
+        LIBRORC_PROFILE_SCOPE("sysmon::i2c");
         uint32_t opdata = (data<<8) | (memaddr);
-        m_bar->set32(RORC_REG_I2C_OPERATION, opdata);
-
-        i2c_module_start(chain, 
-                slvaddr,
-                I2C_WRITE,
-                m_i2c_hsmode, /** mode */
-                1); /** byte_enable */
-
-        i2c_wait_for_cmpl();
+        i2c_transaction(chain, slvaddr, I2C_WRITE,
+                1, opdata); /** byte_enable */
     }
 
 
@@ -811,20 +908,133 @@ namespace LIBRARY_NAME
         uint8_t data1
     )
     {
+        LIBRORC_PROFILE_SCOPE("sysmon::i2c");
         uint32_t opdata = (data1<<24) | (memaddr1<<16) | 
             (data0<<8) | (memaddr0);
-        m_bar->set32(RORC_REG_I2C_OPERATION, opdata);
+        i2c_transaction(chain, slvaddr, I2C_WRITE,
+                3, opdata); /** byte_enable */
+    }
+
+
+    int
+    sysmon::i2cShareLock
+    (
+        uint32_t device_number
+    )
+    {
+        size_t size = sizeof(sysmon_i2c_locks);
+        key_t key = LIBRORC_SYSMON_I2C_LOCK_SHM_KEY_OFFSET + device_number;
+
+        /** the creator initializes the mutexes, everybody else waits
+         *  for the magic to show up */
+        sysmon_i2c_locks *locks = NULL;
+        for( uint32_t attempt=0; attempt<2 && !locks; attempt++ )
+        {
+            bool creator = true;
+            int shID = shmget(key, size, IPC_CREAT | IPC_EXCL | 0666);
+            if( shID == -1 && errno == EEXIST )
+            {
+                creator = false;
+                shID = shmget(key, size, 0666);
+            }
+            if( shID == -1 )
+            { return -1; }
+
+            locks = (sysmon_i2c_locks *)shmat(shID, 0, 0);
+            if( locks == (sysmon_i2c_locks *)-1 )
+            { return -1; }
+
+            if( creator )
+            {
+                i2c_lock_init(locks);
+                break;
+            }
+
+            uint32_t timeout = 10000;
+            while( locks->magic != LIBRORC_SYSMON_I2C_LOCK_MAGIC &&
+                   timeout != 0 && !i2c_lock_creator_died(shID) )
+            {
+                usleep(100);
+                timeout--;
+            }
+            if( locks->magic != LIBRORC_SYSMON_I2C_LOCK_MAGIC )
+            {
+                /** a creator that died before writing the magic leaves
+                 *  a segment nobody initializes: remove it and start
+                 *  over with a new one */
+                shmdt((void *)locks);
+                locks = NULL;
+                if( !i2c_lock_creator_died(shID) )
+                { return -1; }
+                shmctl(shID, IPC_RMID, NULL);
+            }
+        }
+        if( !locks )
+        { return -1; }
+
+        if( m_i2c_locks_shared )
+        { shmdt((void *)m_i2c_locks); }
+        else
+        {
+            for( uint32_t i=0; i<=I2C_LOCK_MODULE; i++ )
+            { pthread_mutex_destroy(&m_i2c_locks->lock[i].mtx); }
+            delete m_i2c_locks;
+        }
+        m_i2c_locks = locks;
+        m_i2c_locks_shared = true;
+        return 0;
+    }
 
-        i2c_module_start(chain, 
-                slvaddr,
-                I2C_WRITE,
-                m_i2c_hsmode, /** mode */
-                3); /** byte_enable */
 
-        i2c_wait_for_cmpl();
+
+    void
+    sysmon::i2cSetLockTimeout
+    (
+        uint32_t timeout_ms
+    )
+    {
+        m_i2c_lock_timeout_ms = timeout_ms;
     }
 
 
+
+    void
+    sysmon::i2cLockChain
+    (
+        uint8_t chain
+    )
+    {
+        if( chain >= LIBRORC_SYSMON_I2C_CHAINS )
+        { throw LIBRORC_SYSMON_ERROR_I2C_INVALID_PARAM; }
+        i2c_lock_acquire(chain);
+    }
+
+
+
+    void
+    sysmon::i2cUnlockChain
+    (
+        uint8_t chain
+    )
+    {
+        if( chain >= LIBRORC_SYSMON_I2C_CHAINS )
+        { throw LIBRORC_SYSMON_ERROR_I2C_INVALID_PARAM; }
+        i2c_lock_release(chain);
+    }
+
+
+
+    uint32_t
+    sysmon::i2cLockRecoveries()
+    {
+        uint32_t recoveries = 0;
+        for( uint32_t i=0; i<=I2C_LOCK_MODULE; i++ )
+        { recoveries += m_i2c_locks->lock[i].recoveries; }
+        return recoveries;
+    }
+
+
+
     void
     sysmon::i2c_set_mode
     (
@@ -887,35 +1097,150 @@ namespace LIBRARY_NAME
          bool diu_error
     )
     {
-        uint32_t *dataptr = event_data;
-        uint32_t addr = ddr3_start_addr;
-        uint16_t mask = 0x7fff;
-        uint32_t flags = 0;
+        LIBRORC_PROFILE_SCOPE("sysmon::ddr3");
+        if ( channel>11 )
+        {
+            throw LIBRORC_SYSMON_ERROR_DATA_REPLAY_INVALID;
+        }
+
+        std::vector<ddr3_replay_event> events(1);
+        events[0].event_data      = event_data;
+        events[0].num_dws         = num_dws;
+        events[0].ddr3_start_addr = ddr3_start_addr;
+        events[0].channel         = channel;
+        events[0].last_event      = last_event;
+        events[0].diu_error       = diu_error;
+        events[0].next_addr       = ddr3_start_addr;
+
+        uint64_t blocks = 0;
+        ddr3DataReplayUploadController(events, (channel>5) ? 1 : 0, &blocks);
+        return events[0].next_addr;
+    }
+
+
+
+    typedef struct
+    {
+        sysmon                         *sm;
+        std::vector<ddr3_replay_event> *events;
+        uint32_t                        controller;
+        uint64_t                        blocks;
+        double                          seconds;
+        int                             error;
+    } ddr3_upload_thread_args;
 
-        while ( num_dws>0 )
+
+
+    static double
+    elapsedSeconds
+    (
+        struct timeval *start
+    )
+    {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        return (now.tv_sec - start->tv_sec) +
+            (now.tv_usec - start->tv_usec) / 1000000.0;
+    }
+
+
+
+    int
+    sysmon::ddr3DataReplayUpload
+    (
+        std::vector<ddr3_replay_event> &events,
+        ddr3_replay_upload_stats       *stats
+    )
+    {
+        ddr3_upload_thread_args args[2];
+        uint64_t bytes[2] = {0, 0};
+        for( uint32_t i=0; i<events.size(); i++ )
         {
-            if ( num_dws<=15 )
+            if ( events[i].channel>11 )
             {
-                mask = (1<<num_dws)-1;
-                flags |= DATA_REPLAY_EOE;
-                if (diu_error)
-                {
-                    flags |= DATA_REPLAY_DIU_ERROR;
-                }
-                if (last_event)
-                {
-                    flags |= DATA_REPLAY_END;
-                }
+                throw LIBRORC_SYSMON_ERROR_DATA_REPLAY_INVALID;
             }
+            bytes[(events[i].channel>5) ? 1 : 0] +=
+                (uint64_t)events[i].num_dws << 2;
+        }
 
-            ddr3DataReplayBlockToRam( addr, dataptr, mask, channel, flags);
-            addr += 8;
-            dataptr += 15;
-            num_dws = (num_dws<15) ? 0 : (num_dws-15);
+        struct timeval start;
+        gettimeofday(&start, NULL);
+
+        /** one thread per DDR3 controller that has events */
+        pthread_t thread[2];
+        bool running[2] = {false, false};
+        for( uint32_t c=0; c<2; c++ )
+        {
+            args[c].sm         = this;
+            args[c].events     = &events;
+            args[c].controller = c;
+            args[c].blocks     = 0;
+            args[c].seconds    = 0;
+            args[c].error      = 0;
+            if( bytes[c] == 0 )
+            { continue; }
+            if( pthread_create(&thread[c], NULL,
+                        ddr3DataReplayUploadThread, &args[c]) == 0 )
+            { running[c] = true; }
+            else
+            { ddr3DataReplayUploadThread(&args[c]); }
         }
-        return addr;
+
+        for( uint32_t c=0; c<2; c++ )
+        {
+            if( running[c] )
+            { pthread_join(thread[c], NULL); }
+        }
+
+        if( stats )
+        {
+            stats->bytes   = bytes[0] + bytes[1];
+            stats->blocks  = args[0].blocks + args[1].blocks;
+            stats->seconds = elapsedSeconds(&start);
+            stats->mbps    = (stats->seconds > 0)
+                ? stats->bytes / stats->seconds / (1024.0*1024.0) : 0;
+            for( uint32_t c=0; c<2; c++ )
+            {
+                stats->controller_mbps[c] = (args[c].seconds > 0)
+                    ? bytes[c] / args[c].seconds / (1024.0*1024.0) : 0;
+            }
+        }
+
+        for( uint32_t c=0; c<2; c++ )
+        {
+            if( args[c].error )
+            { throw args[c].error; }
+        }
+        return 0;
     }
 
+
+
+    void *
+    sysmon::ddr3DataReplayUploadThread
+    (
+        void *arg
+    )
+    {
+        ddr3_upload_thread_args *args = (ddr3_upload_thread_args *)arg;
+        struct timeval start;
+        gettimeofday(&start, NULL);
+        try
+        {
+            args->sm->ddr3DataReplayUploadController(*args->events,
+                    args->controller, &args->blocks);
+        }
+        catch( int e )
+        {
+            args->error = e;
+        }
+        args->seconds = elapsedSeconds(&start);
+        return NULL;
+    }
+
+
+
     uint8_t
     sysmon::ddr3SpdRead
     (
@@ -938,13 +1263,16 @@ namespace LIBRARY_NAME
         uint8_t end_address
     )
     {
-        std::string readout = "";
-        for( uint8_t addr=start_address; addr<=end_address; addr++ )
-        {
-            char data_r = ddr3SpdRead(module, addr);
-            readout.append(1, data_r);
-        }
-        return readout;
+        if( end_address<start_address )
+        { return std::string(); }
+
+        uint8_t data_r[256];
+        uint32_t length = end_address - start_address + 1;
+        i2c_read_mem_seq(
+                3, // DDR3 is chain 3
+                DDR3_SPD_SLVADDR + (module&1),
+                start_address, data_r, length);
+        return std::string((const char *)data_r, length);
     }
 
     float sysmon::maxPcieDeadtime() {
@@ -985,6 +1313,7 @@ namespace LIBRARY_NAME
         uint32_t flags
     )
     {
+        LIBRORC_PROFILE_SCOPE("sysmon::ddr3");
         if ( channel>11 )
         {
             throw LIBRORC_SYSMON_ERROR_DATA_REPLAY_INVALID;
@@ -1010,9 +1339,66 @@ namespace LIBRARY_NAME
             }
         }
 
-        /** copy block_buffer to onboard registers */
+        pthread_mutex_lock(&m_dr_mtx);
+        ddr3DataReplayWaitIdle();
+        ddr3DataReplayIssueBlock(start_addr, block_buffer, channel);
+        ddr3DataReplayWaitIdle();
+        pthread_mutex_unlock(&m_dr_mtx);
+    }
+
+
+
+    uint32_t
+    sysmon::ddr3DataReplayStageBlock
+    (
+        uint32_t *block,
+        uint32_t *data,
+        uint32_t  num_dws,
+        uint8_t   channel,
+        bool      last_event,
+        bool      diu_error
+    )
+    {
+        uint16_t mask = 0x7fff;
+        uint32_t flags = 0;
+        uint32_t used = 15;
+        if ( num_dws<=15 )
+        {
+            mask = (1<<num_dws)-1;
+            used = num_dws;
+            flags |= DATA_REPLAY_EOE;
+            if (diu_error)
+            {
+                flags |= DATA_REPLAY_DIU_ERROR;
+            }
+            if (last_event)
+            {
+                flags |= DATA_REPLAY_END;
+            }
+        }
+
+        uint8_t channel_select = (channel>5) ?
+            (1<<(channel-6)) : (1<<channel);
+        block[0] = ((uint32_t)mask<<16) | flags | channel_select;
+        memcpy(&block[1], data, used*sizeof(uint32_t));
+        return used;
+    }
+
+
+
+    void
+    sysmon::ddr3DataReplayIssueBlock
+    (
+        uint32_t start_addr,
+        uint32_t *block,
+        uint8_t channel
+    )
+    {
+        uint32_t controller_select = (channel>5) ? 1 : 0;
+
+        /** copy block to onboard registers */
         m_bar->memcopy(RORC_REG_DATA_REPLAY_PAYLOAD_BASE,
-                block_buffer, 16*sizeof(uint32_t));
+                block, 16*sizeof(uint32_t));
 
         /**
          * make the RORC write the onboard buffer to the selected
@@ -1022,15 +1408,39 @@ namespace LIBRARY_NAME
         drctrl |= (1<<controller_select); // set destination controller
         m_bar->set32(RORC_REG_DATA_REPLAY_CTRL, drctrl);
 
-        /** wait for write_done */
-        uint32_t timeout = SYSMON_DR_TIMEOUT;
-        uint32_t write_done_flag = (controller_select)
+        m_dr_pending |= (controller_select)
             ? DATA_REPLAY_C1_WRITE_DONE :
             DATA_REPLAY_C0_WRITE_DONE;
-        while( !(m_bar->get32(RORC_REG_DATA_REPLAY_CTRL) & write_done_flag) )
+    }
+
+
+
+    void
+    sysmon::ddr3DataReplayWaitIdle()
+    {
+        /**
+         * the controllers share one onboard replay buffer, so it may
+         * only be overwritten after all pending blocks are written
+         **/
+        uint32_t timeout = SYSMON_DR_TIMEOUT;
+        uint32_t spin = SYSMON_DR_SPIN;
+        while( m_dr_pending )
         {
+            uint32_t ctrl = m_bar->get32(RORC_REG_DATA_REPLAY_CTRL);
+            m_dr_pending &= ~ctrl;
+            if( !m_dr_pending )
+            { break; }
+            if( spin )
+            {
+                spin--;
+                continue;
+            }
             if (timeout==0)
-            { throw LIBRORC_SYSMON_ERROR_DATA_REPLAY_TIMEOUT; }
+            {
+                m_dr_pending = 0;
+                pthread_mutex_unlock(&m_dr_mtx);
+                throw LIBRORC_SYSMON_ERROR_DATA_REPLAY_TIMEOUT;
+            }
             timeout--;
             usleep(100);
         }
@@ -1038,13 +1448,66 @@ namespace LIBRARY_NAME
 
 
 
+    void
+    sysmon::ddr3DataReplayUploadController
+    (
+        std::vector<ddr3_replay_event> &events,
+        uint32_t controller,
+        uint64_t *blocks
+    )
+    {
+        uint32_t block[16];
+        for( uint32_t i=0; i<events.size(); i++ )
+        {
+            ddr3_replay_event *ev = &events[i];
+            if( ((ev->channel>5) ? 1u : 0u) != controller )
+            { continue; }
+
+            uint32_t *dataptr = ev->event_data;
+            uint32_t num_dws = ev->num_dws;
+            uint32_t addr = ev->ddr3_start_addr;
+            while ( num_dws>0 )
+            {
+                /**
+                 * stage the next block while the previous one is still
+                 * being written, only wait for write done before the
+                 * onboard buffer is reused
+                 **/
+                uint32_t used = ddr3DataReplayStageBlock(block, dataptr,
+                        num_dws, ev->channel, ev->last_event, ev->diu_error);
+
+                pthread_mutex_lock(&m_dr_mtx);
+                ddr3DataReplayWaitIdle();
+                ddr3DataReplayIssueBlock(addr, block, ev->channel);
+                pthread_mutex_unlock(&m_dr_mtx);
+
+                addr += 8;
+                dataptr += used;
+                num_dws -= used;
+                (*blocks)++;
+            }
+            ev->next_addr = addr;
+        }
+
+        pthread_mutex_lock(&m_dr_mtx);
+        ddr3DataReplayWaitIdle();
+        pthread_mutex_unlock(&m_dr_mtx);
+    }
+
+
+
     uint32_t
     sysmon::i2c_wait_for_cmpl()
     {
+        /** a transaction takes some 100us at 400 kHz: start with short
+         * sleeps so completions are not rounded up to a full poll interval */
+        uint32_t delay = I2C_CMPL_POLL_MIN_US;
         uint32_t status = m_bar->get32(RORC_REG_I2C_CONFIG);
         while( (status & 0x1)==0 )
         {
-            usleep(100);
+            usleep(delay);
+            if( delay<I2C_CMPL_POLL_MAX_US )
+            { delay <<= 1; }
             status = m_bar->get32(RORC_REG_I2C_CONFIG);
         }
 
@@ -1056,6 +1519,169 @@ namespace LIBRARY_NAME
     }
 
 
+    uint32_t
+    sysmon::i2c_transaction
+    (
+        uint8_t  chain,
+        uint8_t  slvaddr,
+        uint8_t  cmd,
+        uint8_t  byte_enable,
+        uint32_t opdata
+    )
+    {
+        i2c_chain_lock lock(this, chain);
+        i2c_lock_acquire(I2C_LOCK_MODULE);
+
+        uint32_t result = 0;
+        try
+        {
+            m_bar->set32(RORC_REG_I2C_OPERATION, opdata);
+            i2c_module_start(chain, slvaddr, cmd, m_i2c_hsmode, byte_enable);
+            i2c_wait_for_cmpl();
+            if( cmd == I2C_READ )
+            { result = m_bar->get32(RORC_REG_I2C_OPERATION); }
+        }
+        catch(...)
+        {
+            i2c_lock_release(I2C_LOCK_MODULE);
+            throw;
+        }
+
+        i2c_lock_release(I2C_LOCK_MODULE);
+        return result;
+    }
+
+
+
+    bool
+    sysmon::i2c_lock_creator_died
+    (
+        int shID
+    )
+    {
+        struct shmid_ds ds;
+        if( shmctl(shID, IPC_STAT, &ds) != 0 )
+        { return false; }
+        return (kill(ds.shm_cpid, 0) != 0) && (errno == ESRCH);
+    }
+
+
+
+    void
+    sysmon::i2c_lock_init
+    (
+        sysmon_i2c_locks *locks
+    )
+    {
+        memset((void *)locks, 0, sizeof(sysmon_i2c_locks));
+
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        for( uint32_t i=0; i<=I2C_LOCK_MODULE; i++ )
+        {
+            pthread_mutex_init(&locks->lock[i].mtx, &attr);
+            m_i2c_handoff[i] = false;
+            m_i2c_handoff_gen[i] = 0;
+        }
+        pthread_mutexattr_destroy(&attr);
+
+        __sync_synchronize();
+        locks->magic = LIBRORC_SYSMON_I2C_LOCK_MAGIC;
+    }
+
+
+
+    void
+    sysmon::i2c_lock_acquire
+    (
+        uint32_t index
+    )
+    {
+        sysmon_i2c_lock *lock = &m_i2c_locks->lock[index];
+
+        /** fairness: if others waited when we released last time, give
+         *  one of them the chance to take the lock before we retake it */
+        if( m_i2c_handoff[index] )
+        {
+            m_i2c_handoff[index] = false;
+            for( uint32_t us=0; us<I2C_LOCK_HANDOFF_US &&
+                 lock->generation == m_i2c_handoff_gen[index]; us+=10 )
+            { usleep(10); }
+        }
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += m_i2c_lock_timeout_ms / 1000;
+        deadline.tv_nsec += (m_i2c_lock_timeout_ms % 1000) * 1000000;
+        if( deadline.tv_nsec >= 1000000000 )
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        __sync_fetch_and_add(&lock->waiters, 1);
+        int ret = pthread_mutex_timedlock(&lock->mtx, &deadline);
+        __sync_fetch_and_sub(&lock->waiters, 1);
+
+        if( ret == EOWNERDEAD )
+        {
+            /** previous owner died while holding the lock */
+            lock->depth = 0;
+            lock->recoveries++;
+            if( index == I2C_LOCK_MODULE )
+            { i2c_lock_recover_module(); }
+            pthread_mutex_consistent(&lock->mtx);
+        }
+        else if( ret == ETIMEDOUT )
+        { throw LIBRORC_SYSMON_ERROR_I2C_LOCK_TIMEOUT; }
+        else if( ret != 0 )
+        { throw LIBRORC_SYSMON_ERROR_I2C_LOCK_FAILED; }
+
+        if( lock->depth++ == 0 )
+        { lock->generation++; }
+    }
+
+
+
+    void
+    sysmon::i2c_lock_release
+    (
+        uint32_t index
+    )
+    {
+        sysmon_i2c_lock *lock = &m_i2c_locks->lock[index];
+
+        bool outermost = (--lock->depth == 0);
+        uint32_t generation = lock->generation;
+        pthread_mutex_unlock(&lock->mtx);
+
+        if( outermost && lock->waiters )
+        {
+            m_i2c_handoff[index] = true;
+            m_i2c_handoff_gen[index] = generation;
+        }
+    }
+
+
+
+    void
+    sysmon::i2c_lock_recover_module()
+    {
+        /** the dead owner may have started a transaction: let it
+         *  finish, its error flags do not concern us */
+        uint32_t polls = I2C_LOCK_RECOVER_POLLS;
+        while( !(m_bar->get32(RORC_REG_I2C_CONFIG) & 0x1) && polls!=0 )
+        {
+            usleep(100);
+            polls--;
+        }
+    }
+
+
+
     std::string
     sysmon::qsfp_i2c_string_readout
     (
@@ -1064,13 +1690,13 @@ namespace LIBRARY_NAME
         uint8_t end
     )
     {
-        std::string readout = "";
-        for(uint8_t i=start; i<=end; i++)
-        {
-            char data_r = i2c_read_mem(index, QSFP_I2C_SLVADDR, i);
-            readout.append(1, data_r);
-        }
-        return readout;
+        if( end<start )
+        { return std::string(); }
+
+        uint8_t data_r[256];
+        uint32_t length = end - start + 1;
+        i2c_read_mem_seq(index, QSFP_I2C_SLVADDR, start, data_r, length);
+        return std::string((const char *)data_r, length);
     }
 
 
@@ -0,0 +1,498 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <cstring>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <librorc/error.hh>
+#include <librorc/telemetry.hh>
+
+namespace LIBRARY_NAME
+{
+
+#define TELEMETRY_LATEST_RETRIES 4
+
+    static uint64_t
+    wallclockUs()
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    }
+
+
+    telemetry::telemetry
+    (
+        sysmon   *sm,
+        uint32_t  device_number
+    )
+    {
+        if( !sm )
+        { throw LIBRORC_TELEMETRY_ERROR_CONSTRUCTOR_FAILED; }
+        m_sm = sm;
+        attach(device_number, true);
+    }
+
+
+
+    telemetry::telemetry
+    (
+        uint32_t device_number
+    )
+    {
+        m_sm = NULL;
+        attach(device_number, false);
+    }
+
+
+
+    telemetry::~telemetry()
+    {
+        stop();
+        if( m_sm )
+        { __sync_bool_compare_and_swap(&m_header->writer_pid, getpid(), 0); }
+        shmdt(m_header);
+        pthread_cond_destroy(&m_cond);
+        pthread_mutex_destroy(&m_mtx);
+    }
+
+
+
+    int
+    telemetry::setInterval
+    (
+        uint32_t interval_ms,
+        uint32_t qsfp_interval_ms
+    )
+    {
+        if( !m_sm || interval_ms==0 )
+        { return -1; }
+        m_header->interval_ms = interval_ms;
+        m_header->qsfp_interval_ms = qsfp_interval_ms;
+        m_next_qsfp_us = 0;
+        return 0;
+    }
+
+
+
+    int
+    telemetry::start()
+    {
+        if( !m_sm )
+        { return -1; }
+
+        pthread_mutex_lock(&m_mtx);
+        if( m_running )
+        {
+            pthread_mutex_unlock(&m_mtx);
+            return -1;
+        }
+        m_stop = false;
+        if( pthread_create(&m_thread, NULL, samplerThread, this) )
+        {
+            pthread_mutex_unlock(&m_mtx);
+            return -1;
+        }
+        m_running = true;
+        pthread_mutex_unlock(&m_mtx);
+        return 0;
+    }
+
+
+
+    void
+    telemetry::stop()
+    {
+        pthread_mutex_lock(&m_mtx);
+        if( !m_running )
+        {
+            pthread_mutex_unlock(&m_mtx);
+            return;
+        }
+        m_stop = true;
+        pthread_cond_broadcast(&m_cond);
+        pthread_mutex_unlock(&m_mtx);
+
+        pthread_join(m_thread, NULL);
+
+        pthread_mutex_lock(&m_mtx);
+        m_running = false;
+        pthread_mutex_unlock(&m_mtx);
+    }
+
+
+
+    bool
+    telemetry::isRunning()
+    {
+        pthread_mutex_lock(&m_mtx);
+        bool running = m_running;
+        pthread_mutex_unlock(&m_mtx);
+        return running;
+    }
+
+
+
+    int
+    telemetry::sampleOnce()
+    {
+        if( !m_sm )
+        { return -1; }
+        telemetry_sample sample;
+        readSample(&sample);
+        publish(&sample);
+        return 0;
+    }
+
+
+
+    bool
+    telemetry::latest
+    (
+        telemetry_sample *sample
+    )
+    {
+        /** retry only if the sampler lapped the whole ring meanwhile */
+        for( uint32_t i=0; i<TELEMETRY_LATEST_RETRIES; i++ )
+        {
+            uint64_t head = m_header->head;
+            if( head==0 )
+            { return false; }
+            if( readSlot(head-1, sample) )
+            { return true; }
+        }
+        return false;
+    }
+
+
+
+    uint32_t
+    telemetry::history
+    (
+        std::vector<telemetry_sample> &samples,
+        uint32_t                       max_samples
+    )
+    {
+        samples.clear();
+        uint64_t head = m_header->head;
+        uint64_t count = (head < max_samples) ? head : max_samples;
+        if( count > m_header->slots )
+        { count = m_header->slots; }
+
+        samples.reserve(count);
+        telemetry_sample sample;
+        for( uint64_t n=head-count; n<head; n++ )
+        {
+            /** samples overwritten while copying are skipped */
+            if( readSlot(n, &sample) )
+            { samples.push_back(sample); }
+        }
+        return samples.size();
+    }
+
+
+
+    uint64_t
+    telemetry::samplesWritten()
+    {
+        return m_header->head;
+    }
+
+
+
+    int
+    telemetry::removeSharedMemory
+    (
+        uint32_t device_number
+    )
+    {
+        int shID = shmget(LIBRORC_TELEMETRY_SHM_KEY_OFFSET + device_number,
+                          0, 0);
+        if( shID == -1 )
+        { return -1; }
+        return shmctl(shID, IPC_RMID, NULL);
+    }
+
+
+
+    /**********************************************************
+     *                  protected
+     * *******************************************************/
+    void
+    telemetry::attach
+    (
+        uint32_t device_number,
+        bool     create
+    )
+    {
+        size_t size = sizeof(telemetry_ring_header) +
+            LIBRORC_TELEMETRY_SLOTS * sizeof(telemetry_slot);
+        key_t key = LIBRORC_TELEMETRY_SHM_KEY_OFFSET + device_number;
+
+        int shID = create ? shmget(key, size, IPC_CREAT | 0666)
+                          : shmget(key, 0, 0);
+        if( shID == -1 )
+        { throw LIBRORC_TELEMETRY_ERROR_SHM_GET_FAILED; }
+
+        char *shm = (char *)shmat(shID, 0, create ? 0 : SHM_RDONLY);
+        if( shm == (char *)-1 )
+        { throw LIBRORC_TELEMETRY_ERROR_SHM_ATTACH_FAILED; }
+
+        m_header = (telemetry_ring_header *)shm;
+        m_slots = (telemetry_slot *)(shm + sizeof(telemetry_ring_header));
+
+        bool valid = (m_header->magic == LIBRORC_TELEMETRY_MAGIC) &&
+            (m_header->version == LIBRORC_TELEMETRY_VERSION) &&
+            (m_header->slots == LIBRORC_TELEMETRY_SLOTS) &&
+            (m_header->sample_size == sizeof(telemetry_sample));
+
+        if( create && !valid )
+        {
+            /** new segment or different layout: start from scratch,
+             *  magic is written last so readers never see a partial init */
+            memset(shm, 0, size);
+            m_header->version = LIBRORC_TELEMETRY_VERSION;
+            m_header->slots = LIBRORC_TELEMETRY_SLOTS;
+            m_header->sample_size = sizeof(telemetry_sample);
+            m_header->device = device_number;
+            m_header->interval_ms = LIBRORC_TELEMETRY_INTERVAL_MS;
+            m_header->qsfp_interval_ms = LIBRORC_TELEMETRY_QSFP_INTERVAL_MS;
+            __sync_synchronize();
+            m_header->magic = LIBRORC_TELEMETRY_MAGIC;
+        }
+        else if( !valid )
+        {
+            shmdt(shm);
+            throw LIBRORC_TELEMETRY_ERROR_INVALID_RING;
+        }
+
+        /** the ring has a single writer: take it over only from a
+         *  sampler that is gone */
+        if( create )
+        {
+            int32_t self = getpid();
+            int32_t owner = m_header->writer_pid;
+            while( owner != self )
+            {
+                if( owner != 0 && (kill(owner, 0) == 0 || errno != ESRCH) )
+                {
+                    shmdt(shm);
+                    throw LIBRORC_TELEMETRY_ERROR_WRITER_ACTIVE;
+                }
+                int32_t seen = __sync_val_compare_and_swap(
+                    &m_header->writer_pid, owner, self);
+                owner = (seen == owner) ? self : seen;
+            }
+        }
+
+        memset(&m_last, 0, sizeof(m_last));
+        m_next_qsfp_us = 0;
+        m_running = false;
+        m_stop = false;
+
+        pthread_mutex_init(&m_mtx, NULL);
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&m_cond, &attr);
+        pthread_condattr_destroy(&attr);
+    }
+
+
+
+    void
+    telemetry::readSample
+    (
+        telemetry_sample *sample
+    )
+    {
+        /** start from the previous sample to carry over QSFP values */
+        memcpy(sample, &m_last, sizeof(telemetry_sample));
+
+        sample->timestamp_us = wallclockUs();
+        sample->uptime_seconds = m_sm->uptimeSeconds();
+        sample->fpga_temperature = m_sm->FPGATemperature();
+        sample->vccint = m_sm->VCCINT();
+        sample->vccaux = m_sm->VCCAUX();
+        sample->fan_speed = m_sm->systemFanSpeed();
+        sample->max_pcie_deadtime = m_sm->maxPcieDeadtime();
+        sample->pcie_request_canceled = m_sm->pcieRequestCanceledCounter();
+        sample->pcie_tx_timeout = m_sm->pcieTxTimeoutCounter();
+        sample->pcie_illegal_request = m_sm->pcieIllegalRequestCounter();
+        sample->pcie_multi_dw_read = m_sm->pcieMultiDwReadCounter();
+        sample->pcie_tx_destination_busy =
+            m_sm->pcieTxDestinationBusyCounter();
+        sample->pcie_transmission_error =
+            m_sm->pcieTransmissionErrorCounter();
+
+        uint32_t qsfp_interval_ms = m_header->qsfp_interval_ms;
+        if( qsfp_interval_ms && sample->timestamp_us >= m_next_qsfp_us )
+        {
+            readQsfp(sample);
+            m_next_qsfp_us = sample->timestamp_us +
+                (uint64_t)qsfp_interval_ms * 1000;
+        }
+
+        memcpy(&m_last, sample, sizeof(telemetry_sample));
+    }
+
+
+
+    void
+    telemetry::readQsfp
+    (
+        telemetry_sample *sample
+    )
+    {
+        sample->qsfp_timestamp_us = sample->timestamp_us;
+        sample->qsfp_present = 0;
+        sample->qsfp_valid = 0;
+        for( uint32_t i=0; i<LIBRORC_MAX_QSFP; i++ )
+        {
+            if( !m_sm->qsfpIsPresent(i) )
+            { continue; }
+            sample->qsfp_present |= (1<<i);
+            if( m_sm->qsfpGetReset(i) )
+            { continue; }
+
+            try
+            {
+                sample->qsfp_temperature[i] = m_sm->qsfpTemperature(i);
+                sample->qsfp_voltage[i] = m_sm->qsfpVoltage(i);
+                for( uint32_t ch=0; ch<4; ch++ )
+                {
+                    sample->qsfp_rx_power[i][ch] = m_sm->qsfpRxPower(i, ch);
+                    sample->qsfp_tx_bias[i][ch] = m_sm->qsfpTxBias(i, ch);
+                }
+                sample->qsfp_valid |= (1<<i);
+            }
+            catch(...)
+            { sample->i2c_errors++; }
+        }
+    }
+
+
+
+    void
+    telemetry::publish
+    (
+        const telemetry_sample *sample
+    )
+    {
+        uint64_t n = m_header->head;
+        telemetry_slot *slot = &m_slots[n % LIBRORC_TELEMETRY_SLOTS];
+
+        slot->seq = 2*n + 1;
+        __sync_synchronize();
+        memcpy((void *)&slot->sample, sample, sizeof(telemetry_sample));
+        __sync_synchronize();
+        slot->seq = 2*n + 2;
+        __sync_synchronize();
+        m_header->head = n + 1;
+    }
+
+
+
+    bool
+    telemetry::readSlot
+    (
+        uint64_t          n,
+        telemetry_sample *sample
+    )
+    {
+        telemetry_slot *slot = &m_slots[n % m_header->slots];
+
+        uint64_t seq = slot->seq;
+        __sync_synchronize();
+        if( seq != 2*n + 2 )
+        { return false; }
+        memcpy(sample, (const void *)&slot->sample, sizeof(telemetry_sample));
+        __sync_synchronize();
+        return (slot->seq == seq);
+    }
+
+
+
+    void
+    telemetry::run()
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+        pthread_mutex_lock(&m_mtx);
+        while( !m_stop )
+        {
+            pthread_mutex_unlock(&m_mtx);
+            sampleOnce();
+            pthread_mutex_lock(&m_mtx);
+
+            uint64_t interval_ns = (uint64_t)m_header->interval_ms * 1000000;
+            deadline.tv_sec += interval_ns / 1000000000;
+            deadline.tv_nsec += interval_ns % 1000000000;
+            if( deadline.tv_nsec >= 1000000000 )
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+
+            /** do not try to catch up after a stall, skip missed samples */
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if( now.tv_sec > deadline.tv_sec ||
+                (now.tv_sec == deadline.tv_sec &&
+                 now.tv_nsec > deadline.tv_nsec) )
+            { deadline = now; }
+
+            while( !m_stop &&
+                   pthread_cond_timedwait(&m_cond, &m_mtx, &deadline)
+                   != ETIMEDOUT )
+            {}
+        }
+        pthread_mutex_unlock(&m_mtx);
+    }
+
+
+
+    void *
+    telemetry::samplerThread
+    (
+        void *arg
+    )
+    {
+        ((telemetry *)arg)->run();
+        return NULL;
+    }
+
+}
@@ -43,11 +43,18 @@
 using namespace std;
 
 #define LIBRORC_MAX_DMA_CHANNELS 12
+/** seconds between status lines */
+#define STAT_INTERVAL 1
 
 #define HELP_TEXT "dma_monitor usage: \n\
         dma_monitor [parameters] \n\
 parameters: \n\
         --device [0..255] Source device ID \n\
+        --iterations N    Stop after N status updates \n\
+        --prometheus FILE Export metrics of all channels to FILE \n\
+        --socket PATH     Serve metrics on unix socket PATH \n\
+        --all             Export metrics of all devices \n\
+        --interval MS     Export interval in ms, default 1000 \n\
         --help            Show this text\n"
 
 
@@ -60,16 +67,80 @@ void abort_handler( int s )
 }
 
 
+/**
+ * sample DMA and link statistics and publish them in Prometheus text
+ * format until interrupted
+ **/
+int exportMetrics
+(
+    int32_t     DeviceId,
+    bool        AllDevices,
+    const char *MetricsFile,
+    const char *SocketPath,
+    uint32_t    IntervalMs,
+    int32_t     Iterations
+)
+{
+    librorc::metrics_exporter exporter;
+    if( AllDevices )
+    {
+        if( exporter.addAllDevices() == 0 )
+        {
+            cout << "No devices found" << endl;
+            return -1;
+        }
+    }
+    else if( exporter.addDevice(DeviceId) < 0 )
+    {
+        cout << "Failed to open device " << DeviceId << endl;
+        return -1;
+    }
+
+    if( SocketPath && exporter.listenSocket(SocketPath) < 0 )
+    {
+        perror("listenSocket");
+        return -1;
+    }
+
+    cout << "Exporting " << exporter.numberOfChannels()
+         << " channels" << endl;
+
+    int32_t iter = 0;
+    while( (!done) && (iter < Iterations) )
+    {
+        exporter.sample();
+        if( MetricsFile && exporter.writeFile(MetricsFile) < 0 )
+        { perror("writeFile"); }
+
+        if( SocketPath )
+        { exporter.serve(IntervalMs); }
+        else
+        { usleep(IntervalMs * 1000); }
+
+        iter = (Iterations!=INT32_MAX) ? iter+1 : iter;
+    }
+    return 0;
+}
+
+
 int main( int argc, char *argv[])
 {
     int32_t DeviceId   = -1;
     int32_t Iterations =  INT32_MAX;
+    const char *MetricsFile = NULL;
+    const char *SocketPath  = NULL;
+    bool     AllDevices = false;
+    uint32_t IntervalMs = 1000;
 
     // command line arguments
     static struct option long_options[] = {
         {"device", required_argument, 0, 'd'},
         {"help", no_argument, 0, 'h'},
         {"iterations", required_argument, 0, 'i'},
+        {"prometheus", required_argument, 0, 'p'},
+        {"socket", required_argument, 0, 's'},
+        {"all", no_argument, 0, 'a'},
+        {"interval", required_argument, 0, 't'},
         {0, 0, 0, 0}
     };
 
@@ -98,6 +169,22 @@ int main( int argc, char *argv[])
                 Iterations = strtol(optarg, NULL, 0);
             break;
 
+            case 'p':
+                MetricsFile = optarg;
+            break;
+
+            case 's':
+                SocketPath = optarg;
+            break;
+
+            case 'a':
+                AllDevices = true;
+            break;
+
+            case 't':
+                IntervalMs = strtol(optarg, NULL, 0);
+            break;
+
             default:
             break;
         }
@@ -126,6 +213,12 @@ int main( int argc, char *argv[])
     }
     sigaction(SIGINT, &sigIntHandler, NULL);
 
+    if( MetricsFile || SocketPath )
+    {
+        return exportMetrics(DeviceId, AllDevices, MetricsFile,
+                             SocketPath, IntervalMs, Iterations);
+    }
+
     /** Innitialize shm channels */
     uint64_t       last_bytes_received[LIBRORC_MAX_DMA_CHANNELS];
     uint64_t       last_events_received[LIBRORC_MAX_DMA_CHANNELS];
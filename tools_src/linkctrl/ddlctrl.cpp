@@ -348,10 +348,7 @@ int main
                 case RORC_CFG_LINK_TYPE_DIU:
                     {
                         librorc::diu *diu = new librorc::diu(current_link);
-                        diu->clearAllLastStatusWords();
-                        diu->clearDdlDeadtime();
-                        diu->clearDmaDeadtime();
-                        diu->clearEventcount();
+                        diu->clearAllCounters();
                         delete diu;
                     }
                     break;
@@ -359,10 +356,7 @@ int main
                 case RORC_CFG_LINK_TYPE_SIU:
                     {
                         librorc::siu *siu = new librorc::siu(current_link);
-                        siu->clearLastFrontEndCommandWord();
-                        siu->clearDdlDeadtime();
-                        siu->clearDmaDeadtime();
-                        siu->clearEventcount();
+                        siu->clearAllCounters();
                         delete siu;
                     }
                     break;
@@ -52,9 +52,15 @@ using namespace std;
 rorctl [value parameter(s)] [instruction parameter]          \n\
 Value parameters :                                           \n\
   -n [0...255]    Target device ID (get a list with -l).     \n\
-  -f <filename>   Filename of the flash file.                \n\
+  -f <filename>   Filename of the flash file. Given twice,   \n\
+                  -p programs the first file into Flash0 and \n\
+                  the second into Flash1 concurrently.       \n\
   -v              Be verbose                                 \n\
   -c              Select Flash Chip [0 or 1]                 \n\
+  -D              Differential programming: only erase and   \n\
+                  program blocks that differ from the file   \n\
+  -P              Profile register accesses of the following \n\
+                  instruction and print a report at exit     \n\
 Instruction parameters :                                     \n\
   -h              Print this help screen!                    \n\
   -l              List available devices.                    \n\
@@ -62,6 +68,8 @@ Instruction parameters :                                     \n\
                   Requires value parameters -n and f.        \n\
   -p              Program device flash.                      \n\
                   Requires value parameters -n and f.        \n\
+  -V              Verify device flash against file.          \n\
+                  Requires value parameters -n and f.        \n\
   -e              Erase device flash (caution JTAG programmer\n\
                   needed afterwards)                         \n\
                   Requires value parameters -n               \n\
@@ -76,6 +84,10 @@ Dump firmware of device 0 to file firmware.bin :             \n\
   rorctl -n 0 -f firmware.bin -d                             \n\
 Program firmware into device 0 from file firmware.bin :      \n\
   rorctl -n 0 -f firmware.bin -p                             \n\
+Program only changed blocks of device 0 :                    \n\
+  rorctl -n 0 -f firmware.bin -D -p                          \n\
+Program both flash chips of device 0 at once :               \n\
+  rorctl -n 0 -f firmware0.bin -f firmware1.bin -p           \n\
 Erase firmware from device 0:                                \n\
   rorctl -n 0 -e                                             \n\
 List all available devices :                                 \n\
@@ -95,13 +107,17 @@ typedef struct
     uint64_t                device_number;
     uint64_t                chip_select;
     char                   *filename;
+    char                   *filename2;
     librorc::librorc_verbosity_enum  verbose;
     librorc::device        *dev;
+    bool                    differential;
 }confopts;
 
 /** Function signatures */
 void print_devices();
 
+void print_bar_profile();
+
 void
 print_device
 (
@@ -134,6 +150,12 @@ flash_status
     librorc::flash *flash
 );
 
+int
+flash_both_chips
+(
+    confopts options
+);
+
 void
 dump_flash_status
 (
@@ -159,14 +181,16 @@ int main
         NOT_SET,
         NOT_SET,
         NULL,
+        NULL,
         librorc::LIBRORC_VERBOSE_OFF,
-        NULL
+        NULL,
+        false
     };
 
     {
         opterr = 0;
         int c;
-        while((c = getopt(argc, argv, "hvlmdepn:f:c:srb:")) != -1)
+        while((c = getopt(argc, argv, "hvlmdepVPDn:f:c:srb:")) != -1)
         {
             switch(c)
             {
@@ -200,9 +224,35 @@ int main
                 {
                     cout << MESSAGE_DEPRECATED << endl << endl;
                     cout << "Flashing device!" << endl;
+                    if( options.filename2 != NULL )
+                    { return( flash_both_chips(options) ); }
+                    librorc::flash *flash = init_flash(options);
+                    if( flash != NULL )
+                    { return( flash->flashWrite(options.filename, options.verbose,
+                                options.differential) ); }
+                    else
+                    { abort(); }
+                }
+                break;
+
+                case 'V':
+                {
+                    cout << MESSAGE_DEPRECATED << endl << endl;
+                    cout << "Verifying device flash!" << endl;
                     librorc::flash *flash = init_flash(options);
                     if( flash != NULL )
-                    { return( flash->flashWrite(options.filename, options.verbose) ); }
+                    {
+                        int32_t result = flash->verify(options.filename,
+                                librorc::LIBRORC_VERBOSE_ON);
+                        if( result < 0 )
+                        { cout << "Failed to verify flash!" << endl; }
+                        else
+                        {
+                            cout << ((result == 0) ? "Flash matches file."
+                                    : "Flash differs from file!") << endl;
+                        }
+                        return result;
+                    }
                     else
                     { abort(); }
                 }
@@ -274,8 +324,12 @@ int main
 
                 case 'f':
                 {
-                    options.filename = (char *)malloc(strlen(optarg)+2);
-                    sprintf(options.filename, "%s", optarg);
+                    char **name = (options.filename == NULL)
+                        ? &options.filename : &options.filename2;
+                    if( *name != NULL )
+                    { free(*name); }
+                    *name = (char *)malloc(strlen(optarg)+2);
+                    sprintf(*name, "%s", optarg);
                 }
                 break;
 
@@ -285,12 +339,25 @@ int main
                 }
                 break;
 
+                case 'P':
+                {
+                    librorc::bar_profiler::setEnabled(true);
+                    atexit(print_bar_profile);
+                }
+                break;
+
                 case 'c':
                 {
                     options.chip_select = atoi(optarg);
                 }
                 break;
 
+                case 'D':
+                {
+                    options.differential = true;
+                }
+                break;
+
                 case 'b':
                 {
                     set_led_blink_mode(options.device_number, atoi(optarg));
@@ -315,6 +382,11 @@ ret_main:
         free(options.filename);
     }
 
+    if(options.filename2 != NULL)
+    {
+        free(options.filename2);
+    }
+
     if(options.dev != NULL)
     {
         delete options.dev;
@@ -325,6 +397,15 @@ ret_main:
 
 
 
+void
+print_bar_profile()
+{
+    cout << endl;
+    librorc::bar_profiler::report(cout);
+}
+
+
+
 void
 print_devices()
 {
@@ -727,3 +808,23 @@ dump_flash_status
         flash->clearStatusRegister(0);
     }
 }
+
+
+
+int
+flash_both_chips
+(
+    confopts options
+)
+{
+    options.chip_select = 0;
+    librorc::flash *flash0 = init_flash(options);
+    options.chip_select = 1;
+    librorc::flash *flash1 = init_flash(options);
+    if( flash0 == NULL || flash1 == NULL )
+    { abort(); }
+
+    return( librorc::flash::flashWriteParallel(flash0, options.filename,
+                flash1, options.filename2, options.verbose,
+                options.differential) );
+}
@@ -0,0 +1,278 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <signal.h>
+#include <unistd.h>
+
+#include "librorc.h"
+
+using namespace std;
+
+#define HELP_TEXT "telemetryctl usage: \n\
+telemetryctl [parameters] \n\
+Parameters: \n\
+        -h              Print this help \n\
+        -n [0...255]    Target device \n\
+        -s              Run the sampler until CTRL+C \n\
+        -i [ms]         Sampling interval, default 1000 \n\
+        -q [ms]         QSFP sampling interval, 0 to disable, \n\
+                        default 10000 \n\
+        -H [count]      Print the last [count] samples \n\
+Without -s, the latest sample published by a running sampler is \n\
+printed. This does not access the device. \n\
+"
+
+uint32_t done = 0;
+
+void abort_handler( int s )
+{
+    done = 1;
+}
+
+
+void
+print_sample
+(
+    const librorc::telemetry_sample &s
+)
+{
+    cout << "Timestamp        : " << s.timestamp_us/1000000 << "."
+         << setw(6) << setfill('0') << s.timestamp_us%1000000
+         << setfill(' ') << endl;
+    cout << "Uptime           : " << s.uptime_seconds << " s" << endl;
+    cout << "FPGA Temperature : " << s.fpga_temperature << " degC" << endl;
+    cout << "VCCINT           : " << s.vccint << " V" << endl;
+    cout << "VCCAUX           : " << s.vccaux << " V" << endl;
+    cout << "Fan Speed        : " << s.fan_speed << " RPM" << endl;
+    cout << "Max PCIe Deadtime: " << s.max_pcie_deadtime << " us" << endl;
+    cout << "PCIe Errors      : canceled " << s.pcie_request_canceled
+         << ", tx timeout " << s.pcie_tx_timeout
+         << ", illegal " << s.pcie_illegal_request
+         << ", multi-DW read " << s.pcie_multi_dw_read
+         << ", dst busy " << s.pcie_tx_destination_busy
+         << ", transmission " << s.pcie_transmission_error << endl;
+    for( uint32_t i=0; i<LIBRORC_MAX_QSFP; i++ )
+    {
+        if( !(s.qsfp_valid & (1<<i)) )
+        { continue; }
+        cout << "QSFP" << i << "            : "
+             << s.qsfp_temperature[i] << " degC, "
+             << s.qsfp_voltage[i] << " V, RX";
+        for( uint32_t ch=0; ch<4; ch++ )
+        { cout << " " << s.qsfp_rx_power[i][ch]; }
+        cout << " mW" << endl;
+    }
+    cout << "I2C Errors       : " << s.i2c_errors << endl;
+}
+
+
+void
+print_history_line
+(
+    const librorc::telemetry_sample &s
+)
+{
+    cout << s.timestamp_us << " " << s.fpga_temperature << " "
+         << s.vccint << " " << s.vccaux << " " << s.fan_speed << " "
+         << s.max_pcie_deadtime << " " << s.pcie_tx_timeout << " "
+         << s.pcie_transmission_error << endl;
+}
+
+
+int
+main
+(
+    int argc,
+    char *argv[]
+)
+{
+    int32_t device_number = -1;
+    uint32_t interval_ms = LIBRORC_TELEMETRY_INTERVAL_MS;
+    uint32_t qsfp_interval_ms = LIBRORC_TELEMETRY_QSFP_INTERVAL_MS;
+    uint32_t history = 0;
+    int do_sample = 0;
+    int arg;
+
+    /** parse command line arguments */
+    while ( (arg = getopt(argc, argv, "hn:si:q:H:")) != -1 )
+    {
+        switch (arg)
+        {
+            case 'h':
+                cout << HELP_TEXT;
+                return 0;
+                break;
+            case 'n':
+                device_number = atoi(optarg);
+                break;
+            case 's':
+                do_sample = 1;
+                break;
+            case 'i':
+                interval_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 'q':
+                qsfp_interval_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 'H':
+                history = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                cout << "Unknown parameter (" << arg << ")!" << endl;
+                cout << HELP_TEXT;
+                return -1;
+                break;
+        } //switch
+    } //while
+
+    if ( device_number < 0 || device_number > 255 )
+    {
+        cout << "No or invalid device selected: " << device_number << endl;
+        cout << HELP_TEXT;
+        abort();
+    }
+
+    if( !do_sample )
+    {
+        librorc::telemetry *tm = NULL;
+        try
+        { tm = new librorc::telemetry(device_number); }
+        catch(int e)
+        {
+            cout << "No telemetry for device " << device_number << ": "
+                 << librorc::errMsg(e) << endl;
+            return -1;
+        }
+
+        if( history )
+        {
+            vector<librorc::telemetry_sample> samples;
+            tm->history(samples, history);
+            for( size_t i=0; i<samples.size(); i++ )
+            { print_history_line(samples[i]); }
+        }
+        else
+        {
+            librorc::telemetry_sample s;
+            if( !tm->latest(&s) )
+            {
+                cout << "No samples published yet." << endl;
+                delete tm;
+                return -1;
+            }
+            print_sample(s);
+        }
+        delete tm;
+        return 0;
+    }
+
+    /** Instantiate device **/
+    librorc::device *dev = NULL;
+    try
+    { dev = new librorc::device(device_number); }
+    catch(...)
+    {
+        cout << "Failed to intialize device " << device_number
+            << endl;
+        return -1;
+    }
+
+    /** Instantiate a new bar */
+    librorc::bar *bar = NULL;
+    try
+    {
+        bar = new librorc::bar(dev, 1);
+    }
+    catch(...)
+    {
+        cout << "ERROR: failed to initialize BAR." << endl;
+        delete dev;
+        abort();
+    }
+
+    /** Instantiate a new sysmon */
+    librorc::sysmon *sm;
+    try
+    { sm = new librorc::sysmon(bar); }
+    catch(...)
+    {
+        cout << "Sysmon init failed!" << endl;
+        delete bar;
+        delete dev;
+        abort();
+    }
+
+    librorc::telemetry *tm = NULL;
+    try
+    { tm = new librorc::telemetry(sm, device_number); }
+    catch(int e)
+    {
+        cout << "Telemetry init failed: " << librorc::errMsg(e) << endl;
+        delete sm;
+        delete bar;
+        delete dev;
+        return -1;
+    }
+
+    if( tm->setInterval(interval_ms, qsfp_interval_ms) )
+    {
+        cout << "Invalid sampling interval: " << interval_ms << endl;
+        delete tm;
+        delete sm;
+        delete bar;
+        delete dev;
+        return -1;
+    }
+
+    /** catch CTRL+C for abort */
+    struct sigaction sigIntHandler;
+    {
+        sigIntHandler.sa_handler = abort_handler;
+        sigemptyset(&sigIntHandler.sa_mask);
+        sigIntHandler.sa_flags = 0;
+    }
+    sigaction(SIGINT, &sigIntHandler, NULL);
+    sigaction(SIGTERM, &sigIntHandler, NULL);
+
+    tm->start();
+    while( !done )
+    { sleep(1); }
+    tm->stop();
+
+    delete tm;
+    delete sm;
+    delete bar;
+    delete dev;
+    return 0;
+}
@@ -37,8 +37,9 @@ int main(int argc, char *argv[]) {
   uint32_t device_id = 0;
   uint32_t buffer_id = 0;
   uint64_t buffer_size = 0;
+  uint32_t buffer_count = 1;
 
-  while ((arg = getopt(argc, argv, "hn:b:s:")) != -1) {
+  while ((arg = getopt(argc, argv, "hn:b:s:c:")) != -1) {
     switch (arg) {
     case 'n':
       device_id = strtol(optarg, NULL, 0);
@@ -52,8 +53,13 @@ int main(int argc, char *argv[]) {
       buffer_size = strtoul(optarg, NULL, 0);
       break;
 
+    case 'c':
+      buffer_count = strtol(optarg, NULL, 0);
+      break;
+
     case 'h':
-      cout << "Parameter: -n [device_id] -b [buffer_id] -s [buffer_size]" << endl;
+      cout << "Parameter: -n [device_id] -b [buffer_id] -s [buffer_size] "
+           << "-c [number of consecutive buffer IDs]" << endl;
       break;
 
     default:
@@ -67,17 +73,40 @@ int main(int argc, char *argv[]) {
   }
 
   librorc::device *dev;
-  librorc::buffer *buf;
 
   try {
     dev = new librorc::device(device_id);
-    buf = new librorc::buffer(dev, buffer_size, buffer_id, 0);
   } catch (int e) {
     cerr << "Failed with: (" << e << ") " << librorc::errMsg(e) << endl;
     return -1;
   }
 
-  delete buf;
+  for (uint32_t i = 0; i < buffer_count; i++) {
+    librorc::buffer *buf;
+    try {
+      buf = new librorc::buffer(dev, buffer_size, buffer_id + i, 0);
+    } catch (int e) {
+      cerr << "Failed with: (" << e << ") " << librorc::errMsg(e) << endl;
+      delete dev;
+      return -1;
+    }
+    delete buf;
+  }
+
+  librorc::sysfs_latency_histogram hist =
+      dev->getHandler()->get_alloc_latency_histogram();
+  if (hist.count) {
+    cout << "Allocation-to-mappable latency: " << hist.count
+         << " buffers, min " << hist.min_us << " us, avg "
+         << hist.sum_us / hist.count << " us, max " << hist.max_us << " us, "
+         << hist.timeouts << " timeouts" << endl;
+    for (int i = 0; i < LIBRORC_SYSFS_LATENCY_BINS; i++) {
+      if (hist.bin[i]) {
+        cout << "  >= " << (1ul << i) << " us: " << hist.bin[i] << endl;
+      }
+    }
+  }
+
   delete dev;
   return 0;
 }
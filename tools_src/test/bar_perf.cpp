@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include <iostream>
+#include <pthread.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+#define BAR_SIZE (1ul << 21)
+#define MAX_THREADS 12
+#define DEFAULT_ITERATIONS 1000000
+
+typedef struct {
+  librorc::bar *bar;
+  uint32_t link;
+  uint64_t iterations;
+} thread_args;
+
+uint64_t timediff_ns(struct timespec start, struct timespec end) {
+  uint64_t elapsed = (end.tv_sec - start.tv_sec) * 1000000000;
+  elapsed += (end.tv_nsec - start.tv_nsec);
+  return elapsed;
+}
+
+/**
+ * Each thread mimics the release path of one channel: update the 64 bit SW
+ * read pointers with a multi-word write followed by a DMA control write.
+ **/
+void *writer(void *arg) {
+  thread_args *args = (thread_args *)arg;
+  librorc::bar_address base = (args->link + 1) * RORC_CHANNEL_OFFSET;
+  uint64_t offsets[2];
+  for (uint64_t i = 0; i < args->iterations; i += 2) {
+    offsets[0] = i;
+    offsets[1] = i + 1;
+    args->bar->memcopy(base + RORC_REG_EBDM_SW_READ_POINTER_L, offsets,
+                       sizeof(offsets));
+    args->bar->set32(base + RORC_REG_DMA_CTRL, i);
+  }
+  return NULL;
+}
+
+/**
+ * Write registers in a BAR backed by anonymous memory from nthreads
+ * threads and report the aggregate number of writes per second.
+ **/
+void run(librorc::bar *bar, uint32_t nthreads, uint64_t iterations,
+         const char *name) {
+  struct timespec start, end;
+  pthread_t threads[MAX_THREADS];
+  thread_args args[MAX_THREADS];
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (uint32_t i = 0; i < nthreads; i++) {
+    args[i].bar = bar;
+    args[i].link = i;
+    args[i].iterations = iterations;
+    pthread_create(&threads[i], NULL, writer, &args[i]);
+  }
+  for (uint32_t i = 0; i < nthreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  if (bar->postedWrites()) {
+    bar->flush();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  uint64_t ns = timediff_ns(start, end);
+  uint64_t writes = nthreads * iterations;
+  cout << name << ", " << nthreads << " threads: " << writes << " writes in "
+       << ns / 1000 << " us, " << (double)writes * 1000000000.0 / ns
+       << " writes/s" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  int arg;
+  uint64_t iterations = DEFAULT_ITERATIONS;
+  uint32_t max_threads = 1;
+
+  while ((arg = getopt(argc, argv, "hi:t:")) != -1) {
+    switch (arg) {
+    case 'i':
+      iterations = strtoul(optarg, NULL, 0);
+      break;
+
+    case 't':
+      max_threads = strtoul(optarg, NULL, 0);
+      break;
+
+    case 'h':
+      cout << "Parameter: -i [register writes per thread] "
+           << "-t [max. number of threads, 1.." << MAX_THREADS << "]"
+           << endl;
+      return 0;
+
+    default:
+      break;
+    }
+  }
+
+  if (max_threads == 0 || max_threads > MAX_THREADS) {
+    cerr << "Invalid number of threads" << endl;
+    return -1;
+  }
+
+  uint8_t *map = (uint8_t *)mmap(NULL, BAR_SIZE, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED) {
+    perror("mmap");
+    return -1;
+  }
+
+  librorc::bar *bar;
+  try {
+    bar = new librorc::bar(map, BAR_SIZE);
+  } catch (int e) {
+    cerr << "Failed with: (" << e << ") " << librorc::errMsg(e) << endl;
+    munmap(map, BAR_SIZE);
+    return -1;
+  }
+
+  for (uint32_t t = 1; t <= max_threads; t++) {
+    bar->setPostedWrites(false);
+    run(bar, t, iterations, "msync");
+    bar->setPostedWrites(true);
+    run(bar, t, iterations, "posted");
+  }
+
+  delete bar;
+  munmap(map, BAR_SIZE);
+  return 0;
+}
@@ -0,0 +1,176 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include "test_bar.hh"
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+#define GLOBAL_REG 0x10
+#define LINK0_DDL_REG (RORC_CHANNEL_OFFSET + (1 << RORC_REGFILE_DDL_SEL) + 1)
+#define LINK1_PCI_REG (2 * RORC_CHANNEL_OFFSET + 5)
+
+static bool check(const char *name, bool ok) {
+  cout << (ok ? "ok   " : "FAIL ") << name << endl;
+  return ok;
+}
+
+static uint64_t rangeCount(uint32_t range, librorc::bar_profile_regfile regfile,
+                           librorc::bar_profile_op op) {
+  librorc::bar_profile_stats stats;
+  if (librorc::bar_profiler::getRangeStats(range, regfile, op, &stats) != 0) {
+    return ~0ull;
+  }
+  return stats.count;
+}
+
+/**
+ * count column of a report line, 0 if there is none. Subsystem lines are
+ * looked up below the "subsystem" header only.
+ **/
+static uint64_t reportCount(const string &report, const string &name,
+                            const string &op, bool subsystem) {
+  istringstream in(report);
+  string line;
+  bool in_subsystems = false;
+  while (getline(in, line)) {
+    if (line == "subsystem") {
+      in_subsystems = true;
+      continue;
+    }
+    if (in_subsystems != subsystem || line.size() < 18) {
+      continue;
+    }
+    string label = line.substr(0, 18);
+    label.erase(label.find_last_not_of(' ') + 1);
+    istringstream fields(line.substr(18));
+    string line_op;
+    uint64_t count = 0;
+    fields >> line_op >> count;
+    if (label == name && line_op == op) {
+      return count;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  test_bar *impl = new test_bar();
+  librorc::bar *bar = new librorc::bar(impl);
+  bool ok = true;
+
+  librorc::bar_profiler::setEnabled(true);
+  librorc::bar_profiler::reset();
+
+  for (int i = 0; i < 3; i++) {
+    bar->get32(GLOBAL_REG);
+  }
+  {
+    LIBRORC_PROFILE_SCOPE("dma");
+    for (int i = 0; i < 4; i++) {
+      bar->set32(LINK1_PCI_REG, i);
+    }
+    {
+      LIBRORC_PROFILE_SCOPE("ddl");
+      bar->get32(LINK0_DDL_REG);
+      bar->get32(LINK0_DDL_REG);
+    }
+    bar->flush(LINK1_PCI_REG);
+  }
+  {
+    /** same name at a different address joins the existing scope */
+    char name[] = "dma";
+    librorc::bar_profiler::scope s(name);
+    bar->set32(LINK1_PCI_REG, 0);
+  }
+  bar->get32(GLOBAL_REG);
+
+  ok &= check("global reads",
+              rangeCount(0, librorc::LIBRORC_PROF_REGFILE_PCI,
+                         librorc::LIBRORC_PROF_READ) == 4);
+  ok &= check("link 1 PCIe writes",
+              rangeCount(2, librorc::LIBRORC_PROF_REGFILE_PCI,
+                         librorc::LIBRORC_PROF_WRITE) == 5);
+  ok &= check("link 1 PCIe flushes",
+              rangeCount(2, librorc::LIBRORC_PROF_REGFILE_PCI,
+                         librorc::LIBRORC_PROF_FLUSH) == 1);
+  ok &= check("link 0 DDL reads",
+              rangeCount(1, librorc::LIBRORC_PROF_REGFILE_DDL,
+                         librorc::LIBRORC_PROF_READ) == 2 &&
+                  rangeCount(1, librorc::LIBRORC_PROF_REGFILE_PCI,
+                             librorc::LIBRORC_PROF_READ) == 0);
+
+  librorc::bar_profile_stats stats;
+  librorc::bar_profiler::getRangeStats(2, librorc::LIBRORC_PROF_REGFILE_PCI,
+                                       librorc::LIBRORC_PROF_WRITE, &stats);
+  uint64_t binned = 0;
+  for (int i = 0; i < LIBRORC_PROF_HIST_BINS; i++) {
+    binned += stats.hist[i];
+  }
+  ok &= check("histogram covers all accesses",
+              binned == stats.count && stats.max_cycles <= stats.cycles);
+  ok &= check("reject invalid range",
+              librorc::bar_profiler::getRangeStats(
+                  LIBRORC_PROF_MAX_RANGES, librorc::LIBRORC_PROF_REGFILE_PCI,
+                  librorc::LIBRORC_PROF_READ, &stats) == -1);
+
+  ostringstream out;
+  librorc::bar_profiler::report(out);
+  string report = out.str();
+  ok &= check("report ranges",
+              reportCount(report, "global", "read", false) == 4 &&
+                  reportCount(report, "link 1 PCIe", "write", false) == 5 &&
+                  reportCount(report, "link 1 PCIe", "flush", false) == 1 &&
+                  reportCount(report, "link 0 DDL", "read", false) == 2);
+  ok &= check("report scopes",
+              reportCount(report, "(none)", "read", true) == 4 &&
+                  reportCount(report, "dma", "write", true) == 5 &&
+                  reportCount(report, "dma", "flush", true) == 1 &&
+                  reportCount(report, "dma", "read", true) == 0 &&
+                  reportCount(report, "ddl", "read", true) == 2);
+
+  librorc::bar_profiler::setEnabled(false);
+  bar->get32(GLOBAL_REG);
+  ok &= check("disabled profiler records nothing",
+              rangeCount(0, librorc::LIBRORC_PROF_REGFILE_PCI,
+                         librorc::LIBRORC_PROF_READ) == 4);
+
+  librorc::bar_profiler::reset();
+  ok &= check("reset clears statistics",
+              rangeCount(2, librorc::LIBRORC_PROF_REGFILE_PCI,
+                         librorc::LIBRORC_PROF_WRITE) == 0);
+
+  cout << report;
+  cout << (ok ? "PASS" : "FAIL") << endl;
+  delete bar;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include <librorc/bar_impl_hw.hh>
+#include <librorc/bar_impl_trace.hh>
+#include <iostream>
+#include <iomanip>
+#include <sys/mman.h>
+
+using namespace std;
+
+#define BAR_SIZE (1ul << 21)
+#define HELP_TEXT                                                              \
+  "bar_trace usage:\n"                                                         \
+  "  bar_trace -f <trace> -d     dump all records\n"                           \
+  "  bar_trace -f <trace> -s     print a summary\n"                            \
+  "  bar_trace -f <tmpfile> -t   record and replay a link configuration\n"     \
+  "Record a trace with any librorc application by setting\n"                   \
+  "LIBRORC_BAR_RECORD=<prefix>, the trace of BAR n is written to\n"            \
+  "<prefix>.bar<n>.\n"
+
+void dump(const char *path) {
+  librorc::bar_trace_reader reader(path);
+  librorc::bar_trace_record rec;
+  cout << "BAR size: " << reader.barSize() << " bytes" << endl;
+  while (reader.next(&rec)) {
+    cout << setw(12) << rec.start_ns << " ns " << setw(8) << rec.duration_ns
+         << " ns " << setw(12) << librorc::bar_trace_reader::opName(rec.op)
+         << " 0x" << hex << setw(6) << setfill('0') << rec.address;
+    if (rec.data.size()) {
+      cout << dec << setfill(' ') << " " << rec.data.size() << " bytes";
+    } else if (rec.op != librorc::LIBRORC_TRACE_FLUSH) {
+      cout << " 0x" << setw(8) << rec.value << dec << setfill(' ');
+    } else {
+      cout << dec << setfill(' ');
+    }
+    cout << endl;
+  }
+}
+
+void summary(const char *path) {
+  librorc::bar_trace_reader reader(path);
+  librorc::bar_trace_record rec;
+  uint64_t count[8] = {0}, ns[8] = {0}, bytes = 0, last = 0;
+  while (reader.next(&rec)) {
+    count[rec.op & 7]++;
+    ns[rec.op & 7] += rec.duration_ns;
+    bytes += rec.data.size();
+    last = rec.start_ns + rec.duration_ns;
+  }
+  for (uint8_t op = librorc::LIBRORC_TRACE_GET32;
+       op <= librorc::LIBRORC_TRACE_FLUSH; op++) {
+    if (count[op]) {
+      cout << setw(12) << librorc::bar_trace_reader::opName(op) << ": "
+           << setw(8) << count[op] << " accesses, " << setw(10)
+           << ns[op] / 1000 << " us, " << ns[op] / count[op] << " ns avg"
+           << endl;
+    }
+  }
+  cout << "memcopy payload: " << bytes << " bytes, trace duration: "
+       << last / 1000 << " us" << endl;
+}
+
+void configure(librorc::bar *bar) {
+  librorc::link link(bar, 0);
+  librorc::fastclusterfinder fcf(&link);
+  librorc::patterngenerator pg(&link);
+  librorc::ddl ddl(&link);
+  ddl.setEnable(1);
+  link.setFlowControlEnable(1);
+  pg.configureMode(PG_PATTERN_INC, 0, 0);
+  pg.setStaticEventSize(0x100);
+  fcf.setState(1, 0);
+  fcf.setClusterLowerLimit(10);
+  fcf.setMergerDistance(4);
+  fcf.setState(0, 1);
+  bar->flush();
+}
+
+int selftest(const char *path) {
+  uint8_t *map = (uint8_t *)mmap(NULL, BAR_SIZE, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED) {
+    cerr << "mmap failed" << endl;
+    return -1;
+  }
+
+  /** record */
+  librorc::bar *bar = new librorc::bar(
+      new librorc::bar_impl_trace_recorder(new librorc::bar_impl_hw(map,
+                                                                    BAR_SIZE),
+                                           path));
+  bar->set32(0x10, 0xcafe);
+  configure(bar);
+  delete bar;
+  munmap(map, BAR_SIZE);
+
+  /** replay the same sequence */
+  librorc::bar_impl_trace_replay *replay =
+      new librorc::bar_impl_trace_replay(path);
+  bar = new librorc::bar(replay);
+  bar->set32(0x10, 0xcafe);
+  configure(bar);
+  bool same_ok = (replay->mismatches() == 0 && replay->remaining() == 0);
+  cout << "identical sequence: " << replay->mismatches() << " mismatches, "
+       << replay->remaining() << " records left" << endl;
+  delete bar;
+
+  /** replay a modified sequence */
+  replay = new librorc::bar_impl_trace_replay(path);
+  bar = new librorc::bar(replay);
+  bar->set32(0x10, 0xbeef);
+  configure(bar);
+  bool diff_ok = (replay->mismatches() == 1);
+  cout << "modified sequence: " << replay->mismatches()
+       << " mismatches, first: " << replay->firstMismatch() << endl;
+  delete bar;
+
+  cout << ((same_ok && diff_ok) ? "PASS" : "FAIL") << endl;
+  return (same_ok && diff_ok) ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+  int arg;
+  char *path = NULL;
+  char mode = 0;
+
+  while ((arg = getopt(argc, argv, "hf:dst")) != -1) {
+    switch (arg) {
+    case 'f':
+      path = optarg;
+      break;
+    case 'd':
+    case 's':
+    case 't':
+      mode = arg;
+      break;
+    case 'h':
+    default:
+      cout << HELP_TEXT;
+      return (arg == 'h') ? 0 : -1;
+    }
+  }
+
+  if (path == NULL || mode == 0) {
+    cout << HELP_TEXT;
+    return -1;
+  }
+
+  try {
+    switch (mode) {
+    case 'd':
+      dump(path);
+      break;
+    case 's':
+      summary(path);
+      break;
+    case 't':
+      return selftest(path);
+    }
+  } catch (int e) {
+    cerr << "ERROR: " << librorc::errMsg(e) << endl;
+    return -1;
+  }
+  return 0;
+}
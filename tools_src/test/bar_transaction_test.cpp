@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include "test_bar.hh"
+#include <iostream>
+#include <string.h>
+
+using namespace std;
+
+#define LINK 3
+
+bool check(const char *name, bool condition) {
+  cout << (condition ? "ok   " : "FAIL ") << name << endl;
+  return condition;
+}
+
+int main(int argc, char *argv[]) {
+  bool pass = true;
+  test_bar *impl = new test_bar();
+  librorc::bar *bar = new librorc::bar(impl);
+  librorc::link link(bar, LINK);
+
+  /** consecutive writes are merged, the write order is preserved */
+  uint32_t cfg[10];
+  for (uint32_t i = 0; i < 10; i++) {
+    cfg[i] = 0x100 + i;
+  }
+  librorc::bar::transaction t(bar);
+  t.memcopy(link.pciAddress(RORC_REG_EBDM_N_SG_CONFIG), cfg, sizeof(cfg));
+  t.set32(link.pciAddress(RORC_REG_DMA_CTRL), 0xabc);
+  t.set32(link.pciAddress(RORC_REG_DMA_PKT_SIZE), 0x40);
+  size_t bursts = link.apply(t);
+  pass &= check("two bursts", bursts == 2 && impl->writes == 2);
+  pass &= check("single flush", impl->flushes == 1);
+  pass &= check("burst contents",
+                memcmp(impl->m_regs + link.pciAddress(0), cfg, sizeof(cfg)) ==
+                        0 &&
+                    impl->m_regs[link.pciAddress(RORC_REG_DMA_CTRL)] == 0xabc &&
+                    impl->m_regs[link.pciAddress(RORC_REG_DMA_PKT_SIZE)] ==
+                        0x40);
+  pass &= check("transaction empty after apply", t.size() == 0);
+
+  /** masked writes take the base value from the transaction or the BAR */
+  librorc::bar_address ctrl = link.ddlAddress(RORC_REG_FCF_CTRL);
+  librorc::bar_address limits = link.ddlAddress(RORC_REG_FCF_LIMITS);
+  impl->m_regs[ctrl] = 0xff00ff00;
+  impl->reads = 0;
+  t.set32(limits, 0x12345678);
+  t.modify32(limits, 0x0000ff00, 0x0000aa00);
+  t.modify32(ctrl, 0x000000ff, 0x00000055);
+  link.apply(t);
+  pass &= check("masked write on pending value",
+                impl->m_regs[limits] == 0x1234aa78);
+  pass &= check("masked write on device value",
+                impl->m_regs[ctrl] == 0xff00ff55);
+  pass &= check("one device read plus flush", impl->reads == 2);
+
+  /** FCF parameter load */
+  librorc::fastclusterfinder fcf(&link);
+  librorc::fcf_parameters params;
+  memset(&params, 0, sizeof(params));
+  params.deconv_pad = 1;
+  params.cluster_lower_limit = 10;
+  params.merger_distance = 4;
+  params.merger_algorithm = 1;
+  params.noise_suppression = 3;
+  params.cluster_qmax_lower_limit = 5;
+  fcf.setParameters(&params);
+  pass &= check("fcf parameters",
+                fcf.deconvPad() == 1 && fcf.clusterLowerLimit() == 10 &&
+                    fcf.mergerDistance() == 4 && fcf.mergerAlgorithm() == 1 &&
+                    fcf.noiseSuppression() == 3 &&
+                    fcf.clusterQmaxLowerLimit() == 5 &&
+                    fcf.singlePadSuppression() == 0);
+
+  cout << (pass ? "PASS" : "FAIL") << endl;
+  delete bar;
+  return pass ? 0 : 1;
+}
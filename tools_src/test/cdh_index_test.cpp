@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include <iostream>
+#include <vector>
+#include <string.h>
+
+using namespace std;
+
+#define EVENTS 100
+#define INDEX_ENTRIES 64
+#define PAYLOAD 16
+
+uint64_t failures = 0;
+
+void check(bool condition, const char *what) {
+  if (!condition) {
+    cout << "FAILED: " << what << endl;
+    failures++;
+  }
+}
+
+/** CDH with the fields used below, trigger class (id % 70) set */
+void fillCdh(uint32_t *w, uint32_t version, uint64_t id) {
+  memset(w, 0, LIBRORC_CDH_V3_SIZE * sizeof(uint32_t));
+  uint32_t tc = id % 70;
+  w[0] = 0xffffffff;
+  w[1] = (version << 24) | (0x5a << 14) | (id & 0xfff);
+  w[2] = (id >> 12) & 0xffffff;
+  w[3] = (0x81 << 24) | 0x000123;
+  w[4] = ((LIBRORC_CDH_ERR_FEE | 0x100) << 12) | 0xabc;
+  if (version == LIBRORC_CDH_V2) {
+    tc %= 50;
+    if (tc < 32) {
+      w[5] = 1u << tc;
+    } else {
+      w[6] = 1u << (tc - 32);
+    }
+    w[6] |= 0x5u << 28;
+    w[7] = 0x12345678;
+  } else {
+    if (tc < 64) {
+      w[5 + tc / 32] = 1u << (tc % 32);
+    } else {
+      w[7] = 1u << (tc - 64);
+    }
+    w[8] = 0x5u << 28;
+    w[9] = 0x12345678;
+  }
+}
+
+void checkView() {
+  uint32_t w[LIBRORC_CDH_V3_SIZE];
+  uint64_t id = (0xabcdefull << 12) | 0x123;
+
+  fillCdh(w, LIBRORC_CDH_V2, id);
+  librorc::cdh_v2 v2(w);
+  check(librorc::cdhVersion(w, 8) == LIBRORC_CDH_V2, "v2 version");
+  check(librorc::cdhVersion(w, 7) == 0, "v2 too short");
+  check(v2.eventId() == id, "v2 event id");
+  check(v2.bunchCrossing() == 0x123 && v2.orbit() == 0xabcdef,
+        "v2 bc/orbit");
+  check(v2.l1TriggerMessage() == 0x5a, "v2 l1 message");
+  check(v2.participatingSubdetectors() == 0x123, "v2 subdetectors");
+  check(v2.blockAttributes() == 0x81, "v2 attributes");
+  check(v2.miniEventId() == 0xabc, "v2 mini event id");
+  check(v2.hasError() && (v2.statusErrorBits() & 0x100), "v2 status");
+  check(v2.triggerClass(id % 70 % 50), "v2 trigger class");
+  check(v2.triggerClassesHigh() == 0, "v2 high trigger classes");
+  check(v2.roi() == ((0x12345678ull << 4) | 5), "v2 roi");
+
+  fillCdh(w, LIBRORC_CDH_V3, id);
+  librorc::cdh_v3 v3(w);
+  check(librorc::cdhVersion(w, 10) == LIBRORC_CDH_V3, "v3 version");
+  check(librorc::cdhVersion(w, 8) == 0, "v3 too short");
+  check(v3.eventId() == id, "v3 event id");
+  check(v3.triggerClass(id % 70), "v3 trigger class");
+  check(v3.roi() == ((0x12345678ull << 4) | 5), "v3 roi");
+
+  /** trigger classes above 64 */
+  uint64_t id66 = 66;
+  fillCdh(w, LIBRORC_CDH_V3, id66);
+  librorc::cdh_fields fields;
+  check(librorc::cdhDecode(w, 10, &fields) == 0, "v3 decode");
+  check(fields.trigger_classes_low == 0 &&
+            fields.trigger_classes_high == (1ull << 2),
+        "v3 decode trigger classes");
+  check(fields.version == LIBRORC_CDH_V3 && fields.event_id == 66,
+        "v3 decode id");
+
+  w[1] = (7 << 24);
+  check(librorc::cdhDecode(w, 10, &fields) == -1, "unsupported version");
+}
+
+void checkIndex() {
+  librorc::event_index index(INDEX_ENTRIES - 1);
+  check(index.capacity() == INDEX_ENTRIES, "capacity rounding");
+
+  vector<uint32_t> data(EVENTS * PAYLOAD);
+  vector<librorc::EventDescriptor> reports(EVENTS);
+  for (uint64_t i = 0; i < EVENTS; i++) {
+    uint32_t *event = &data[i * PAYLOAD];
+    fillCdh(event, (i & 1) ? LIBRORC_CDH_V3 : LIBRORC_CDH_V2, 1000 + i);
+    memset(&reports[i], 0, sizeof(librorc::EventDescriptor));
+    reports[i].calc_event_size = (i == 7 || i == 90) ? 4 : PAYLOAD;
+    index.add(i, &reports[i], event);
+  }
+
+  check(index.count() == EVENTS, "count");
+  check(index.recent(0)->reference == EVENTS - 1, "newest entry");
+  check(index.recent(INDEX_ENTRIES - 1)->reference ==
+            EVENTS - INDEX_ENTRIES,
+        "oldest entry");
+  check(index.recent(INDEX_ENTRIES) == NULL, "beyond capacity");
+  check(index.findReference(10) == NULL, "overwritten reference");
+  check(index.findReference(50) != NULL &&
+            index.findReference(50)->event_id == 1050,
+        "find reference");
+  check(index.findEventId(1060) != NULL &&
+            index.findEventId(1060)->reference == 60,
+        "find event id");
+  check(index.findReference(90)->version == 0, "short event");
+  check(index.findEventId(1090) == NULL, "no id for short event");
+
+  /** trigger class 0: ids with id % 70 == 0 or v2 with id % 70 == 50 */
+  vector<uint64_t> refs;
+  uint32_t expected = 0;
+  for (uint64_t i = EVENTS - INDEX_ENTRIES; i < EVENTS; i++) {
+    uint32_t tc = (1000 + i) % 70;
+    if (!(i & 1)) {
+      tc %= 50;
+    }
+    if (tc == 0 && i != 90) {
+      expected++;
+    }
+  }
+  uint32_t matches = index.selectTriggerClasses(1, 0, &refs);
+  check(matches == expected && refs.size() == expected,
+        "select trigger class");
+  cout << "trigger class 0: " << matches << " of " << INDEX_ENTRIES
+       << " indexed events" << endl;
+
+  index.clear();
+  check(index.recent(0) == NULL, "clear");
+}
+
+int main(int argc, char *argv[]) {
+  checkView();
+  checkIndex();
+  cout << (failures ? "FAIL" : "PASS") << endl;
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include "replay_bar.hh"
+#include <iostream>
+#include <map>
+#include <vector>
+#include <string.h>
+#include <time.h>
+
+using namespace std;
+
+#define NUM_CHANNELS 12
+#define EVENTS_PER_CHANNEL 16
+#define CHANNEL_ADDR_RANGE 0x100000
+
+/** time until a controller sets write done after a block was issued */
+#define WRITE_LATENCY_NS 2000
+/** round trip time of a register read */
+#define READ_LATENCY_NS 800
+
+#define DATA_REPLAY_EOE (1 << 8)
+#define DATA_REPLAY_END (1 << 9)
+
+/**
+ * check DDR3 contents of one event against the expected block layout
+ **/
+bool checkEvent(replay_bar *fake, librorc::ddr3_replay_event *ev) {
+  uint32_t c = (ev->channel > 5) ? 1 : 0;
+  uint32_t chsel = 1 << (ev->channel % 6);
+  uint32_t addr = ev->ddr3_start_addr;
+  uint32_t left = ev->num_dws;
+  uint32_t *data = ev->event_data;
+  while (left) {
+    uint32_t n = (left < 15) ? left : 15;
+    uint32_t header = ((uint32_t)((1 << n) - 1) << 16) | chsel;
+    if (left <= 15) {
+      header |= DATA_REPLAY_EOE | (ev->last_event ? DATA_REPLAY_END : 0);
+    }
+    map<uint32_t, vector<uint32_t> >::iterator it = fake->ddr3[c].find(addr);
+    if (it == fake->ddr3[c].end() || it->second[0] != header ||
+        memcmp(&it->second[1], data, n * sizeof(uint32_t)) != 0) {
+      cout << "ch " << (int)ev->channel << ": mismatch at 0x" << hex << addr
+           << dec << endl;
+      return false;
+    }
+    addr += 8;
+    data += n;
+    left -= n;
+  }
+  if (ev->next_addr != addr) {
+    cout << "ch " << (int)ev->channel << ": wrong next_addr" << endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * build EVENTS_PER_CHANNEL chained events for each channel
+ **/
+vector<librorc::ddr3_replay_event> buildEvents(vector<uint32_t> &data) {
+  vector<librorc::ddr3_replay_event> events;
+  uint32_t total = 0;
+  for (uint32_t ch = 0; ch < NUM_CHANNELS; ch++) {
+    for (uint32_t i = 0; i < EVENTS_PER_CHANNEL; i++) {
+      total += 100 + 37 * ch + 13 * i;
+    }
+  }
+  data.resize(total);
+  for (uint32_t i = 0; i < total; i++) {
+    data[i] = (i * 2654435761u) ^ 0x5a5a5a5a;
+  }
+
+  uint32_t pos = 0;
+  for (uint32_t ch = 0; ch < NUM_CHANNELS; ch++) {
+    uint32_t addr = (ch % 6) * CHANNEL_ADDR_RANGE;
+    for (uint32_t i = 0; i < EVENTS_PER_CHANNEL; i++) {
+      librorc::ddr3_replay_event ev;
+      ev.event_data = &data[pos];
+      ev.num_dws = 100 + 37 * ch + 13 * i;
+      ev.ddr3_start_addr = addr;
+      ev.channel = ch;
+      ev.last_event = (i == EVENTS_PER_CHANNEL - 1);
+      ev.diu_error = false;
+      ev.next_addr = 0;
+      pos += ev.num_dws;
+      /** blocks are 8 address units apart */
+      addr += ((ev.num_dws + 14) / 15) * 8;
+      events.push_back(ev);
+    }
+  }
+  return events;
+}
+
+bool check(const char *name, replay_bar *fake,
+           vector<librorc::ddr3_replay_event> &events) {
+  bool pass = (fake->overwrites == 0);
+  for (uint32_t i = 0; i < events.size() && pass; i++) {
+    pass = checkEvent(fake, &events[i]);
+  }
+  cout << name << ": " << fake->blocks << " blocks, " << fake->overwrites
+       << " replay buffer overwrites, " << (pass ? "OK" : "FAILED") << endl;
+  return pass;
+}
+
+int main(int argc, char *argv[]) {
+  vector<uint32_t> data;
+  bool pass = true;
+
+  /** one event at a time */
+  {
+    vector<librorc::ddr3_replay_event> events = buildEvents(data);
+    replay_bar *fake = new replay_bar(WRITE_LATENCY_NS, READ_LATENCY_NS);
+    librorc::bar *bar = new librorc::bar(fake);
+    librorc::sysmon sm(bar);
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < events.size(); i++) {
+      librorc::ddr3_replay_event *ev = &events[i];
+      ev->next_addr =
+          sm.ddr3DataReplayEventToRam(ev->event_data, ev->num_dws,
+                                      ev->ddr3_start_addr, ev->channel,
+                                      ev->last_event, ev->diu_error);
+      bytes += ev->num_dws << 2;
+    }
+    gettimeofday(&end, NULL);
+    double secs =
+        (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+    cout << "ddr3DataReplayEventToRam: " << bytes / secs / (1024.0 * 1024.0)
+         << " MB/s" << endl;
+    pass &= check("ddr3DataReplayEventToRam", fake, events);
+    delete bar;
+  }
+
+  /** streaming upload, one thread per controller */
+  {
+    vector<librorc::ddr3_replay_event> events = buildEvents(data);
+    replay_bar *fake = new replay_bar(WRITE_LATENCY_NS, READ_LATENCY_NS);
+    librorc::bar *bar = new librorc::bar(fake);
+    librorc::sysmon sm(bar);
+
+    librorc::ddr3_replay_upload_stats stats;
+    sm.ddr3DataReplayUpload(events, &stats);
+    cout << "ddr3DataReplayUpload: " << stats.mbps << " MB/s (C0 "
+         << stats.controller_mbps[0] << " MB/s, C1 "
+         << stats.controller_mbps[1] << " MB/s)" << endl;
+    pass &= check("ddr3DataReplayUpload", fake, events);
+    pass &= (stats.blocks == fake->blocks);
+    delete bar;
+  }
+
+  cout << (pass ? "PASS" : "FAIL") << endl;
+  return pass ? 0 : 1;
+}
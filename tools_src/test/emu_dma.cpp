@@ -0,0 +1,255 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include <librorc/bar_impl_emu.hh>
+#include <iostream>
+#include <iomanip>
+#include <pthread.h>
+#include <string.h>
+#include <sys/time.h>
+
+using namespace std;
+
+#define HELP_TEXT                                                              \
+  "emu_dma usage: emu_dma [options]\n"                                         \
+  "Runs the host side DMA data path against the in-process C-RORC\n"           \
+  "emulator and checks all received events.\n"                                 \
+  "  -n <channels>  number of DMA channels, default: 1\n"                      \
+  "  -s <size>      PatternGenerator event size in DWs, default: 2048\n"       \
+  "  -b <size>      EventBuffer size in MB, default: 8\n"                      \
+  "  -p <size>      PCIe packet size in bytes, default: 256\n"                 \
+  "  -t <seconds>   run time, default: 2\n"                                    \
+  "  -H             use hugepages for the DMA buffers\n"
+
+/** release events in batches, like a consumer using event_stream */
+#define RELEASE_BATCH 64
+
+struct consumer {
+  librorc::link *link;
+  librorc::dma_channel *channel;
+  uint32_t *eb;
+  librorc::EventDescriptor *reports;
+  uint64_t eb_size;
+  uint64_t rb_size;
+  uint64_t max_rb_entries;
+  uint32_t event_size;
+  volatile bool *stop;
+
+  uint64_t events;
+  uint64_t bytes;
+  uint64_t errors;
+};
+
+bool checkEvent(consumer *c, librorc::EventDescriptor *report,
+                uint64_t event_id) {
+  uint32_t size = c->event_size;
+  if (report->reported_event_size != size ||
+      (report->calc_event_size & 0x3fffffff) != size) {
+    return false;
+  }
+  const uint32_t *event = c->eb + report->offset / 4;
+  if (librorc::cdh_v2(event).eventId() != (event_id & 0xfffffffffull)) {
+    return false;
+  }
+  for (uint32_t i = LIBRORC_EMU_CDH_SIZE; i < size; i++) {
+    if (event[i] != i - LIBRORC_EMU_CDH_SIZE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void *consume(void *arg) {
+  consumer *c = (consumer *)arg;
+  uint64_t index = 0;
+  uint64_t pending = 0;
+  while (!*c->stop) {
+    librorc::EventDescriptor *report = &c->reports[index];
+    if (report->reported_event_size == 0) {
+      continue;
+    }
+    if (!checkEvent(c, report, c->events)) {
+      c->errors++;
+    }
+    c->events++;
+    c->bytes += (report->calc_event_size & 0x3fffffff) << 2;
+    pending++;
+
+    if (pending == RELEASE_BATCH || c->reports[(index + 1) %
+        c->max_rb_entries].reported_event_size == 0) {
+      /** clear the released descriptors and hand the space back */
+      uint64_t eb_offset = report->offset;
+      for (uint64_t i = 0; i < pending; i++) {
+        uint64_t idx = (index + c->max_rb_entries - i) % c->max_rb_entries;
+        memset((void *)&c->reports[idx], 0, sizeof(librorc::EventDescriptor));
+      }
+      c->channel->setBufferOffsetsOnDevice(
+          eb_offset, index * sizeof(librorc::EventDescriptor));
+      pending = 0;
+    }
+    index = (index + 1) % c->max_rb_entries;
+  }
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t channels = 1;
+  uint32_t event_size = 2048;
+  uint64_t eb_size = 8ull << 20;
+  uint32_t pkt_size = 256;
+  uint32_t seconds = 2;
+  bool hugepages = false;
+
+  int arg;
+  while ((arg = getopt(argc, argv, "hn:s:b:p:t:H")) != -1) {
+    switch (arg) {
+    case 'n':
+      channels = strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      event_size = strtoul(optarg, NULL, 0);
+      break;
+    case 'b':
+      eb_size = strtoull(optarg, NULL, 0) << 20;
+      break;
+    case 'p':
+      pkt_size = strtoul(optarg, NULL, 0);
+      break;
+    case 't':
+      seconds = strtoul(optarg, NULL, 0);
+      break;
+    case 'H':
+      hugepages = true;
+      break;
+    default:
+      cout << HELP_TEXT;
+      return (arg == 'h') ? 0 : -1;
+    }
+  }
+  if (channels == 0 || event_size == 0 || eb_size == 0 || pkt_size == 0 ||
+      (pkt_size % 4) || pkt_size > 256 ||
+      ((uint64_t)event_size << 2) >= eb_size) {
+    cout << HELP_TEXT;
+    return -1;
+  }
+
+  librorc::bar_impl_emu *emu = new librorc::bar_impl_emu(channels);
+  librorc::bar *bar = new librorc::bar(emu);
+  librorc::sysmon sm(bar);
+  cout << "emulated firmware: " << sm.firmwareDescription() << ", "
+       << sm.numberOfChannels() << " channels" << endl;
+
+  volatile bool stop = false;
+  consumer *c = new consumer[channels];
+  pthread_t *threads = new pthread_t[channels];
+  uint64_t rb_size = (eb_size / pkt_size) * sizeof(librorc::EventDescriptor);
+
+  for (uint32_t i = 0; i < channels; i++) {
+    c[i].link = new librorc::link(bar, i);
+    c[i].channel = new librorc::dma_channel(c[i].link);
+    c[i].eb = (uint32_t *)librorc::bar_impl_emu::allocateHostBuffer(eb_size,
+                                                                    hugepages);
+    c[i].reports = (librorc::EventDescriptor *)
+        librorc::bar_impl_emu::allocateHostBuffer(rb_size, hugepages);
+    if (c[i].eb == NULL || c[i].reports == NULL) {
+      cout << "failed to allocate DMA buffers" << endl;
+      return -1;
+    }
+    c[i].eb_size = eb_size;
+    c[i].rb_size = rb_size;
+    c[i].max_rb_entries = rb_size / sizeof(librorc::EventDescriptor);
+    c[i].event_size = event_size;
+    c[i].stop = &stop;
+    c[i].events = 0;
+    c[i].bytes = 0;
+    c[i].errors = 0;
+
+    if (c[i].channel->configure(
+            librorc::bar_impl_emu::sgList(c[i].eb, eb_size), eb_size,
+            librorc::bar_impl_emu::sgList(c[i].reports, rb_size), rb_size,
+            librorc::kEventStreamToHost, pkt_size) != 0) {
+      cout << "failed to configure DMA channel " << i << endl;
+      return -1;
+    }
+    c[i].channel->enable();
+
+    librorc::patterngenerator pg(c[i].link);
+    pg.configureMode(PG_PATTERN_INC, 0, 0);
+    pg.setStaticEventSize(event_size);
+    pg.useAsDataSource();
+    pthread_create(&threads[i], NULL, consume, &c[i]);
+    pg.enable();
+  }
+
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  sleep(seconds);
+
+  for (uint32_t i = 0; i < channels; i++) {
+    librorc::patterngenerator pg(c[i].link);
+    pg.disable();
+    c[i].channel->disable();
+  }
+  gettimeofday(&end, NULL);
+  stop = true;
+
+  double runtime = (end.tv_sec - start.tv_sec) +
+                   (end.tv_usec - start.tv_usec) / 1000000.0;
+  uint64_t events = 0, bytes = 0, errors = 0;
+  for (uint32_t i = 0; i < channels; i++) {
+    pthread_join(threads[i], NULL);
+    cout << "channel " << setw(2) << i << ": " << setw(10) << c[i].events
+         << " events, " << fixed << setprecision(1) << setw(8)
+         << (c[i].bytes / runtime / (1 << 20)) << " MB/s, " << c[i].errors
+         << " errors, " << c[i].channel->eventCount()
+         << " events on device" << endl;
+    events += c[i].events;
+    bytes += c[i].bytes;
+    errors += c[i].errors;
+  }
+  cout << "total     : " << setw(10) << events << " events, " << fixed
+       << setprecision(1) << setw(8) << (bytes / runtime / (1 << 20))
+       << " MB/s, " << setprecision(0) << (events / runtime) << " events/s"
+       << endl;
+
+  bool pass = (events != 0 && errors == 0);
+  cout << (pass ? "PASS" : "FAIL") << endl;
+
+  for (uint32_t i = 0; i < channels; i++) {
+    delete c[i].channel;
+    delete c[i].link;
+    librorc::bar_impl_emu::freeHostBuffer(c[i].eb, eb_size);
+    librorc::bar_impl_emu::freeHostBuffer(c[i].reports, rb_size);
+  }
+  delete[] c;
+  delete[] threads;
+  delete bar;
+  return pass ? 0 : 1;
+}
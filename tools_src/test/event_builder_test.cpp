@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include <iostream>
+#include <vector>
+#include <string.h>
+#include <unistd.h>
+
+using namespace std;
+
+#define SOURCES 4
+#define EVENTS 10000
+#define CDH_SIZE 8
+/** source 2 never delivers this event */
+#define MISSING_ID 5000
+
+/**
+ * synthetic source: delivers the events 0..EVENTS-1 as 8 DW CDH only
+ * fragments. Source 1 swaps neighbouring events, source 2 drops
+ * MISSING_ID.
+ **/
+class test_source : public librorc::event_fragment_source {
+public:
+  test_source(uint32_t s) {
+    m_next = 0;
+    m_released.resize(EVENTS, 0);
+    for (uint64_t i = 0; i < EVENTS; i++) {
+      uint64_t id = i;
+      if (s == 1) {
+        id = i ^ 1;
+      }
+      if (s == 2 && id == MISSING_ID) {
+        continue;
+      }
+      m_order.push_back(id);
+    }
+    m_cdh.resize(EVENTS * CDH_SIZE, 0);
+    m_reports.resize(EVENTS);
+    for (uint64_t id = 0; id < EVENTS; id++) {
+      uint32_t *cdh = &m_cdh[id * CDH_SIZE];
+      cdh[0] = 0xffffffff;
+      cdh[1] = (2 << 24) | (id & 0xfff);
+      cdh[2] = (id >> 12) & 0xffffff;
+      memset(&m_reports[id], 0, sizeof(librorc::EventDescriptor));
+      m_reports[id].calc_event_size = CDH_SIZE;
+      m_reports[id].reported_event_size = CDH_SIZE;
+    }
+  }
+
+  bool fetchFragment(librorc::EventDescriptor **report,
+                     const uint32_t **event, uint64_t *reference) {
+    if (m_next >= m_order.size()) {
+      return false;
+    }
+    uint64_t id = m_order[m_next++];
+    *report = &m_reports[id];
+    *event = &m_cdh[id * CDH_SIZE];
+    *reference = id;
+    return true;
+  }
+
+  int releaseFragment(uint64_t reference) {
+    m_released[reference]++;
+    return 0;
+  }
+
+  volatile size_t m_next;
+  vector<uint64_t> m_order;
+  vector<uint32_t> m_cdh;
+  vector<librorc::EventDescriptor> m_reports;
+  vector<uint32_t> m_released;
+};
+
+int main(int argc, char *argv[]) {
+  librorc::event_builder builder;
+  test_source *sources[SOURCES];
+  for (uint32_t s = 0; s < SOURCES; s++) {
+    sources[s] = new test_source(s);
+    builder.addSource(sources[s]);
+  }
+  builder.setReorderWindow(16);
+  builder.setTimeout(20000);
+  if (builder.start() != 0) {
+    cout << "failed to start builder" << endl;
+    return 1;
+  }
+
+  uint64_t built = 0;
+  uint64_t errors = 0;
+  bool missing_seen = false;
+  uint32_t idle = 0;
+  while (built < EVENTS && idle < 100000) {
+    librorc::built_event *event;
+    if (!builder.getNextEvent(&event)) {
+      idle++;
+      usleep(10);
+      continue;
+    }
+    idle = 0;
+    built++;
+    for (uint32_t s = 0; s < SOURCES; s++) {
+      if (((event->sources >> s) & 1) &&
+          event->fragment[s].event_id != event->event_id) {
+        errors++;
+      }
+    }
+    if (event->event_id == MISSING_ID) {
+      missing_seen = true;
+      if (event->complete || event->sources != 0xb) {
+        errors++;
+      }
+    } else if (!event->complete) {
+      errors++;
+    }
+    builder.releaseEvent(event);
+  }
+  builder.stop();
+
+  uint64_t bad_releases = 0;
+  for (uint32_t s = 0; s < SOURCES; s++) {
+    for (uint64_t id = 0; id < EVENTS; id++) {
+      uint32_t expected = (s == 2 && id == MISSING_ID) ? 0 : 1;
+      if (sources[s]->m_released[id] != expected) {
+        bad_releases++;
+      }
+    }
+  }
+
+  cout << "built events: " << built << " (" << builder.completeEvents()
+       << " complete, " << builder.incompleteEvents() << " incomplete), "
+       << builder.fragments() << " fragments" << endl;
+  cout << "errors: " << errors << ", bad releases: " << bad_releases
+       << endl;
+
+  bool pass = (built == EVENTS) && (errors == 0) && (bad_releases == 0) &&
+              missing_seen && (builder.completeEvents() == EVENTS - 1) &&
+              (builder.incompleteEvents() == 1) &&
+              (builder.fragments() == SOURCES * EVENTS - 1);
+  cout << (pass ? "PASS" : "FAIL") << endl;
+  return pass ? 0 : 1;
+}
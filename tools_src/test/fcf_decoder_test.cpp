@@ -0,0 +1,208 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace std;
+
+#define HELP_TEXT                                                              \
+  "fcf_decoder_test usage: fcf_decoder_test [options]\n"                       \
+  "Checks the AVX2 FCF output decoder against the scalar one and\n"            \
+  "measures their throughput.\n"                                               \
+  "  -f <file>   recorded FCF output event (.ddl) to benchmark with\n"         \
+  "  -n <count>  synthetic clusters per event, default: 20000\n"              \
+  "  -i <iter>   benchmark iterations, default: 200\n"
+
+uint32_t floatWord(float f) {
+  uint32_t w;
+  memcpy(&w, &f, sizeof(w));
+  return w;
+}
+
+/** FCF output event: CDH v2, clusters, two RCU trailer words */
+vector<uint32_t> syntheticEvent(uint32_t clusters) {
+  vector<uint32_t> event(LIBRORC_CDH_V2_SIZE, 0);
+  event[0] = 0xffffffff;
+  event[1] = (LIBRORC_CDH_V2 << 24) | 0x123;
+  for (uint32_t i = 0; i < clusters; i++) {
+    float pad = (rand() % 14000) / 100.0f;
+    float time = (rand() % 100000) / 100.0f;
+    event.push_back((3u << 30) | ((i % 64) << 24) | (rand() & 0xffffff));
+    event.push_back(floatWord(pad));
+    event.push_back(floatWord(time));
+    /** some moments below the squared mean to exercise the clamp */
+    event.push_back(floatWord(pad * pad + (rand() % 200 - 20) / 100.0f));
+    event.push_back(floatWord(time * time + (rand() % 200 - 20) / 100.0f));
+    event.push_back(rand() & 0x3ffffff);
+  }
+  event.push_back(0x80000000 | clusters);
+  event.push_back(0x80000000);
+  return event;
+}
+
+bool sameClusters(librorc::fcf_clusters *a, librorc::fcf_clusters *b) {
+  uint32_t n = a->size();
+  if (b->size() != n) {
+    return false;
+  }
+  return !memcmp(a->row, b->row, n * 4) && !memcmp(a->flags, b->flags, n * 4) &&
+         !memcmp(a->pad, b->pad, n * 4) && !memcmp(a->time, b->time, n * 4) &&
+         !memcmp(a->charge, b->charge, n * 4) &&
+         !memcmp(a->qmax, b->qmax, n * 4) &&
+         !memcmp(a->sigma_pad2, b->sigma_pad2, n * 4) &&
+         !memcmp(a->sigma_time2, b->sigma_time2, n * 4);
+}
+
+double benchmark(librorc::fcf_decoder *decoder, const vector<uint32_t> &event,
+                 uint32_t iterations, librorc::fcf_clusters *clusters) {
+  timeval start, end;
+  gettimeofday(&start, NULL);
+  for (uint32_t i = 0; i < iterations; i++) {
+    clusters->clear();
+    decoder->decode(&event[0], event.size(), clusters);
+  }
+  gettimeofday(&end, NULL);
+  return librorc::gettimeofdayDiff(start, end);
+}
+
+int main(int argc, char *argv[]) {
+  const char *filename = NULL;
+  uint32_t nclusters = 20000;
+  uint32_t iterations = 200;
+
+  int arg;
+  while ((arg = getopt(argc, argv, "hf:n:i:")) != -1) {
+    switch (arg) {
+    case 'f':
+      filename = optarg;
+      break;
+    case 'n':
+      nclusters = strtoul(optarg, NULL, 0);
+      break;
+    case 'i':
+      iterations = strtoul(optarg, NULL, 0);
+      break;
+    default:
+      cout << HELP_TEXT;
+      return (arg == 'h') ? 0 : -1;
+    }
+  }
+
+  srand(7);
+  bool pass = true;
+
+  /** odd count to cover the scalar remainder of the AVX2 path */
+  vector<uint32_t> event = syntheticEvent(1003);
+  librorc::fcf_decoder scalar;
+  librorc::fcf_decoder vector_decoder;
+  scalar.setSimd(false);
+  librorc::fcf_clusters a, b;
+  int32_t na = scalar.decode(&event[0], event.size(), &a);
+  int32_t nb = vector_decoder.decode(&event[0], event.size(), &b);
+  bool same = (na == 1003) && (nb == 1003) && sameClusters(&a, &b);
+  cout << "AVX2 " << (librorc::fcf_decoder::simdAvailable() ? "" : "not ")
+       << "available, scalar and default decoder "
+       << (same ? "match" : "DIFFER") << endl;
+  pass &= same;
+
+  /** field decoding of cluster 5 */
+  const uint32_t *w = &event[LIBRORC_CDH_V2_SIZE + 5 * 6];
+  float pad, p2;
+  memcpy(&pad, &w[1], 4);
+  memcpy(&p2, &w[3], 4);
+  float sigma = p2 - pad * pad;
+  pass &= (a.row[5] == 5) && (a.pad[5] == pad) &&
+          (a.charge[5] == (w[0] & 0xffffff) / 64.0f) &&
+          (a.qmax[5] == (w[5] & 0x7fffff) / 64.0f) &&
+          (a.flags[5] == ((w[5] >> 23) & 7)) &&
+          (a.sigma_pad2[5] == (sigma > 0 ? sigma : 0));
+
+  /** appending and tagging masks */
+  librorc::fcf_parameters params;
+  memset(&params, 0, sizeof(params));
+  params.tag_border_clusters = 1;
+  vector_decoder.setTagging(&params);
+  vector_decoder.decode(&event[0], event.size(), &b);
+  bool masked = (b.size() == 2006);
+  for (uint32_t i = 1003; i < 2006; i++) {
+    masked &= (b.flags[i] == (b.flags[i - 1003] & LIBRORC_FCF_FLAG_BORDER));
+    masked &= (b.pad[i] == b.pad[i - 1003]);
+  }
+  cout << "tagging mask " << (masked ? "applied" : "NOT applied") << endl;
+  pass &= masked;
+
+  vector<uint32_t> bad(event.begin(), event.begin() + 4);
+  pass &= (scalar.decode(&bad[0], bad.size(), &a) == -1);
+
+  /** throughput */
+  vector<uint32_t> bench;
+  if (filename) {
+    FILE *fd = fopen(filename, "r");
+    if (!fd) {
+      perror("fopen");
+      return -1;
+    }
+    uint32_t word;
+    while (fread(&word, sizeof(word), 1, fd) == 1) {
+      bench.push_back(word);
+    }
+    fclose(fd);
+  } else {
+    bench = syntheticEvent(nclusters);
+  }
+
+  librorc::fcf_clusters out;
+  librorc::fcf_decoder bench_decoder;
+  int32_t n = bench_decoder.decode(&bench[0], bench.size(), &out);
+  if (n < 0) {
+    cout << "no FCF output event" << endl;
+    return -1;
+  }
+  for (uint32_t simd = 0; simd < 2; simd++) {
+    bench_decoder.setSimd(simd);
+    if (simd && !bench_decoder.simd()) {
+      continue;
+    }
+    double seconds = benchmark(&bench_decoder, bench, iterations, &out);
+    cout << (simd ? "AVX2  " : "scalar") << ": "
+         << (double)n * iterations / seconds / 1e6 << " M clusters/s, "
+         << (double)bench.size() * 4 * iterations / seconds / (1 << 20)
+         << " MB/s" << endl;
+  }
+
+  cout << (pass ? "PASS" : "FAIL") << endl;
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include "test_bar.hh"
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace std;
+
+/** device number of the test cache, chosen to not collide with boards */
+#define TEST_DEVICE 253
+#define LINKS 12
+#define DDL_OFFSET (1 << RORC_REGFILE_DDL_SEL)
+
+/**
+ * BAR backend on plain memory modelling the FCF mapping RAM behind the
+ * CTRL/DATA register pair of each link
+ **/
+class mapping_bar : public test_bar {
+public:
+  mapping_bar() { memset(ram, 0, sizeof(ram)); }
+
+  uint32_t ram[LINKS][LIBRORC_FCF_MAPPING_RAM_SIZE];
+
+protected:
+  void write32(librorc::bar_address address, uint32_t data) {
+    m_regs[address] = data;
+    uint32_t ch = address / RORC_CHANNEL_OFFSET - 1;
+    uint32_t reg = address % RORC_CHANNEL_OFFSET;
+    if (ch >= LINKS || reg != DDL_OFFSET + RORC_REG_FCF_RAM_CTRL) {
+      return;
+    }
+    uint32_t *data_reg = m_regs + address - RORC_REG_FCF_RAM_CTRL +
+                         RORC_REG_FCF_RAM_DATA;
+    uint32_t entry = data & (LIBRORC_FCF_MAPPING_RAM_SIZE - 1);
+    if (data & (1 << 31)) {
+      ram[ch][entry] = *data_reg & LIBRORC_FCF_MAPPING_DATA_MASK;
+    } else {
+      *data_reg = ram[ch][entry];
+    }
+  }
+};
+
+static bool check(const char *name, bool ok) {
+  cout << (ok ? "ok   " : "FAIL ") << name << endl;
+  return ok;
+}
+
+static bool ramMatches(mapping_bar *impl, uint32_t ch,
+                       const vector<uint32_t> &table) {
+  for (uint32_t i = 0; i < table.size(); i++) {
+    if (impl->ram[ch][i] != (table[i] & LIBRORC_FCF_MAPPING_DATA_MASK)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  bool ok = true;
+  srand(42);
+  vector<uint32_t> table(LIBRORC_FCF_MAPPING_RAM_SIZE);
+  for (uint32_t i = 0; i < table.size(); i++) {
+    table[i] = ((uint32_t)rand() << 8 ^ rand()) & LIBRORC_FCF_MAPPING_DATA_MASK;
+  }
+  librorc::fastclusterfinder::removeMappingCache(TEST_DEVICE);
+
+  /** reference: one register round trip per entry */
+  mapping_bar *single = new mapping_bar();
+  librorc::bar *single_bar = new librorc::bar(single);
+  librorc::link single_link(single_bar, 0);
+  librorc::fastclusterfinder single_fcf(&single_link);
+  for (uint32_t i = 0; i < table.size(); i++) {
+    single_fcf.writeMappingRamEntry(i, table[i]);
+  }
+  ok &= check("per-entry load", ramMatches(single, 0, table));
+
+  mapping_bar *bulk = new mapping_bar();
+  librorc::bar *bulk_bar = new librorc::bar(bulk);
+  vector<librorc::link *> links;
+  vector<librorc::fastclusterfinder *> fcfs;
+  for (uint32_t ch = 0; ch < LINKS; ch++) {
+    links.push_back(new librorc::link(bulk_bar, ch));
+    fcfs.push_back(new librorc::fastclusterfinder(links[ch]));
+    fcfs[ch]->setMappingCacheDevice(TEST_DEVICE);
+  }
+
+  int result = fcfs[0]->loadMappingRam(&table[0], table.size(),
+                                       LIBRORC_FCF_VERIFY_NONE);
+  cout << "per-entry: " << single->flushes << " completions, bulk: "
+       << bulk->flushes << " completions" << endl;
+  ok &= check("bulk load", result == 0 && ramMatches(bulk, 0, table));
+  ok &= check("bulk load waits for one completion per burst",
+              bulk->flushes ==
+                  (table.size() + LIBRORC_FCF_MAPPING_BURST - 1) /
+                      LIBRORC_FCF_MAPPING_BURST);
+  ok &= check("full verify", fcfs[0]->verifyMappingRam(
+                                 &table[0], table.size(),
+                                 LIBRORC_FCF_VERIFY_FULL) == 0);
+
+  /** unchanged table: only the sampled readback touches the BAR */
+  uint64_t writes = bulk->writes;
+  result = fcfs[0]->loadMappingRam(&table[0], table.size());
+  ok &= check("unchanged table skipped",
+              result == LIBRORC_FCF_MAPPING_UNCHANGED &&
+                  bulk->writes - writes <= 2 * LIBRORC_FCF_VERIFY_SAMPLES + 2);
+
+  /** a cleared RAM, e.g. after FPGA reconfiguration, is reloaded */
+  memset(bulk->ram[0], 0, sizeof(bulk->ram[0]));
+  result = fcfs[0]->loadMappingRam(&table[0], table.size());
+  ok &= check("cleared RAM reloaded", result == 0 && ramMatches(bulk, 0, table));
+
+  /** single entry writes invalidate the cached hash */
+  fcfs[0]->writeMappingRamEntry(1, table[1] ^ 1);
+  result = fcfs[0]->loadMappingRam(&table[0], table.size());
+  ok &= check("entry write invalidates cache",
+              result == 0 && ramMatches(bulk, 0, table));
+
+  /** cache is shared with other instances on the same device */
+  librorc::fastclusterfinder other(links[0]);
+  other.setMappingCacheDevice(TEST_DEVICE);
+  ok &= check("cache shared between instances",
+              other.loadMappingRam(&table[0], table.size()) ==
+                  LIBRORC_FCF_MAPPING_UNCHANGED);
+
+  /** all links in parallel, one forced mismatch per link */
+  vector<uint32_t> table2(table);
+  for (uint32_t i = 0; i < table2.size(); i++) {
+    table2[i] ^= 0x155;
+  }
+  vector<int> results;
+  result = librorc::fastclusterfinder::loadMappingRamParallel(
+      fcfs, &table2[0], table2.size(), LIBRORC_FCF_VERIFY_FULL, &results);
+  bool all = (result == 0 && results.size() == LINKS);
+  for (uint32_t ch = 0; ch < LINKS; ch++) {
+    all &= (results[ch] == 0 && ramMatches(bulk, ch, table2));
+  }
+  ok &= check("parallel load", all);
+
+  /** mapping file: "addr data" and "data" lines, comments */
+  char filename[] = "/tmp/fcf_mapping_testXXXXXX";
+  int fd = mkstemp(filename);
+  FILE *f = fdopen(fd, "w");
+  fprintf(f, "# FCF mapping\n0x0 0x10\n0x11 # row 0\n\n5 0x1fffffff\n7\n");
+  fclose(f);
+  vector<uint32_t> parsed;
+  int32_t n = librorc::fastclusterfinder::readMappingFile(filename, &parsed);
+  ok &= check("read mapping file",
+              n == 7 && parsed[0] == 0x10 && parsed[1] == 0x11 &&
+                  parsed[2] == 0 && parsed[5] == 0x1fffffff && parsed[6] == 7);
+  f = fopen(filename, "w");
+  fprintf(f, "4096 1\n");
+  fclose(f);
+  ok &= check("reject out of range address",
+              librorc::fastclusterfinder::readMappingFile(filename, &parsed) <
+                  0);
+  unlink(filename);
+
+  ok &= check("reject oversized table",
+              fcfs[0]->loadMappingRam(&table[0], table.size() + 1) < 0);
+
+  for (uint32_t ch = 0; ch < LINKS; ch++) {
+    delete fcfs[ch];
+    delete links[ch];
+  }
+  librorc::fastclusterfinder::removeMappingCache(TEST_DEVICE);
+  delete bulk_bar;
+  delete single_bar;
+
+  cout << (ok ? "PASS" : "FAIL") << endl;
+  return ok ? 0 : 1;
+}
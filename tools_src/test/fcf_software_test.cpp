@@ -0,0 +1,367 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include <iostream>
+#include <vector>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+using namespace std;
+
+#define ROWS 32
+#define PADS 128
+#define TIMEBINS 256
+#define ZS_THRESHOLD 2
+#define CHANNELS 4
+#define EVENTS 16
+#define CLUSTERS_PER_EVENT 400
+
+/** hardware address of a pad: [11:7] row, [6:0] pad */
+static uint32_t mappingEntry(uint32_t addr, uint32_t gain) {
+  uint32_t row = (addr >> 7) & 0x1f;
+  uint32_t pad = addr & 0x7f;
+  uint32_t border = (pad == 0 || pad == PADS - 1);
+  return (gain << 16) | (1 << 15) | (border << 14) | (row << 8) | pad;
+}
+
+/**
+ * TPC sector readout model: ADC values of all pads, zero suppressed and
+ * packed into an RCU payload
+ **/
+class event_generator {
+public:
+  event_generator() : m_adc(ROWS * PADS * TIMEBINS) {}
+
+  void clear() { fill(m_adc.begin(), m_adc.end(), 0); }
+
+  void addCluster(uint32_t row, double pad, double time, double amplitude,
+                  double sigma_pad, double sigma_time) {
+    for (int p = (int)pad - 4; p <= (int)pad + 4; p++) {
+      for (int t = (int)time - 8; t <= (int)time + 8; t++) {
+        if (p < 0 || p >= PADS || t < 0 || t >= TIMEBINS) {
+          continue;
+        }
+        double dp = (p - pad) / sigma_pad;
+        double dt = (t - time) / sigma_time;
+        uint32_t &adc = m_adc[(row * PADS + p) * TIMEBINS + t];
+        adc += (uint32_t)(amplitude * exp(-0.5 * (dp * dp + dt * dt)));
+        adc = min(adc, 1023u);
+      }
+    }
+  }
+
+  void build(vector<uint32_t> *event) {
+    event->assign(LIBRORC_CDH_V2_SIZE, 0);
+    (*event)[1] = LIBRORC_CDH_V2 << 24;
+    vector<uint32_t> w10;
+    for (uint32_t addr = 0; addr < ROWS * PADS; addr++) {
+      const uint32_t *adc = &m_adc[addr * TIMEBINS];
+      w10.clear();
+      /** bunches in descending time order */
+      int t = TIMEBINS - 1;
+      while (t >= 0) {
+        if (adc[t] < ZS_THRESHOLD) {
+          t--;
+          continue;
+        }
+        size_t start = w10.size();
+        w10.push_back(0);
+        w10.push_back(t);
+        while (t >= 0 && adc[t] >= ZS_THRESHOLD) {
+          w10.push_back(adc[t--]);
+        }
+        w10[start] = w10.size() - start;
+      }
+      if (w10.empty()) {
+        continue;
+      }
+      event->push_back((LIBRORC_RCU_CHANNEL_MARKER << 30) |
+                       (w10.size() << 16) | addr);
+      for (size_t i = 0; i < w10.size(); i += 3) {
+        uint32_t w = w10[i] << 20;
+        w |= (i + 1 < w10.size()) ? (w10[i + 1] << 10) : 0;
+        w |= (i + 2 < w10.size()) ? w10[i + 2] : 0;
+        event->push_back(w);
+      }
+    }
+    event->push_back((LIBRORC_RCU_TRAILER_MARKER << 30) | 0x1234);
+    event->push_back((LIBRORC_RCU_TRAILER_MARKER << 30) | 2);
+    (*event)[0] = event->size() * 4;
+  }
+
+private:
+  vector<uint32_t> m_adc;
+};
+
+static bool check(const char *name, bool ok) {
+  cout << (ok ? "ok   " : "FAIL ") << name << endl;
+  return ok;
+}
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/** run one event through the software FCF and decode the result */
+static int32_t findClusters(librorc::fcf_software *fcf, event_generator *gen,
+                            const librorc::fcf_parameters *params,
+                            librorc::fcf_clusters *clusters) {
+  vector<uint32_t> event, output;
+  gen->build(&event);
+  fcf->setParameters(params);
+  if (fcf->process(&event[0], event.size(), &output) < 0) {
+    return -1;
+  }
+  librorc::fcf_decoder decoder;
+  decoder.setTagging(params);
+  clusters->clear();
+  return decoder.decode(&output[0], output.size(), clusters);
+}
+
+int main(int argc, char *argv[]) {
+  bool ok = true;
+  vector<uint32_t> table(LIBRORC_FCF_MAPPING_RAM_SIZE);
+  for (uint32_t i = 0; i < table.size(); i++) {
+    table[i] = mappingEntry(i, 1 << LIBRORC_FCF_GAIN_SHIFT);
+  }
+  librorc::fcf_software fcf;
+  ok &= check("mapping", fcf.setMapping(&table[0], table.size()) == 0);
+
+  librorc::fcf_parameters params;
+  memset(&params, 0, sizeof(params));
+  params.merger_distance = 2;
+  params.merger_algorithm = 1;
+  params.tag_border_clusters = 1;
+  params.tag_deconvoluted_clusters = 1;
+
+  event_generator gen;
+  librorc::fcf_clusters clusters;
+
+  /** output event format */
+  vector<uint32_t> event, output;
+  gen.addCluster(3, 40.3, 50.6, 200, 0.8, 1.2);
+  gen.build(&event);
+  fcf.setParameters(&params);
+  int32_t n = fcf.process(&event[0], event.size(), &output);
+  ok &= check("output keeps CDH and trailer",
+              n == 1 && output.size() == LIBRORC_CDH_V2_SIZE + 6 + 2 &&
+                  memcmp(&output[0], &event[0], LIBRORC_CDH_V2_SIZE * 4) ==
+                      0 &&
+                  output[output.size() - 1] == event[event.size() - 1]);
+
+  n = findClusters(&fcf, &gen, &params, &clusters);
+  ok &= check("isolated cluster",
+              n == 1 && clusters.row[0] == 3 &&
+                  fabs(clusters.pad[0] - 40.3) < 0.1 &&
+                  fabs(clusters.time[0] - 50.6) < 0.1 &&
+                  clusters.qmax[0] > 150 && clusters.flags[0] == 0 &&
+                  clusters.sigma_pad2[0] > 0.3 &&
+                  clusters.sigma_pad2[0] < 1.0);
+
+  /** gain correction scales charges */
+  vector<uint32_t> half(table);
+  half[3 * PADS + 40] = mappingEntry(3 * PADS + 40, 1 << 11);
+  librorc::fcf_software fcf_gain;
+  fcf_gain.setMapping(&half[0], half.size());
+  librorc::fcf_clusters gain_clusters;
+  n = findClusters(&fcf_gain, &gen, &params, &gain_clusters);
+  ok &= check("gain correction",
+              n == 1 && gain_clusters.charge[0] < clusters.charge[0] &&
+                  gain_clusters.pad[0] > clusters.pad[0]);
+
+  /** border pads */
+  gen.clear();
+  gen.addCluster(7, 0.4, 90, 200, 0.8, 1.2);
+  n = findClusters(&fcf, &gen, &params, &clusters);
+  ok &= check("border cluster tagged",
+              n == 1 && clusters.flags[0] == LIBRORC_FCF_FLAG_BORDER);
+
+  /** time deconvolution and noise suppression */
+  gen.clear();
+  gen.addCluster(5, 60.2, 40, 150, 0.8, 1.5);
+  gen.addCluster(5, 60.2, 49, 150, 0.8, 1.5);
+  n = findClusters(&fcf, &gen, &params, &clusters);
+  ok &= check("split in time",
+              n == 2 &&
+                  (clusters.flags[0] & LIBRORC_FCF_FLAG_DECONV_TIME) &&
+                  (clusters.flags[1] & LIBRORC_FCF_FLAG_DECONV_TIME) &&
+                  fabs(clusters.time[0] - clusters.time[1]) > 8);
+
+  gen.clear();
+  gen.addCluster(5, 60.2, 40, 24, 0.8, 1.5);
+  gen.addCluster(5, 60.2, 45, 24, 0.8, 1.5);
+  librorc::fcf_parameters noisy = params;
+  noisy.merger_distance = 6;
+  noisy.noise_suppression = 15;
+  n = findClusters(&fcf, &gen, &noisy, &clusters);
+  ok &= check("shallow minimum suppressed", n == 1);
+  noisy.noise_suppression = 2;
+  n = findClusters(&fcf, &gen, &noisy, &clusters);
+  ok &= check("shallow minimum split", n == 2);
+
+  /** pad deconvolution */
+  gen.clear();
+  gen.addCluster(9, 20, 80, 200, 0.7, 1.2);
+  gen.addCluster(9, 24, 80, 200, 0.7, 1.2);
+  librorc::fcf_parameters deconv = params;
+  n = findClusters(&fcf, &gen, &deconv, &clusters);
+  ok &= check("merged without pad deconvolution",
+              n == 1 && fabs(clusters.pad[0] - 22) < 0.1);
+  deconv.deconv_pad = 1;
+  n = findClusters(&fcf, &gen, &deconv, &clusters);
+  ok &= check("split with pad deconvolution",
+              n == 2 && (clusters.flags[0] & LIBRORC_FCF_FLAG_DECONV_PAD) &&
+                  (clusters.flags[1] & LIBRORC_FCF_FLAG_DECONV_PAD));
+
+  /** merger distance */
+  gen.clear();
+  gen.addCluster(11, 30, 80, 200, 0.1, 1.2);
+  gen.addCluster(11, 31, 84, 200, 0.1, 1.2);
+  n = findClusters(&fcf, &gen, &params, &clusters);
+  ok &= check("distant sequences not merged", n == 2);
+  librorc::fcf_parameters wide = params;
+  wide.merger_distance = 4;
+  n = findClusters(&fcf, &gen, &wide, &clusters);
+  ok &= check("sequences within merger distance merged", n == 1);
+
+  /** cuts */
+  gen.clear();
+  gen.addCluster(13, 70, 100, 200, 0.1, 1.2);
+  gen.addCluster(13, 90.5, 100, 30, 0.8, 1.2);
+  librorc::fcf_parameters cuts = params;
+  n = findClusters(&fcf, &gen, &cuts, &clusters);
+  ok &= check("no cuts", n == 2);
+  cuts.single_pad_suppression = 1;
+  n = findClusters(&fcf, &gen, &cuts, &clusters);
+  ok &= check("single pad suppression", n == 1 && clusters.qmax[0] < 40);
+  cuts.single_pad_suppression = 0;
+  cuts.cluster_qmax_lower_limit = 100;
+  n = findClusters(&fcf, &gen, &cuts, &clusters);
+  ok &= check("qmax lower limit", n == 1 && clusters.qmax[0] > 100);
+  cuts.cluster_qmax_lower_limit = 0;
+  cuts.cluster_lower_limit = 2000;
+  n = findClusters(&fcf, &gen, &cuts, &clusters);
+  ok &= check("cluster lower limit", n == 0);
+  cuts.cluster_lower_limit = 0;
+  cuts.single_seq_limit = 100;
+  n = findClusters(&fcf, &gen, &cuts, &clusters);
+  ok &= check("single sequence limit",
+              n == 1 && clusters.qmax[0] > 100);
+
+  /** realistic events: scalar and AVX2 identical, parallel identical */
+  srand(7);
+  for (uint32_t i = 0; i < table.size(); i++) {
+    table[i] = mappingEntry(i, 0xe00 + rand() % 0x400);
+  }
+  params.deconv_pad = 1;
+  params.charge_tolerance = 1;
+  params.noise_suppression = 2;
+  params.noise_suppression_minimum = 2;
+  params.noise_suppression_neighbor = 1;
+  params.single_pad_suppression = 1;
+  params.cluster_qmax_lower_limit = 5;
+
+  vector<vector<uint32_t> > events(CHANNELS * EVENTS);
+  uint64_t bytes = 0;
+  for (size_t e = 0; e < events.size(); e++) {
+    gen.clear();
+    for (uint32_t c = 0; c < CLUSTERS_PER_EVENT; c++) {
+      gen.addCluster(rand() % ROWS, (rand() % (PADS * 16)) / 16.0,
+                     8 + (rand() % ((TIMEBINS - 16) * 16)) / 16.0,
+                     10 + rand() % 300, 0.5 + (rand() % 8) / 10.0,
+                     0.8 + (rand() % 10) / 10.0);
+    }
+    gen.build(&events[e]);
+    bytes += events[e].size() * 4;
+  }
+
+  vector<librorc::fcf_software *> instances;
+  for (uint32_t ch = 0; ch < CHANNELS; ch++) {
+    instances.push_back(new librorc::fcf_software());
+    instances[ch]->setMapping(&table[0], table.size());
+    instances[ch]->setParameters(&params);
+  }
+
+  vector<vector<uint32_t> > reference(events.size());
+  uint64_t total = 0;
+  instances[0]->setSimd(false);
+  double start = now();
+  for (size_t e = 0; e < events.size(); e++) {
+    total += instances[0]->process(&events[e][0], events[e].size(),
+                                   &reference[e]);
+  }
+  double scalar_time = now() - start;
+
+  bool identical = true;
+  if (librorc::fcf_software::simdAvailable()) {
+    instances[0]->setSimd(true);
+    vector<uint32_t> output;
+    start = now();
+    for (size_t e = 0; e < events.size(); e++) {
+      instances[0]->process(&events[e][0], events[e].size(), &output);
+      identical &= (output == reference[e]);
+    }
+    double simd_time = now() - start;
+    cout << "AVX2: " << bytes / simd_time / 1e6 << " MB/s" << endl;
+  }
+  cout << "scalar: " << bytes / scalar_time / 1e6 << " MB/s, "
+       << total / (double)events.size() << " clusters/event" << endl;
+  ok &= check("scalar and AVX2 identical", identical);
+
+  vector<vector<uint32_t> > outputs(events.size());
+  vector<librorc::fcf_software_job> jobs(events.size());
+  for (size_t e = 0; e < events.size(); e++) {
+    jobs[e].channel = e % CHANNELS;
+    jobs[e].event = &events[e][0];
+    jobs[e].size_dw = events[e].size();
+    jobs[e].output = &outputs[e];
+  }
+  start = now();
+  int result = librorc::fcf_software::processParallel(instances, jobs);
+  double parallel_time = now() - start;
+  cout << CHANNELS << " channels: " << bytes / parallel_time / 1e6 << " MB/s"
+       << endl;
+  identical = (result == 0);
+  for (size_t e = 0; e < events.size(); e++) {
+    identical &= (outputs[e] == reference[e]);
+  }
+  ok &= check("parallel identical", identical && total > 0);
+
+  for (uint32_t ch = 0; ch < CHANNELS; ch++) {
+    delete instances[ch];
+  }
+
+  cout << (ok ? "PASS" : "FAIL") << endl;
+  return ok ? 0 : 1;
+}
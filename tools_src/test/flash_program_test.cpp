@@ -0,0 +1,316 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include "test_bar.hh"
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace std;
+
+#define CHIP_WORDS (FLASH_SIZE >> 1)
+#define IMAGE_WORDS (1 << 19) /** 1 MB */
+
+/** busy time of program and erase operations */
+#define PROGRAM_TIME_NS 50000
+#define ERASE_TIME_NS 2000000
+
+/**
+ * command state machine of one flash chip, enough of the Intel CFI
+ * command set for flash::programImage
+ **/
+class flash_chip {
+public:
+  enum { ARRAY, STATUS, IDENT, PROG_COUNT, PROG_DATA, ERASE_SETUP, LOCK_SETUP };
+
+  flash_chip() : mem(CHIP_WORDS, 0xffff) {
+    mode = ARRAY;
+    busy_until = 0;
+    remaining = 0;
+    erases = 0;
+    programs = 0;
+  }
+
+  uint16_t read(uint32_t addr) {
+    switch (mode) {
+    case STATUS:
+    case PROG_COUNT:
+      return (now_ns() < busy_until) ? 0x00 : 0x80;
+    case IDENT:
+      return 0; /** unlocked */
+    default:
+      return mem[addr];
+    }
+  }
+
+  void write(uint32_t addr, uint16_t data) {
+    if (mode == PROG_COUNT) {
+      remaining = data + 1;
+      pending.clear();
+      mode = PROG_DATA;
+      return;
+    }
+    if (mode == PROG_DATA && remaining) {
+      pending.push_back(make_pair(addr, data));
+      remaining--;
+      return;
+    }
+    if (mode == PROG_DATA && data == FLASH_CMD_CONFIRM) {
+      for (size_t i = 0; i < pending.size(); i++) {
+        mem[pending[i].first] &= pending[i].second;
+      }
+      programs++;
+      busy_until = now_ns() + PROGRAM_TIME_NS;
+      mode = STATUS;
+      return;
+    }
+    if (mode == ERASE_SETUP && data == FLASH_CMD_CONFIRM) {
+      struct flash_architecture arch;
+      flash_arch(addr, &arch);
+      for (uint32_t i = 0; i < (arch.blksize >> 1); i++) {
+        mem[arch.blkaddr + i] = 0xffff;
+      }
+      erases++;
+      busy_until = now_ns() + ERASE_TIME_NS;
+      mode = STATUS;
+      return;
+    }
+    if (mode == LOCK_SETUP) {
+      mode = (data == FLASH_CMD_CFG_REG_CONFIRM) ? ARRAY : STATUS;
+      return;
+    }
+
+    switch (data) {
+    case FLASH_CMD_READ_ARRAY:
+    case FLASH_CMD_RESET:
+      mode = ARRAY;
+      break;
+    case FLASH_CMD_READ_STATUS:
+      mode = STATUS;
+      break;
+    case FLASH_CMD_READ_IDENTIFIER:
+      mode = IDENT;
+      break;
+    case FLASH_CMD_BUFFER_PROG:
+      mode = PROG_COUNT;
+      break;
+    case FLASH_CMD_BLOCK_ERASE_SETUP:
+      mode = ERASE_SETUP;
+      break;
+    case FLASH_CMD_BLOCK_LOCK_SETUP:
+      mode = LOCK_SETUP;
+      break;
+    default: /** clear status */
+      break;
+    }
+  }
+
+  static void flash_arch(uint32_t addr, struct flash_architecture *arch) {
+    if (addr <= 0x7effff) {
+      arch->blkaddr = addr & 0xffff0000;
+      arch->blksize = 0x20000;
+    } else {
+      arch->blkaddr = addr & 0xffffc000;
+      arch->blksize = 0x8000;
+    }
+  }
+
+  vector<uint16_t> mem;
+  uint32_t mode;
+  uint64_t busy_until;
+  uint32_t remaining;
+  vector<pair<uint32_t, uint16_t> > pending;
+  uint32_t erases;
+  uint32_t programs;
+};
+
+/**
+ * flash BAR with two chips, address bit 23 selects the chip
+ **/
+class flash_bar : public test_bar {
+public:
+  flash_bar() : test_bar(FLASH_SIZE << 1) { swapped = false; }
+
+  flash_chip chip[2];
+  /** 32 bit reads return the WORDs in the other order */
+  bool swapped;
+
+protected:
+  uint32_t read32(librorc::bar_address address) {
+    uint32_t lo = read16(address << 1);
+    uint32_t hi = read16((address << 1) + 1);
+    return swapped ? ((lo << 16) | hi) : (lo | (hi << 16));
+  }
+  void write32(librorc::bar_address address, uint32_t data) {}
+  uint16_t read16(librorc::bar_address address) {
+    return chip[(address >> FLASH_CHIP_SELECT_BIT) & 1].read(
+        address & (CHIP_WORDS - 1));
+  }
+  void write16(librorc::bar_address address, uint16_t data) {
+    chip[(address >> FLASH_CHIP_SELECT_BIT) & 1].write(
+        address & (CHIP_WORDS - 1), data);
+  }
+};
+
+string writeImage(vector<uint16_t> &image) {
+  char name[] = "/tmp/flash_imageXXXXXX";
+  int fd = mkstemp(name);
+  size_t bytes = image.size() * sizeof(uint16_t);
+  if (fd < 0 || write(fd, &image[0], bytes) != (ssize_t)bytes) {
+    cout << "ERROR: failed to write " << name << endl;
+    exit(1);
+  }
+  close(fd);
+  return string(name);
+}
+
+double seconds(struct timeval *start) {
+  struct timeval end;
+  gettimeofday(&end, NULL);
+  return (end.tv_sec - start->tv_sec) + (end.tv_usec - start->tv_usec) / 1e6;
+}
+
+bool matches(flash_chip *chip, vector<uint16_t> &image) {
+  return memcmp(&chip->mem[0], &image[0], image.size() * 2) == 0;
+}
+
+int main(int argc, char *argv[]) {
+  flash_bar *fake = new flash_bar();
+  librorc::bar *bar = new librorc::bar(fake);
+  librorc::flash flash0(bar, 0);
+  librorc::flash flash1(bar, 1);
+  bool pass = true;
+
+  /** image A with an erased region, image B changes two blocks of A */
+  vector<uint16_t> image_a(IMAGE_WORDS);
+  for (uint32_t i = 0; i < IMAGE_WORDS; i++) {
+    image_a[i] = (i >= 0x20000 && i < 0x28000) ? 0xffff : (i * 40503) >> 3;
+  }
+  vector<uint16_t> image_b(image_a);
+  image_b[0x10010] = 0x0000; /** bits cleared only: no erase */
+  image_b[0x30020] ^= 0x00ff; /** bits set: erase */
+  string file_a = writeImage(image_a);
+  string file_b = writeImage(image_b);
+
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  int32_t ret = flash0.flashWrite((char *)file_a.c_str(),
+                                  librorc::LIBRORC_VERBOSE_OFF);
+  double full = seconds(&start);
+  cout << "full write        : " << full << " s, "
+       << fake->chip[0].erases << " erases, " << fake->chip[0].programs
+       << " buffer programs" << endl;
+  pass &= (ret == 0 && matches(&fake->chip[0], image_a));
+  pass &= (fake->chip[0].erases == IMAGE_WORDS / 0x10000);
+
+  fake->chip[0].erases = 0;
+  fake->chip[0].programs = 0;
+  gettimeofday(&start, NULL);
+  ret = flash0.flashWrite((char *)file_a.c_str(),
+                          librorc::LIBRORC_VERBOSE_OFF, true);
+  cout << "differential, same: " << seconds(&start) << " s, "
+       << fake->chip[0].erases << " erases, " << fake->chip[0].programs
+       << " buffer programs" << endl;
+  pass &= (ret == 0 && fake->chip[0].erases == 0 &&
+           fake->chip[0].programs == 0);
+
+  gettimeofday(&start, NULL);
+  ret = flash0.flashWrite((char *)file_b.c_str(),
+                          librorc::LIBRORC_VERBOSE_OFF, true);
+  cout << "differential, diff: " << seconds(&start) << " s, "
+       << fake->chip[0].erases << " erases, " << fake->chip[0].programs
+       << " buffer programs" << endl;
+  pass &= (ret == 0 && matches(&fake->chip[0], image_b));
+  pass &= (fake->chip[0].erases == 1);
+
+  /** both chips from scratch, concurrently */
+  fake->chip[0] = flash_chip();
+  gettimeofday(&start, NULL);
+  ret = librorc::flash::flashWriteParallel(
+      &flash0, (char *)file_a.c_str(), &flash1, (char *)file_b.c_str(),
+      librorc::LIBRORC_VERBOSE_OFF);
+  double parallel = seconds(&start);
+  cout << "parallel, 2 chips : " << parallel << " s" << endl;
+  pass &= (ret == 0 && matches(&fake->chip[0], image_a) &&
+           matches(&fake->chip[1], image_b));
+
+  /** readout of chip 0: WORD by WORD versus bulk reads */
+  vector<uint16_t> readout(IMAGE_WORDS);
+  gettimeofday(&start, NULL);
+  for (uint32_t i = 0; i < IMAGE_WORDS; i++) {
+    readout[i] = flash0.get(i);
+  }
+  double single = seconds(&start);
+  uint64_t hash = FLASH_HASH_INIT;
+  gettimeofday(&start, NULL);
+  flash0.readBulk(0, IMAGE_WORDS, &readout[0], &hash);
+  double bulk = seconds(&start);
+  cout << "readout get()     : " << (IMAGE_WORDS * 2 / single / 1048576.0)
+       << " MB/s" << endl;
+  cout << "readout readBulk(): " << (IMAGE_WORDS * 2 / bulk / 1048576.0)
+       << " MB/s" << endl;
+  pass &= (readout == image_a);
+  pass &= (hash == librorc::flash::hashUpdate(FLASH_HASH_INIT, &image_a[0],
+                                              IMAGE_WORDS * 2));
+
+  /** 32 bit reads with unexpected WORD order fall back to 16 bit */
+  fake->swapped = true;
+  librorc::flash swapped(bar, 0);
+  vector<uint16_t> fallback(IMAGE_WORDS);
+  pass &= (swapped.readBulk(0, IMAGE_WORDS, &fallback[0]) == 0 &&
+           fallback == image_a);
+  cout << "readBulk fallback : " << (fallback == image_a ? "OK" : "FAILED")
+       << endl;
+  fake->swapped = false;
+
+  uint64_t verify_hash = 0;
+  pass &= (flash0.verify((char *)file_a.c_str(),
+                         librorc::LIBRORC_VERBOSE_OFF, &verify_hash) == 0);
+  pass &= (verify_hash == hash);
+  pass &= (flash0.verify((char *)file_b.c_str(),
+                         librorc::LIBRORC_VERBOSE_OFF) == 1);
+
+  /** sync word at an odd WORD address across a chunk boundary */
+  fake->chip[0].mem[0x40000 + 2047] = 0x5599;
+  fake->chip[0].mem[0x40000 + 2048] = 0xaa66;
+  int32_t sync = flash0.findFpgaSyncWord(0x80000, 0x10000);
+  cout << "sync word offset  : 0x" << hex << sync << dec << endl;
+  pass &= (sync == (0x40000 + 2048) * 2);
+
+  unlink(file_a.c_str());
+  unlink(file_b.c_str());
+  delete bar;
+
+  cout << (pass ? "PASS" : "FAIL") << endl;
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#ifndef I2C_BAR_H
+#define I2C_BAR_H
+
+#include "test_bar.hh"
+
+#define I2C_CHAINS 6
+#define I2C_READ (1 << 1)
+#define I2C_WRITE (1 << 2)
+
+/** bus time of a transaction: start, slave address and memory address */
+#define I2C_SETUP_NS 75000
+/** bus time per data byte at 400 kHz */
+#define I2C_BYTE_NS 25000
+
+/**
+ * I2C module state, may be placed in memory shared between processes.
+ * Each chain has one 256 byte memory, address 127 selects its page.
+ **/
+typedef struct {
+  volatile uint32_t op;
+  volatile uint64_t done_at;
+  volatile uint32_t page[I2C_CHAINS];
+  volatile uint32_t collisions;
+  volatile uint32_t page_errors;
+  volatile uint64_t transactions;
+  uint8_t mem[I2C_CHAINS][256];
+} i2c_state;
+
+/**
+ * BAR backend emulating the I2C module. Starting a transaction or
+ * touching the operation register while another one is in flight
+ * counts as a collision. Reading the upper memory half with a page
+ * other than 0 selected counts as a page error. Without a state given
+ * the backend uses its own.
+ **/
+class i2c_bar : public test_bar {
+public:
+  i2c_bar(i2c_state *shared = NULL) : state(shared), m_own(NULL) {
+    if (!state) {
+      m_own = new i2c_state;
+      memset(m_own, 0, sizeof(i2c_state));
+      state = m_own;
+    }
+  }
+  ~i2c_bar() { delete m_own; }
+
+  i2c_state *state;
+
+protected:
+  uint32_t read32(librorc::bar_address address) {
+    if (address == RORC_REG_I2C_CONFIG) {
+      return busy() ? 0 : 1;
+    } else if (address == RORC_REG_I2C_OPERATION) {
+      return state->op;
+    }
+    return m_regs[address];
+  }
+  void write32(librorc::bar_address address, uint32_t data) {
+    if (address == RORC_REG_I2C_OPERATION) {
+      if (busy()) {
+        __sync_fetch_and_add(&state->collisions, 1);
+      }
+      state->op = data;
+    } else if (address == RORC_REG_I2C_CONFIG) {
+      if (busy()) {
+        __sync_fetch_and_add(&state->collisions, 1);
+      }
+      transfer(data);
+    } else {
+      m_regs[address] = data;
+    }
+  }
+
+  bool busy() { return now_ns() < state->done_at; }
+
+  void transfer(uint32_t cfg) {
+    uint32_t chain = 0;
+    while (chain < I2C_CHAINS && !((cfg >> 24) & (1 << chain))) {
+      chain++;
+    }
+    uint32_t byte_enable = (cfg >> 3) & 3;
+    uint32_t op = state->op;
+    uint32_t nbytes = 0;
+    for (uint32_t b = 0; b < 2; b++) {
+      if (!(byte_enable & (1 << b))) {
+        continue;
+      }
+      uint8_t addr = (op >> (16 * b)) & 0xff;
+      if (cfg & I2C_READ) {
+        if (addr >= 128 && state->page[chain] != 0) {
+          __sync_fetch_and_add(&state->page_errors, 1);
+        }
+        op &= ~(0xff << (16 * b + 8));
+        op |= (uint32_t)(addr == 127 ? state->page[chain]
+                                     : state->mem[chain][addr])
+              << (16 * b + 8);
+      } else if (cfg & I2C_WRITE) {
+        uint8_t data = (op >> (16 * b + 8)) & 0xff;
+        if (addr == 127) {
+          state->page[chain] = data;
+        } else {
+          state->mem[chain][addr] = data;
+        }
+      }
+      nbytes++;
+    }
+    state->op = op;
+    state->done_at = now_ns() + I2C_SETUP_NS + nbytes * I2C_BYTE_NS;
+    __sync_fetch_and_add(&state->transactions, 1);
+  }
+
+  i2c_state *m_own;
+};
+
+#endif /** I2C_BAR_H */
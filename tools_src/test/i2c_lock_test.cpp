@@ -0,0 +1,207 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include "i2c_bar.hh"
+#include <iostream>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/mman.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+/** device number of the test locks, chosen to not collide with boards */
+#define TEST_DEVICE 251
+#define MONITOR_LOOPS 200
+#define CONTROL_LOOPS 50
+
+static i2c_state *g_state;
+
+static librorc::sysmon *attach(librorc::bar **bar) {
+  *bar = new librorc::bar(new i2c_bar(g_state));
+  librorc::sysmon *sm = new librorc::sysmon(*bar);
+  sm->i2c_set_mode(1);
+  if (sm->i2cShareLock(TEST_DEVICE) != 0) {
+    cout << "failed to attach shared I2C locks" << endl;
+    exit(1);
+  }
+  return sm;
+}
+
+/** read module info while flipping to page 3 in between */
+static void monitor(uint8_t chain, uint32_t loops) {
+  librorc::bar *bar;
+  librorc::sysmon *sm = attach(&bar);
+  for (uint32_t i = 0; i < loops; i++) {
+    sm->qsfpVendorName(chain);
+    sm->qsfpTemperature(chain);
+    librorc::i2c_chain_lock lock(sm, chain);
+    sm->i2c_write_mem(chain, 0x50, 127, 3);
+    sm->i2c_read_mem(chain, 0x50, 0);
+  }
+  delete sm;
+  delete bar;
+}
+
+static void remove_locks() {
+  int id = shmget(LIBRORC_SYSMON_I2C_LOCK_SHM_KEY_OFFSET + TEST_DEVICE, 0, 0);
+  if (id != -1) {
+    shmctl(id, IPC_RMID, NULL);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  remove_locks();
+  g_state = (i2c_state *)mmap(NULL, sizeof(i2c_state),
+                              PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  memset(g_state, 0, sizeof(i2c_state));
+  bool pass = true;
+
+  /** creator dies before initializing the segment */
+  pid_t creator = fork();
+  if (creator == 0) {
+    shmget(LIBRORC_SYSMON_I2C_LOCK_SHM_KEY_OFFSET + TEST_DEVICE,
+           sizeof(librorc::sysmon_i2c_locks), IPC_CREAT | IPC_EXCL | 0666);
+    _exit(0);
+  }
+  waitpid(creator, NULL, 0);
+  uint64_t t0 = now_ns();
+  librorc::bar *bar;
+  librorc::sysmon *sm = attach(&bar);
+  cout << "stale segment replaced after " << (now_ns() - t0) / 1000 << " us"
+       << endl;
+
+  /** two monitoring processes on different chains of the same module,
+   * plus one more on chain 0 racing the page select */
+  pid_t pid[3];
+  uint8_t chains[3] = {0, 1, 0};
+  for (int i = 0; i < 3; i++) {
+    pid[i] = fork();
+    if (pid[i] == 0) {
+      monitor(chains[i], MONITOR_LOOPS);
+      _exit(0);
+    }
+  }
+
+  /** control actions from this process on chain 0 meanwhile */
+  uint64_t max_wait = 0;
+  for (uint32_t i = 0; i < CONTROL_LOOPS; i++) {
+    uint64_t t0 = now_ns();
+    sm->i2cLockChain(0);
+    uint64_t wait = now_ns() - t0;
+    max_wait = (wait > max_wait) ? wait : max_wait;
+    sm->i2c_write_mem(0, 0x50, 86, i);
+    sm->i2cUnlockChain(0);
+    usleep(1000);
+  }
+  for (int i = 0; i < 3; i++) {
+    int status;
+    waitpid(pid[i], &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+      pass = false;
+    }
+  }
+  cout << "collisions: " << g_state->collisions
+       << ", page errors: " << g_state->page_errors
+       << ", max control wait: " << max_wait / 1000 << " us" << endl;
+  if (g_state->collisions || g_state->page_errors ||
+      max_wait > 20000000ull) {
+    pass = false;
+  }
+
+  /** owner dies while holding a chain lock */
+  pid_t dead = fork();
+  if (dead == 0) {
+    librorc::bar *b;
+    librorc::sysmon *s = attach(&b);
+    s->i2cLockChain(2);
+    _exit(0);
+  }
+  waitpid(dead, NULL, 0);
+  uint32_t recoveries = sm->i2cLockRecoveries();
+  sm->i2cSetLockTimeout(1000);
+  try {
+    sm->qsfpTemperature(2);
+  } catch (int e) {
+    cout << "access after owner death failed: " << librorc::errMsg(e) << endl;
+    pass = false;
+  }
+  cout << "recovered locks: " << sm->i2cLockRecoveries() - recoveries << endl;
+  if (sm->i2cLockRecoveries() == recoveries) {
+    pass = false;
+  }
+
+  /** owner alive but stuck: time out */
+  int pfd[2];
+  if (pipe(pfd) != 0) {
+    return 1;
+  }
+  pid_t stuck = fork();
+  if (stuck == 0) {
+    librorc::bar *b;
+    librorc::sysmon *s = attach(&b);
+    s->i2cLockChain(3);
+    char c = 1;
+    if (write(pfd[1], &c, 1) != 1) {
+      _exit(1);
+    }
+    sleep(10);
+    _exit(0);
+  }
+  char c;
+  if (read(pfd[0], &c, 1) != 1) {
+    pass = false;
+  }
+  sm->i2cSetLockTimeout(100);
+  bool timed_out = false;
+  try {
+    sm->ddr3SpdRead(0, 0);
+  } catch (int e) {
+    timed_out = (e == LIBRORC_SYSMON_ERROR_I2C_LOCK_TIMEOUT);
+  }
+  kill(stuck, SIGKILL);
+  waitpid(stuck, NULL, 0);
+  cout << "stuck owner: " << (timed_out ? "timed out" : "NO TIMEOUT") << endl;
+  if (!timed_out) {
+    pass = false;
+  }
+
+  cout << (pass ? "PASS" : "FAIL") << endl;
+
+  delete sm;
+  delete bar;
+  remove_locks();
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include "i2c_bar.hh"
+#include <iostream>
+#include <string>
+#include <string.h>
+#include <time.h>
+
+using namespace std;
+
+static void fill(uint8_t *m, uint8_t start, const char *str, uint32_t len) {
+  uint32_t slen = strlen(str);
+  for (uint32_t i = 0; i < len; i++) {
+    m[start + i] = (i < slen) ? str[i] : ' ';
+  }
+}
+
+/**
+ * read all module info of one QSFP the way the per-byte accessors did
+ **/
+static string qsfpInfoPerByte(librorc::sysmon *sm, uint8_t index) {
+  string info;
+  uint8_t ranges[4][2] = {{148, 163}, {168, 183}, {196, 211}, {184, 185}};
+  for (int r = 0; r < 4; r++) {
+    for (uint32_t a = ranges[r][0]; a <= ranges[r][1]; a++) {
+      info.append(1, (char)sm->i2c_read_mem(index, 0x50, a));
+    }
+  }
+  return info;
+}
+
+static string qsfpInfo(librorc::sysmon *sm, uint8_t index) {
+  return sm->qsfpVendorName(index) + sm->qsfpPartNumber(index) +
+         sm->qsfpSerialNumber(index) + sm->qsfpRevisionNumber(index);
+}
+
+int main(int argc, char *argv[]) {
+  i2c_bar *impl = new i2c_bar();
+  librorc::bar *bar = new librorc::bar(impl);
+  librorc::sysmon *sm = new librorc::sysmon(bar);
+  sm->i2c_set_mode(1);
+  bool pass = true;
+
+  for (uint32_t q = 0; q < LIBRORC_MAX_QSFP; q++) {
+    uint8_t *m = impl->state->mem[q];
+    fill(m, 148, "AVAGO", 16);
+    fill(m, 168, "AFBR-79EQPZ", 16);
+    fill(m, 196, "QSFP0123456789", 16);
+    fill(m, 184, "01", 2);
+    m[22] = 0x1e + q; /** 30.5 degC */
+    m[23] = 0x80;
+    m[26] = 0x80; /** 3.2896 V */
+    m[27] = 0x80;
+    impl->state->page[q] = 3; /** not on page 0 */
+  }
+  for (uint32_t i = 0; i < 256; i++) {
+    impl->state->mem[3][i] = (uint8_t)(i * 7 + 1);
+  }
+
+  /** per-byte reference */
+  uint64_t t0 = now_ns();
+  uint64_t tr0 = impl->state->transactions;
+  string ref[LIBRORC_MAX_QSFP];
+  for (uint32_t q = 0; q < LIBRORC_MAX_QSFP; q++) {
+    ref[q] = qsfpInfoPerByte(sm, q);
+  }
+  string spd_ref;
+  for (uint32_t a = 128; a <= 145; a++) {
+    spd_ref.append(1, (char)sm->ddr3SpdRead(0, a));
+  }
+  uint64_t t_byte = now_ns() - t0;
+  uint64_t tr_byte = impl->state->transactions - tr0;
+
+  /** accessors on top of sequential reads */
+  t0 = now_ns();
+  tr0 = impl->state->transactions;
+  for (uint32_t q = 0; q < LIBRORC_MAX_QSFP; q++) {
+    if (qsfpInfo(sm, q) != ref[q]) {
+      cout << "QSFP" << q << " module info mismatch" << endl;
+      pass = false;
+    }
+  }
+  string spd = sm->ddr3SpdReadString(0, 128, 145);
+  uint64_t t_seq = now_ns() - t0;
+  uint64_t tr_seq = impl->state->transactions - tr0;
+
+  if (spd != spd_ref) {
+    cout << "SPD string mismatch" << endl;
+    pass = false;
+  }
+  for (uint32_t q = 0; q < LIBRORC_MAX_QSFP; q++) {
+    float temp = sm->qsfpTemperature(q);
+    float volt = sm->qsfpVoltage(q);
+    if (temp != 30.5 + q || volt < 3.2895 || volt > 3.2897) {
+      cout << "QSFP" << q << " monitor mismatch: " << temp << " degC, "
+           << volt << " V" << endl;
+      pass = false;
+    }
+  }
+  uint8_t odd[3];
+  sm->i2c_read_mem_seq(3, 0x50, 253, odd, 3);
+  if (odd[0] != impl->state->mem[3][253] ||
+      odd[2] != impl->state->mem[3][255]) {
+    cout << "odd length sequential read mismatch" << endl;
+    pass = false;
+  }
+
+  cout << "per-byte  : " << tr_byte << " transactions, " << t_byte / 1000
+       << " us" << endl;
+  cout << "sequential: " << tr_seq << " transactions, " << t_seq / 1000
+       << " us" << endl;
+  if (tr_seq >= tr_byte) {
+    pass = false;
+  }
+  cout << (pass ? "PASS" : "FAIL") << endl;
+
+  delete sm;
+  delete bar;
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include "test_bar.hh"
+#include <iostream>
+#include <string.h>
+
+using namespace std;
+
+#define LINK 0
+
+/**
+ * configure PatternGenerator, EventFilter and FCF of one link the same way
+ * a readout application does at startup
+ **/
+void configure(librorc::link *link) {
+  librorc::patterngenerator pg(link);
+  librorc::fastclusterfinder fcf(link);
+  librorc::eventfilter filter(link);
+  librorc::ddl ddl(link);
+
+  ddl.setEnable(1);
+  link->setFlowControlEnable(1);
+  link->setChannelActive(1);
+  pg.configureMode(PG_PATTERN_INC, 0, 0);
+  pg.setStaticEventSize(0x100);
+  pg.useAsDataSource();
+  pg.enable();
+  filter.setFilterMask(0x12345);
+  filter.setFilterAll(0);
+
+  fcf.setState(1, 0);
+  fcf.setSinglePadSuppression(1);
+  fcf.setBypassMerger(0);
+  fcf.setDeconvPad(1);
+  fcf.setSingleSeqLimit(2);
+  fcf.setClusterLowerLimit(10);
+  fcf.setMergerDistance(4);
+  fcf.setMergerAlgorithm(1);
+  fcf.setChargeTolerance(0);
+  fcf.setNoiseSuppression(1);
+  fcf.setNoiseSuppressionMinimum(2);
+  fcf.setNoiseSuppressionNeighbor(1);
+  fcf.setClusterQmaxLowerLimit(5);
+  fcf.setTagDeconvolutedClusters(1);
+  fcf.clearErrors();
+  fcf.setState(0, 1);
+}
+
+int main(int argc, char *argv[]) {
+  test_bar *plain = new test_bar();
+  test_bar *shadowed = new test_bar();
+  librorc::bar *plain_bar = new librorc::bar(plain);
+  librorc::bar *shadowed_bar = new librorc::bar(shadowed);
+
+  librorc::link plain_link(plain_bar, LINK);
+  librorc::link shadowed_link(shadowed_bar, LINK);
+  shadowed_link.setShadowEnable(true);
+
+  configure(&plain_link);
+  configure(&shadowed_link);
+
+  cout << "shadow off: " << plain->reads << " reads, " << plain->writes
+       << " writes" << endl;
+  cout << "shadow on : " << shadowed->reads << " reads, " << shadowed->writes
+       << " writes" << endl;
+
+  bool match = (memcmp(plain->m_regs, shadowed->m_regs, TEST_BAR_SIZE) == 0);
+  bool fewer = (shadowed->reads < plain->reads);
+  cout << "register contents " << (match ? "match" : "DIFFER") << endl;
+  cout << ((match && fewer) ? "PASS" : "FAIL") << endl;
+
+  delete plain_bar;
+  delete shadowed_bar;
+  return (match && fewer) ? 0 : 1;
+}
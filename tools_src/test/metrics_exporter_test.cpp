@@ -0,0 +1,212 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include "test_bar.hh"
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+#define DEVICE 252
+#define CHANNELS 2
+
+bool contains(const string &text, const string &line) {
+  return (text.find(line) != string::npos);
+}
+
+bool expect(const string &text, const string &line) {
+  if (contains(text, line)) {
+    return true;
+  }
+  cout << "missing: " << line << endl;
+  return false;
+}
+
+/** connect to the exporter socket, optionally send a request */
+string fetch(const char *path, const char *request) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  string reply;
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+    if (request) {
+      send(fd, request, strlen(request), 0);
+    }
+    char buffer[4096];
+    ssize_t len;
+    while ((len = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+      reply.append(buffer, len);
+    }
+  }
+  close(fd);
+  return reply;
+}
+
+int main(int argc, char *argv[]) {
+  test_bar *regs = new test_bar();
+  librorc::bar *bar = new librorc::bar(regs);
+  regs->m_regs[RORC_REG_TYPE_CHANNELS] = CHANNELS;
+
+  /** channel 0: enabled DIU with a quarter filled event buffer */
+  regs->pci(0)[RORC_REG_DMA_CTRL] = 1;
+  regs->pci(0)[RORC_REG_EBDM_BUFFER_SIZE_L] = 0x10000;
+  regs->pci(0)[RORC_REG_EBDM_FPGA_WRITE_POINTER_L] = 0x4000;
+  regs->pci(0)[RORC_REG_RBDM_BUFFER_SIZE_L] = 0x1000;
+  regs->pci(0)[RORC_REG_RBDM_FPGA_WRITE_POINTER_L] = 0x0800;
+  regs->pci(0)[RORC_REG_RBDM_SW_READ_POINTER_L] = 0x0c00;
+  regs->pci(0)[RORC_REG_DMA_N_EVENTS_PROCESSED] = 1234;
+  regs->pci(0)[RORC_REG_DMA_STALL_CNT] = 77;
+  regs->ddl(0)[RORC_REG_DDL_DEADTIME] = 555;
+  regs->ddl(0)[RORC_REG_DDL_DMA_DEADTIME] = 666;
+  /** channel 1: disabled, no DDL */
+  regs->pci(1)[RORC_REG_GTX_ASYNC_CFG] = (RORC_CFG_LINK_TYPE_VIRTUAL << 12);
+
+  /** event stream status of channel 0 */
+  int shID = shmget(SHM_KEY_OFFSET + DEVICE * SHM_DEV_OFFSET,
+                    sizeof(librorc::ChannelStatus), IPC_CREAT | 0666);
+  librorc::ChannelStatus *status =
+      (librorc::ChannelStatus *)shmat(shID, 0, 0);
+  if (shID == -1 || status == (librorc::ChannelStatus *)-1) {
+    perror("shm");
+    return 1;
+  }
+  memset(status, 0, sizeof(librorc::ChannelStatus));
+  status->n_events = 100;
+  status->bytes_received = 1000;
+  status->error_count = 3;
+
+  bool pass = true;
+  librorc::metrics_exporter exporter;
+  exporter.addBar(bar, DEVICE);
+  pass &= (exporter.numberOfChannels() == CHANNELS);
+
+  exporter.sample();
+  pass &= !contains(exporter.exposition(), "librorc_dma_event_rate{");
+
+  status->n_events = 300;
+  status->bytes_received = 5800;
+  usleep(100000);
+  exporter.sample();
+  string text = exporter.exposition();
+  cout << text;
+
+  const char *label0 = "{device=\"252\",channel=\"0\"} ";
+  const char *label1 = "{device=\"252\",channel=\"1\"} ";
+  pass &= expect(text, "# TYPE librorc_dma_events_total counter");
+  pass &= expect(text, string("librorc_dma_enabled") + label0 + "1\n");
+  pass &= expect(text, string("librorc_dma_enabled") + label1 + "0\n");
+  pass &= expect(text, string("librorc_dma_events_total") + label0 + "300\n");
+  pass &= expect(text, string("librorc_dma_bytes_total") + label0 + "5800\n");
+  pass &= expect(text, string("librorc_dma_errors_total") + label0 + "3\n");
+  pass &= expect(text,
+                   string("librorc_dma_engine_events_total") + label0 + "1234\n");
+  pass &= expect(text,
+                   string("librorc_dma_stall_cycles_total") + label0 + "77\n");
+  pass &= expect(text,
+                   string("librorc_ddl_deadtime_cycles_total") + label0 + "555\n");
+  pass &= expect(text,
+                   string("librorc_dma_deadtime_cycles_total") + label0 + "666\n");
+  pass &= expect(text,
+                   string("librorc_dma_eb_occupancy_ratio") + label0 + "0.25\n");
+  pass &= expect(text,
+                   string("librorc_dma_rb_occupancy_ratio") + label0 + "0.75\n");
+  pass &= !contains(text, string("librorc_ddl_deadtime_cycles_total") + label1);
+  pass &= !contains(text, string("librorc_dma_events_total") + label1);
+
+  const librorc::metrics_exporter_channel *ch0 = &exporter.channels()[0];
+  double event_rate = ch0->values[librorc::kMetricEventRate];
+  double byte_rate = ch0->values[librorc::kMetricByteRate];
+  cout << "event rate " << event_rate << " Hz, byte rate " << byte_rate
+       << " B/s" << endl;
+  pass &= (event_rate > 200 && event_rate < 2000);
+  pass &= (byte_rate > 24 * event_rate - 1 && byte_rate < 24 * event_rate + 1);
+
+  /** file export */
+  char filename[256];
+  snprintf(filename, sizeof(filename), "/tmp/metrics_exporter_test.%d.prom",
+           getpid());
+  pass &= (exporter.writeFile(filename) == 0);
+  string readback;
+  FILE *fd = fopen(filename, "r");
+  if (fd) {
+    char buffer[4096];
+    size_t len;
+    while ((len = fread(buffer, 1, sizeof(buffer), fd)) > 0) {
+      readback.append(buffer, len);
+    }
+    fclose(fd);
+  }
+  unlink(filename);
+  bool file_match = (readback == text);
+  cout << "file export " << (file_match ? "matches" : "DIFFERS") << endl;
+  pass &= file_match;
+
+  /** socket export, one HTTP client and one plain client */
+  char sockname[256];
+  snprintf(sockname, sizeof(sockname), "/tmp/metrics_exporter_test.%d.sock",
+           getpid());
+  pass &= (exporter.listenSocket(sockname) == 0);
+  pid_t pid = fork();
+  if (pid == 0) {
+    string http = fetch(sockname, "GET /metrics HTTP/1.0\r\n\r\n");
+    string plain = fetch(sockname, NULL);
+    bool ok = (http.compare(0, 15, "HTTP/1.0 200 OK") == 0) &&
+              (http.size() > text.size()) &&
+              (http.compare(http.size() - text.size(), text.size(), text) ==
+               0) &&
+              (plain == text);
+    _exit(ok ? 0 : 1);
+  }
+  int served = exporter.serve(1000);
+  int child_status = -1;
+  waitpid(pid, &child_status, 0);
+  bool socket_ok = (served == 2) && WIFEXITED(child_status) &&
+                   (WEXITSTATUS(child_status) == 0);
+  cout << "socket clients served: " << served << ", "
+       << (socket_ok ? "replies match" : "replies DIFFER") << endl;
+  pass &= socket_ok;
+
+  shmdt(status);
+  shmctl(shID, IPC_RMID, NULL);
+  delete bar;
+
+  cout << (pass ? "PASS" : "FAIL") << endl;
+  return pass ? 0 : 1;
+}
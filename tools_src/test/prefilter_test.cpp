@@ -0,0 +1,184 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <string.h>
+#include <sys/time.h>
+
+using namespace std;
+
+#define EVENTS 200000
+#define EVENT_SIZE LIBRORC_CDH_V3_SIZE
+
+/** straightforward evaluation of one rule as reference */
+bool matchRule(const librorc::event_prefilter_rule *r,
+               const librorc::cdh_fields *cdh) {
+  for (uint32_t n = 0; n < 100; n++) {
+    uint64_t low = 0, high = 0;
+    librorc::event_prefilter::setClass(&low, &high, n);
+    bool set = (cdh->trigger_classes_low & low) ||
+               (cdh->trigger_classes_high & high);
+    if ((r->all_low & low || r->all_high & high) && !set) {
+      return false;
+    }
+    if ((r->none_low & low || r->none_high & high) && set) {
+      return false;
+    }
+  }
+  if ((r->any_low || r->any_high) &&
+      !((cdh->trigger_classes_low & r->any_low) ||
+        (cdh->trigger_classes_high & r->any_high))) {
+    return false;
+  }
+  if ((cdh->event_id & r->id_mask) != (r->id_value & r->id_mask)) {
+    return false;
+  }
+  if (cdh->status & r->status_reject) {
+    return false;
+  }
+  return true;
+}
+
+uint64_t random64() {
+  return ((uint64_t)rand() << 62) ^ ((uint64_t)rand() << 31) ^ rand();
+}
+
+int main(int argc, char *argv[]) {
+  srand(42);
+  vector<librorc::event_prefilter_rule> rules(3);
+  memset(&rules[0], 0, rules.size() * sizeof(librorc::event_prefilter_rule));
+
+  /** rule 0: class 3 or 70, not class 10, no FEE error */
+  librorc::event_prefilter::setClass(&rules[0].any_low, &rules[0].any_high, 3);
+  librorc::event_prefilter::setClass(&rules[0].any_low, &rules[0].any_high,
+                                     70);
+  librorc::event_prefilter::setClass(&rules[0].none_low, &rules[0].none_high,
+                                     10);
+  rules[0].status_reject = LIBRORC_CDH_ERR_FEE;
+  /** rule 1: classes 20 and 90, every 4th orbit */
+  librorc::event_prefilter::setClass(&rules[1].all_low, &rules[1].all_high,
+                                     20);
+  librorc::event_prefilter::setClass(&rules[1].all_low, &rules[1].all_high,
+                                     90);
+  rules[1].id_mask = 3ull << 12;
+  rules[1].id_value = 0;
+  /** rule 2: bunch crossing 0x100 */
+  rules[2].id_mask = 0xfff;
+  rules[2].id_value = 0x100;
+
+  librorc::event_prefilter filter;
+  for (size_t i = 0; i < rules.size(); i++) {
+    if (filter.addRule(&rules[i]) != (int32_t)i) {
+      cout << "addRule failed" << endl;
+      return 1;
+    }
+  }
+
+  /** sparse random trigger classes so that all rules fire sometimes */
+  vector<uint32_t> data(EVENTS * EVENT_SIZE);
+  vector<librorc::EventDescriptor> reports(EVENTS);
+  for (uint32_t i = 0; i < EVENTS; i++) {
+    uint32_t *w = &data[i * EVENT_SIZE];
+    uint32_t version = (i % 3) ? LIBRORC_CDH_V3 : LIBRORC_CDH_V2;
+    uint64_t tc = random64() & random64() & random64();
+    w[0] = 0xffffffff;
+    w[1] = (version << 24) | (rand() & ((i & 1) ? 0xfff : 0x1ff));
+    w[2] = rand() & 0xffffff;
+    w[3] = 0;
+    w[4] = (rand() & 0x3f) == 0 ? (LIBRORC_CDH_ERR_FEE << 12) : 0;
+    w[5] = tc;
+    w[6] = tc >> 32;
+    w[7] = rand() & rand();
+    w[8] = rand() & 0xf;
+    w[9] = 0;
+    memset(&reports[i], 0, sizeof(librorc::EventDescriptor));
+    reports[i].calc_event_size = (i % 1000 == 999) ? 4 : EVENT_SIZE;
+  }
+
+  uint64_t mismatches = 0;
+  uint64_t expected_accepts = 0;
+  for (uint32_t i = 0; i < EVENTS; i++) {
+    librorc::cdh_fields cdh;
+    bool expected = true;
+    if (librorc::cdhDecode(&data[i * EVENT_SIZE],
+                           reports[i].calc_event_size, &cdh) == 0) {
+      expected = false;
+      for (size_t r = 0; r < rules.size(); r++) {
+        expected |= matchRule(&rules[r], &cdh);
+      }
+    }
+    expected_accepts += expected;
+    if (filter.accept(&reports[i], &data[i * EVENT_SIZE]) != expected) {
+      mismatches++;
+    }
+  }
+
+  const librorc::event_prefilter_stats *stats = filter.stats();
+  cout << "accepted " << stats->accepted << ", rejected " << stats->rejected
+       << ", without CDH " << stats->no_cdh << ", mismatches " << mismatches
+       << endl;
+  bool pass = (mismatches == 0) && (stats->accepted == expected_accepts) &&
+              (stats->accepted + stats->rejected == EVENTS) &&
+              (stats->no_cdh == EVENTS / 1000) && (stats->accepted > 0) &&
+              (stats->rejected > 0) &&
+              (stats->rejected_bytes + stats->accepted_bytes ==
+               (uint64_t)(EVENTS - EVENTS / 1000) * EVENT_SIZE * 4 +
+                   (EVENTS / 1000) * 16);
+
+  /** rejecting unknown events, empty filter */
+  filter.clearStats();
+  filter.setAcceptUnknown(false);
+  pass &= !filter.accept(&reports[999], &data[999 * EVENT_SIZE]);
+  filter.clearRules();
+  pass &= !filter.accept(&reports[0], &data[0]);
+
+  /** throughput of the filter decision */
+  filter.setAcceptUnknown(true);
+  for (size_t i = 0; i < rules.size(); i++) {
+    filter.addRule(&rules[i]);
+  }
+  filter.clearStats();
+  timeval start, end;
+  gettimeofday(&start, NULL);
+  for (uint32_t pass_nr = 0; pass_nr < 10; pass_nr++) {
+    for (uint32_t i = 0; i < EVENTS; i++) {
+      filter.accept(&reports[i], &data[i * EVENT_SIZE]);
+    }
+  }
+  gettimeofday(&end, NULL);
+  double seconds = librorc::gettimeofdayDiff(start, end);
+  cout << "filter rate: " << (10.0 * EVENTS / seconds / 1e6)
+       << " M events/s" << endl;
+
+  cout << (pass ? "PASS" : "FAIL") << endl;
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#ifndef REPLAY_BAR_H
+#define REPLAY_BAR_H
+
+#include "test_bar.hh"
+#include <map>
+#include <vector>
+
+/**
+ * BAR backend emulating the data replay buffer and the write done flags
+ * of both DDR3 controllers. Optionally models device timing: a
+ * controller sets write done write_ns after a block was issued and each
+ * register read takes read_ns. Writing the payload buffer while a
+ * controller is still busy counts as an overwrite.
+ **/
+class replay_bar : public test_bar {
+public:
+  replay_bar(uint64_t write_ns = 0, uint64_t read_ns = 0)
+      : m_write_ns(write_ns), m_read_ns(read_ns) {
+    m_done_at[0] = 0;
+    m_done_at[1] = 0;
+    overwrites = 0;
+    blocks = 0;
+  }
+
+  bool busy() {
+    uint64_t t = now_ns();
+    return (t < m_done_at[0]) || (t < m_done_at[1]);
+  }
+
+  /** DDR3 contents per controller, keyed by block address */
+  std::map<uint32_t, std::vector<uint32_t> > ddr3[2];
+  uint64_t overwrites;
+  uint64_t blocks;
+
+protected:
+  uint32_t read32(librorc::bar_address address) {
+    if (m_read_ns) {
+      uint64_t end = now_ns() + m_read_ns;
+      while (now_ns() < end) {
+      }
+    }
+    if (address == RORC_REG_DATA_REPLAY_CTRL) {
+      uint64_t t = now_ns();
+      return ((t >= m_done_at[0]) ? 1 : 0) | ((t >= m_done_at[1]) ? 2 : 0);
+    }
+    return m_regs[address];
+  }
+  void write32(librorc::bar_address address, uint32_t data) {
+    if (address == RORC_REG_DATA_REPLAY_PAYLOAD_BASE && busy()) {
+      overwrites++;
+    }
+    m_regs[address] = data;
+    if (address != RORC_REG_DATA_REPLAY_CTRL) {
+      return;
+    }
+    for (uint32_t c = 0; c < 2; c++) {
+      if (data & (1 << c)) {
+        ddr3[c][data & 0x7ffffffc].assign(
+            m_regs + RORC_REG_DATA_REPLAY_PAYLOAD_BASE,
+            m_regs + RORC_REG_DATA_REPLAY_PAYLOAD_BASE + 16);
+        m_done_at[c] = now_ns() + m_write_ns;
+        blocks++;
+      }
+    }
+  }
+
+  uint64_t m_write_ns;
+  uint64_t m_read_ns;
+  uint64_t m_done_at[2];
+};
+
+#endif /** REPLAY_BAR_H */
@@ -0,0 +1,172 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include "replay_bar.hh"
+#include <iostream>
+#include <map>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace std;
+
+#define FILES_PER_CHANNEL 4
+#define LOOPS 3
+
+/**
+ * DDR3_CTRL: both controllers implemented at 1066 MBit/s, single
+ * ranked with the smallest address width (128 MB modules)
+ **/
+#define DDR3_CTRL_VALUE ((3 << 9) | (7 << 11) | (3 << 25) | (7 << 27))
+/** DDR3_CTRL: dual ranked with address width 29 (4 GB modules) */
+#define DDR3_CTRL_4GB                                                          \
+  ((3 << 9) | (3 << 11) | (1 << 14) | (3 << 25) | (3 << 27) | (1u << 30))
+
+/**
+ * write a DDL event file with num_dws data words
+ **/
+string writeEventFile(uint32_t num_dws, uint32_t seed) {
+  char name[] = "/tmp/replay_playlistXXXXXX";
+  int fd = mkstemp(name);
+  vector<uint32_t> data(num_dws);
+  for (uint32_t i = 0; i < num_dws; i++) {
+    data[i] = seed * 0x10000 + i;
+  }
+  if (fd < 0 || write(fd, &data[0], num_dws * 4) != (ssize_t)(num_dws * 4)) {
+    cout << "ERROR: failed to write " << name << endl;
+    exit(1);
+  }
+  close(fd);
+  return string(name);
+}
+
+/**
+ * compare the DDR3 blocks of one event with its file contents
+ **/
+bool checkEvent(replay_bar *fake, uint32_t ch, uint32_t addr,
+                uint32_t num_dws, uint32_t seed) {
+  uint32_t c = (ch > 5) ? 1 : 0;
+  uint32_t i = 0;
+  while (i < num_dws) {
+    map<uint32_t, vector<uint32_t> >::iterator it = fake->ddr3[c].find(addr);
+    if (it == fake->ddr3[c].end() || (it->second[0] & 0x3f) != (1u << (ch % 6))) {
+      return false;
+    }
+    for (uint32_t j = 0; j < 15 && i < num_dws; j++, i++) {
+      if (it->second[j + 1] != seed * 0x10000 + i) {
+        return false;
+      }
+    }
+    addr += 8;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  replay_bar *fake = new replay_bar();
+  fake->m_regs[RORC_REG_DDR3_CTRL] = DDR3_CTRL_VALUE;
+  librorc::bar *bar = new librorc::bar(fake);
+  librorc::datareplayplaylist playlist(bar);
+  vector<string> files;
+  bool pass = true;
+
+  for (uint32_t ch = 0; ch < LIBRORC_DATA_REPLAY_CHANNELS; ch++) {
+    for (uint32_t i = 0; i < FILES_PER_CHANNEL; i++) {
+      uint32_t seed = ch * FILES_PER_CHANNEL + i;
+      files.push_back(writeEventFile(200 + 31 * seed, seed));
+      if (playlist.addFile(ch, files.back().c_str())) {
+        cout << "ERROR: addFile failed" << endl;
+        pass = false;
+      }
+    }
+  }
+
+  if (playlist.pack() || playlist.upload() ||
+      playlist.configureChannels(LOOPS)) {
+    cout << "ERROR: pack/upload/configure failed" << endl;
+    pass = false;
+  }
+  cout << playlist.manifest();
+
+  for (uint32_t ch = 0; ch < LIBRORC_DATA_REPLAY_CHANNELS && pass; ch++) {
+    librorc::link ln(bar, ch);
+    librorc::datareplaychannel dr(&ln);
+    if (dr.startAddress() != playlist.startAddress(ch) ||
+        dr.eventLimit() != LOOPS * FILES_PER_CHANNEL) {
+      cout << "ch " << ch << ": channel configuration mismatch" << endl;
+      pass = false;
+    }
+    uint32_t addr = playlist.startAddress(ch);
+    for (uint32_t i = 0; i < FILES_PER_CHANNEL && pass; i++) {
+      uint32_t seed = ch * FILES_PER_CHANNEL + i;
+      uint32_t num_dws = 200 + 31 * seed;
+      if (!checkEvent(fake, ch, addr, num_dws, seed)) {
+        cout << "ch " << ch << " event " << i << ": DDR3 content mismatch"
+             << endl;
+        pass = false;
+      }
+      addr += ((num_dws + 14) / 15) * 8;
+    }
+    if (addr != playlist.endAddress(ch)) {
+      cout << "ch " << ch << ": end address mismatch" << endl;
+      pass = false;
+    }
+  }
+
+  /** channels 0 and 6 start at the beginning of their module */
+  pass &= (playlist.startAddress(0) == 0 && playlist.startAddress(6) == 0);
+
+  /** 128 MB module: 40 x 4 MB events do not fit */
+  files.push_back(writeEventFile(1 << 20, 0));
+  for (uint32_t i = 0; i < 40; i++) {
+    playlist.addFile(0, files.back().c_str());
+  }
+  if (playlist.pack() == 0) {
+    cout << "ERROR: oversized playlist was packed" << endl;
+    pass = false;
+  }
+
+  /** the same playlist fits on 4 GB modules */
+  fake->m_regs[RORC_REG_DDR3_CTRL] = DDR3_CTRL_4GB;
+  if (playlist.pack() != 0) {
+    cout << "ERROR: playlist not packed for 4 GB modules" << endl;
+    pass = false;
+  }
+
+  playlist.clear();
+  for (size_t i = 0; i < files.size(); i++) {
+    unlink(files[i].c_str());
+  }
+  delete bar;
+
+  cout << (pass ? "PASS" : "FAIL") << endl;
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,250 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include <librorc/bar_impl_sim.hh>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+using namespace std;
+
+#define BAR_SIZE (1ul << 21)
+#define HELP_TEXT                                                              \
+  "sim_transport_perf usage: sim_transport_perf [-i <iterations>]\n"           \
+  "Runs bar_impl_sim against a minimal in-process FLI server on a\n"           \
+  "socketpair and reports requests/s for reads, writes and posted\n"           \
+  "writes.\n"
+
+/**
+ * minimal stand-in for the Modelsim FLI server: a plain register file
+ * answering reads, writes and time requests
+ **/
+class fli_server {
+public:
+  fli_server(int fd) : messages(0), m_fd(fd), m_pos(0), m_len(0) {
+    m_regs = new uint32_t[BAR_SIZE >> 2];
+    memset(m_regs, 0, BAR_SIZE);
+  }
+  ~fli_server() { delete[] m_regs; }
+
+  static void *run_helper(void *arg) {
+    ((fli_server *)arg)->run();
+    return NULL;
+  }
+
+  void run() {
+    uint32_t header;
+    while (readDW(&header)) {
+      uint32_t msgsize = header >> 16;
+      uint32_t msgid;
+      readDW(&msgid);
+      vector<uint32_t> payload(msgsize - 2);
+      for (size_t i = 0; i < payload.size(); i++) {
+        readDW(&payload[i]);
+      }
+      messages++;
+      switch (header & 0xffff) {
+      case CMD_READ_FROM_DEVICE: {
+        uint32_t data = m_regs[(payload[0] >> 2) % (BAR_SIZE >> 2)];
+        uint32_t reply[4] = {(4 << 16) + CMD_CMPL_TO_HOST, msgid, 0, data};
+        queue(reply, 4);
+      } break;
+      case CMD_WRITE_TO_DEVICE: {
+        uint32_t addr = payload[0] >> 2;
+        uint32_t ndw = payload[1] & 0xffff;
+        uint8_t be = (payload[1] >> 16) & 0xff;
+        for (uint32_t i = 0; i < ndw; i++) {
+          uint32_t mask = 0xffffffff;
+          if (ndw == 1) {
+            mask = ((be & 1) ? 0xff : 0) | ((be & 2) ? 0xff00 : 0) |
+                   ((be & 4) ? 0xff0000 : 0) | ((be & 8) ? 0xff000000 : 0);
+          }
+          uint32_t *reg = &m_regs[(addr + i) % (BAR_SIZE >> 2)];
+          *reg = (*reg & ~mask) | (payload[2 + i] & mask);
+        }
+        uint32_t reply[2] = {(2 << 16) + CMD_ACK_WRITE, msgid};
+        queue(reply, 2);
+      } break;
+      case CMD_GET_TIME: {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        uint64_t ns = (tv.tv_sec * 1000000ull + tv.tv_usec) * 1000;
+        uint32_t reply[4] = {(4 << 16) + CMD_ACK_TIME, msgid,
+                             (uint32_t)(ns >> 32), (uint32_t)ns};
+        queue(reply, 4);
+      } break;
+      default:
+        break;
+      }
+      /** answer in batches, like a simulator stepping the clock */
+      if (m_pos == m_len) {
+        sendQueue();
+      }
+    }
+  }
+
+  uint64_t messages;
+
+protected:
+  int m_fd;
+  uint32_t *m_regs;
+  uint8_t m_rx[65536];
+  size_t m_pos;
+  size_t m_len;
+  vector<uint32_t> m_tx;
+
+  bool readDW(uint32_t *dw) {
+    size_t have = 0;
+    while (have < 4) {
+      if (m_pos == m_len) {
+        sendQueue();
+        ssize_t n = read(m_fd, m_rx, sizeof(m_rx));
+        if (n <= 0) {
+          return false;
+        }
+        m_pos = 0;
+        m_len = n;
+      }
+      ((uint8_t *)dw)[have++] = m_rx[m_pos++];
+    }
+    return true;
+  }
+
+  void queue(uint32_t *msg, size_t ndw) {
+    m_tx.insert(m_tx.end(), msg, msg + ndw);
+  }
+
+  void sendQueue() {
+    if (!m_tx.empty()) {
+      if (write(m_fd, &m_tx[0], m_tx.size() * 4) < 0) {
+        perror("write");
+      }
+      m_tx.clear();
+    }
+  }
+};
+
+double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void report(const char *name, uint64_t requests, double seconds) {
+  cout << setw(24) << left << name << right << setw(12) << fixed
+       << setprecision(0) << (requests / seconds) << " requests/s" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  uint64_t iterations = 100000;
+  int arg;
+  while ((arg = getopt(argc, argv, "hi:")) != -1) {
+    switch (arg) {
+    case 'i':
+      iterations = strtoull(optarg, NULL, 0);
+      break;
+    default:
+      cout << HELP_TEXT;
+      return (arg == 'h') ? 0 : -1;
+    }
+  }
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    perror("socketpair");
+    return -1;
+  }
+  fli_server server(fds[1]);
+  pthread_t server_thread;
+  pthread_create(&server_thread, NULL, fli_server::run_helper, &server);
+
+  librorc::bar *bar =
+      new librorc::bar(new librorc::bar_impl_sim(fds[0], 1, BAR_SIZE));
+  bool pass = true;
+
+  double start = now();
+  for (uint64_t i = 0; i < iterations; i++) {
+    bar->set32(i & 0xff, i);
+  }
+  report("set32", iterations, now() - start);
+
+  start = now();
+  uint32_t sum = 0;
+  for (uint64_t i = 0; i < iterations; i++) {
+    sum += bar->get32(i & 0xff);
+  }
+  report("get32", iterations, now() - start);
+
+  bar->setPostedWrites(true);
+  start = now();
+  for (uint64_t i = 0; i < iterations; i++) {
+    bar->set32(0x100 + (i & 0xff), i);
+  }
+  bar->flush(0);
+  report("set32 posted + flush", iterations, now() - start);
+  bar->setPostedWrites(false);
+
+  /** the last posted write to each register must have won */
+  for (uint64_t i = 0; i < 0x100 && i < iterations; i++) {
+    uint64_t last = ((iterations - 1 - i) & ~0xffull) + i;
+    if (bar->get32(0x100 + i) != (uint32_t)last) {
+      pass = false;
+    }
+  }
+
+  struct timeval tv;
+  bar->gettime(&tv, NULL);
+  cout << "FLI messages handled: " << server.messages << endl;
+
+  /** requests after the simulator went away must fail, not block */
+  signal(SIGPIPE, SIG_IGN);
+  alarm(10);
+  shutdown(fds[1], SHUT_RDWR);
+  pthread_join(server_thread, NULL);
+  bar->set32(0, 1);
+  bar->setPostedWrites(true);
+  bar->set32(1, 1);
+  bar->flush(0);
+  bar->setPostedWrites(false);
+  bool failed = (bar->get32(0) == 0) && (bar->gettime(&tv, NULL) < 0);
+  alarm(0);
+  cout << "disconnect " << (failed ? "detected" : "NOT detected") << endl;
+  pass &= failed;
+  cout << (pass ? "PASS" : "FAIL") << endl;
+
+  delete bar;
+  close(fds[1]);
+  return pass ? 0 : 1;
+}
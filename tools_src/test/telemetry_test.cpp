@@ -0,0 +1,208 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <librorc.h>
+#include "test_bar.hh"
+#include <iostream>
+#include <vector>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+/** device number of the test ring, chosen to not collide with boards */
+#define TEST_DEVICE 250
+#define PUBLISH_SAMPLES 200000
+
+/**
+ * BAR backend on plain memory. Every read of the uptime register starts
+ * a new sample: all PCIe error counters then return the same tick, so a
+ * torn sample shows up as differing counters.
+ **/
+class telemetry_bar : public test_bar {
+public:
+  telemetry_bar() {
+    /** QSFP0 present and out of reset, QSFP1/2 absent */
+    m_regs[RORC_REG_QSFP_LED_CTRL] = (1 << 3) | (1 << 10) | (1 << 18);
+    m_tick = 0;
+  }
+
+protected:
+  uint32_t read32(librorc::bar_address address) {
+    switch (address) {
+    case RORC_REG_UPTIME:
+      return ++m_tick;
+    case RORC_REG_SC_REQ_CANCELED:
+    case RORC_REG_DMA_TX_TIMEOUT:
+    case RORC_REG_ILLEGAL_REQ:
+    case RORC_REG_MULTIDWREAD:
+    case RORC_REG_PCIE_DST_BUSY:
+    case RORC_REG_PCIE_TERR_DROP:
+      return m_tick;
+    case RORC_REG_I2C_CONFIG:
+      return 1; /** transaction done */
+    default:
+      return m_regs[address];
+    }
+  }
+
+  uint32_t m_tick;
+};
+
+static bool consistent(const librorc::telemetry_sample &s) {
+  uint32_t t = s.pcie_request_canceled;
+  return s.pcie_tx_timeout == t && s.pcie_illegal_request == t &&
+         s.pcie_multi_dw_read == t && s.pcie_tx_destination_busy == t &&
+         s.pcie_transmission_error == t;
+}
+
+typedef struct {
+  volatile bool stop;
+  uint64_t reads;
+  uint64_t torn;
+  uint64_t backwards;
+} reader_state;
+
+/** attach as a separate reader and poll the latest sample */
+static void *reader(void *arg) {
+  reader_state *st = (reader_state *)arg;
+  librorc::telemetry tm(TEST_DEVICE);
+  librorc::telemetry_sample s;
+  uint32_t last = 0;
+  while (!st->stop) {
+    if (!tm.latest(&s)) {
+      continue;
+    }
+    st->reads++;
+    if (!consistent(s)) {
+      st->torn++;
+    }
+    if (s.pcie_request_canceled < last) {
+      st->backwards++;
+    }
+    last = s.pcie_request_canceled;
+  }
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  librorc::telemetry::removeSharedMemory(TEST_DEVICE);
+
+  librorc::bar *bar = new librorc::bar(new telemetry_bar());
+  librorc::sysmon *sm = new librorc::sysmon(bar);
+  librorc::telemetry *sampler = NULL;
+  try {
+    sampler = new librorc::telemetry(sm, TEST_DEVICE);
+  } catch (int e) {
+    cout << "telemetry init failed: " << librorc::errMsg(e) << endl;
+    return 1;
+  }
+  bool pass = true;
+
+  /** background sampling at a 5 ms cadence */
+  sampler->setInterval(5, 20);
+  sampler->start();
+  usleep(200000);
+  sampler->stop();
+
+  librorc::telemetry *rd = new librorc::telemetry(TEST_DEVICE);
+  vector<librorc::telemetry_sample> hist;
+  uint32_t n = rd->history(hist, 1000);
+  cout << "sampler thread: " << n << " samples in 200 ms" << endl;
+  if (n < 20 || n > 60) {
+    pass = false;
+  }
+  for (uint32_t i = 1; i < n; i++) {
+    if (hist[i].timestamp_us <= hist[i - 1].timestamp_us ||
+        !consistent(hist[i])) {
+      pass = false;
+    }
+  }
+  if (n && !(hist[n - 1].qsfp_valid & 1)) {
+    cout << "QSFP0 values missing" << endl;
+    pass = false;
+  }
+
+  /** concurrent readers while the sampler publishes as fast as it can */
+  reader_state st[2];
+  pthread_t th[2];
+  for (int i = 0; i < 2; i++) {
+    memset(&st[i], 0, sizeof(reader_state));
+    pthread_create(&th[i], NULL, reader, &st[i]);
+  }
+  sampler->setInterval(1, 0);
+  for (uint32_t i = 0; i < PUBLISH_SAMPLES; i++) {
+    sampler->sampleOnce();
+  }
+  for (int i = 0; i < 2; i++) {
+    st[i].stop = true;
+    pthread_join(th[i], NULL);
+    cout << "reader " << i << ": " << st[i].reads << " reads, " << st[i].torn
+         << " torn, " << st[i].backwards << " out of order" << endl;
+    if (st[i].torn || st[i].backwards || st[i].reads == 0) {
+      pass = false;
+    }
+  }
+
+  n = rd->history(hist, 100000);
+  cout << "history: " << n << " of " << rd->samplesWritten() << " samples"
+       << endl;
+  if (n != LIBRORC_TELEMETRY_SLOTS) {
+    pass = false;
+  }
+
+  /** a second sampler process must not become another writer */
+  pid_t second = fork();
+  if (second == 0) {
+    try {
+      librorc::telemetry other(sm, TEST_DEVICE);
+    } catch (int e) {
+      _exit(e == LIBRORC_TELEMETRY_ERROR_WRITER_ACTIVE ? 0 : 1);
+    }
+    _exit(1);
+  }
+  int status;
+  waitpid(second, &status, 0);
+  bool refused = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  cout << "second sampler: " << (refused ? "refused" : "NOT REFUSED") << endl;
+  if (!refused) {
+    pass = false;
+  }
+
+  cout << (pass ? "PASS" : "FAIL") << endl;
+
+  delete rd;
+  delete sampler;
+  librorc::telemetry::removeSharedMemory(TEST_DEVICE);
+  delete sm;
+  delete bar;
+  return pass ? 0 : 1;
+}
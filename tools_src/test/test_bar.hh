@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2015, Heiko Engel <hengel@cern.ch>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of University Frankfurt, CERN nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL A COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#ifndef TEST_BAR_H
+#define TEST_BAR_H
+
+#include <librorc.h>
+#include <librorc/bar_impl.hh>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define TEST_BAR_SIZE (1ul << 21)
+
+static inline uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * BAR backend on a plain register array for the tests. Counts reads,
+ * writes and flushes the way a device would see them: a burst is one
+ * access, a non-posted write or a flush is one flush. Tests model
+ * individual registers by overriding read32()/write32() and
+ * read16()/write16(); bursts are routed through them per word.
+ **/
+class test_bar : public librorc::bar_impl {
+public:
+  test_bar(size_t size = TEST_BAR_SIZE) : m_size(size) {
+    /** calloc leaves large arrays to lazily zeroed pages */
+    m_regs = (uint32_t *)calloc(size >> 2, sizeof(uint32_t));
+    reads = 0;
+    writes = 0;
+    flushes = 0;
+  }
+  virtual ~test_bar() { free(m_regs); }
+
+  void memcopy(librorc::bar_address target, const void *source, size_t num) {
+    store(target, source, num);
+    __sync_fetch_and_add(&writes, 1);
+    __sync_fetch_and_add(&flushes, 1);
+  }
+  void memcopy(void *target, librorc::bar_address source, size_t num) {
+    uint32_t *dest = (uint32_t *)target;
+    for (size_t i = 0; i < (num >> 2); i++) {
+      dest[i] = read32(source + i);
+    }
+    __sync_fetch_and_add(&reads, 1);
+  }
+  void memcopyPosted(librorc::bar_address target, const void *source,
+                     size_t num) {
+    store(target, source, num);
+    __sync_fetch_and_add(&writes, 1);
+  }
+  uint32_t get32(librorc::bar_address address) {
+    __sync_fetch_and_add(&reads, 1);
+    return read32(address);
+  }
+  uint16_t get16(librorc::bar_address address) {
+    __sync_fetch_and_add(&reads, 1);
+    return read16(address);
+  }
+  void set32(librorc::bar_address address, uint32_t data) {
+    __sync_fetch_and_add(&writes, 1);
+    __sync_fetch_and_add(&flushes, 1);
+    write32(address, data);
+  }
+  void set16(librorc::bar_address address, uint16_t data) {
+    __sync_fetch_and_add(&writes, 1);
+    __sync_fetch_and_add(&flushes, 1);
+    write16(address, data);
+  }
+  void flush(librorc::bar_address readback) {
+    __sync_fetch_and_add(&flushes, 1);
+    get32(readback);
+  }
+  int32_t gettime(struct timeval *tv, struct timezone *tz) {
+    return gettimeofday(tv, tz);
+  }
+  size_t size() { return m_size; }
+  void simSetPacketSize(uint32_t packet_size) {}
+
+  /** registers of a link, DDL registers behind the PCIe ones */
+  uint32_t *pci(uint32_t ch) {
+    return m_regs + (ch + 1) * RORC_CHANNEL_OFFSET;
+  }
+  uint32_t *ddl(uint32_t ch) { return pci(ch) + (1 << RORC_REGFILE_DDL_SEL); }
+
+  uint32_t *m_regs;
+  uint64_t reads;
+  uint64_t writes;
+  uint64_t flushes;
+
+protected:
+  virtual uint32_t read32(librorc::bar_address address) {
+    return m_regs[address];
+  }
+  virtual void write32(librorc::bar_address address, uint32_t data) {
+    m_regs[address] = data;
+  }
+  virtual uint16_t read16(librorc::bar_address address) {
+    return ((uint16_t *)m_regs)[address];
+  }
+  virtual void write16(librorc::bar_address address, uint16_t data) {
+    ((uint16_t *)m_regs)[address] = data;
+  }
+
+  void store(librorc::bar_address target, const void *source, size_t num) {
+    const uint32_t *src = (const uint32_t *)source;
+    for (size_t i = 0; i < (num >> 2); i++) {
+      write32(target + i, src[i]);
+    }
+  }
+
+  size_t m_size;
+};
+
+#endif /** TEST_BAR_H */